@@ -0,0 +1,891 @@
+#define _POSIX_C_SOURCE 200809L
+#include "image.h"
+#include "sift.h"
+#include "kmeans.h"
+#include "spm.h"
+#include "svm.h"
+#include "packed.h"
+#include "rng.h"
+#include "index.h"
+#include "simsearch.h"
+#include "tiled.h"
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+// 微基准测试: 在合成输入上测量流水线各个内核
+// 每行输出一个JSON对象，便于在不同提交之间比较:
+//   {"kernel": ..., "params": ..., "elements": ..., "reps": ..., "median_ns": ..., "mad_ns": ...,
+//    "throughput": ..., "cycles_per_element": ...}
+// cycles_per_element 使用TSC (标称频率)，不支持的平台输出 null
+
+#define BENCH_DEFAULT_WARMUP 1
+#define BENCH_DEFAULT_MIN_REPS 3
+#define BENCH_DEFAULT_MAX_REPS 50
+#define BENCH_DEFAULT_MIN_TIME_NS 200000000ULL  // 每个用例至少测量0.2秒
+
+typedef struct {
+    int warmup;
+    int min_reps;
+    int max_reps;
+    uint64_t min_time_ns;
+    int full;                 // 运行完整规模 (1024x1024图像、K=10000、1M描述符)
+    const char* filter;       // 只运行名称包含该字符串的内核
+} BenchConfig;
+
+typedef void (*BenchFn)(void* ctx);
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_cycles(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 可复现的合成数据 (xorshift64)
+static uint64_t bench_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t bench_next(void) {
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return bench_state;
+}
+
+static float bench_uniform(void) {
+    return (float)(bench_next() >> 40) / (float)(1 << 24);
+}
+
+static int compare_double(const void* a, const void* b) {
+    double va = *(const double*)a;
+    double vb = *(const double*)b;
+    return (va > vb) - (va < vb);
+}
+
+static double median_of(double* values, int n) {
+    qsort(values, n, sizeof(double), compare_double);
+    return (n % 2) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+static void run_case(const BenchConfig* config, const char* kernel, const char* params, double elements,
+                     BenchFn fn, void* ctx) {
+    if (config->filter && !strstr(kernel, config->filter)) {
+        return;
+    }
+
+    for (int i = 0; i < config->warmup; i++) {
+        fn(ctx);
+    }
+
+    double* times = (double*)malloc(config->max_reps * sizeof(double));
+    double* cycles = (double*)malloc(config->max_reps * sizeof(double));
+    int reps = 0;
+    uint64_t total = 0;
+
+    while (reps < config->max_reps && (reps < config->min_reps || total < config->min_time_ns)) {
+        uint64_t c0 = bench_cycles();
+        uint64_t t0 = bench_now_ns();
+        fn(ctx);
+        uint64_t t1 = bench_now_ns();
+        uint64_t c1 = bench_cycles();
+
+        times[reps] = (double)(t1 - t0);
+        cycles[reps] = (double)(c1 - c0);
+        total += t1 - t0;
+        reps++;
+    }
+
+    double median = median_of(times, reps);
+    for (int i = 0; i < reps; i++) {
+        times[i] = fabs(times[i] - median);
+    }
+    double mad = median_of(times, reps);
+    double median_cycles = median_of(cycles, reps);
+
+    printf("{\"kernel\": \"%s\", \"params\": \"%s\", \"elements\": %.0f, \"reps\": %d, "
+           "\"median_ns\": %.0f, \"mad_ns\": %.0f, \"throughput\": %.6g, ",
+           kernel, params, elements, reps, median, mad, median > 0 ? elements / (median * 1e-9) : 0.0);
+#ifdef BENCH_HAVE_TSC
+    printf("\"cycles_per_element\": %.4g}\n", median_cycles / elements);
+#else
+    (void)median_cycles;
+    printf("\"cycles_per_element\": null}\n");
+#endif
+    fflush(stdout);
+
+    free(times);
+    free(cycles);
+}
+
+// 合成输入
+static Image make_image(int size) {
+    Image img = create_image(size, size, CIFAR_IMAGE_CHANNELS);
+    // 平滑的渐变叠加噪声，保证梯度不为零
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            for (int c = 0; c < CIFAR_IMAGE_CHANNELS; c++) {
+                int v = (x * 3 + y * 5 + c * 40) % 256 + (int)(bench_uniform() * 32.0f);
+                img.data[(y * size + x) * CIFAR_IMAGE_CHANNELS + c] = (unsigned char)(v > 255 ? 255 : v);
+            }
+        }
+    }
+    return img;
+}
+
+static float** make_points(int n, int dim) {
+    float** data = allocate_float_matrix(n, dim);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < dim; j++) {
+            data[i][j] = bench_uniform();
+        }
+        normalize_vector(data[i], dim);
+    }
+    return data;
+}
+
+static Codebook make_codebook(int num_clusters) {
+    Codebook codebook;
+    codebook.num_clusters = num_clusters;
+    codebook.dim = SIFT_DESC_SIZE;
+    codebook.centers = make_points(num_clusters, SIFT_DESC_SIZE);
+    return codebook;
+}
+
+// 直接引用矩阵的行，避免逐个 add_descriptor
+static DescriptorList wrap_points(float** data, int n, int dim) {
+    DescriptorList list;
+    list.count = n;
+    list.descriptors = (Descriptor*)malloc(n * sizeof(Descriptor));
+    for (int i = 0; i < n; i++) {
+        list.descriptors[i].data = data[i];
+        list.descriptors[i].length = dim;
+        list.descriptors[i].x = 0.0f;
+        list.descriptors[i].y = 0.0f;
+    }
+    return list;
+}
+
+// 各内核的上下文与调用
+typedef struct {
+    const Image* img;
+    GrayImage gray;
+    Codebook* codebook;
+    int level;
+    Gray16Image gray16;
+    GrayImage gray_out;
+    OrientationPlanes planes;
+    float* descriptors;
+    float* positions;
+    int max_count;
+} ImageCtx;
+
+// 描述符累加: 硬分bin的单元格求和与查找表驱动的三线性插值，两者读取同一组预先计算的方向平面
+static void bench_descriptor_hard(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    extract_dense_sift_into(&ctx->planes, SPM_SIFT_STEP, ctx->descriptors, ctx->positions, ctx->max_count);
+}
+
+static void bench_descriptor_trilinear(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    extract_dense_sift_trilinear_into(&ctx->planes, SPM_SIFT_STEP, ctx->descriptors, ctx->positions,
+                                      ctx->max_count);
+}
+
+// 预处理前端: RGB → 灰度 → 方向平面，浮点与定点两条路径写入相同的预分配缓冲区
+static void bench_frontend_float(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    ImageView view = image_view(ctx->img);
+    convert_view_to_gray_into(&view, &ctx->gray_out);
+    compute_orientation_planes_into(&ctx->gray_out, &ctx->planes, SIFT_ORI_BINNING);
+}
+
+static void bench_frontend_fixed(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    ImageView view = image_view(ctx->img);
+    convert_view_to_gray16_into(&view, &ctx->gray16);
+    compute_orientation_planes_gray16_into(&ctx->gray16, &ctx->planes, SIFT_ORI_BINNING);
+}
+
+static void bench_gray_float(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    ImageView view = image_view(ctx->img);
+    convert_view_to_gray_into(&view, &ctx->gray_out);
+}
+
+static void bench_gray_fixed(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    ImageView view = image_view(ctx->img);
+    convert_view_to_gray16_into(&view, &ctx->gray16);
+}
+
+static void bench_gaussian_blur(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    GrayImage blurred = gaussian_blur(&ctx->gray, (float)SIFT_SIGMA);
+    free_gray_image(&blurred);
+}
+
+static void bench_gradient_atan2(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    GrayImage magnitude = compute_gradient_magnitude(&ctx->gray);
+    GrayImage orientation = compute_gradient_orientation(&ctx->gray);
+    free_gray_image(&magnitude);
+    free_gray_image(&orientation);
+}
+
+static void bench_orientation_planes(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    OrientationPlanes planes = compute_orientation_planes(&ctx->gray, SIFT_ORI_BINNING);
+    free_orientation_planes(&planes);
+}
+
+static void bench_dense_sift(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    DescriptorList list = extract_dense_sift(ctx->img, SPM_SIFT_STEP);
+    free_descriptor_list(&list);
+}
+
+static void bench_dense_sift_multiscale(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    DescriptorList list = extract_dense_sift_multiscale(ctx->img, SPM_SIFT_STEP, sift_default_cell_sizes,
+                                                        SIFT_NUM_DEFAULT_SCALES);
+    free_descriptor_list(&list);
+}
+
+static void bench_spatial_pyramid(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    SpmHistogram hist = build_spatial_pyramid(ctx->img, ctx->codebook, ctx->level);
+    free_spm_histogram(&hist);
+}
+
+static void bench_spatial_pyramid_tiled(void* p) {
+    ImageCtx* ctx = (ImageCtx*)p;
+    ImageView view = image_view(ctx->img);
+    SpmHistogram hist = build_spatial_pyramid_tiled(&view, ctx->codebook, ctx->level, TILED_DEFAULT_STRIP_ROWS);
+    free_spm_histogram(&hist);
+}
+
+typedef struct {
+    float** data;
+    int num_points;
+    Codebook* codebook;
+    int* assignments;
+    DescriptorList list;
+    PackedDescriptors packed;
+    PackedCodebook packed_u8;
+    PackedCodebook packed_f16;
+} ClusterCtx;
+
+static void bench_assign_clusters(void* p) {
+    ClusterCtx* ctx = (ClusterCtx*)p;
+    assign_clusters(ctx->data, ctx->num_points, ctx->codebook->dim, ctx->codebook->num_clusters,
+                    ctx->codebook->centers, ctx->assignments);
+}
+
+static void bench_quantize(void* p) {
+    ClusterCtx* ctx = (ClusterCtx*)p;
+    float* histogram = quantize_descriptors(&ctx->list, ctx->codebook);
+    free_float_array(histogram);
+}
+
+static void bench_quantize_packed_u8(void* p) {
+    ClusterCtx* ctx = (ClusterCtx*)p;
+    float* histogram = quantize_packed_descriptors(&ctx->packed, &ctx->packed_u8);
+    free_float_array(histogram);
+}
+
+static void bench_assign_packed_f16(void* p) {
+    ClusterCtx* ctx = (ClusterCtx*)p;
+    for (int i = 0; i < ctx->num_points; i++) {
+        ctx->assignments[i] = find_nearest_center_packed(ctx->data[i], &ctx->packed_f16);
+    }
+}
+
+// 紧凑格式与float最近中心的一致率
+static void report_packed_agreement(const BenchConfig* config, const char* params, ClusterCtx* ctx) {
+    if (config->filter && !strstr("packed_agreement", config->filter)) {
+        return;
+    }
+
+    int n = min_int(ctx->num_points, 10000);
+    int same_u8 = 0;
+    int same_f16 = 0;
+    for (int i = 0; i < n; i++) {
+        int reference = find_nearest_center(ctx->data[i], ctx->codebook);
+        same_u8 += find_nearest_center_u8(ctx->packed.data + (size_t)i * ctx->packed.dim, &ctx->packed_u8) == reference;
+        same_f16 += find_nearest_center_packed(ctx->data[i], &ctx->packed_f16) == reference;
+    }
+
+    printf("{\"kernel\": \"packed_agreement\", \"params\": \"%s\", \"impl\": \"%s\", "
+           "\"u8\": %.4f, \"f16\": %.4f, \"bytes_per_desc\": {\"float\": %d, \"f16\": %d, \"u8\": %d}}\n",
+           params, packed_kernel_name(), (double)same_u8 / n, (double)same_f16 / n,
+           ctx->packed.dim * (int)sizeof(float), ctx->packed.dim * 2, ctx->packed.dim);
+    fflush(stdout);
+}
+
+typedef struct {
+    double** data;
+    int* labels;
+    int num_samples;
+    int num_features;
+    int iterations;
+} SvmCtx;
+
+static void bench_svm_train(void* p) {
+    SvmCtx* ctx = (SvmCtx*)p;
+    SVMModel* model = svm_create(ctx->num_features, 0.01);
+    svm_train(model, ctx->data, ctx->labels, ctx->num_samples, ctx->iterations);
+    svm_free(model);
+}
+
+// 热启动与冷启动所需的对偶求解轮数: 追加1%样本、以及沿C路径训练
+static void report_svm_warm_start(const BenchConfig* config, const char* params, SvmCtx* ctx) {
+    if (config->filter && !strstr("svm_warm_start", config->filter)) {
+        return;
+    }
+
+    SVMSolverOptions solver = {500, SVM_DEFAULT_TOLERANCE, 1e-3};
+    int base = ctx->num_samples - ctx->num_samples / 100;
+
+    SVMModel* model = svm_create(ctx->num_features, 16.0);
+    SVMDualState state = svm_create_dual_state(base);
+    svm_train_dual(model, &state, ctx->data, ctx->labels, base, &solver);
+    int warm_append = svm_train_dual(model, &state, ctx->data, ctx->labels, ctx->num_samples, &solver);
+    svm_free_dual_state(&state);
+    svm_free(model);
+
+    model = svm_create(ctx->num_features, 16.0);
+    int cold_append = svm_train_dual(model, NULL, ctx->data, ctx->labels, ctx->num_samples, &solver);
+    svm_free(model);
+
+    const double Cs[] = {1.0, 2.0, 4.0, 8.0, 16.0};
+    SVMModel* path[5];
+    int warm_path[5];
+    int cold_path = 0;
+    int warm_total = 0;
+    svm_train_path(path, Cs, 5, ctx->data, ctx->labels, ctx->num_samples, ctx->num_features, &solver, warm_path);
+    for (int k = 0; k < 5; k++) {
+        svm_free(path[k]);
+        model = svm_create(ctx->num_features, Cs[k]);
+        cold_path += svm_train_dual(model, NULL, ctx->data, ctx->labels, ctx->num_samples, &solver);
+        warm_total += warm_path[k];
+        svm_free(model);
+    }
+
+    printf("{\"kernel\": \"svm_warm_start\", \"params\": \"%s\", "
+           "\"append_1pct\": {\"cold_epochs\": %d, \"warm_epochs\": %d}, "
+           "\"C_path\": {\"cold_epochs\": %d, \"warm_epochs\": %d}}\n",
+           params, cold_append, warm_append, cold_path, warm_total);
+    fflush(stdout);
+}
+
+static void run_image_kernels(const BenchConfig* config) {
+    const int sizes[] = {CIFAR_IMAGE_SIZE, 256, 1024};
+    Codebook codebook = make_codebook(100);
+
+    for (int s = 0; s < 3; s++) {
+        // 1024x1024只在完整模式下运行
+        if (sizes[s] > 256 && !config->full) {
+            continue;
+        }
+
+        char params[128];
+        Image img = make_image(sizes[s]);
+        int grid = dense_sift_grid_count(sizes[s], SPM_SIFT_STEP);
+        ImageCtx ctx = {&img, convert_to_gray(&img), &codebook, SPM_LEVEL_2, create_gray16_image(sizes[s], sizes[s]),
+                        create_gray_image(sizes[s], sizes[s]), create_orientation_planes(sizes[s], sizes[s]),
+                        NULL, NULL, grid * grid};
+        ctx.descriptors = (float*)malloc((size_t)ctx.max_count * SIFT_DESC_SIZE * sizeof(float));
+        ctx.positions = (float*)malloc((size_t)ctx.max_count * 2 * sizeof(float));
+        double pixels = (double)sizes[s] * sizes[s];
+
+        snprintf(params, sizeof(params), "%dx%d sigma=%.1f", sizes[s], sizes[s], SIFT_SIGMA);
+        run_case(config, "gaussian_blur", params, pixels, bench_gaussian_blur, &ctx);
+
+        snprintf(params, sizeof(params), "%dx%d", sizes[s], sizes[s]);
+        run_case(config, "gradient_atan2", params, pixels, bench_gradient_atan2, &ctx);
+        snprintf(params, sizeof(params), "%dx%d %s", sizes[s], sizes[s], orientation_kernel_name());
+        run_case(config, "orientation_planes", params, pixels, bench_orientation_planes, &ctx);
+
+        snprintf(params, sizeof(params), "%dx%d rgb", sizes[s], sizes[s]);
+        run_case(config, "gray_float", params, pixels, bench_gray_float, &ctx);
+        run_case(config, "gray_fixed", params, pixels, bench_gray_fixed, &ctx);
+        snprintf(params, sizeof(params), "%dx%d %s", sizes[s], sizes[s], orientation_kernel_name());
+        run_case(config, "frontend_float", params, pixels, bench_frontend_float, &ctx);
+        run_case(config, "frontend_fixed", params, pixels, bench_frontend_fixed, &ctx);
+
+        snprintf(params, sizeof(params), "%dx%d step=%d", sizes[s], sizes[s], SPM_SIFT_STEP);
+        run_case(config, "extract_dense_sift", params, pixels, bench_dense_sift, &ctx);
+        compute_orientation_planes_into(&ctx.gray, &ctx.planes, SIFT_ORI_BINNING);
+        run_case(config, "descriptor_hard", params, pixels, bench_descriptor_hard, &ctx);
+        snprintf(params, sizeof(params), "%dx%d step=%d %s", sizes[s], sizes[s], SPM_SIFT_STEP,
+                 sift_trilinear_kernel_name());
+        run_case(config, "descriptor_trilinear", params, pixels, bench_descriptor_trilinear, &ctx);
+
+        snprintf(params, sizeof(params), "%dx%d step=%d cells=4,6,8,10", sizes[s], sizes[s], SPM_SIFT_STEP);
+        run_case(config, "extract_dense_sift_multiscale", params, pixels, bench_dense_sift_multiscale, &ctx);
+
+        snprintf(params, sizeof(params), "%dx%d K=%d L=%d", sizes[s], sizes[s], codebook.num_clusters, ctx.level);
+        run_case(config, "build_spatial_pyramid", params, pixels, bench_spatial_pyramid, &ctx);
+        snprintf(params, sizeof(params), "%dx%d K=%d L=%d strip=%d", sizes[s], sizes[s], codebook.num_clusters,
+                 ctx.level, TILED_DEFAULT_STRIP_ROWS);
+        run_case(config, "build_spatial_pyramid_tiled", params, pixels, bench_spatial_pyramid_tiled, &ctx);
+
+        free_gray_image(&ctx.gray);
+        free_gray16_image(&ctx.gray16);
+        free_gray_image(&ctx.gray_out);
+        free_orientation_planes(&ctx.planes);
+        free(ctx.descriptors);
+        free(ctx.positions);
+        free_image(&img);
+    }
+
+    free_codebook(&codebook);
+}
+
+// 跨图像批处理: IMAGE_BATCH_LANES 幅CIFAR图像逐幅处理与交错批处理，输出写入相同的预分配缓冲区
+typedef struct {
+    ImageView views[IMAGE_BATCH_LANES];
+    Gray16Image gray;
+    OrientationPlanes planes;
+    Gray16Batch gray_batch;
+    OrientationPlanesBatch planes_batch;
+    float* descriptors[IMAGE_BATCH_LANES];
+    float* positions;
+    int max_count;
+} BatchCtx;
+
+static void bench_dense_sift_per_image(void* p) {
+    BatchCtx* ctx = (BatchCtx*)p;
+    for (int i = 0; i < IMAGE_BATCH_LANES; i++) {
+        convert_view_to_gray16_into(&ctx->views[i], &ctx->gray);
+        compute_orientation_planes_gray16_into(&ctx->gray, &ctx->planes, SIFT_ORI_BINNING);
+        extract_dense_sift_into(&ctx->planes, SPM_SIFT_STEP, ctx->descriptors[i], ctx->positions, ctx->max_count);
+    }
+}
+
+static void bench_dense_sift_batch(void* p) {
+    BatchCtx* ctx = (BatchCtx*)p;
+    convert_views_to_gray16_batch(ctx->views, IMAGE_BATCH_LANES, &ctx->gray_batch);
+    compute_orientation_planes_batch_into(&ctx->gray_batch, &ctx->planes_batch, SIFT_ORI_BINNING);
+    extract_dense_sift_batch_into(&ctx->planes_batch, SPM_SIFT_STEP, ctx->descriptors, ctx->positions, ctx->max_count);
+}
+
+static void run_batch_kernels(const BenchConfig* config) {
+    const int size = CIFAR_IMAGE_SIZE;
+    unsigned char* records = (unsigned char*)malloc((size_t)IMAGE_BATCH_LANES * CIFAR_RECORD_SIZE);
+    BatchCtx ctx;
+    ctx.max_count = dense_sift_grid_count(size, SPM_SIFT_STEP) * dense_sift_grid_count(size, SPM_SIFT_STEP);
+    for (int i = 0; i < IMAGE_BATCH_LANES; i++) {
+        unsigned char* record = records + (size_t)i * CIFAR_RECORD_SIZE;
+        for (int j = 0; j < CIFAR_RECORD_SIZE; j++) {
+            record[j] = (unsigned char)(bench_next() >> 56);
+        }
+        ctx.views[i] = cifar_record_view(record);
+        ctx.descriptors[i] = allocate_float_array(ctx.max_count * SIFT_DESC_SIZE);
+    }
+    ctx.positions = allocate_float_array(ctx.max_count * 2);
+    ctx.gray = create_gray16_image(size, size);
+    ctx.planes = create_orientation_planes(size, size);
+    ctx.gray_batch = create_gray16_batch(size, size);
+    ctx.planes_batch = create_orientation_planes_batch(size, size);
+
+    char params[128];
+    double pixels = (double)IMAGE_BATCH_LANES * size * size;
+    snprintf(params, sizeof(params), "%d x %dx%d step=%d %s", IMAGE_BATCH_LANES, size, size, SPM_SIFT_STEP,
+             orientation_kernel_name());
+    run_case(config, "dense_sift_per_image", params, pixels, bench_dense_sift_per_image, &ctx);
+    run_case(config, "dense_sift_batch", params, pixels, bench_dense_sift_batch, &ctx);
+
+    for (int i = 0; i < IMAGE_BATCH_LANES; i++) {
+        free_float_array(ctx.descriptors[i]);
+    }
+    free_float_array(ctx.positions);
+    free_gray16_image(&ctx.gray);
+    free_orientation_planes(&ctx.planes);
+    free_gray16_batch(&ctx.gray_batch);
+    free_orientation_planes_batch(&ctx.planes_batch);
+    free(records);
+}
+
+static void run_cluster_kernels(const BenchConfig* config) {
+    const int point_counts[] = {10000, 1000000};
+    const int cluster_counts[] = {100, 1000, 10000};
+
+    for (int n = 0; n < 2; n++) {
+        int num_points = point_counts[n];
+        // 1M描述符和K=10000只在完整模式下运行
+        if (num_points > 10000 && !config->full) {
+            continue;
+        }
+
+        float** data = make_points(num_points, SIFT_DESC_SIZE);
+        int* assignments = (int*)malloc(num_points * sizeof(int));
+        DescriptorList list = wrap_points(data, num_points, SIFT_DESC_SIZE);
+        PackedDescriptors packed = pack_descriptors(&list);
+
+        for (int k = 0; k < 3; k++) {
+            if (cluster_counts[k] > 1000 && !config->full) {
+                continue;
+            }
+
+            Codebook codebook = make_codebook(cluster_counts[k]);
+            ClusterCtx ctx = {data, num_points, &codebook, assignments, list, packed,
+                              pack_codebook(&codebook, PACKED_U8), pack_codebook(&codebook, PACKED_F16)};
+            double distances = (double)num_points * codebook.num_clusters;
+            char params[128];
+
+            snprintf(params, sizeof(params), "N=%d K=%d D=%d", num_points, codebook.num_clusters, SIFT_DESC_SIZE);
+            run_case(config, "assign_clusters", params, distances, bench_assign_clusters, &ctx);
+            run_case(config, "quantize_descriptors", params, distances, bench_quantize, &ctx);
+            run_case(config, "quantize_packed_u8", params, distances, bench_quantize_packed_u8, &ctx);
+            run_case(config, "assign_packed_f16", params, distances, bench_assign_packed_f16, &ctx);
+            report_packed_agreement(config, params, &ctx);
+
+            free_packed_codebook(&ctx.packed_u8);
+            free_packed_codebook(&ctx.packed_f16);
+            free_codebook(&codebook);
+        }
+
+        free_packed_descriptors(&packed);
+        free(list.descriptors);
+        free(assignments);
+        free_float_matrix(data, num_points);
+    }
+}
+
+static void run_svm_kernels(const BenchConfig* config) {
+    const int sample_counts[] = {1000, 10000};
+    int num_features = spm_histogram_length(100, SPM_LEVEL_2);
+
+    for (int n = 0; n < 2; n++) {
+        SvmCtx ctx;
+        ctx.num_samples = sample_counts[n];
+        ctx.num_features = num_features;
+        ctx.iterations = 5;
+        ctx.labels = (int*)malloc(ctx.num_samples * sizeof(int));
+        ctx.data = (double**)malloc(ctx.num_samples * sizeof(double*));
+
+        for (int i = 0; i < ctx.num_samples; i++) {
+            ctx.labels[i] = (bench_next() & 1) ? 1 : -1;
+            ctx.data[i] = (double*)malloc(num_features * sizeof(double));
+            for (int j = 0; j < num_features; j++) {
+                ctx.data[i][j] = bench_uniform() / num_features + (ctx.labels[i] > 0 && j % 7 == 0 ? 0.01 : 0.0);
+            }
+        }
+
+        char params[128];
+        snprintf(params, sizeof(params), "N=%d D=%d iters=%d", ctx.num_samples, num_features, ctx.iterations);
+        run_case(config, "svm_train", params, (double)ctx.num_samples * num_features * ctx.iterations,
+                 bench_svm_train, &ctx);
+        report_svm_warm_start(config, params, &ctx);
+
+        for (int i = 0; i < ctx.num_samples; i++) {
+            free(ctx.data[i]);
+        }
+        free(ctx.data);
+        free(ctx.labels);
+    }
+}
+
+typedef struct {
+    Rng rng;
+    float* values;
+    int* indices;
+    int count;
+} RngCtx;
+
+static void bench_rand_libc(void* p) {
+    RngCtx* ctx = (RngCtx*)p;
+    for (int i = 0; i < ctx->count; i++) {
+        ctx->values[i] = rand() / (float)RAND_MAX;
+    }
+}
+
+static void bench_rng_uniform(void* p) {
+    RngCtx* ctx = (RngCtx*)p;
+    for (int i = 0; i < ctx->count; i++) {
+        ctx->values[i] = rng_uniform_float(&ctx->rng);
+    }
+}
+
+static void bench_rng_fill_uniform(void* p) {
+    RngCtx* ctx = (RngCtx*)p;
+    rng_fill_uniform(&ctx->rng, ctx->values, ctx->count);
+}
+
+static void bench_rng_shuffle(void* p) {
+    RngCtx* ctx = (RngCtx*)p;
+    rng_shuffle_int(&ctx->rng, ctx->indices, ctx->count);
+}
+
+static void run_rng_kernels(const BenchConfig* config) {
+    RngCtx ctx;
+    ctx.rng = rng_create(RNG_DEFAULT_SEED);
+    ctx.count = 1 << 20;
+    ctx.values = (float*)malloc(ctx.count * sizeof(float));
+    ctx.indices = (int*)malloc(ctx.count * sizeof(int));
+    for (int i = 0; i < ctx.count; i++) {
+        ctx.indices[i] = i;
+    }
+
+    char params[128];
+    snprintf(params, sizeof(params), "N=%d kernel=%s", ctx.count, rng_kernel_name());
+    run_case(config, "rand_libc", params, ctx.count, bench_rand_libc, &ctx);
+    run_case(config, "rng_uniform", params, ctx.count, bench_rng_uniform, &ctx);
+    run_case(config, "rng_fill_uniform", params, ctx.count, bench_rng_fill_uniform, &ctx);
+    run_case(config, "rng_shuffle", params, ctx.count, bench_rng_shuffle, &ctx);
+
+    free(ctx.values);
+    free(ctx.indices);
+}
+
+// 合成的检索数据: 每幅"图像"为 32x32 上 36 个随机视觉词，近重复查询替换其中约 10% 的词
+#define INDEX_BENCH_WORDS 1000
+#define INDEX_BENCH_DESCRIPTORS 36
+
+typedef struct {
+    InvertedIndex* index;
+    SpmHistogram* queries;
+    int num_queries;
+    IndexHit* hits;
+    int* num_hits;
+    int k;
+    int max_terms;
+    int threads;
+    SpmHistogram* dense;     // 暴力扫描的对照集
+    int num_dense;
+} IndexCtx;
+
+// 生成第 doc 幅图像的直方图 (perturb 非0时替换部分视觉词)
+static void make_index_doc(float* histogram, int length, int doc, int perturb) {
+    Rng rng = rng_create(0x1DE7ULL + (uint64_t)doc);
+    Rng noise = rng_create(0xD0C5ULL ^ ((uint64_t)doc << 20));
+    memset(histogram, 0, length * sizeof(float));
+    for (int i = 0; i < INDEX_BENCH_DESCRIPTORS; i++) {
+        int word = (int)rng_bounded(&rng, INDEX_BENCH_WORDS);
+        float x = rng_uniform_float(&rng) * 32.0f;
+        float y = rng_uniform_float(&rng) * 32.0f;
+        if (perturb && rng_bounded(&noise, 10) == 0) {
+            word = (int)rng_bounded(&noise, INDEX_BENCH_WORDS);
+        }
+        spm_accumulate_word(histogram, INDEX_BENCH_WORDS, SPM_LEVEL_2, word, x, y, 32, 32,
+                            1.0f / INDEX_BENCH_DESCRIPTORS);
+    }
+}
+
+static void bench_index_query(void* p) {
+    IndexCtx* ctx = (IndexCtx*)p;
+    inverted_index_query_batch(ctx->index, ctx->queries, ctx->num_queries, ctx->k, ctx->max_terms, ctx->threads,
+                               ctx->hits, ctx->num_hits);
+}
+
+static void bench_spm_similarity_scan(void* p) {
+    IndexCtx* ctx = (IndexCtx*)p;
+    float best = -FLT_MAX;
+    for (int i = 0; i < ctx->num_dense; i++) {
+        float s = compute_spm_similarity(&ctx->queries[0], &ctx->dense[i]);
+        if (s > best) best = s;
+    }
+    ctx->hits[0].score = best;
+}
+
+static void run_index_kernels(const BenchConfig* config) {
+    int num_docs = config->full ? 1000000 : 100000;
+    int length = spm_histogram_length(INDEX_BENCH_WORDS, SPM_LEVEL_2);
+    float* histogram = (float*)malloc(length * sizeof(float));
+    int* terms = (int*)malloc(length * sizeof(int));
+    float* tf = (float*)malloc(length * sizeof(float));
+
+    IndexCtx ctx;
+    ctx.index = inverted_index_create(length);
+    uint64_t t0 = bench_now_ns();
+    for (int d = 0; d < num_docs; d++) {
+        make_index_doc(histogram, length, d, 0);
+        int count = 0;
+        for (int t = 0; t < length; t++) {
+            if (histogram[t] > 0.0f) {
+                terms[count] = t;
+                tf[count++] = histogram[t];
+            }
+        }
+        inverted_index_add_sparse(ctx.index, terms, tf, count);
+    }
+    inverted_index_build(ctx.index);
+    double build_s = (bench_now_ns() - t0) / 1e9;
+
+    ctx.num_queries = 1000;
+    ctx.k = 10;
+    ctx.queries = (SpmHistogram*)malloc(ctx.num_queries * sizeof(SpmHistogram));
+    for (int q = 0; q < ctx.num_queries; q++) {
+        ctx.queries[q].length = length;
+        ctx.queries[q].histogram = (float*)malloc(length * sizeof(float));
+        make_index_doc(ctx.queries[q].histogram, length, (int)((uint64_t)q * 7919 % num_docs), 1);
+    }
+    ctx.hits = (IndexHit*)malloc((size_t)ctx.num_queries * ctx.k * sizeof(IndexHit));
+    ctx.num_hits = (int*)malloc(ctx.num_queries * sizeof(int));
+    ctx.num_dense = 2000;
+    ctx.dense = (SpmHistogram*)malloc(ctx.num_dense * sizeof(SpmHistogram));
+    for (int i = 0; i < ctx.num_dense; i++) {
+        ctx.dense[i].length = length;
+        ctx.dense[i].histogram = (float*)malloc(length * sizeof(float));
+        make_index_doc(ctx.dense[i].histogram, length, i, 0);
+    }
+
+    char params[128];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    ctx.threads = 1;
+    ctx.max_terms = 0;
+    snprintf(params, sizeof(params), "N=%d terms=%d queries=%d k=%d threads=1", num_docs, length,
+             ctx.num_queries, ctx.k);
+    run_case(config, "index_query", params, ctx.num_queries, bench_index_query, &ctx);
+    ctx.max_terms = 32;
+    snprintf(params, sizeof(params), "N=%d terms=%d queries=%d k=%d threads=1 max_terms=32", num_docs, length,
+             ctx.num_queries, ctx.k);
+    run_case(config, "index_query_pruned", params, ctx.num_queries, bench_index_query, &ctx);
+    ctx.threads = cpus > 0 ? (int)cpus : 1;
+    snprintf(params, sizeof(params), "N=%d terms=%d queries=%d k=%d threads=%d max_terms=32", num_docs, length,
+             ctx.num_queries, ctx.k, ctx.threads);
+    run_case(config, "index_query_batch", params, ctx.num_queries, bench_index_query, &ctx);
+    snprintf(params, sizeof(params), "N=%d terms=%d", ctx.num_dense, length);
+    run_case(config, "spm_similarity_scan", params, ctx.num_dense, bench_spm_similarity_scan, &ctx);
+
+    if (!config->filter || strstr("index_recall", config->filter)) {
+        inverted_index_query_batch(ctx.index, ctx.queries, ctx.num_queries, ctx.k, 32, 1, ctx.hits, ctx.num_hits);
+        int found = 0;
+        for (int q = 0; q < ctx.num_queries; q++) {
+            found += ctx.num_hits[q] > 0 && ctx.hits[(size_t)q * ctx.k].doc == (int)((uint64_t)q * 7919 % num_docs);
+        }
+        printf("{\"kernel\": \"index_recall\", \"params\": \"N=%d max_terms=32\", \"top1\": %.4f, \"build_s\": %.3f, "
+               "\"postings\": %lld, \"bytes\": %lld}\n",
+               num_docs, (double)found / ctx.num_queries, build_s, (long long)ctx.index->num_postings,
+               (long long)(ctx.index->num_postings * (sizeof(uint32_t) + sizeof(float))));
+        fflush(stdout);
+    }
+
+    for (int q = 0; q < ctx.num_queries; q++) {
+        free_spm_histogram(&ctx.queries[q]);
+    }
+    for (int i = 0; i < ctx.num_dense; i++) {
+        free_spm_histogram(&ctx.dense[i]);
+    }
+    free(ctx.queries);
+    free(ctx.dense);
+    free(ctx.hits);
+    free(ctx.num_hits);
+    inverted_index_free(ctx.index);
+    free(histogram);
+    free(terms);
+    free(tf);
+}
+
+typedef struct {
+    SpmHistogram* queries;
+    SpmHistogram* gallery;
+    int num_queries;
+    int num_gallery;
+    SpmSimilarity kind;
+    int k;
+    int threads;
+    IndexHit* hits;
+    int* num_hits;
+} TopKCtx;
+
+static void bench_spm_topk(void* p) {
+    TopKCtx* ctx = (TopKCtx*)p;
+    spm_topk_search(ctx->queries, ctx->num_queries, ctx->gallery, ctx->num_gallery, ctx->kind, ctx->k,
+                    ctx->threads, ctx->hits, ctx->num_hits, NULL);
+}
+
+// 暴力 top-k: elements 为 (查询, 图库) 对数，throughput 即 pairs/sec
+static void run_topk_kernels(const BenchConfig* config) {
+    TopKCtx ctx;
+    int length = spm_histogram_length(200, SPM_LEVEL_2);
+    ctx.num_queries = 64;
+    ctx.num_gallery = config->full ? 50000 : 4000;
+    ctx.k = 10;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    ctx.threads = cpus > 0 ? (int)cpus : 1;
+    ctx.queries = (SpmHistogram*)malloc(ctx.num_queries * sizeof(SpmHistogram));
+    ctx.gallery = (SpmHistogram*)malloc(ctx.num_gallery * sizeof(SpmHistogram));
+    ctx.hits = (IndexHit*)malloc((size_t)ctx.num_queries * ctx.k * sizeof(IndexHit));
+    ctx.num_hits = (int*)malloc(ctx.num_queries * sizeof(int));
+
+    // 稀疏的非负直方图 (每幅图像约 36 个描述符 × 3 层)
+    for (int i = 0; i < ctx.num_queries + ctx.num_gallery; i++) {
+        SpmHistogram* h = i < ctx.num_queries ? &ctx.queries[i] : &ctx.gallery[i - ctx.num_queries];
+        h->length = length;
+        h->histogram = (float*)calloc(length, sizeof(float));
+        for (int j = 0; j < 108; j++) {
+            h->histogram[bench_next() % length] += bench_uniform() / 36.0f;
+        }
+    }
+
+    const char* names[3] = {"spm_topk_chi2", "spm_topk_intersection", "spm_topk_l2"};
+    char params[128];
+    snprintf(params, sizeof(params), "Q=%d G=%d D=%d k=%d threads=%d kernel=%s", ctx.num_queries,
+             ctx.num_gallery, length, ctx.k, ctx.threads, simsearch_kernel_name());
+    for (int kind = 0; kind < 3; kind++) {
+        ctx.kind = (SpmSimilarity)kind;
+        run_case(config, names[kind], params, (double)ctx.num_queries * ctx.num_gallery, bench_spm_topk, &ctx);
+    }
+
+    for (int i = 0; i < ctx.num_queries; i++) {
+        free_spm_histogram(&ctx.queries[i]);
+    }
+    for (int i = 0; i < ctx.num_gallery; i++) {
+        free_spm_histogram(&ctx.gallery[i]);
+    }
+    free(ctx.queries);
+    free(ctx.gallery);
+    free(ctx.hits);
+    free(ctx.num_hits);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--full] [--filter NAME] [--reps N] [--warmup N] [--min-time MS]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {BENCH_DEFAULT_WARMUP, BENCH_DEFAULT_MIN_REPS, BENCH_DEFAULT_MAX_REPS,
+                          BENCH_DEFAULT_MIN_TIME_NS, 0, NULL};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--full") == 0) {
+            config.full = 1;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            config.filter = argv[++i];
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            config.min_reps = atoi(argv[++i]);
+            if (config.min_reps < 1) config.min_reps = 1;
+            if (config.max_reps < config.min_reps) config.max_reps = config.min_reps;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            config.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            config.min_time_ns = (uint64_t)atoll(argv[++i]) * 1000000ULL;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    run_image_kernels(&config);
+    run_batch_kernels(&config);
+    run_cluster_kernels(&config);
+    run_svm_kernels(&config);
+    run_rng_kernels(&config);
+    run_index_kernels(&config);
+    run_topk_kernels(&config);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "spm.h"
+
+// 特征缓存参数
+#define FEATURE_CACHE_VERSION 2        // 特征提取实现变化时递增，使旧缓存失效
+#define FEATURE_CACHE_DEFAULT_SHARDS 16
+
+// 单个分片文件: 追加写入，读取时通过 mmap 访问
+typedef struct {
+    int fd;                   // 文件描述符
+    unsigned char* map;       // 映射区域
+    size_t map_size;          // 已映射的字节数
+    size_t file_size;         // 文件的有效长度
+    uint64_t* keys;           // 开放寻址哈希表: 键
+    uint64_t* offsets;        // 开放寻址哈希表: 记录在文件中的偏移
+    int capacity;             // 哈希表容量 (2的幂)
+    int count;                // 记录数量
+} CacheShard;
+
+// 以内容哈希为键的特征缓存
+// 分两级存储: 密集SIFT描述符 (键: 图像内容+提取参数) 和
+// SPM直方图 (键: SIFT键+金字塔层数+码本哈希)，参数变化时只重算受影响的阶段
+struct FeatureCache {
+    char dir[512];            // 缓存目录
+    int num_shards;           // 每一级的分片数量
+    CacheShard* sift_shards;  // SIFT描述符分片
+    CacheShard* spm_shards;   // SPM直方图分片
+    pthread_mutex_t lock;     // 保护分片与统计
+    long sift_hits, sift_misses;
+    long spm_hits, spm_misses;
+    size_t bytes_read;        // 从缓存读取的字节数
+    size_t bytes_written;     // 写入缓存的字节数
+};
+
+// 打开/关闭缓存目录 (目录不存在时自动创建)
+FeatureCache* feature_cache_open(const char* dir, int num_shards);
+void feature_cache_close(FeatureCache* cache);
+
+// 计算缓存键
+uint64_t feature_cache_hash(const void* data, size_t size, uint64_t seed);
+uint64_t feature_cache_sift_key(const Image* img, int step);
+uint64_t feature_cache_codebook_key(const Codebook* codebook);
+uint64_t feature_cache_spm_key(uint64_t sift_key, int level, uint64_t codebook_key);
+
+// 查询与写入，命中返回1并填充 out (调用者负责释放)
+int feature_cache_get_sift(FeatureCache* cache, uint64_t key, DescriptorList* out);
+void feature_cache_put_sift(FeatureCache* cache, uint64_t key, const DescriptorList* descriptors);
+int feature_cache_get_spm(FeatureCache* cache, uint64_t key, SpmHistogram* out);
+void feature_cache_put_spm(FeatureCache* cache, uint64_t key, const SpmHistogram* hist);
+
+// 打印命中/未命中统计
+void feature_cache_print_stats(const FeatureCache* cache);
+
+#endif /* CACHE_H */
@@ -0,0 +1,59 @@
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include "inference.h"
+
+// 由粗到细的级联SPM分类
+// 粗网格为密集网格中下标均为 CASCADE_COARSE_STRIDE 倍数的点 (约1/4的描述符)。
+// 阶段 l (0 <= l < num_coarse) 只用粗网格描述符构建 0..l 层金字塔，由该阶段的一对多子模型打分；
+// 最后阶段补齐细网格描述符，构建完整金字塔并交给完整模型。
+// 最大与次大决策值之差 (边距) 不低于该阶段阈值时即停止，较细的层和其余描述符不再计算。
+// 阈值在留出样本上校准: 取使边距不低于阈值的样本与完整模型预测一致的比例达到目标值的最小阈值。
+
+#define CASCADE_COARSE_STRIDE 2
+#define CASCADE_MAX_STAGES 8
+#define CASCADE_DEFAULT_AGREEMENT 0.99
+// 训练集末尾留出用于校准的比例 (子模型不在这部分样本上训练)
+#define CASCADE_CALIBRATION_FRACTION 0.1
+
+typedef struct {
+    int level;               // 完整金字塔层数
+    int num_coarse;          // 粗网格阶段数: max(level, 1)
+    int num_classes;         // 类别数量
+    int num_clusters;        // 码本大小
+    SVMModel** models;       // 子模型 models[stage * num_classes + c]
+    double thresholds[CASCADE_MAX_STAGES];  // 各粗网格阶段的边距阈值 (DBL_MAX 表示从不在该阶段停止)
+} CascadeClassifier;
+
+typedef struct {
+    long images;                          // 分类的图像数
+    long computed[CASCADE_MAX_STAGES];    // 计算到各阶段的图像数 (下标 num_coarse 为完整金字塔)
+    long descriptors;                     // 实际提取的描述符数
+    long dense_descriptors;               // 完整路径需要的描述符数
+} CascadeStats;
+
+int cascade_num_coarse(int level);
+
+// 粗网格特征: 各粗网格阶段的直方图依次拼接，阶段 l 为 spm_histogram_length(K, l) 个值
+int cascade_feature_length(int num_clusters, int level);
+int cascade_stage_offset(int num_clusters, int stage);
+// 将一个粗网格上的视觉词累加到所有粗网格阶段 (scale 为 1/粗网格描述符数)
+void cascade_accumulate_word(float* features, int num_clusters, int level, int word,
+                             float x, float y, int width, int height, float scale);
+
+// 在粗网格特征上训练各阶段的一对多子模型 (svm_iterations/dual 的含义与 train 命令相同)，阈值初始为 DBL_MAX
+CascadeClassifier* cascade_train(double** features, const int* labels, int num_samples, int num_clusters,
+                                 int level, int num_classes, double C, int svm_iterations, int dual);
+// 按与完整模型预测 (full_predictions) 的一致率校准各阶段阈值
+void cascade_calibrate(CascadeClassifier* cascade, double** features, const int* full_predictions,
+                       int num_samples, double agreement);
+void cascade_free(CascadeClassifier* cascade);
+
+// 级联分类单幅图像，完整阶段使用 workspace 中的完整模型；返回类别，失败返回-1
+// stage 可为NULL，返回作出决定的阶段；stats 可为NULL
+int classify_image_cascade_view(InferenceWorkspace* workspace, const CascadeClassifier* cascade,
+                                const ImageView* view, int* stage, CascadeStats* stats);
+
+void cascade_print_stats(const CascadeClassifier* cascade, const CascadeStats* stats);
+
+#endif /* CASCADE_H */
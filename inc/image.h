@@ -1,6 +1,7 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <stddef.h>
 #include "utils.h"
 
 // 图像数据结构
@@ -18,11 +19,55 @@ typedef struct {
     int height;       // 图像高度
 } GrayImage;
 
+// 定点灰度图像: 值 = 灰度 × GRAY16_SCALE (0-32640)，中心差分的结果仍在int16范围内
+#define GRAY16_SCALE 32640
+
+typedef struct {
+    int16_t* data;
+    int width;
+    int height;
+} Gray16Image;
+
+// 跨图像批处理: IMAGE_BATCH_LANES 幅同尺寸图像按 (像素优先、图像其次) 交错存放，
+// data[(y * width + x) * IMAGE_BATCH_LANES + lane]。每个SIMD通道处理不同图像的同一像素位置，
+// 边界判断对所有通道相同，32x32的CIFAR图像也能用满向量宽度
+#define IMAGE_BATCH_LANES 8
+
+typedef struct {
+    int16_t* data;      // 交错的定点灰度
+    int16_t* scratch;   // 单幅图像的转换缓冲区 (width*height)
+    int width;
+    int height;
+    int count;          // 有效图像数，其余通道置0
+} Gray16Batch;
+
+// 零拷贝的图像视图: 像素(x,y)的通道c位于 data[y*row_stride + x*pixel_stride + c*channel_stride]
+// 通过调整步长即可表示子区域、翻转 (负步长) 和CIFAR的按通道平面布局，而无需复制像素
+typedef struct {
+    const unsigned char* data;  // 像素(0,0)通道0的地址
+    int width;
+    int height;
+    int channels;
+    ptrdiff_t row_stride;       // 相邻行的偏移 (字节)
+    ptrdiff_t pixel_stride;     // 相邻像素的偏移 (字节)
+    ptrdiff_t channel_stride;   // 相邻通道的偏移 (字节)
+} ImageView;
+
+// 灰度图像视图，步长以float为单位
+typedef struct {
+    const float* data;
+    int width;
+    int height;
+    ptrdiff_t row_stride;
+    ptrdiff_t pixel_stride;
+} GrayView;
+
 // CIFAR-10相关
 #define CIFAR_IMAGE_SIZE 32
 #define CIFAR_IMAGE_CHANNELS 3
 #define CIFAR_BATCH_SIZE 10000
 #define CIFAR_NUM_CLASSES 10
+#define CIFAR_RECORD_SIZE (1 + CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE * CIFAR_IMAGE_CHANNELS)
 
 typedef struct {
     Image* images;          // 图像数组
@@ -35,18 +80,51 @@ Image create_image(int width, int height, int channels);
 void free_image(Image* img);
 GrayImage create_gray_image(int width, int height);
 void free_gray_image(GrayImage* img);
+Gray16Image create_gray16_image(int width, int height);
+void free_gray16_image(Gray16Image* img);
+Gray16Batch create_gray16_batch(int width, int height);
+void free_gray16_batch(Gray16Batch* batch);
+
+// 视图构造 (子区域按 extract_sub_image 的规则裁剪到图像范围内)
+ImageView image_view(const Image* img);
+ImageView cifar_record_view(const unsigned char* record);
+ImageView image_view_roi(const ImageView* view, int x, int y, int width, int height);
+ImageView image_view_flip_horizontal(const ImageView* view);
+ImageView image_view_flip_vertical(const ImageView* view);
+GrayView gray_view(const GrayImage* img);
+GrayView gray_view_roi(const GrayView* view, int x, int y, int width, int height);
+// 读取视图像素，越界坐标复制边界 (与 get_pixel_gray 相同)
+float gray_view_pixel(const GrayView* view, int x, int y);
 
 // 图像转换
 GrayImage convert_to_gray(const Image* img);
 float get_pixel_gray(const GrayImage* img, int x, int y);
 void set_pixel_gray(GrayImage* img, int x, int y, float value);
+void convert_to_gray_into(const Image* img, GrayImage* gray);
+void convert_view_to_gray_into(const ImageView* view, GrayImage* gray);
+// 定点灰度转换: BT.709权重取Q15定点，整数运算 (AVX2每次16个像素)
+// 结果除以 GRAY16_SCALE 后与 convert_view_to_gray_into 之差小于 1/GRAY16_SCALE
+void convert_view_to_gray16_into(const ImageView* view, Gray16Image* gray);
+// 批量定点灰度转换: 至多 IMAGE_BATCH_LANES 幅与批同尺寸的图像，每个通道与 convert_view_to_gray16_into 结果相同
+// 尺寸不符或数量超出时返回0
+int convert_views_to_gray16_batch(const ImageView* views, int count, Gray16Batch* batch);
 
 // 图像操作
 GrayImage compute_gradient_magnitude(const GrayImage* img);
 GrayImage compute_gradient_orientation(const GrayImage* img);
 GrayImage gaussian_blur(const GrayImage* img, float sigma);
 
+// 写入预分配输出的版本 (输出缓冲区至少容纳 width*height 个像素，不进行堆分配)
+void compute_gradient_magnitude_into(const GrayImage* img, GrayImage* magnitude);
+void compute_gradient_orientation_into(const GrayImage* img, GrayImage* orientation);
+
+// 视图版本: 子区域的边界按视图自身的边界处理，结果与先复制子图像再计算相同
+void compute_gradient_magnitude_view_into(const GrayView* view, GrayImage* magnitude);
+void compute_gradient_orientation_view_into(const GrayView* view, GrayImage* orientation);
+GrayImage gaussian_blur_view(const GrayView* view, float sigma);
+
 // CIFAR-10操作
+Image decode_cifar_record(const unsigned char* record);
 CifarDataset load_cifar10_batch(const char* filename);
 void free_cifar_dataset(CifarDataset* dataset);
 Image get_cifar_image(const CifarDataset* dataset, int index);
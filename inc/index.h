@@ -0,0 +1,69 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "spm.h"
+
+// 基于视觉词的倒排索引，用于SPM图像检索
+// 词项是SPM直方图的一个分量 (视觉词 × 金字塔单元)，每个词项一个倒排表 (文档, 词频)
+// 打分为 tf-idf 加权的余弦相似度，只访问查询中出现的词项的倒排表，
+// 因此代价取决于这些倒排表的总长度而不是索引中的图像数
+
+typedef struct {
+    int num_terms;            // 词项数 (直方图长度)
+    int num_docs;             // 已加入的文档数 (含尚未构建的)
+    int num_built_docs;       // 已构建部分的文档数
+
+    // 已构建部分 (CSR): 词项 t 的倒排表为 [offsets[t], offsets[t+1])
+    int64_t* offsets;
+    uint32_t* docs;
+    float* tf;
+    int64_t num_postings;
+    float* idf;               // log(N / df)，出现在所有文档中的词项为0
+    float* inv_norms;         // 每个文档 tf-idf 向量的 1/L2范数
+
+    // 待构建的倒排表 (inverted_index_add 追加，inverted_index_build 并入)
+    uint32_t** pending_docs;
+    float** pending_tf;
+    int* pending_count;
+    int* pending_capacity;
+} InvertedIndex;
+
+typedef struct {
+    int doc;
+    float score;
+} IndexHit;
+
+// 每个查询线程一个的打分缓冲区 (查询结束时只清零被访问过的文档)
+typedef struct {
+    float* scores;
+    uint32_t* touched;
+    int num_touched;
+    int capacity;
+} IndexScratch;
+
+InvertedIndex* inverted_index_create(int num_terms);
+void inverted_index_free(InvertedIndex* index);
+
+// 加入一个文档 (非零分量即为其词项)，返回文档编号；加入后须调用 inverted_index_build 才能被查询到
+int inverted_index_add(InvertedIndex* index, const SpmHistogram* hist);
+int inverted_index_add_sparse(InvertedIndex* index, const int* terms, const float* tf, int count);
+// 并入待构建的文档，重新计算 idf 与文档范数
+void inverted_index_build(InvertedIndex* index);
+
+IndexScratch inverted_index_scratch(const InvertedIndex* index);
+void free_index_scratch(IndexScratch* scratch);
+
+// 返回得分最高的至多 k 个文档 (按得分降序写入 hits)，返回命中数
+// max_terms > 0 时只使用查询中 tf-idf 权重最大的 max_terms 个词项
+// 构建完成后可多线程并发查询，每个线程使用自己的 scratch
+int inverted_index_query(const InvertedIndex* index, const SpmHistogram* query, int k, int max_terms,
+                         IndexScratch* scratch, IndexHit* hits);
+// 批量查询: 第 q 个查询的结果写入 hits[q*k ...]，命中数写入 num_hits[q]
+void inverted_index_query_batch(const InvertedIndex* index, const SpmHistogram* queries, int num_queries, int k,
+                                int max_terms, int num_threads, IndexHit* hits, int* num_hits);
+
+// 保存/加载已构建的索引 (存在待构建的文档时保存失败)，成功返回1
+int inverted_index_save(const InvertedIndex* index, const char* filename);
+InvertedIndex* inverted_index_load(const char* filename);
+
+#endif /* INDEX_H */
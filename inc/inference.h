@@ -0,0 +1,49 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "spm.h"
+#include "svm.h"
+#include "orientation.h"
+
+// 单幅图像推理的工作区
+// 所有缓冲区按最大图像尺寸、码本和金字塔层数一次性分配，
+// classify_image 在热路径上不进行任何堆分配
+typedef struct {
+    int max_width;           // 支持的最大图像宽度
+    int max_height;          // 支持的最大图像高度
+    int level;               // 金字塔层数
+    int step;                // 密集SIFT采样步长
+
+    Codebook* codebook;      // 码本 (不持有)
+    SVMModel** models;       // 一对多SVM模型 (不持有)
+    int num_classes;         // 类别数量
+
+    Gray16Image gray;        // 定点灰度图像缓冲区
+    OrientationPlanes planes;  // 方向平面缓冲区
+
+    float* descriptors;      // 描述符缓冲区 (max_descriptors * SIFT_DESC_SIZE)
+    float* positions;        // 描述符坐标 (max_descriptors * 2)
+    int max_descriptors;     // 描述符缓冲区容量
+    int num_descriptors;     // 最近一次提取的描述符数量
+    int* words;              // 每个描述符的视觉词 (级联分类使用，见 cascade.h)
+
+    float* histogram;        // SPM直方图
+    int histogram_length;    // 直方图长度
+    double* features;        // 送入SVM的特征向量
+    double* scores;          // 每个类别的决策值
+} InferenceWorkspace;
+
+// 创建/释放工作区
+InferenceWorkspace* create_inference_workspace(int max_width, int max_height, Codebook* codebook, int level,
+                                               SVMModel** models, int num_classes);
+void free_inference_workspace(InferenceWorkspace* workspace);
+
+// 计算图像的SPM特征，结果保存在 workspace->histogram 中，失败返回0
+int compute_spm_feature_into(InferenceWorkspace* workspace, const Image* img);
+int compute_spm_feature_view_into(InferenceWorkspace* workspace, const ImageView* view);
+
+// 对单幅图像分类，返回类别 (决策值保存在 workspace->scores)，失败返回-1
+int classify_image(InferenceWorkspace* workspace, const Image* img);
+int classify_image_view(InferenceWorkspace* workspace, const ImageView* view);
+
+#endif /* INFERENCE_H */
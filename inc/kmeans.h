@@ -2,6 +2,8 @@
 #define KMEANS_H
 
 #include "utils.h"
+#include "packed.h"
+#include "store.h"
 
 // K-means聚类结果
 typedef struct {
@@ -12,22 +14,79 @@ typedef struct {
     int num_points;     // 数据点数量
 } KMeansResult;
 
-// 执行K-means聚类
+// 执行K-means聚类 (num_points 少于 num_clusters 时返回 centers 为NULL的空结果)
 KMeansResult kmeans_cluster(float** data, int num_points, int dim, int num_clusters, int max_iter);
 
+// 为每个数据点分配最近的簇
+void assign_clusters(float** data, int num_points, int dim, int num_clusters, float** centers, int* assignments);
+
 // 释放K-means结果
 void free_kmeans_result(KMeansResult* result);
 
-// 从描述符列表构建码本
+// 从描述符列表构建码本 (描述符少于 num_clusters 时返回 centers 为NULL的码本)
 Codebook build_codebook(DescriptorList* descriptors, int num_clusters);
 
+// 码本的充分统计量: 每个中心的样本数与向量和 (double累加)，用于增量更新
+// 中心 i 等于 sums[i*dim .. ] / counts[i]
+typedef struct {
+    double* sums;
+    int64_t* counts;
+    int num_clusters;
+    int dim;
+} CodebookStats;
+
+CodebookStats create_codebook_stats(int num_clusters, int dim);
+void free_codebook_stats(CodebookStats* stats);
+// 将描述符按最近中心累加进统计量 (用于为已有码本建立基线)
+void accumulate_codebook_stats(CodebookStats* stats, Codebook* codebook, DescriptorList* descriptors);
+// 保存/加载统计量 (失败时 save 返回0，load 返回 sums 为 NULL 的统计量)
+int save_codebook_stats(const CodebookStats* stats, const char* filename);
+CodebookStats load_codebook_stats(const char* filename);
+
+// 构建码本的同时输出统计量 (stats 可为NULL，此时等价于 build_codebook)
+Codebook build_codebook_with_stats(DescriptorList* descriptors, int num_clusters, CodebookStats* stats);
+
+// 在描述符存储上构建码本: 初始中心按行随机访问抽取，每次迭代按块顺序扫描一遍
+// 内存占用为存储的预算加上 O(簇数 * 维度)，与描述符总数无关 (stats 可为NULL)
+Codebook build_codebook_from_store(DescriptorStore* store, int num_clusters, CodebookStats* stats);
+// 将存储中的每个描述符量化为视觉词 (words 至少容纳 store->count 个元素)
+void quantize_store(DescriptorStore* store, Codebook* codebook, int* words);
+
+// 增量更新的结果
+typedef struct {
+    int num_descriptors;     // 折入的新描述符数
+    int clusters_touched;    // 中心发生变化的簇数
+    int iterations;          // 实际执行的精化迭代次数
+    int reassigned;          // 精化过程中改变归属的描述符数
+    float max_drift;         // 中心移动距离的最大值
+    float mean_drift;        // 发生变化的中心的平均移动距离
+} CodebookUpdate;
+
+// 增量更新码本: 新描述符按在线k-means (MacQueen) 逐个并入最近的中心，
+// 然后执行至多 refine_iterations 次热启动Lloyd迭代 (只重新分配新描述符，只重算归属变化的中心)
+// 代价为 O(新描述符数 * 簇数)，与历史数据量无关；旧描述符的归属不重新计算，
+// 根据返回的中心漂移量决定是否需要重新量化已存储的特征
+CodebookUpdate update_codebook(Codebook* codebook, CodebookStats* stats, DescriptorList* descriptors,
+                               int refine_iterations);
+
+// 直接在uint8描述符上聚类构建码本 (分配与累加均使用紧凑数据)
+Codebook build_codebook_packed(const PackedDescriptors* descriptors, int num_clusters);
+// 同时输出统计量 (stats 可为NULL)
+Codebook build_codebook_packed_with_stats(const PackedDescriptors* descriptors, int num_clusters,
+                                          CodebookStats* stats);
+
 // 释放码本
 void free_codebook(Codebook* codebook);
 
+// 保存/加载码本 (失败时 save 返回0，load 返回 centers 为 NULL 的码本)
+int save_codebook(const Codebook* codebook, const char* filename);
+Codebook load_codebook(const char* filename);
+
 // 计算描述符到码本中心的最近距离
 int find_nearest_center(float* desc, Codebook* codebook);
 
 // 将描述符量化为直方图
 float* quantize_descriptors(DescriptorList* descriptors, Codebook* codebook);
+float* quantize_packed_descriptors(const PackedDescriptors* descriptors, const PackedCodebook* codebook);
 
 #endif /* KMEANS_H */
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// 堆分配统计
+// 使用 -DCV_MEMTRACK 编译时启用 (CMake选项 CV_C_ENABLE_MEMTRACK)，否则所有宏直接展开为 malloc/calloc/realloc/free。
+// 每次分配按子系统标签记录字节数与次数，维护当前值与峰值；MEM_STAGE_BEGIN/END 之间的峰值按阶段汇总输出，
+// 进程退出时按分配位置列出未释放的内存。
+// 统计表以指针为键，未经统计分配的指针也可以传给 MEM_FREE/MEM_REALLOC (反之用 free 释放统计过的指针
+// 不会出错，但会在退出时被报告为泄漏)。
+
+// 子系统标签
+typedef enum {
+    MEM_TAG_OTHER = 0,
+    MEM_TAG_IMAGE,      // 图像与灰度图
+    MEM_TAG_SIFT,       // 描述符与SIFT中间结果
+    MEM_TAG_KMEANS,     // 码本与聚类
+    MEM_TAG_SPM,        // 金字塔直方图
+    MEM_TAG_SVM,        // SVM模型与求解器
+    MEM_TAG_COUNT
+} MemTag;
+
+// 每个源文件可在包含本头文件之前定义 MEMTRACK_TAG，作为该文件中分配的默认标签
+#ifndef MEMTRACK_TAG
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#endif
+
+#ifdef CV_MEMTRACK
+
+void* mem_malloc(MemTag tag, size_t size, const char* file, int line);
+void* mem_calloc(MemTag tag, size_t count, size_t size, const char* file, int line);
+void* mem_realloc(MemTag tag, void* ptr, size_t size, const char* file, int line);
+void mem_free(void* ptr);
+
+// 开始/结束一个阶段，结束时输出该阶段内的峰值 (阶段不嵌套，由主线程调用)
+void mem_stage_begin(const char* name);
+void mem_stage_end(void);
+// 立即输出汇总与泄漏报告 (通常由 atexit 调用)
+void mem_report(void);
+
+#define MEM_MALLOC_TAG(tag, size) mem_malloc((tag), (size), __FILE__, __LINE__)
+#define MEM_CALLOC_TAG(tag, count, size) mem_calloc((tag), (count), (size), __FILE__, __LINE__)
+#define MEM_REALLOC_TAG(tag, ptr, size) mem_realloc((tag), (ptr), (size), __FILE__, __LINE__)
+#define MEM_FREE(ptr) mem_free(ptr)
+#define MEM_STAGE_BEGIN(name) mem_stage_begin(name)
+#define MEM_STAGE_END() mem_stage_end()
+
+#else
+
+#define MEM_MALLOC_TAG(tag, size) malloc(size)
+#define MEM_CALLOC_TAG(tag, count, size) calloc((count), (size))
+#define MEM_REALLOC_TAG(tag, ptr, size) realloc((ptr), (size))
+#define MEM_FREE(ptr) free(ptr)
+#define MEM_STAGE_BEGIN(name) ((void)0)
+#define MEM_STAGE_END() ((void)0)
+
+#endif /* CV_MEMTRACK */
+
+// 使用本文件的默认标签
+#define MEM_MALLOC(size) MEM_MALLOC_TAG(MEMTRACK_TAG, size)
+#define MEM_CALLOC(count, size) MEM_CALLOC_TAG(MEMTRACK_TAG, count, size)
+#define MEM_REALLOC(ptr, size) MEM_REALLOC_TAG(MEMTRACK_TAG, ptr, size)
+
+#endif /* MEMTRACK_H */
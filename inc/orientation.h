@@ -0,0 +1,59 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include "image.h"
+
+// 融合的梯度->方向平面内核
+// 直接由中心差分 gx/gy 得到每个像素在8个方向bin上的梯度幅值，不调用 atan2f:
+// 象限由符号判断，象限内的半区由 |gx|、|gy| 比较得到，软分配所需的角度由 min/max 比值的多项式近似
+
+#define ORIENTATION_BINS 8
+
+typedef enum {
+    ORIENTATION_HARD = 0,   // 幅值全部计入所在的bin (与 atan2f 分bin结果一致)
+    ORIENTATION_SOFT = 1    // 在相邻两个bin中心之间线性插值
+} OrientationBinning;
+
+// 方向平面，按像素交错存放: data[(y * width + x) * ORIENTATION_BINS + b]
+typedef struct {
+    float* data;
+    int width;
+    int height;
+} OrientationPlanes;
+
+OrientationPlanes create_orientation_planes(int width, int height);
+void free_orientation_planes(OrientationPlanes* planes);
+
+// 计算方向平面 (planes 至少容纳 width*height*ORIENTATION_BINS 个float，不进行堆分配)
+void compute_orientation_planes_into(const GrayImage* img, OrientationPlanes* planes, OrientationBinning binning);
+OrientationPlanes compute_orientation_planes(const GrayImage* img, OrientationBinning binning);
+// 视图版本: 子区域边界按视图自身的边界复制处理
+void compute_orientation_planes_view_into(const GrayView* view, OrientationPlanes* planes,
+                                          OrientationBinning binning);
+
+// 定点版本: 由 int16 灰度 (convert_view_to_gray16_into) 直接做整数中心差分 (AVX2每条指令16个像素)，
+// 只在写入方向平面时转换为float。与浮点路径 (convert_view_to_gray_into + compute_orientation_planes_into) 相比，
+// 梯度幅值之差小于 3/GRAY16_SCALE (约1e-4)；只有梯度方向与bin边界的距离在同样的误差内时分bin才可能不同
+void compute_orientation_planes_gray16_into(const Gray16Image* img, OrientationPlanes* planes,
+                                            OrientationBinning binning);
+
+// 批量方向平面: data[((y * width + x) * ORIENTATION_BINS + b) * IMAGE_BATCH_LANES + lane]
+typedef struct {
+    float* data;
+    int width;
+    int height;
+    int count;
+} OrientationPlanesBatch;
+
+OrientationPlanesBatch create_orientation_planes_batch(int width, int height);
+void free_orientation_planes_batch(OrientationPlanesBatch* planes);
+
+// 由交错的定点灰度计算批量方向平面，每个通道与 compute_orientation_planes_gray16_into 逐位相同
+// 边界列/行只改变读取的像素下标 (对所有通道相同)，每个像素的8个bin由8次向量比较直接写出
+void compute_orientation_planes_batch_into(const Gray16Batch* gray, OrientationPlanesBatch* planes,
+                                           OrientationBinning binning);
+
+// 当前使用的内核名称
+const char* orientation_kernel_name(void);
+
+#endif /* ORIENTATION_H */
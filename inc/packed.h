@@ -0,0 +1,62 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdint.h>
+#include "utils.h"
+
+// 紧凑的描述符/码本存储
+// uint8: 与VLFeat相同，将归一化后的描述符乘以512并截断到[0,255]，每维1字节 (float的1/4)
+// float16: IEEE半精度，每维2字节
+#define PACKED_U8_SCALE 512.0f
+#define PACKED_MAX_DIM 256     // 紧凑码本的最大维度 (混合格式查找时栈上转换缓冲区的大小)
+
+typedef enum {
+    PACKED_U8 = 0,
+    PACKED_F16 = 1
+} PackedFormat;
+
+// uint8描述符，按行连续存放
+typedef struct {
+    uint8_t* data;      // count * dim 字节
+    float* positions;   // 每个描述符的 (x, y)
+    int count;          // 描述符数量
+    int dim;            // 描述符维度
+    int capacity;       // 已分配的行数
+} PackedDescriptors;
+
+// 紧凑码本
+typedef struct {
+    PackedFormat format;
+    uint8_t* u8;        // PACKED_U8: num_clusters * dim
+    uint16_t* f16;      // PACKED_F16: num_clusters * dim
+    int num_clusters;
+    int dim;
+} PackedCodebook;
+
+// 标量转换
+uint8_t pack_u8(float value);
+float unpack_u8(uint8_t value);
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+// 打包与释放
+PackedDescriptors pack_descriptors(const DescriptorList* descriptors);
+// 逐批追加: 浮点描述符打包后即可释放，描述符池只以uint8形式存在
+PackedDescriptors create_packed_descriptors(int dim);
+void append_packed_descriptors(PackedDescriptors* packed, const DescriptorList* descriptors);
+void free_packed_descriptors(PackedDescriptors* packed);
+// 维度超过 PACKED_MAX_DIM 时返回空码本 (u8/f16 为NULL，num_clusters 为0)
+PackedCodebook pack_codebook(const Codebook* codebook, PackedFormat format);
+void free_packed_codebook(PackedCodebook* packed);
+
+// 直接在紧凑数据上计算的距离内核 (运行时选择 AVX2/SSE2/标量实现)
+uint32_t squared_distance_u8(const uint8_t* a, const uint8_t* b, int dim);
+float squared_distance_f16(const float* a, const uint16_t* b, int dim);
+// 当前使用的内核名称
+const char* packed_kernel_name(void);
+
+// 最近中心查找 (码本维度不超过 PACKED_MAX_DIM)
+int find_nearest_center_u8(const uint8_t* desc, const PackedCodebook* codebook);
+int find_nearest_center_packed(const float* desc, const PackedCodebook* codebook);
+
+#endif /* PACKED_H */
@@ -0,0 +1,88 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "spm.h"
+
+// 有界无锁MPMC队列 (Vyukov)，容量为2的幂
+typedef struct {
+    atomic_size_t sequence;
+    void* data;
+} QueueCell;
+
+typedef struct {
+    QueueCell* cells;
+    size_t mask;
+    _Alignas(64) atomic_size_t enqueue_pos;
+    _Alignas(64) atomic_size_t dequeue_pos;
+    _Alignas(64) atomic_int closed;   // 生产者全部结束后置1
+} BoundedQueue;
+
+BoundedQueue* create_bounded_queue(size_t capacity);
+void free_bounded_queue(BoundedQueue* queue);
+int queue_try_push(BoundedQueue* queue, void* data);
+int queue_try_pop(BoundedQueue* queue, void** data);
+// 阻塞版本: 队列满时等待 (背压)，返回等待的纳秒数
+uint64_t queue_push(BoundedQueue* queue, void* data);
+// 队列空时等待；队列已关闭且为空时返回0
+int queue_pop(BoundedQueue* queue, void** data, uint64_t* waited_ns);
+void queue_close(BoundedQueue* queue);
+
+// 在流水线中流动的单个样本
+typedef struct {
+    int index;                    // 样本序号
+    unsigned char label;          // 类别标签
+    Image image;                  // 解码后的图像
+    DescriptorList descriptors;   // 密集SIFT描述符
+    int* words;                   // 每个描述符的视觉词
+    SpmHistogram histogram;       // SPM直方图
+    SpmHistogram coarse;          // 级联分类的粗网格特征 (见 cascade.h，未启用时为空)
+} PipelineItem;
+
+void free_pipeline_item(PipelineItem* item);
+
+// 阶段函数: 处理样本，返回0表示丢弃该样本
+typedef int (*PipelineStageFn)(PipelineItem* item, void* ctx);
+// 汇聚函数: 在调用线程上接收完成的样本，负责释放
+typedef void (*PipelineSinkFn)(PipelineItem* item, void* ctx);
+
+typedef struct {
+    const char* name;        // 阶段名称
+    PipelineStageFn fn;      // 处理函数
+    void* ctx;               // 处理函数上下文
+    int num_threads;         // 线程数
+
+    // 运行统计
+    atomic_long items;           // 处理的样本数
+    atomic_uint_fast64_t busy_ns;     // 处理耗时
+    atomic_uint_fast64_t starved_ns;  // 等待输入的耗时
+    atomic_uint_fast64_t blocked_ns;  // 因下游队列满而等待的耗时 (背压)
+} PipelineStage;
+
+// 运行流水线: 样本 0..num_items-1 依次经过各阶段，最终交给 sink
+// 返回运行的墙钟时间 (秒)
+double run_pipeline(PipelineStage* stages, int num_stages, int num_items, int queue_capacity,
+                    PipelineSinkFn sink, void* sink_ctx);
+
+// 打印每个阶段的利用率 (busy / (wall * threads))
+void print_pipeline_stats(const PipelineStage* stages, int num_stages, double wall_seconds);
+
+// SPM流水线各阶段共享的上下文
+typedef struct {
+    const unsigned char* records;  // CIFAR-10原始记录
+    int num_records;               // 记录数量
+    int step;                      // 密集SIFT步长
+    Codebook* codebook;            // 码本 (量化阶段使用)
+    int level;                     // 金字塔层数
+    FeatureCache* cache;           // 可选的SIFT特征缓存
+    int cascade;                   // 金字塔阶段同时计算级联分类的粗网格特征
+} PipelineContext;
+
+// 标准阶段: 解码 → 梯度/SIFT → 量化 → 金字塔
+int pipeline_stage_decode(PipelineItem* item, void* ctx);
+int pipeline_stage_sift(PipelineItem* item, void* ctx);
+int pipeline_stage_quantize(PipelineItem* item, void* ctx);
+int pipeline_stage_pyramid(PipelineItem* item, void* ctx);
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,61 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 可复现的伪随机数生成器 (xoshiro256**)
+// 每个 Rng 是独立的状态，不共享全局锁；多线程时每个线程持有一个由 rng_split 得到的流
+// 相同的种子在任何平台、任何内核下产生相同的序列 (批量接口的SIMD与标量路径逐位一致)
+
+#define RNG_DEFAULT_SEED 0x5EED5EEDULL
+#define RNG_BULK_LANES 4   // 批量生成时交错的子流数
+
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// 由64位种子初始化 (经 splitmix64 扩展，任意种子均可，包括0)
+void rng_seed(Rng* rng, uint64_t seed);
+Rng rng_create(uint64_t seed);
+// 第 stream 个独立流: 等价于 rng_seed 后执行 stream 次 rng_jump
+Rng rng_create_stream(uint64_t seed, int stream);
+
+// 前进 2^128 步，用于划分互不重叠的子序列
+void rng_jump(Rng* rng);
+// 从 rng 拆分出一个子流到 child，rng 自身跳到下一个子序列
+void rng_split(Rng* rng, Rng* child);
+
+uint64_t rng_next_u64(Rng* rng);
+uint32_t rng_next_u32(Rng* rng);
+// [0, 1) 内的均匀分布
+float rng_uniform_float(Rng* rng);
+double rng_uniform_double(Rng* rng);
+// [0, bound) 内无偏的均匀整数 (Lemire乘法拒绝法)
+uint32_t rng_bounded(Rng* rng, uint32_t bound);
+// [min, max] 内的均匀整数
+int rng_range_int(Rng* rng, int min, int max);
+
+// 批量生成: 内部以 RNG_BULK_LANES 个子流交错生成 (AVX2 可用时并行推进)
+void rng_fill_u64(Rng* rng, uint64_t* out, size_t count);
+void rng_fill_uniform(Rng* rng, float* out, size_t count);
+// bound 为0时输出全为0 (与 rng_bounded 相同)，rng 不前进
+void rng_fill_bounded(Rng* rng, uint32_t* out, size_t count, uint32_t bound);
+
+// Fisher-Yates 原地洗牌
+void rng_shuffle_int(Rng* rng, int* values, int count);
+// 从 [0, n) 中无放回地抽取 k 个下标 (Floyd算法，已选集合用哈希表，时间与空间均为 O(k))，
+// 结果按抽取顺序写入 out；k 不在 [0, n] 内时返回0
+int rng_sample_indices(Rng* rng, int n, int k, int* out);
+
+// 无状态哈希: 由 (seed, a, b) 得到均匀的64位值，结果与调用顺序和线程划分无关
+uint64_t rng_hash(uint64_t seed, uint64_t a, uint64_t b);
+
+// 进程级默认种子 (命令行 --seed)，各模块需要随机性时由它派生各自的流
+void rng_set_default_seed(uint64_t seed);
+uint64_t rng_default_seed(void);
+
+// 当前使用的批量内核名称
+const char* rng_kernel_name(void);
+
+#endif /* RNG_H */
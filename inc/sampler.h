@@ -0,0 +1,62 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "image.h"
+
+// 码本训练用的描述符蓄水池采样
+// 单遍扫描，样本容量固定，与数据总量无关；每个线程、每个分层各一个蓄水池，结束时合并
+// 采用优先级 (bottom-k) 采样: 每个描述符的键由 (种子, 图像序号, 描述符序号) 哈希得到，
+// 蓄水池保留键最小的 k 个。这等价于均匀的无放回抽样，而且结果与线程数、图像到达顺序无关，
+// 合并两个蓄水池只需再取一次最小的 k 个
+
+#define SAMPLER_DEFAULT_BUDGET 100000
+
+typedef struct {
+    float* rows;        // 样本，按槽位存放 (按需增长，至多 capacity 行)
+    uint64_t* keys;     // 各槽位的键
+    int* heap;          // 按键排列的最大堆 (槽位序号)
+    int rows_allocated;
+    int capacity;       // 样本容量
+    int count;          // 当前样本数
+    int dim;
+    int64_t seen;       // 已见过的描述符数
+} Reservoir;
+
+void reservoir_init(Reservoir* reservoir, int capacity, int dim);
+void reservoir_free(Reservoir* reservoir);
+// 以 key 提交一行，键小于当前最大键时替换之
+void reservoir_offer(Reservoir* reservoir, uint64_t key, const float* row);
+// 把 other 并入 into
+void reservoir_merge(Reservoir* into, const Reservoir* other);
+
+typedef struct {
+    int budget;            // 样本总数
+    int per_image_quota;   // >0 时每幅图像先在图像内均匀抽取至多这么多描述符，避免大图像占据样本
+    int num_strata;        // 分层数 (如类别数)，每层预算 budget/num_strata，余数分给前面的层；1表示不分层
+    int num_threads;       // 提交样本的线程数
+    uint64_t seed;         // 随机种子
+} SamplerOptions;
+
+typedef struct {
+    SamplerOptions options;
+    int dim;
+    Reservoir* reservoirs;   // [thread * num_strata + stratum]
+} DescriptorSampler;
+
+DescriptorSampler* descriptor_sampler_create(const SamplerOptions* options, int dim);
+void descriptor_sampler_free(DescriptorSampler* sampler);
+// 提交第 item 幅图像的描述符 (thread 为调用线程的序号，同一线程序号不能并发使用)
+// stratum 按 num_strata 取模 (负数也映射到 [0, num_strata))
+void descriptor_sampler_offer(DescriptorSampler* sampler, int thread, int stratum, int64_t item,
+                              const DescriptorList* descriptors);
+// 合并所有线程的蓄水池，各层样本按键排序后依次排列 (位置信息不保留)
+DescriptorList descriptor_sampler_finish(DescriptorSampler* sampler);
+
+// 多线程提取密集SIFT并采样 (strata 可为NULL)，每幅图像的描述符用完即释放
+DescriptorList sample_dense_sift(const Image* images, int num_images, const int* strata, int step,
+                                 const SamplerOptions* options);
+
+// 在线CPU数
+int sampler_cpu_count(void);
+
+#endif /* SAMPLER_H */
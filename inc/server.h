@@ -0,0 +1,70 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Unix域套接字分类服务
+// 协议: 客户端在同一连接上依次发送请求，每个请求得到一个回复
+//   请求: ServerRequestHeader + 负载 (RGB: width*height*3 字节交错像素; CIFAR: 一条3073字节记录)
+//   回复: ServerReplyHeader + num_scores 个float决策值 (统计请求则为 payload_size 字节的JSON)
+//   RGB请求的宽或高为0或超过 max_image_size 时，服务端回复错误 (label -1) 并关闭连接，不读取负载
+
+#define SERVER_MAGIC 0x53435643u      // "CVCS"
+#define SERVER_DEFAULT_MAX_BATCH 16
+#define SERVER_DEFAULT_MAX_WAIT_US 500
+#define SERVER_DEFAULT_MAX_IMAGE_SIZE 256
+#define SERVER_QUEUE_CAPACITY 1024
+#define LATENCY_BUCKETS 32            // 以2的幂划分的微秒区间
+
+typedef enum {
+    SERVER_REQUEST_RGB = 0,           // 交错RGB像素
+    SERVER_REQUEST_CIFAR = 1,         // CIFAR-10二进制记录 (标签字节被忽略)
+    SERVER_REQUEST_STATS = 2          // 返回延迟直方图 (JSON)
+} ServerRequestType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+} ServerRequestHeader;
+
+typedef struct {
+    uint32_t magic;
+    int32_t label;                    // 预测的类别，出错时为-1
+    uint32_t num_scores;              // 后续float决策值的个数
+    uint32_t payload_size;            // 统计请求的JSON长度
+} ServerReplyHeader;
+
+// 延迟直方图: 第i个桶统计 [2^(i-1), 2^i) 微秒
+typedef struct {
+    atomic_ulong buckets[LATENCY_BUCKETS];
+    atomic_ulong count;
+    atomic_ulong total_us;
+} LatencyHistogram;
+
+void latency_histogram_add(LatencyHistogram* hist, uint64_t value_us);
+// 近似百分位数 (取所在桶的上界)
+uint64_t latency_histogram_percentile(const LatencyHistogram* hist, double p);
+
+typedef struct {
+    const char* model_prefix;   // 模型文件前缀 (<prefix>.codebook, <prefix>.svm)
+    const char* socket_path;    // 监听的套接字路径
+    int max_batch;              // 微批最大样本数
+    int max_wait_us;            // 第一个请求到达后等待凑批的最长时间
+    int num_batchers;           // 批处理线程数
+    int max_image_size;         // 接受的最大图像边长
+} ServerConfig;
+
+// 运行服务，直到收到 SIGINT/SIGTERM
+int run_server(const ServerConfig* config);
+
+// 客户端: 连接服务并发送请求
+int server_connect(const char* socket_path);
+// 发送一条CIFAR记录，返回预测类别 (scores 可为NULL)，失败返回-2
+int server_classify_cifar(int fd, const unsigned char* record, float* scores, int max_scores);
+// 获取服务端统计JSON (调用者释放)
+char* server_fetch_stats(int fd);
+
+#endif /* SERVER_H */
@@ -0,0 +1,37 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include "utils.h"
+
+// 描述符分片文件与多进程分片K-means
+// 分片文件格式: 16字节头 (magic, dim, uint64 count)，后接按行存放的float描述符
+// 头部为16字节，dim为4的倍数时每行都按16字节对齐，可直接走特化的距离内核
+
+#define DESCRIPTOR_SHARD_MAGIC 0x31485344u  // "DSH1"
+
+// 只读映射的分片
+typedef struct {
+    int fd;
+    void* map;
+    size_t map_size;
+    const float* data;   // 第 i 行为 data + i * dim
+    int count;
+    int dim;
+} DescriptorShard;
+
+// 将 descriptors[begin, end) 写成分片文件，成功返回1
+int write_descriptor_shard(const char* path, const DescriptorList* descriptors, int begin, int end);
+// 映射分片文件，成功返回1
+int open_descriptor_shard(DescriptorShard* shard, const char* path);
+void close_descriptor_shard(DescriptorShard* shard);
+
+// 分片K-means: 协调进程为每个分片fork一个工作进程，工作进程各自映射自己的分片
+// 每次迭代:
+//   1. 工作进程对本分片做最近中心分配，把每簇的部分和与计数写入共享内存中自己的槽位
+//   2. 屏障后每个工作进程负责一段簇，跨所有槽位归约并直接写回共享的中心 (reduce-scatter)
+//   3. 屏障后所有进程看到同一份新中心 (广播)
+// 初始中心与 build_codebook 相同 (对所有分片拼接后的下标做Forgy抽样)，收敛判据也相同
+// 须在没有其他线程运行时调用 (fork 后子进程只保留调用线程)
+Codebook build_codebook_sharded(const char* const* shard_paths, int num_shards, int num_clusters, int max_iter);
+
+#endif /* SHARDED_H */
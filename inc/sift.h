@@ -2,6 +2,7 @@
 #define SIFT_H
 
 #include "image.h"
+#include "orientation.h"
 
 // SIFT参数
 #define SIFT_DESC_SIZE 128    // SIFT描述符的维度 (4x4x8)
@@ -9,6 +10,14 @@
 #define SIFT_SCALES 5         // 每个八度中的尺度数
 #define SIFT_SIGMA 1.6        // 初始高斯模糊的sigma
 #define SIFT_CONTRAST_THRESH 0.03  // 对比度阈值
+#define SIFT_GRID_SIZE 4      // 描述符每边的单元格数
+#define SIFT_CELL_SIZE 4      // 单尺度描述符的单元格边长 (像素)
+#define SIFT_ORI_BINS ORIENTATION_BINS  // 方向直方图的bin数
+#define SIFT_ORI_BINNING ORIENTATION_HARD  // 方向分bin方式 (训练与推理须一致)
+#define SIFT_NUM_DEFAULT_SCALES 4
+
+// 多尺度密集SIFT的默认单元格边长 (与SPM论文一致: 4, 6, 8, 10)
+extern const int sift_default_cell_sizes[SIFT_NUM_DEFAULT_SCALES];
 
 // 关键点检测结构
 typedef struct {
@@ -47,5 +56,72 @@ DescriptorList convert_sift_to_descriptors(const SiftDescriptorList* sift_list);
 
 // 简化的SIFT实现（密集采样版本，用于SPM）
 DescriptorList extract_dense_sift(const Image* img, int step);
+// 视图版本: 子区域、翻转和CIFAR平面布局无需复制 (坐标相对于视图)
+DescriptorList extract_dense_sift_view(const ImageView* view, int step);
+
+// 密集网格在一个方向上的采样点数
+int dense_sift_grid_count(int size, int step);
+
+// 在预分配缓冲区上从方向平面提取密集SIFT特征，返回描述符数量
+// 窗口完全在图像内部的点使用展开的内核；只有宽度为 CIFAR_IMAGE_SIZE 的图像使用行跨度为编译期常量的特化实例，
+// 其他宽度 (包括服务端的任意尺寸图像) 使用运行时跨度的同一内核，形状特化带来的加速只适用于CIFAR
+int extract_dense_sift_into(const OrientationPlanes* planes, int step,
+                            float* descriptors, float* positions, int max_count);
+
+// 只提取网格中 y_begin <= y < y_end 的行 (分条处理，见 tiled.h)
+// planes 的第0行对应图像第 row_offset 行，须覆盖这些描述符的整个窗口；image_height 为整幅图像的高度
+// 只要 planes 中窗口覆盖的行与整幅图像计算的相同，结果就与 extract_dense_sift_into 的对应行逐位相同，坐标为图像坐标
+int extract_dense_sift_rows_into(const OrientationPlanes* planes, int step, int row_offset, int image_height,
+                                 int y_begin, int y_end, float* descriptors, float* positions, int max_count);
+
+// 密集网格的子集: 网格下标 (x/step - 1, y/step - 1) 均为 stride 的倍数的点构成粗网格，其余为细网格
+typedef enum {
+    DENSE_GRID_COARSE = 0,
+    DENSE_GRID_FINE
+} DenseGridSubset;
+
+int dense_grid_is_coarse(int x, int y, int step, int stride);
+// 只提取粗网格或细网格上的描述符，两者合起来与 extract_dense_sift_into 的结果相同 (顺序不同)
+int extract_dense_sift_subset_into(const OrientationPlanes* planes, int step, int stride, DenseGridSubset subset,
+                                   float* descriptors, float* positions, int max_count);
+
+// 三线性插值描述符: 窗口内高斯空间加权 (sigma为窗口半宽)，每个像素按位置双线性地计入相邻的4个单元格；
+// 与 ORIENTATION_SOFT 方向平面配合时方向维也被插值。权重来自预先计算的16x16窗口查找表，每个像素只需4次乘加
+// (FMA内核与标量版本的结果只有舍入差异)。keypoint路径 (compute_sift_descriptor) 使用此描述符
+// 与逐像素直接计算权重的双精度参考实现相比，归一化后每个分量之差不超过 TRILINEAR_SIFT_TOLERANCE
+#define TRILINEAR_SIFT_TOLERANCE 1e-6f
+void compute_trilinear_descriptor(const OrientationPlanes* planes, int x, int y, float* descriptor);
+// 密集版本，参数与返回值同 extract_dense_sift_into
+int extract_dense_sift_trilinear_into(const OrientationPlanes* planes, int step,
+                                      float* descriptors, float* positions, int max_count);
+const char* sift_trilinear_kernel_name(void);
+
+// 跨图像批量密集SIFT: 由批量方向平面为 planes->count 幅图像同时计算描述符，每个SIMD通道对应一幅图像
+// descriptors[lane] 至少容纳 max_count * SIFT_DESC_SIZE 个float (为NULL的通道跳过)，positions 为各图像共用的网格坐标
+// 每幅图像的结果与 extract_dense_sift_into 逐位相同，返回每幅图像的描述符数量
+int extract_dense_sift_batch_into(const OrientationPlanesBatch* planes, int step, float* const* descriptors,
+                                  float* positions, int max_count);
+
+// 方向积分图: 每个方向平面一张积分图，按像素交错存放
+// sums[((y * (width + 1)) + x) * SIFT_ORI_BINS + b] 为 [0,x)x[0,y) 内bin b的梯度幅值之和
+// 使用double累加，避免大图像上的精度损失
+typedef struct {
+    double* sums;
+    int width;
+    int height;
+} OrientationIntegral;
+
+// 构建一次后，任意位置、任意大小单元格的直方图都是O(1)
+OrientationIntegral build_orientation_integral(const OrientationPlanes* planes);
+void free_orientation_integral(OrientationIntegral* integral);
+
+// 以(x,y)为中心、单元格边长为cell_size的描述符
+// cell_size为4时与 extract_dense_sift 的网格相同，但积分图以double按矩形求和而密集路径按像素以float累加，
+// 结果并非逐位相同: 归一化后每个分量之差不超过 INTEGRAL_SIFT_TOLERANCE
+#define INTEGRAL_SIFT_TOLERANCE 1e-6f
+void compute_integral_descriptor(const OrientationIntegral* integral, int x, int y, int cell_size, float* descriptor);
+
+// 多尺度密集SIFT: 所有尺度共享同一组网格点，描述符按尺度依次排列
+DescriptorList extract_dense_sift_multiscale(const Image* img, int step, const int* cell_sizes, int num_scales);
 
 #endif /* SIFT_H */
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef SIMSEARCH_H
+#define SIMSEARCH_H
+
+#include "spm.h"
+#include "index.h"
+
+// 精确的暴力 top-k SPM 相似度搜索 (查询批 × 图库)
+// 按缓存分块计算，每个线程为每个查询维护一个大小为 k 的堆，完整的相似度矩阵不会被生成
+// 结果与线程数无关，可作为近似索引 (index.h) 的精确基线
+
+typedef enum {
+    SPM_SIMILARITY_CHI2 = 0,       // 1 - Σ (a-b)^2/(a+b)，与 compute_spm_similarity 相同
+    SPM_SIMILARITY_INTERSECTION,   // Σ min(a,b) (金字塔匹配核)
+    SPM_SIMILARITY_L2              // -Σ (a-b)^2
+} SpmSimilarity;
+
+// 一个分块中图库部分的目标大小 (字节)，按L2缓存估计
+#define SIMSEARCH_TILE_BYTES (256 * 1024)
+// 每次同时计算的查询数 (图库向量载入一次供这些查询共用)
+#define SIMSEARCH_QUERY_BLOCK 4
+
+typedef struct {
+    int64_t pairs;             // 计算的 (查询, 图库) 对数
+    double seconds;
+    double pairs_per_second;
+} SimSearchStats;
+
+// 单对相似度 (使用与批量搜索相同的内核)
+float spm_similarity(const float* a, const float* b, int length, SpmSimilarity kind);
+
+// 每个查询返回相似度最高的至多 k 个图库下标 (hits[q*k ...]，按相似度降序，同分时下标小的在前)
+// 直方图长度不一致时返回0；stats 可为NULL
+int spm_topk_search(const SpmHistogram* queries, int num_queries, const SpmHistogram* gallery, int num_gallery,
+                    SpmSimilarity kind, int k, int num_threads, IndexHit* hits, int* num_hits,
+                    SimSearchStats* stats);
+
+// 当前使用的内核名称
+const char* simsearch_kernel_name(void);
+
+#endif /* SIMSEARCH_H */
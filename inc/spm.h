@@ -9,12 +9,18 @@
 #define SPM_LEVEL_1 1  // 2x2网格
 #define SPM_LEVEL_2 2  // 4x4网格
 
+// 密集SIFT的采样步长
+#define SPM_SIFT_STEP 4
+
 // SPM相关数据结构
 typedef struct {
     float* histogram;   // SPM直方图
     int length;         // 直方图长度
 } SpmHistogram;
 
+// 特征缓存 (见 cache.h)
+typedef struct FeatureCache FeatureCache;
+
 // SPM功能
 // 将图像分成金字塔层次的网格并提取描述符
 DescriptorList* extract_pyramid_descriptors(const Image* img, int level);
@@ -22,9 +28,20 @@ DescriptorList* extract_pyramid_descriptors(const Image* img, int level);
 // 从一个区域提取描述符
 DescriptorList extract_region_descriptors(const Image* img, int x, int y, int width, int height);
 
+// 金字塔直方图的总长度
+int spm_histogram_length(int num_clusters, int level);
+
 // 构建空间金字塔直方图
 SpmHistogram build_spatial_pyramid(const Image* img, Codebook* codebook, int level);
 
+// 将一个视觉词按位置累加到金字塔各层的单元中 (scale 为归一化系数)
+void spm_accumulate_word(float* histogram, int num_clusters, int level, int word,
+                         float x, float y, int width, int height, float scale);
+
+// 由已提取的描述符构建空间金字塔直方图
+SpmHistogram build_spatial_pyramid_from_descriptors(const DescriptorList* descriptors, int width, int height,
+                                                    Codebook* codebook, int level);
+
 // 释放SPM直方图
 void free_spm_histogram(SpmHistogram* hist);
 
@@ -38,4 +55,8 @@ Codebook build_codebook_from_images(Image* images, int num_images, int voc_size)
 // 计算一组图像的SPM特征
 SpmHistogram* compute_spm_features(Image* images, int num_images, Codebook* codebook, int level);
 
+// 设置 compute_spm_features 使用的特征缓存 (NULL 关闭缓存)
+void spm_set_feature_cache(FeatureCache* cache);
+FeatureCache* spm_get_feature_cache(void);
+
 #endif /* SPM_H */
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include "utils.h"
+
+// 超出内存的描述符存储
+// 描述符按固定行数的块追加；总量未超过内存预算时全部留在内存中，
+// 超过后自动溢出到临时文件 (之后只在内存中保留一个未写满的尾块)，文件部分逐块通过 mmap 读取
+// K-means 与量化通过同一接口访问: 按块顺序扫描，或按行随机访问
+// 读取不能与追加并发进行
+
+#define DESCRIPTOR_STORE_CHUNK_ROWS 4096
+
+typedef struct {
+    int dim;                 // 描述符维度
+    int count;               // 描述符总数
+    size_t ram_budget;       // 内存预算 (字节)，0 表示不限制
+    char spill_dir[512];     // 溢出文件所在目录
+
+    // 内存中的块 (溢出前的全部块，溢出后只有尾块)
+    float** chunks;
+    int num_chunks;
+    int chunk_capacity;
+
+    // 溢出文件: 只包含写满的块
+    int fd;
+    char path[600];
+    int file_chunks;         // 文件中的块数
+    void* map;               // 当前映射的文件块
+    size_t map_size;
+    int map_chunk;           // 当前映射的块序号
+} DescriptorStore;
+
+// 创建存储；spill_dir 为NULL时使用 $TMPDIR 或 /tmp
+DescriptorStore* descriptor_store_create(int dim, size_t ram_budget, const char* spill_dir);
+// 释放存储并删除溢出文件
+void descriptor_store_free(DescriptorStore* store);
+
+// 追加一行或一个描述符列表，失败 (如磁盘写满) 返回0
+int descriptor_store_append(DescriptorStore* store, const float* row);
+int descriptor_store_append_list(DescriptorStore* store, const DescriptorList* descriptors);
+
+// 是否已溢出到文件
+int descriptor_store_spilled(const DescriptorStore* store);
+// 当前占用的堆内存 (字节，不含页缓存)
+size_t descriptor_store_memory(const DescriptorStore* store);
+
+// 块数与第 chunk 块: 返回块内行数，*rows 指向按行连续存放的数据
+// 文件中的块按需映射且同时只映射一块，指针在下一次访问其他块之前有效
+int descriptor_store_num_chunks(const DescriptorStore* store);
+int descriptor_store_chunk(DescriptorStore* store, int chunk, const float** rows);
+// 随机访问第 i 行
+const float* descriptor_store_row(DescriptorStore* store, int i);
+
+#endif /* STORE_H */
@@ -10,12 +10,53 @@ typedef struct {
 // 初始化 SVM 模型
 SVMModel* svm_create(int num_features, double C);
 
-// 训练 SVM 模型
+// 训练 SVM 模型 (从 model 当前的权重继续，新建的模型为零权重)
 void svm_train(SVMModel* model, double** data, int* labels, int num_samples, int max_iterations);
 
+// 复制模型 (用于以已有权重作为初始解继续训练)
+SVMModel* svm_copy(const SVMModel* model);
+
+// 对偶坐标下降求解器 (L1损失线性SVM，无偏置项)
+// w = Σ alpha_i y_i x_i，0 <= alpha_i <= C；保留对偶变量即可在再训练之间热启动
+typedef struct {
+    double* alpha;    // 每个样本的对偶变量
+    int num_samples;  // 样本数
+} SVMDualState;
+
+typedef struct {
+    int max_iterations;   // 最多遍历数据的轮数
+    double tolerance;     // 投影梯度的最大值与最小值之差小于该值时停止
+    double gap_tolerance; // 相对对偶间隙 (P-D)/P 小于该值时停止；0表示不检查 (每轮多一次遍历)
+} SVMSolverOptions;
+
+#define SVM_DEFAULT_TOLERANCE 0.1
+#define SVM_DEFAULT_GAP_TOLERANCE 0.0
+
+SVMDualState svm_create_dual_state(int num_samples);
+void svm_free_dual_state(SVMDualState* state);
+// 调整样本数: 新增样本的对偶变量为0 (样本只能追加在末尾)
+void svm_resize_dual_state(SVMDualState* state, int num_samples);
+
+// 对偶坐标下降训练，返回实际遍历的轮数
+// state 为NULL或全0时冷启动；否则从已有对偶解继续: 对偶变量先截断到 [0, model->C]，再由它重建权重
+int svm_train_dual(SVMModel* model, SVMDualState* state, double** data, int* labels, int num_samples,
+                   const SVMSolverOptions* options);
+
+// 正则化路径: Cs 应从小到大排列，依次训练，每个C从上一个C的对偶解热启动
+// models[k] 为 Cs[k] 的解 (调用者负责释放)，iterations[k] 可为NULL
+void svm_train_path(SVMModel** models, const double* Cs, int num_C, double** data, int* labels, int num_samples,
+                    int num_features, const SVMSolverOptions* options, int* iterations);
+
+// 计算决策函数值
+double svm_decision_value(const SVMModel* model, const double* feature_vector);
+
 // 使用 SVM 进行预测
 int svm_predict(SVMModel* model, double* feature_vector);
 
+// 保存/加载一组模型 (如一对多分类器)
+int svm_save_models(SVMModel** models, int num_models, const char* filename);
+SVMModel** svm_load_models(const char* filename, int* num_models);
+
 // 释放 SVM 模型
 void svm_free(SVMModel* model);
 
@@ -0,0 +1,26 @@
+#ifndef TILED_H
+#define TILED_H
+
+#include "spm.h"
+#include "sift.h"
+
+// 大图像的分条处理
+// 图像按水平条带依次经过 定点灰度 → 方向平面 → 密集SIFT。每个条带上下各多处理 TILED_HALO 行
+// (描述符窗口半径加梯度模板的1行)，使条带内用到的方向平面与整幅图像计算的逐位相同，
+// 因此描述符、坐标和顺序都与 extract_dense_sift_view 一致，金字塔直方图与 build_spatial_pyramid 逐位相同。
+// 临时缓冲区只按条带分配: 约 (strip_rows + 2 * TILED_HALO) * width * 34 字节 (int16灰度与8个float方向平面)
+// 加上一个条带的描述符 (每个 512 字节)，与图像高度无关。
+
+#define TILED_HALO (SIFT_GRID_SIZE * SIFT_CELL_SIZE / 2 + 1)
+#define TILED_DEFAULT_STRIP_ROWS 64
+
+// 每个条带的描述符 (descriptors[i * SIFT_DESC_SIZE ...]，positions 为图像坐标)，缓冲区在回调返回后被下一个条带复用
+typedef void (*TiledDescriptorFn)(float* descriptors, const float* positions, int count, void* ctx);
+
+// 条带输出 strip_rows 个像素行的网格点 (向上取整为 step 的倍数)，返回描述符总数
+int extract_dense_sift_tiled(const ImageView* view, int step, int strip_rows, TiledDescriptorFn fn, void* ctx);
+
+// 分条构建空间金字塔直方图: 每个条带的描述符量化后直接累加进金字塔单元，不保留描述符
+SpmHistogram build_spatial_pyramid_tiled(const ImageView* view, Codebook* codebook, int level, int strip_rows);
+
+#endif /* TILED_H */
@@ -0,0 +1,53 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// 热路径插桩
+// 使用 -DCV_TRACE 编译时启用 (CMake选项 CV_C_ENABLE_TRACE)，否则所有宏展开为空。
+// 每个线程写入自己的缓冲区，无锁；main 在所有工作线程结束后调用 TRACE_FLUSH 输出JSON汇总和Chrome trace_event文件。
+
+// 插桩阶段
+typedef enum {
+    TRACE_STAGE_LOAD = 0,     // 数据加载
+    TRACE_STAGE_GRAY,         // 灰度转换
+    TRACE_STAGE_GRADIENT,     // 梯度计算
+    TRACE_STAGE_DENSE_SIFT,   // 密集SIFT
+    TRACE_STAGE_INTEGRAL,     // 方向积分图
+    TRACE_STAGE_QUANTIZE,     // 描述符量化
+    TRACE_STAGE_PYRAMID,      // 空间金字塔构建
+    TRACE_STAGE_KMEANS_ITER,  // K-means单次迭代
+    TRACE_STAGE_SVM_EPOCH,    // SVM单轮训练
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+#define TRACE_BUFFER_EVENTS 65536  // 每个线程保存的事件数上限，超出后只计入汇总
+
+#ifdef CV_TRACE
+
+// 设置输出路径 (NULL表示不输出该文件)，默认为当前目录下的 cv-c-trace-summary.json 和 cv-c-trace.json
+void trace_init(const char* summary_path, const char* trace_path);
+uint64_t trace_now_ns(void);
+void trace_record(TraceStage stage, uint64_t start_ns, uint64_t end_ns, uint64_t bytes);
+void trace_count(TraceStage stage, uint64_t items);
+// 写出结果，调用时不得有其他线程仍在记录
+void trace_flush(void);
+
+#define TRACE_INIT(summary_path, trace_path) trace_init((summary_path), (trace_path))
+#define TRACE_BEGIN(name) uint64_t trace_start_##name = trace_now_ns()
+#define TRACE_END(name, stage, bytes) \
+    trace_record((stage), trace_start_##name, trace_now_ns(), (uint64_t)(bytes))
+#define TRACE_COUNT(stage, items) trace_count((stage), (uint64_t)(items))
+#define TRACE_FLUSH() trace_flush()
+
+#else
+
+#define TRACE_INIT(summary_path, trace_path) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name, stage, bytes) ((void)0)
+#define TRACE_COUNT(stage, items) ((void)0)
+#define TRACE_FLUSH() ((void)0)
+
+#endif /* CV_TRACE */
+
+#endif /* TRACE_H */
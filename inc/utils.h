@@ -7,6 +7,20 @@
 #include <math.h>
 #include <float.h>
 #include <time.h>
+#include <stdint.h>
+#include "memtrack.h"
+
+// 编译期特化内核的辅助宏
+// UNROLL_LOOP: 完全展开次数为编译期常量的循环
+// ASSUME_ALIGNED: 告知编译器指针已按n字节对齐 (调用者需先用 IS_ALIGNED 检查)
+#if defined(__GNUC__)
+#define UNROLL_LOOP _Pragma("GCC unroll 64")
+#define ASSUME_ALIGNED(p, n) __builtin_assume_aligned((p), (n))
+#else
+#define UNROLL_LOOP
+#define ASSUME_ALIGNED(p, n) (p)
+#endif
+#define IS_ALIGNED(p, n) ((((uintptr_t)(p)) & ((n) - 1)) == 0)
 
 // 基本数据结构
 typedef struct {
@@ -32,6 +46,15 @@ float** allocate_float_matrix(int rows, int cols);
 void free_float_array(float* array);
 void free_float_matrix(float** matrix, int rows);
 
+#ifdef CV_MEMTRACK
+// 启用分配统计时，分配计入调用者所在文件的标签 (MEMTRACK_TAG) 与位置
+float* allocate_float_array_tagged(int size, MemTag tag, const char* file, int line);
+float** allocate_float_matrix_tagged(int rows, int cols, MemTag tag, const char* file, int line);
+#define allocate_float_array(size) allocate_float_array_tagged((size), MEMTRACK_TAG, __FILE__, __LINE__)
+#define allocate_float_matrix(rows, cols) \
+    allocate_float_matrix_tagged((rows), (cols), MEMTRACK_TAG, __FILE__, __LINE__)
+#endif
+
 // 描述符操作函数
 Descriptor create_descriptor(int length);
 void free_descriptor(Descriptor* desc);
@@ -39,13 +62,26 @@ DescriptorList create_descriptor_list(int initial_capacity);
 void free_descriptor_list(DescriptorList* list);
 void add_descriptor(DescriptorList* list, Descriptor desc);
 
+#ifdef CV_MEMTRACK
+// 描述符同样计入调用者的标签 (SIFT提取、采样、K-means各自的描述符分别统计)
+Descriptor create_descriptor_tagged(int length, MemTag tag, const char* file, int line);
+DescriptorList create_descriptor_list_tagged(int initial_capacity, MemTag tag, const char* file, int line);
+void add_descriptor_tagged(DescriptorList* list, Descriptor desc, MemTag tag, const char* file, int line);
+#define create_descriptor(length) create_descriptor_tagged((length), MEMTRACK_TAG, __FILE__, __LINE__)
+#define create_descriptor_list(initial_capacity) \
+    create_descriptor_list_tagged((initial_capacity), MEMTRACK_TAG, __FILE__, __LINE__)
+#define add_descriptor(list, desc) add_descriptor_tagged((list), (desc), MEMTRACK_TAG, __FILE__, __LINE__)
+#endif
+
 // 数学工具函数
+// dim为64/128且指针16字节对齐时自动使用特化版本，结果与通用版本逐位一致
 float euclidean_distance(float* v1, float* v2, int dim);
 float chi_square_distance(float* v1, float* v2, int dim);
 int min_int(int a, int b);
 float min_float(float a, float b);
 
-// 随机数生成
+// 随机数生成 (基于 rng.h，不再使用 rand()/srand(time))
+// init_random 将调用线程的流重置到起点；需要可控子流的代码应直接使用 Rng
 void init_random();
 int random_int(int min, int max);
 float random_float(float min, float max);
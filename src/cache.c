@@ -0,0 +1,450 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#include "cache.h"
+#include "sift.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CACHE_RECORD_MAGIC 0x46434331u  // "FCC1"
+#define CACHE_INDEX_EMPTY 0              // 键为0的记录视为空槽
+#define FNV_OFFSET_BASIS 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+// 记录头，后接负载数据
+// SIFT: count 个描述符，每个为 (x, y, dim个float)
+// SPM:  count 个float
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t dim;
+    uint32_t reserved;
+    uint64_t key;
+} CacheRecordHeader;
+
+// FNV-1a 64位哈希
+uint64_t feature_cache_hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed ? seed : FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t hash_int(uint64_t hash, int value) {
+    return feature_cache_hash(&value, sizeof(value), hash);
+}
+
+// 键为0保留给空槽
+static uint64_t non_zero_key(uint64_t key) {
+    return key == CACHE_INDEX_EMPTY ? 1 : key;
+}
+
+uint64_t feature_cache_sift_key(const Image* img, int step) {
+    uint64_t hash = hash_int(FNV_OFFSET_BASIS, FEATURE_CACHE_VERSION);
+    hash = hash_int(hash, img->width);
+    hash = hash_int(hash, img->height);
+    hash = hash_int(hash, img->channels);
+    hash = hash_int(hash, step);
+    hash = hash_int(hash, SIFT_DESC_SIZE);
+    hash = feature_cache_hash(img->data, (size_t)img->width * img->height * img->channels, hash);
+    return non_zero_key(hash);
+}
+
+uint64_t feature_cache_codebook_key(const Codebook* codebook) {
+    uint64_t hash = hash_int(FNV_OFFSET_BASIS, codebook->num_clusters);
+    hash = hash_int(hash, codebook->dim);
+    for (int i = 0; i < codebook->num_clusters; i++) {
+        hash = feature_cache_hash(codebook->centers[i], codebook->dim * sizeof(float), hash);
+    }
+    return non_zero_key(hash);
+}
+
+uint64_t feature_cache_spm_key(uint64_t sift_key, int level, uint64_t codebook_key) {
+    uint64_t hash = feature_cache_hash(&sift_key, sizeof(sift_key), FNV_OFFSET_BASIS);
+    hash = hash_int(hash, level);
+    hash = feature_cache_hash(&codebook_key, sizeof(codebook_key), hash);
+    return non_zero_key(hash);
+}
+
+// 哈希表操作
+static void shard_index_insert(CacheShard* shard, uint64_t key, uint64_t offset);
+
+static void shard_index_grow(CacheShard* shard) {
+    int old_capacity = shard->capacity;
+    uint64_t* old_keys = shard->keys;
+    uint64_t* old_offsets = shard->offsets;
+
+    shard->capacity = old_capacity ? old_capacity * 2 : 64;
+    shard->keys = (uint64_t*)MEM_CALLOC(shard->capacity, sizeof(uint64_t));
+    shard->offsets = (uint64_t*)MEM_CALLOC(shard->capacity, sizeof(uint64_t));
+    if (!shard->keys || !shard->offsets) {
+        fprintf(stderr, "Error: Memory allocation failed for cache index\n");
+        exit(EXIT_FAILURE);
+    }
+    shard->count = 0;
+
+    for (int i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != CACHE_INDEX_EMPTY) {
+            shard_index_insert(shard, old_keys[i], old_offsets[i]);
+        }
+    }
+
+    MEM_FREE(old_keys);
+    MEM_FREE(old_offsets);
+}
+
+static void shard_index_insert(CacheShard* shard, uint64_t key, uint64_t offset) {
+    // 负载因子保持在0.5以下
+    if ((shard->count + 1) * 2 > shard->capacity) {
+        shard_index_grow(shard);
+    }
+
+    int mask = shard->capacity - 1;
+    int slot = (int)(key & mask);
+    while (shard->keys[slot] != CACHE_INDEX_EMPTY && shard->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+
+    if (shard->keys[slot] == CACHE_INDEX_EMPTY) {
+        shard->count++;
+    }
+    shard->keys[slot] = key;
+    shard->offsets[slot] = offset;
+}
+
+static int shard_index_find(const CacheShard* shard, uint64_t key, uint64_t* offset) {
+    if (shard->capacity == 0) {
+        return 0;
+    }
+
+    int mask = shard->capacity - 1;
+    int slot = (int)(key & mask);
+    while (shard->keys[slot] != CACHE_INDEX_EMPTY) {
+        if (shard->keys[slot] == key) {
+            *offset = shard->offsets[slot];
+            return 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
+
+// 保证整个文件已映射
+static int shard_remap(CacheShard* shard) {
+    if (shard->map_size == shard->file_size) {
+        return 1;
+    }
+
+    if (shard->map) {
+        munmap(shard->map, shard->map_size);
+        shard->map = NULL;
+        shard->map_size = 0;
+    }
+
+    if (shard->file_size == 0) {
+        return 1;
+    }
+
+    void* map = mmap(NULL, shard->file_size, PROT_READ, MAP_SHARED, shard->fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map cache shard (%s)\n", strerror(errno));
+        return 0;
+    }
+
+    shard->map = (unsigned char*)map;
+    shard->map_size = shard->file_size;
+    return 1;
+}
+
+static size_t record_payload_size(const CacheRecordHeader* header) {
+    return (size_t)header->count * header->dim * sizeof(float);
+}
+
+// 打开分片并扫描已有记录建立索引，截断不完整的尾部记录
+static int shard_open(CacheShard* shard, const char* path) {
+    memset(shard, 0, sizeof(CacheShard));
+    shard->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (shard->fd < 0) {
+        fprintf(stderr, "Error: Could not open cache shard %s\n", path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(shard->fd, &st) != 0) {
+        close(shard->fd);
+        return 0;
+    }
+    shard->file_size = (size_t)st.st_size;
+
+    if (!shard_remap(shard)) {
+        close(shard->fd);
+        return 0;
+    }
+
+    size_t offset = 0;
+    while (offset + sizeof(CacheRecordHeader) <= shard->file_size) {
+        CacheRecordHeader header;
+        memcpy(&header, shard->map + offset, sizeof(header));
+        size_t record_size = sizeof(header) + record_payload_size(&header);
+
+        if (header.magic != CACHE_RECORD_MAGIC || offset + record_size > shard->file_size) {
+            break;
+        }
+
+        shard_index_insert(shard, header.key, offset);
+        offset += record_size;
+    }
+
+    if (offset != shard->file_size) {
+        fprintf(stderr, "Warning: Truncating corrupted tail of cache shard %s\n", path);
+        if (ftruncate(shard->fd, (off_t)offset) != 0) {
+            fprintf(stderr, "Error: Could not truncate cache shard %s\n", path);
+        }
+        shard->file_size = offset;
+        shard_remap(shard);
+    }
+
+    return 1;
+}
+
+static void shard_close(CacheShard* shard) {
+    if (shard->map) {
+        munmap(shard->map, shard->map_size);
+    }
+    if (shard->fd >= 0) {
+        close(shard->fd);
+    }
+    MEM_FREE(shard->keys);
+    MEM_FREE(shard->offsets);
+    memset(shard, 0, sizeof(CacheShard));
+    shard->fd = -1;
+}
+
+// 追加一条记录，payload为float数组
+static int shard_append(CacheShard* shard, uint64_t key, uint32_t count, uint32_t dim, const float* payload) {
+    CacheRecordHeader header = {CACHE_RECORD_MAGIC, count, dim, 0, key};
+    size_t payload_size = record_payload_size(&header);
+    size_t offset = shard->file_size;
+
+    if (pwrite(shard->fd, &header, sizeof(header), (off_t)offset) != (ssize_t)sizeof(header)) {
+        return 0;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)payload;
+    size_t written = 0;
+    while (written < payload_size) {
+        ssize_t n = pwrite(shard->fd, bytes + written, payload_size - written,
+                           (off_t)(offset + sizeof(header) + written));
+        if (n <= 0) {
+            return 0;
+        }
+        written += (size_t)n;
+    }
+
+    shard->file_size = offset + sizeof(header) + payload_size;
+    shard_index_insert(shard, key, offset);
+    return 1;
+}
+
+// 查找记录，返回指向映射区域中记录头的指针
+static const CacheRecordHeader* shard_lookup(CacheShard* shard, uint64_t key) {
+    uint64_t offset;
+    if (!shard_index_find(shard, key, &offset)) {
+        return NULL;
+    }
+    if (!shard_remap(shard)) {
+        return NULL;
+    }
+    return (const CacheRecordHeader*)(shard->map + offset);
+}
+
+static int open_shard_set(FeatureCache* cache, CacheShard** shards, const char* prefix) {
+    *shards = (CacheShard*)MEM_CALLOC(cache->num_shards, sizeof(CacheShard));
+    if (!*shards) {
+        fprintf(stderr, "Error: Memory allocation failed for cache shards\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char path[600];
+    for (int i = 0; i < cache->num_shards; i++) {
+        snprintf(path, sizeof(path), "%s/%s-%03d.bin", cache->dir, prefix, i);
+        if (!shard_open(&(*shards)[i], path)) {
+            for (int j = 0; j < i; j++) {
+                shard_close(&(*shards)[j]);
+            }
+            MEM_FREE(*shards);
+            *shards = NULL;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void close_shard_set(FeatureCache* cache, CacheShard* shards) {
+    if (!shards) {
+        return;
+    }
+    for (int i = 0; i < cache->num_shards; i++) {
+        shard_close(&shards[i]);
+    }
+    MEM_FREE(shards);
+}
+
+FeatureCache* feature_cache_open(const char* dir, int num_shards) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Could not create cache directory %s\n", dir);
+        return NULL;
+    }
+
+    FeatureCache* cache = (FeatureCache*)MEM_CALLOC(1, sizeof(FeatureCache));
+    if (!cache) {
+        fprintf(stderr, "Error: Memory allocation failed for feature cache\n");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(cache->dir, sizeof(cache->dir), "%s", dir);
+    cache->num_shards = num_shards > 0 ? num_shards : FEATURE_CACHE_DEFAULT_SHARDS;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    if (!open_shard_set(cache, &cache->sift_shards, "sift") ||
+        !open_shard_set(cache, &cache->spm_shards, "spm")) {
+        feature_cache_close(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void feature_cache_close(FeatureCache* cache) {
+    if (!cache) {
+        return;
+    }
+    close_shard_set(cache, cache->sift_shards);
+    close_shard_set(cache, cache->spm_shards);
+    pthread_mutex_destroy(&cache->lock);
+    MEM_FREE(cache);
+}
+
+int feature_cache_get_sift(FeatureCache* cache, uint64_t key, DescriptorList* out) {
+    if (!cache) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    CacheShard* shard = &cache->sift_shards[key % cache->num_shards];
+    const CacheRecordHeader* header = shard_lookup(shard, key);
+
+    if (!header || header->dim < 2) {
+        cache->sift_misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return 0;
+    }
+
+    int desc_length = (int)header->dim - 2;
+    const float* payload = (const float*)(header + 1);
+
+    *out = create_descriptor_list(header->count);
+    for (uint32_t i = 0; i < header->count; i++) {
+        const float* row = payload + (size_t)i * header->dim;
+        Descriptor desc = create_descriptor(desc_length);
+        desc.x = row[0];
+        desc.y = row[1];
+        memcpy(desc.data, row + 2, desc_length * sizeof(float));
+        add_descriptor(out, desc);
+    }
+
+    cache->sift_hits++;
+    cache->bytes_read += record_payload_size(header);
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+void feature_cache_put_sift(FeatureCache* cache, uint64_t key, const DescriptorList* descriptors) {
+    if (!cache) {
+        return;
+    }
+
+    int desc_length = descriptors->count > 0 ? descriptors->descriptors[0].length : 0;
+    int row_length = desc_length + 2;
+    float* payload = allocate_float_array(descriptors->count * row_length + 1);
+
+    for (int i = 0; i < descriptors->count; i++) {
+        float* row = payload + (size_t)i * row_length;
+        row[0] = descriptors->descriptors[i].x;
+        row[1] = descriptors->descriptors[i].y;
+        memcpy(row + 2, descriptors->descriptors[i].data, desc_length * sizeof(float));
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    CacheShard* shard = &cache->sift_shards[key % cache->num_shards];
+    if (shard_append(shard, key, (uint32_t)descriptors->count, (uint32_t)row_length, payload)) {
+        cache->bytes_written += (size_t)descriptors->count * row_length * sizeof(float);
+    } else {
+        fprintf(stderr, "Error: Could not write SIFT record to cache\n");
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    free_float_array(payload);
+}
+
+int feature_cache_get_spm(FeatureCache* cache, uint64_t key, SpmHistogram* out) {
+    if (!cache) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    CacheShard* shard = &cache->spm_shards[key % cache->num_shards];
+    const CacheRecordHeader* header = shard_lookup(shard, key);
+
+    if (!header || header->dim != 1) {
+        cache->spm_misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return 0;
+    }
+
+    out->length = (int)header->count;
+    out->histogram = allocate_float_array(out->length);
+    memcpy(out->histogram, header + 1, record_payload_size(header));
+
+    cache->spm_hits++;
+    cache->bytes_read += record_payload_size(header);
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+void feature_cache_put_spm(FeatureCache* cache, uint64_t key, const SpmHistogram* hist) {
+    if (!cache) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    CacheShard* shard = &cache->spm_shards[key % cache->num_shards];
+    if (shard_append(shard, key, (uint32_t)hist->length, 1, hist->histogram)) {
+        cache->bytes_written += (size_t)hist->length * sizeof(float);
+    } else {
+        fprintf(stderr, "Error: Could not write SPM record to cache\n");
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void feature_cache_print_stats(const FeatureCache* cache) {
+    if (!cache) {
+        return;
+    }
+
+    long sift_total = cache->sift_hits + cache->sift_misses;
+    long spm_total = cache->spm_hits + cache->spm_misses;
+
+    printf("Feature cache %s:\n", cache->dir);
+    printf("  SIFT: %ld hits, %ld misses (%.1f%% hit rate)\n", cache->sift_hits, cache->sift_misses,
+           sift_total > 0 ? 100.0 * cache->sift_hits / sift_total : 0.0);
+    printf("  SPM:  %ld hits, %ld misses (%.1f%% hit rate)\n", cache->spm_hits, cache->spm_misses,
+           spm_total > 0 ? 100.0 * cache->spm_hits / spm_total : 0.0);
+    printf("  %.2f MB read, %.2f MB written\n", cache->bytes_read / (1024.0 * 1024.0),
+           cache->bytes_written / (1024.0 * 1024.0));
+}
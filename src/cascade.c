@@ -0,0 +1,285 @@
+#define MEMTRACK_TAG MEM_TAG_SVM
+#include "cascade.h"
+#include "sift.h"
+
+int cascade_num_coarse(int level) {
+    return level > 0 ? level : 1;
+}
+
+int cascade_stage_offset(int num_clusters, int stage) {
+    int offset = 0;
+    for (int s = 0; s < stage; s++) {
+        offset += spm_histogram_length(num_clusters, s);
+    }
+    return offset;
+}
+
+int cascade_feature_length(int num_clusters, int level) {
+    return cascade_stage_offset(num_clusters, cascade_num_coarse(level));
+}
+
+// 每个阶段按自身的层数加权，与单独构建的 0..l 层金字塔相同
+void cascade_accumulate_word(float* features, int num_clusters, int level, int word,
+                             float x, float y, int width, int height, float scale) {
+    int offset = 0;
+    for (int s = 0; s < cascade_num_coarse(level); s++) {
+        spm_accumulate_word(features + offset, num_clusters, s, word, x, y, width, height, scale);
+        offset += spm_histogram_length(num_clusters, s);
+    }
+}
+
+// 一对多打分，返回最佳类别，margin 为最大与次大决策值之差
+static int score_classes(SVMModel* const* models, int num_classes, const double* features, double* scores,
+                         double* margin) {
+    int best_class = -1;
+    double best_score = -DBL_MAX;
+    double second_score = -DBL_MAX;
+
+    for (int c = 0; c < num_classes; c++) {
+        scores[c] = svm_decision_value(models[c], features);
+        if (scores[c] > best_score) {
+            second_score = best_score;
+            best_score = scores[c];
+            best_class = c;
+        } else if (scores[c] > second_score) {
+            second_score = scores[c];
+        }
+    }
+
+    *margin = num_classes > 1 ? best_score - second_score : DBL_MAX;
+    return best_class;
+}
+
+CascadeClassifier* cascade_train(double** features, const int* labels, int num_samples, int num_clusters,
+                                 int level, int num_classes, double C, int svm_iterations, int dual) {
+    int num_coarse = cascade_num_coarse(level);
+    if (num_coarse + 1 > CASCADE_MAX_STAGES) {
+        fprintf(stderr, "Error: Cascade supports at most %d pyramid levels\n", CASCADE_MAX_STAGES - 2);
+        return NULL;
+    }
+
+    CascadeClassifier* cascade = (CascadeClassifier*)MEM_CALLOC(1, sizeof(CascadeClassifier));
+    double** rows = (double**)MEM_MALLOC((num_samples + 1) * sizeof(double*));
+    int* binary = (int*)MEM_MALLOC((num_samples + 1) * sizeof(int));
+    if (!cascade || !rows || !binary) {
+        fprintf(stderr, "Error: Memory allocation failed for cascade classifier\n");
+        exit(EXIT_FAILURE);
+    }
+
+    cascade->level = level;
+    cascade->num_coarse = num_coarse;
+    cascade->num_classes = num_classes;
+    cascade->num_clusters = num_clusters;
+    cascade->models = (SVMModel**)MEM_CALLOC(num_coarse * num_classes, sizeof(SVMModel*));
+    if (!cascade->models) {
+        fprintf(stderr, "Error: Memory allocation failed for cascade models\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int s = 0; s < num_coarse; s++) {
+        int offset = cascade_stage_offset(num_clusters, s);
+        int length = spm_histogram_length(num_clusters, s);
+        for (int i = 0; i < num_samples; i++) {
+            rows[i] = features[i] + offset;
+        }
+
+        for (int c = 0; c < num_classes; c++) {
+            for (int i = 0; i < num_samples; i++) {
+                binary[i] = labels[i] == c ? 1 : -1;
+            }
+            SVMModel* model = svm_create(length, C);
+            if (dual) {
+                SVMSolverOptions solver = {svm_iterations, SVM_DEFAULT_TOLERANCE, SVM_DEFAULT_GAP_TOLERANCE};
+                svm_train_dual(model, NULL, rows, binary, num_samples, &solver);
+            } else {
+                svm_train(model, rows, binary, num_samples, svm_iterations);
+            }
+            cascade->models[s * num_classes + c] = model;
+        }
+        cascade->thresholds[s] = DBL_MAX;
+    }
+
+    MEM_FREE(rows);
+    MEM_FREE(binary);
+    return cascade;
+}
+
+typedef struct {
+    double margin;
+    int agrees;
+} CalibrationSample;
+
+static int compare_margin_desc(const void* a, const void* b) {
+    double x = ((const CalibrationSample*)a)->margin;
+    double y = ((const CalibrationSample*)b)->margin;
+    return (x < y) - (x > y);
+}
+
+// 样本按边距降序排列，取满足一致率的最长前缀；同边距的样本一起计入，阈值为前缀中最小的边距
+void cascade_calibrate(CascadeClassifier* cascade, double** features, const int* full_predictions,
+                       int num_samples, double agreement) {
+    CalibrationSample* samples = (CalibrationSample*)MEM_MALLOC((num_samples + 1) * sizeof(CalibrationSample));
+    double* scores = (double*)MEM_MALLOC((cascade->num_classes + 1) * sizeof(double));
+    if (!samples || !scores) {
+        fprintf(stderr, "Error: Memory allocation failed for cascade calibration\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int s = 0; s < cascade->num_coarse; s++) {
+        int offset = cascade_stage_offset(cascade->num_clusters, s);
+        for (int i = 0; i < num_samples; i++) {
+            int predicted = score_classes(cascade->models + s * cascade->num_classes, cascade->num_classes,
+                                          features[i] + offset, scores, &samples[i].margin);
+            samples[i].agrees = predicted == full_predictions[i];
+        }
+        qsort(samples, num_samples, sizeof(CalibrationSample), compare_margin_desc);
+
+        int accepted = 0;
+        int disagreements = 0;
+        for (int k = 1; k <= num_samples; k++) {
+            disagreements += !samples[k - 1].agrees;
+            int group_end = k == num_samples || samples[k].margin < samples[k - 1].margin;
+            if (group_end && disagreements <= (1.0 - agreement) * k) {
+                accepted = k;
+            }
+        }
+        cascade->thresholds[s] = accepted > 0 ? samples[accepted - 1].margin : DBL_MAX;
+    }
+
+    MEM_FREE(samples);
+    MEM_FREE(scores);
+}
+
+void cascade_free(CascadeClassifier* cascade) {
+    if (cascade) {
+        for (int i = 0; i < cascade->num_coarse * cascade->num_classes; i++) {
+            svm_free(cascade->models[i]);
+        }
+        MEM_FREE(cascade->models);
+        MEM_FREE(cascade);
+    }
+}
+
+static void quantize_into(InferenceWorkspace* workspace, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        workspace->words[i] = find_nearest_center(workspace->descriptors + (size_t)i * SIFT_DESC_SIZE,
+                                                  workspace->codebook);
+    }
+}
+
+// 将粗网格 words[0..num_coarse) 与细网格 words[num_coarse..num_coarse+num_fine) 累加为 0..level 层的直方图，
+// 并转换为SVM的输入。两段各自按行优先排列，按坐标归并后即为密集网格的顺序，
+// 因此完整阶段的浮点累加顺序与 classify_image 相同，直方图逐位一致
+static void build_features(InferenceWorkspace* workspace, int num_coarse, int num_fine, int level, int width,
+                           int height) {
+    int num_clusters = workspace->codebook->num_clusters;
+    int length = spm_histogram_length(num_clusters, level);
+    const float* positions = workspace->positions;
+
+    memset(workspace->histogram, 0, length * sizeof(float));
+    int count = num_coarse + num_fine;
+    if (count > 0) {
+        float inv_count = 1.0f / (float)count;
+        int coarse = 0;
+        int fine = num_coarse;
+        while (coarse < num_coarse || fine < count) {
+            int i;
+            if (fine >= count) {
+                i = coarse++;
+            } else if (coarse >= num_coarse) {
+                i = fine++;
+            } else {
+                float cy = positions[coarse * 2 + 1];
+                float fy = positions[fine * 2 + 1];
+                int coarse_first = cy < fy || (cy == fy && positions[coarse * 2] < positions[fine * 2]);
+                i = coarse_first ? coarse++ : fine++;
+            }
+            spm_accumulate_word(workspace->histogram, num_clusters, level, workspace->words[i],
+                                positions[i * 2], positions[i * 2 + 1], width, height, inv_count);
+        }
+    }
+
+    for (int i = 0; i < length; i++) {
+        workspace->features[i] = workspace->histogram[i];
+    }
+}
+
+int classify_image_cascade_view(InferenceWorkspace* workspace, const CascadeClassifier* cascade,
+                                const ImageView* img, int* stage, CascadeStats* stats) {
+    if (img->width > workspace->max_width || img->height > workspace->max_height) {
+        fprintf(stderr, "Error: Image %dx%d exceeds inference workspace %dx%d\n",
+                img->width, img->height, workspace->max_width, workspace->max_height);
+        return -1;
+    }
+    if (cascade->level != workspace->level || cascade->num_clusters != workspace->codebook->num_clusters ||
+        cascade->num_classes != workspace->num_classes) {
+        fprintf(stderr, "Error: Cascade classifier does not match the inference workspace\n");
+        return -1;
+    }
+
+    convert_view_to_gray16_into(img, &workspace->gray);
+    compute_orientation_planes_gray16_into(&workspace->gray, &workspace->planes, SIFT_ORI_BINNING);
+
+    // 粗网格描述符由所有粗网格阶段共用
+    int num_coarse = extract_dense_sift_subset_into(&workspace->planes, workspace->step, CASCADE_COARSE_STRIDE,
+                                                    DENSE_GRID_COARSE, workspace->descriptors,
+                                                    workspace->positions, workspace->max_descriptors);
+    quantize_into(workspace, 0, num_coarse);
+    if (stats) {
+        stats->images++;
+        stats->descriptors += num_coarse;
+        stats->dense_descriptors += (long)dense_sift_grid_count(img->width, workspace->step) *
+                                    dense_sift_grid_count(img->height, workspace->step);
+    }
+
+    double margin;
+    int best_class;
+    for (int s = 0; s < cascade->num_coarse; s++) {
+        build_features(workspace, num_coarse, 0, s, img->width, img->height);
+        best_class = score_classes(cascade->models + s * cascade->num_classes, cascade->num_classes,
+                                   workspace->features, workspace->scores, &margin);
+        if (stats) {
+            stats->computed[s]++;
+        }
+        if (margin >= cascade->thresholds[s]) {
+            if (stage) *stage = s;
+            return best_class;
+        }
+    }
+
+    // 完整阶段: 细网格描述符接在粗网格之后
+    int num_fine = extract_dense_sift_subset_into(&workspace->planes, workspace->step, CASCADE_COARSE_STRIDE,
+                                                  DENSE_GRID_FINE,
+                                                  workspace->descriptors + (size_t)num_coarse * SIFT_DESC_SIZE,
+                                                  workspace->positions + (size_t)num_coarse * 2,
+                                                  workspace->max_descriptors - num_coarse);
+    quantize_into(workspace, num_coarse, num_coarse + num_fine);
+    workspace->num_descriptors = num_coarse + num_fine;
+    if (stats) {
+        stats->computed[cascade->num_coarse]++;
+        stats->descriptors += num_fine;
+    }
+
+    build_features(workspace, num_coarse, num_fine, workspace->level, img->width, img->height);
+    best_class = score_classes(workspace->models, workspace->num_classes, workspace->features, workspace->scores,
+                               &margin);
+    if (stage) *stage = cascade->num_coarse;
+    return best_class;
+}
+
+void cascade_print_stats(const CascadeClassifier* cascade, const CascadeStats* stats) {
+    double images = stats->images > 0 ? (double)stats->images : 1.0;
+    for (int s = 0; s < cascade->num_coarse; s++) {
+        if (cascade->thresholds[s] < DBL_MAX) {
+            printf("  stage %d coarse L0-%d: computed %6ld (%5.1f%%)  threshold %.4f\n", s, s,
+                   stats->computed[s], 100.0 * stats->computed[s] / images, cascade->thresholds[s]);
+        } else {
+            printf("  stage %d coarse L0-%d: computed %6ld (%5.1f%%)  threshold never\n", s, s,
+                   stats->computed[s], 100.0 * stats->computed[s] / images);
+        }
+    }
+    printf("  stage %d dense  L0-%d: computed %6ld (%5.1f%%)\n", cascade->num_coarse, cascade->level,
+           stats->computed[cascade->num_coarse], 100.0 * stats->computed[cascade->num_coarse] / images);
+    printf("  descriptors: %ld of %ld (%.1f%%)\n", stats->descriptors, stats->dense_descriptors,
+           stats->dense_descriptors > 0 ? 100.0 * stats->descriptors / stats->dense_descriptors : 0.0);
+}
@@ -1,16 +1,30 @@
+#define MEMTRACK_TAG MEM_TAG_IMAGE
 #include "image.h"
 #include "utils.h"
+#include "trace.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define IMAGE_HAVE_X86 1
+#endif
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
+
+// BT.709权重的Q15定点表示 (三者之和为32768)，加权和右移8位后最大值为 GRAY16_SCALE
+#define GRAY16_WEIGHT_R 6966
+#define GRAY16_WEIGHT_G 23436
+#define GRAY16_WEIGHT_B 2366
+#define GRAY16_SHIFT 8
+
 // 图像创建与释放
 Image create_image(int width, int height, int channels) {
     Image img;
     img.width = width;
     img.height = height;
     img.channels = channels;
-    img.data = (unsigned char*)malloc(width * height * channels * sizeof(unsigned char));
+    img.data = (unsigned char*)MEM_MALLOC(width * height * channels * sizeof(unsigned char));
 
     if (!img.data) {
         fprintf(stderr, "Error: Memory allocation failed for image\n");
@@ -23,7 +37,7 @@ Image create_image(int width, int height, int channels) {
 
 void free_image(Image* img) {
     if (img && img->data) {
-        free(img->data);
+        MEM_FREE(img->data);
         img->data = NULL;
         img->width = 0;
         img->height = 0;
@@ -35,7 +49,7 @@ GrayImage create_gray_image(int width, int height) {
     GrayImage img;
     img.width = width;
     img.height = height;
-    img.data = (float*)malloc(width * height * sizeof(float));
+    img.data = (float*)MEM_MALLOC(width * height * sizeof(float));
 
     if (!img.data) {
         fprintf(stderr, "Error: Memory allocation failed for gray image\n");
@@ -48,32 +62,314 @@ GrayImage create_gray_image(int width, int height) {
 
 void free_gray_image(GrayImage* img) {
     if (img && img->data) {
-        free(img->data);
+        MEM_FREE(img->data);
         img->data = NULL;
         img->width = 0;
         img->height = 0;
     }
 }
 
+Gray16Image create_gray16_image(int width, int height) {
+    Gray16Image img;
+    img.width = width;
+    img.height = height;
+    img.data = (int16_t*)MEM_CALLOC((size_t)width * height, sizeof(int16_t));
+
+    if (!img.data) {
+        fprintf(stderr, "Error: Memory allocation failed for fixed-point gray image\n");
+        exit(EXIT_FAILURE);
+    }
+    return img;
+}
+
+void free_gray16_image(Gray16Image* img) {
+    if (img && img->data) {
+        MEM_FREE(img->data);
+        img->data = NULL;
+        img->width = 0;
+        img->height = 0;
+    }
+}
+
+Gray16Batch create_gray16_batch(int width, int height) {
+    Gray16Batch batch;
+    batch.width = width;
+    batch.height = height;
+    batch.count = 0;
+    batch.data = (int16_t*)MEM_CALLOC((size_t)width * height * IMAGE_BATCH_LANES, sizeof(int16_t));
+    batch.scratch = (int16_t*)MEM_CALLOC((size_t)width * height, sizeof(int16_t));
+
+    if (!batch.data || !batch.scratch) {
+        fprintf(stderr, "Error: Memory allocation failed for gray image batch\n");
+        exit(EXIT_FAILURE);
+    }
+    return batch;
+}
+
+void free_gray16_batch(Gray16Batch* batch) {
+    if (batch && batch->data) {
+        MEM_FREE(batch->data);
+        MEM_FREE(batch->scratch);
+        batch->data = NULL;
+        batch->scratch = NULL;
+        batch->width = 0;
+        batch->height = 0;
+        batch->count = 0;
+    }
+}
+
 // 图像转换
 GrayImage convert_to_gray(const Image* img) {
     GrayImage gray = create_gray_image(img->width, img->height);
+    convert_to_gray_into(img, &gray);
+    return gray;
+}
 
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            int idx = (y * img->width + x) * img->channels;
+// 转换到预分配的灰度图像 (gray->data 至少容纳 width*height 个像素)
+void convert_to_gray_into(const Image* img, GrayImage* gray) {
+    ImageView view = image_view(img);
+    convert_view_to_gray_into(&view, gray);
+}
 
+void convert_view_to_gray_into(const ImageView* view, GrayImage* gray) {
+    TRACE_BEGIN(gray);
+    gray->width = view->width;
+    gray->height = view->height;
+
+    for (int y = 0; y < view->height; y++) {
+        const unsigned char* pixel = view->data + y * view->row_stride;
+        for (int x = 0; x < view->width; x++, pixel += view->pixel_stride) {
             // 使用BT.709加权平均将RGB转换为灰度
-            float r = img->data[idx] / 255.0f;
-            float g = img->data[idx + 1] / 255.0f;
-            float b = img->data[idx + 2] / 255.0f;
+            float r = pixel[0] / 255.0f;
+            float g = pixel[view->channel_stride] / 255.0f;
+            float b = pixel[2 * view->channel_stride] / 255.0f;
 
             float gray_value = 0.2126f * r + 0.7152f * g + 0.0722f * b;
-            gray.data[y * img->width + x] = gray_value;
+            gray->data[y * view->width + x] = gray_value;
         }
     }
 
-    return gray;
+    TRACE_END(gray, TRACE_STAGE_GRAY, (size_t)view->width * view->height * view->channels);
+}
+
+static inline int16_t gray16_pixel(const unsigned char* pixel, ptrdiff_t channel_stride) {
+    int sum = GRAY16_WEIGHT_R * pixel[0] + GRAY16_WEIGHT_G * pixel[channel_stride] +
+              GRAY16_WEIGHT_B * pixel[2 * channel_stride];
+    return (int16_t)((sum + (1 << (GRAY16_SHIFT - 1))) >> GRAY16_SHIFT);
+}
+
+#ifdef IMAGE_HAVE_X86
+
+// 16个像素的R/G/B字节 → 16个定点灰度值
+// (r,g) 与 (b,舍入常数) 两两交错后用 madd 得到32位加权和，unpack/pack 都在128位通道内进行，顺序自然还原
+__attribute__((target("avx2"), always_inline))
+static inline __m256i gray16_weigh_avx2(__m128i r, __m128i g, __m128i b) {
+    const __m256i weights_rg = _mm256_set1_epi32((GRAY16_WEIGHT_G << 16) | GRAY16_WEIGHT_R);
+    const __m256i weights_b1 = _mm256_set1_epi32((1 << 16) | GRAY16_WEIGHT_B);
+    const __m256i rounding = _mm256_set1_epi16(1 << (GRAY16_SHIFT - 1));
+
+    __m256i r16 = _mm256_cvtepu8_epi16(r);
+    __m256i g16 = _mm256_cvtepu8_epi16(g);
+    __m256i b16 = _mm256_cvtepu8_epi16(b);
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r16, g16), weights_rg),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(b16, rounding), weights_b1));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r16, g16), weights_rg),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(b16, rounding), weights_b1));
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, GRAY16_SHIFT), _mm256_srai_epi32(hi, GRAY16_SHIFT));
+}
+
+// 交错RGB中48个字节的第chunk段 → 某一通道的16个字节 (不属于该段的位置置0)
+__attribute__((target("avx2")))
+static __m128i deinterleave_mask(int channel, int chunk) {
+    unsigned char mask[16];
+    for (int p = 0; p < 16; p++) {
+        int index = 3 * p + channel;
+        mask[p] = index / 16 == chunk ? (unsigned char)(index % 16) : 0x80;
+    }
+    return _mm_loadu_si128((const __m128i*)mask);
+}
+
+// 支持按通道平面存放 (像素步长1) 与交错RGB (像素步长3、通道步长1) 两种布局，返回每行处理到的位置
+__attribute__((target("avx2")))
+static int convert_gray16_avx2(const ImageView* view, Gray16Image* gray) {
+    int planar = view->pixel_stride == 1;
+    __m128i masks[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) {
+            masks[c][k] = deinterleave_mask(c, k);
+        }
+    }
+
+    int end = 0;
+    for (int y = 0; y < view->height; y++) {
+        const unsigned char* row = view->data + y * view->row_stride;
+        int16_t* out = gray->data + (size_t)y * view->width;
+        int x = 0;
+
+        for (; x + 16 <= view->width; x += 16) {
+            __m128i r, g, b;
+            if (planar) {
+                r = _mm_loadu_si128((const __m128i*)(row + x));
+                g = _mm_loadu_si128((const __m128i*)(row + x + view->channel_stride));
+                b = _mm_loadu_si128((const __m128i*)(row + x + 2 * view->channel_stride));
+            } else {
+                const unsigned char* pixel = row + 3 * x;
+                __m128i a0 = _mm_loadu_si128((const __m128i*)pixel);
+                __m128i a1 = _mm_loadu_si128((const __m128i*)(pixel + 16));
+                __m128i a2 = _mm_loadu_si128((const __m128i*)(pixel + 32));
+                r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, masks[0][0]), _mm_shuffle_epi8(a1, masks[0][1])),
+                                 _mm_shuffle_epi8(a2, masks[0][2]));
+                g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, masks[1][0]), _mm_shuffle_epi8(a1, masks[1][1])),
+                                 _mm_shuffle_epi8(a2, masks[1][2]));
+                b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, masks[2][0]), _mm_shuffle_epi8(a1, masks[2][1])),
+                                 _mm_shuffle_epi8(a2, masks[2][2]));
+            }
+            _mm256_storeu_si256((__m256i*)(out + x), gray16_weigh_avx2(r, g, b));
+        }
+        end = x;
+    }
+    return end;
+}
+
+#endif /* IMAGE_HAVE_X86 */
+
+static int image_use_avx2 = -1;
+
+static int detect_image_kernel(void) {
+    if (image_use_avx2 < 0) {
+        int use_avx2 = 0;
+#ifdef IMAGE_HAVE_X86
+        __builtin_cpu_init();
+        use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+        image_use_avx2 = use_avx2;
+    }
+    return image_use_avx2;
+}
+
+void convert_view_to_gray16_into(const ImageView* view, Gray16Image* gray) {
+    TRACE_BEGIN(gray);
+    gray->width = view->width;
+    gray->height = view->height;
+
+    // 各行已由SIMD内核处理的前缀长度 (每行相同)
+    int done = 0;
+#ifdef IMAGE_HAVE_X86
+    int simd_layout = view->pixel_stride == 1 || (view->pixel_stride == 3 && view->channel_stride == 1);
+    if (simd_layout && view->channels >= 3 && detect_image_kernel()) {
+        done = convert_gray16_avx2(view, gray);
+    }
+#endif
+
+    for (int y = 0; y < view->height; y++) {
+        const unsigned char* pixel = view->data + y * view->row_stride + done * view->pixel_stride;
+        int16_t* out = gray->data + (size_t)y * view->width;
+        for (int x = done; x < view->width; x++, pixel += view->pixel_stride) {
+            out[x] = gray16_pixel(pixel, view->channel_stride);
+        }
+    }
+
+    TRACE_END(gray, TRACE_STAGE_GRAY, (size_t)view->width * view->height * view->channels);
+}
+
+// 灰度转换本身没有边界处理，逐幅使用行内核后交错写入即可
+int convert_views_to_gray16_batch(const ImageView* views, int count, Gray16Batch* batch) {
+    if (count < 0 || count > IMAGE_BATCH_LANES) {
+        return 0;
+    }
+    for (int lane = 0; lane < count; lane++) {
+        if (views[lane].width != batch->width || views[lane].height != batch->height) {
+            return 0;
+        }
+    }
+
+    size_t pixels = (size_t)batch->width * batch->height;
+    Gray16Image gray = {batch->scratch, batch->width, batch->height};
+    batch->count = count;
+
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        int16_t* out = batch->data + lane;
+        if (lane < count) {
+            convert_view_to_gray16_into(&views[lane], &gray);
+            for (size_t p = 0; p < pixels; p++) {
+                out[p * IMAGE_BATCH_LANES] = gray.data[p];
+            }
+        } else {
+            for (size_t p = 0; p < pixels; p++) {
+                out[p * IMAGE_BATCH_LANES] = 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// 视图构造
+ImageView image_view(const Image* img) {
+    ImageView view = {img->data, img->width, img->height, img->channels,
+                      (ptrdiff_t)img->width * img->channels, img->channels, 1};
+    return view;
+}
+
+// CIFAR记录按通道平面存放，跳过标签字节即可直接作为视图使用
+ImageView cifar_record_view(const unsigned char* record) {
+    ImageView view = {record + 1, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_CHANNELS,
+                      CIFAR_IMAGE_SIZE, 1, CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE};
+    return view;
+}
+
+ImageView image_view_roi(const ImageView* view, int x, int y, int width, int height) {
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x + width > view->width) width = view->width - x;
+    if (y + height > view->height) height = view->height - y;
+
+    ImageView roi = *view;
+    roi.data = view->data + y * view->row_stride + x * view->pixel_stride;
+    roi.width = width;
+    roi.height = height;
+    return roi;
+}
+
+ImageView image_view_flip_horizontal(const ImageView* view) {
+    ImageView flipped = *view;
+    flipped.data = view->data + (view->width - 1) * view->pixel_stride;
+    flipped.pixel_stride = -view->pixel_stride;
+    return flipped;
+}
+
+ImageView image_view_flip_vertical(const ImageView* view) {
+    ImageView flipped = *view;
+    flipped.data = view->data + (view->height - 1) * view->row_stride;
+    flipped.row_stride = -view->row_stride;
+    return flipped;
+}
+
+GrayView gray_view(const GrayImage* img) {
+    GrayView view = {img->data, img->width, img->height, img->width, 1};
+    return view;
+}
+
+GrayView gray_view_roi(const GrayView* view, int x, int y, int width, int height) {
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x + width > view->width) width = view->width - x;
+    if (y + height > view->height) height = view->height - y;
+
+    GrayView roi = *view;
+    roi.data = view->data + y * view->row_stride + x * view->pixel_stride;
+    roi.width = width;
+    roi.height = height;
+    return roi;
+}
+
+float gray_view_pixel(const GrayView* view, int x, int y) {
+    // 边界检查
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= view->width) x = view->width - 1;
+    if (y >= view->height) y = view->height - 1;
+
+    return view->data[y * view->row_stride + x * view->pixel_stride];
 }
 
 float get_pixel_gray(const GrayImage* img, int x, int y) {
@@ -98,43 +394,119 @@ void set_pixel_gray(GrayImage* img, int x, int y, float value) {
 // 图像操作
 GrayImage compute_gradient_magnitude(const GrayImage* img) {
     GrayImage magnitude = create_gray_image(img->width, img->height);
+    compute_gradient_magnitude_into(img, &magnitude);
+    return magnitude;
+}
 
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
+void compute_gradient_magnitude_into(const GrayImage* img, GrayImage* magnitude) {
+    GrayView view = gray_view(img);
+    compute_gradient_magnitude_view_into(&view, magnitude);
+}
+
+void compute_gradient_magnitude_view_into(const GrayView* view, GrayImage* magnitude) {
+    TRACE_BEGIN(gradient);
+    magnitude->width = view->width;
+    magnitude->height = view->height;
+
+    for (int y = 0; y < view->height; y++) {
+        for (int x = 0; x < view->width; x++) {
             // 简单的Sobel算子计算梯度
-            float gx = get_pixel_gray(img, x+1, y) - get_pixel_gray(img, x-1, y);
-            float gy = get_pixel_gray(img, x, y+1) - get_pixel_gray(img, x, y-1);
+            float gx = gray_view_pixel(view, x+1, y) - gray_view_pixel(view, x-1, y);
+            float gy = gray_view_pixel(view, x, y+1) - gray_view_pixel(view, x, y-1);
 
             // 计算梯度幅值
             float mag = sqrtf(gx*gx + gy*gy);
-            set_pixel_gray(&magnitude, x, y, mag);
+            magnitude->data[y * view->width + x] = mag;
         }
     }
 
-    return magnitude;
+    TRACE_END(gradient, TRACE_STAGE_GRADIENT, (size_t)view->width * view->height * sizeof(float));
 }
 
 GrayImage compute_gradient_orientation(const GrayImage* img) {
     GrayImage orientation = create_gray_image(img->width, img->height);
+    compute_gradient_orientation_into(img, &orientation);
+    return orientation;
+}
 
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
+void compute_gradient_orientation_into(const GrayImage* img, GrayImage* orientation) {
+    GrayView view = gray_view(img);
+    compute_gradient_orientation_view_into(&view, orientation);
+}
+
+void compute_gradient_orientation_view_into(const GrayView* view, GrayImage* orientation) {
+    TRACE_BEGIN(gradient);
+    orientation->width = view->width;
+    orientation->height = view->height;
+
+    for (int y = 0; y < view->height; y++) {
+        for (int x = 0; x < view->width; x++) {
             // 简单的Sobel算子计算梯度
-            float gx = get_pixel_gray(img, x+1, y) - get_pixel_gray(img, x-1, y);
-            float gy = get_pixel_gray(img, x, y+1) - get_pixel_gray(img, x, y-1);
+            float gx = gray_view_pixel(view, x+1, y) - gray_view_pixel(view, x-1, y);
+            float gy = gray_view_pixel(view, x, y+1) - gray_view_pixel(view, x, y-1);
 
             // 计算梯度方向 (弧度，范围 [0, 2π))
             float angle = atan2f(gy, gx);
             if (angle < 0) angle += 2.0f * M_PI;
 
-            set_pixel_gray(&orientation, x, y, angle);
+            orientation->data[y * view->width + x] = angle;
         }
     }
 
-    return orientation;
+    TRACE_END(gradient, TRACE_STAGE_GRADIENT, (size_t)view->width * view->height * sizeof(float));
 }
 
+// 固定图像边长和核半径的可分离高斯模糊
+// 内部区域无边界判断，边界区域按复制边界处理；每个像素的累加顺序与通用版本相同，结果逐位一致
+#define DEFINE_GAUSSIAN_BLUR(SUFFIX, SIZE, HALF)                                                \
+    static void blur_horizontal_##SUFFIX(const float* in, const float* kernel, float* out) {  \
+        for (int y = 0; y < (SIZE); y++) {                                                     \
+            const float* row = in + y * (SIZE);                                                \
+            float* dst = out + y * (SIZE);                                                     \
+            for (int x = 0; x < (SIZE); x++) {                                                 \
+                float sum = 0.0f;                                                              \
+                if (x >= (HALF) && x < (SIZE) - (HALF)) {                                      \
+                    UNROLL_LOOP                                                                \
+                    for (int i = -(HALF); i <= (HALF); i++) {                                  \
+                        sum += row[x + i] * kernel[i + (HALF)];                                \
+                    }                                                                          \
+                } else {                                                                       \
+                    for (int i = -(HALF); i <= (HALF); i++) {                                  \
+                        int xi = x + i < 0 ? 0 : (x + i >= (SIZE) ? (SIZE) - 1 : x + i);       \
+                        sum += row[xi] * kernel[i + (HALF)];                                   \
+                    }                                                                          \
+                }                                                                              \
+                dst[x] = sum;                                                                  \
+            }                                                                                  \
+        }                                                                                      \
+    }                                                                                          \
+    static void blur_vertical_##SUFFIX(const float* in, const float* kernel, float* out) {    \
+        for (int y = 0; y < (SIZE); y++) {                                                     \
+            float* dst = out + y * (SIZE);                                                     \
+            for (int x = 0; x < (SIZE); x++) {                                                 \
+                dst[x] = 0.0f;                                                                 \
+            }                                                                                  \
+            for (int i = -(HALF); i <= (HALF); i++) {                                          \
+                int yi = y + i < 0 ? 0 : (y + i >= (SIZE) ? (SIZE) - 1 : y + i);               \
+                const float* src = in + yi * (SIZE);                                           \
+                float weight = kernel[i + (HALF)];                                             \
+                for (int x = 0; x < (SIZE); x++) {                                             \
+                    dst[x] += src[x] * weight;                                                 \
+                }                                                                              \
+            }                                                                                  \
+        }                                                                                      \
+    }
+
+// CIFAR图像，sigma = SIFT_SIGMA (1.6) 时核半径为5
+#define CIFAR_BLUR_HALF 5
+DEFINE_GAUSSIAN_BLUR(cifar, CIFAR_IMAGE_SIZE, CIFAR_BLUR_HALF)
+
 GrayImage gaussian_blur(const GrayImage* img, float sigma) {
+    GrayView view = gray_view(img);
+    return gaussian_blur_view(&view, sigma);
+}
+
+GrayImage gaussian_blur_view(const GrayView* img, float sigma) {
     // 计算高斯核大小
     int kernel_size = (int)(6.0f * sigma + 1.0f);
     if (kernel_size % 2 == 0) kernel_size++;  // 确保kernel_size是奇数
@@ -142,7 +514,7 @@ GrayImage gaussian_blur(const GrayImage* img, float sigma) {
     int half_size = kernel_size / 2;
 
     // 创建高斯核
-    float* kernel = (float*)malloc(kernel_size * sizeof(float));
+    float* kernel = (float*)MEM_MALLOC(kernel_size * sizeof(float));
     float sum = 0.0f;
 
     for (int i = 0; i < kernel_size; i++) {
@@ -156,6 +528,18 @@ GrayImage gaussian_blur(const GrayImage* img, float sigma) {
         kernel[i] /= sum;
     }
 
+    // 形状匹配且视图连续时使用特化版本
+    if (img->width == CIFAR_IMAGE_SIZE && img->height == CIFAR_IMAGE_SIZE && half_size == CIFAR_BLUR_HALF &&
+        img->pixel_stride == 1 && img->row_stride == CIFAR_IMAGE_SIZE) {
+        GrayImage temp = create_gray_image(img->width, img->height);
+        GrayImage blurred = create_gray_image(img->width, img->height);
+        blur_horizontal_cifar(img->data, kernel, temp.data);
+        blur_vertical_cifar(temp.data, kernel, blurred.data);
+        free_gray_image(&temp);
+        MEM_FREE(kernel);
+        return blurred;
+    }
+
     // 水平方向高斯模糊
     GrayImage temp = create_gray_image(img->width, img->height);
     for (int y = 0; y < img->height; y++) {
@@ -166,7 +550,7 @@ GrayImage gaussian_blur(const GrayImage* img, float sigma) {
                 if (xi < 0) xi = 0;
                 if (xi >= img->width) xi = img->width - 1;
 
-                sum += get_pixel_gray(img, xi, y) * kernel[i + half_size];
+                sum += gray_view_pixel(img, xi, y) * kernel[i + half_size];
             }
             set_pixel_gray(&temp, x, y, sum);
         }
@@ -189,13 +573,34 @@ GrayImage gaussian_blur(const GrayImage* img, float sigma) {
     }
 
     free_gray_image(&temp);
-    free(kernel);
+    MEM_FREE(kernel);
 
     return blurred;
 }
 
 // CIFAR-10操作
+// 解码一条CIFAR-10记录 (1字节标签 + 3072字节图像数据)
+Image decode_cifar_record(const unsigned char* record) {
+    Image img = create_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_CHANNELS);
+    const unsigned char* pixels = record + 1;
+
+    // CIFAR-10中的数据是按RGB分通道存储的
+    // 先是所有像素的R通道，然后是G通道，最后是B通道
+    for (int c = 0; c < CIFAR_IMAGE_CHANNELS; c++) {
+        for (int y = 0; y < CIFAR_IMAGE_SIZE; y++) {
+            for (int x = 0; x < CIFAR_IMAGE_SIZE; x++) {
+                int img_offset = c * CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE + y * CIFAR_IMAGE_SIZE + x;
+                int pixel_offset = (y * CIFAR_IMAGE_SIZE + x) * CIFAR_IMAGE_CHANNELS + c;
+                img.data[pixel_offset] = pixels[img_offset];
+            }
+        }
+    }
+
+    return img;
+}
+
 CifarDataset load_cifar10_batch(const char* filename) {
+    TRACE_BEGIN(load);
     CifarDataset dataset;
     dataset.count = 0;
     dataset.images = NULL;
@@ -209,17 +614,17 @@ CifarDataset load_cifar10_batch(const char* filename) {
     }
 
     // CIFAR-10文件格式：每个样本有1个字节的标签和3072个字节的图像数据(32x32x3)
-    int num_samples = size / (1 + CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE * CIFAR_IMAGE_CHANNELS);
+    int num_samples = size / CIFAR_RECORD_SIZE;
 
     dataset.count = num_samples;
-    dataset.images = (Image*)malloc(num_samples * sizeof(Image));
-    dataset.labels = (unsigned char*)malloc(num_samples * sizeof(unsigned char));
+    dataset.images = (Image*)MEM_MALLOC(num_samples * sizeof(Image));
+    dataset.labels = (unsigned char*)MEM_MALLOC(num_samples * sizeof(unsigned char));
 
     if (!dataset.images || !dataset.labels) {
         fprintf(stderr, "Error: Memory allocation failed for CIFAR dataset\n");
-        free(data);
-        if (dataset.images) free(dataset.images);
-        if (dataset.labels) free(dataset.labels);
+        MEM_FREE(data);
+        if (dataset.images) MEM_FREE(dataset.images);
+        if (dataset.labels) MEM_FREE(dataset.labels);
         dataset.count = 0;
         dataset.images = NULL;
         dataset.labels = NULL;
@@ -227,28 +632,18 @@ CifarDataset load_cifar10_batch(const char* filename) {
     }
 
     for (int i = 0; i < num_samples; i++) {
-        int offset = i * (1 + CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE * CIFAR_IMAGE_CHANNELS);
+        const unsigned char* record = data + (size_t)i * CIFAR_RECORD_SIZE;
 
         // 读取标签
-        dataset.labels[i] = data[offset];
+        dataset.labels[i] = record[0];
 
         // 读取图像数据
-        dataset.images[i] = create_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_CHANNELS);
-
-        // CIFAR-10中的数据是按RGB分通道存储的
-        // 先是所有像素的R通道，然后是G通道，最后是B通道
-        for (int c = 0; c < CIFAR_IMAGE_CHANNELS; c++) {
-            for (int y = 0; y < CIFAR_IMAGE_SIZE; y++) {
-                for (int x = 0; x < CIFAR_IMAGE_SIZE; x++) {
-                    int img_offset = offset + 1 + c * CIFAR_IMAGE_SIZE * CIFAR_IMAGE_SIZE + y * CIFAR_IMAGE_SIZE + x;
-                    int pixel_offset = (y * CIFAR_IMAGE_SIZE + x) * CIFAR_IMAGE_CHANNELS + c;
-                    dataset.images[i].data[pixel_offset] = data[img_offset];
-                }
-            }
-        }
+        dataset.images[i] = decode_cifar_record(record);
     }
 
-    free(data);
+    MEM_FREE(data);
+    TRACE_COUNT(TRACE_STAGE_LOAD, num_samples);
+    TRACE_END(load, TRACE_STAGE_LOAD, size);
     return dataset;
 }
 
@@ -258,12 +653,12 @@ void free_cifar_dataset(CifarDataset* dataset) {
             for (int i = 0; i < dataset->count; i++) {
                 free_image(&dataset->images[i]);
             }
-            free(dataset->images);
+            MEM_FREE(dataset->images);
             dataset->images = NULL;
         }
 
         if (dataset->labels) {
-            free(dataset->labels);
+            MEM_FREE(dataset->labels);
             dataset->labels = NULL;
         }
 
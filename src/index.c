@@ -0,0 +1,448 @@
+#define MEMTRACK_TAG MEM_TAG_SPM
+#include "index.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define INVERTED_INDEX_FILE_MAGIC 0x31465649  // "IVF1"
+
+InvertedIndex* inverted_index_create(int num_terms) {
+    InvertedIndex* index = (InvertedIndex*)MEM_CALLOC(1, sizeof(InvertedIndex));
+    if (!index) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index\n");
+        exit(EXIT_FAILURE);
+    }
+    index->num_terms = num_terms;
+    index->offsets = (int64_t*)MEM_CALLOC(num_terms + 1, sizeof(int64_t));
+    index->idf = (float*)MEM_CALLOC(num_terms, sizeof(float));
+    index->pending_docs = (uint32_t**)MEM_CALLOC(num_terms, sizeof(uint32_t*));
+    index->pending_tf = (float**)MEM_CALLOC(num_terms, sizeof(float*));
+    index->pending_count = (int*)MEM_CALLOC(num_terms, sizeof(int));
+    index->pending_capacity = (int*)MEM_CALLOC(num_terms, sizeof(int));
+    if (!index->offsets || !index->idf || !index->pending_docs || !index->pending_tf ||
+        !index->pending_count || !index->pending_capacity) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index\n");
+        exit(EXIT_FAILURE);
+    }
+    return index;
+}
+
+void inverted_index_free(InvertedIndex* index) {
+    if (!index) {
+        return;
+    }
+    for (int t = 0; t < index->num_terms; t++) {
+        MEM_FREE(index->pending_docs[t]);
+        MEM_FREE(index->pending_tf[t]);
+    }
+    MEM_FREE(index->pending_docs);
+    MEM_FREE(index->pending_tf);
+    MEM_FREE(index->pending_count);
+    MEM_FREE(index->pending_capacity);
+    MEM_FREE(index->offsets);
+    MEM_FREE(index->docs);
+    MEM_FREE(index->tf);
+    MEM_FREE(index->idf);
+    MEM_FREE(index->inv_norms);
+    MEM_FREE(index);
+}
+
+int inverted_index_add_sparse(InvertedIndex* index, const int* terms, const float* tf, int count) {
+    int doc = index->num_docs++;
+    for (int i = 0; i < count; i++) {
+        int t = terms[i];
+        if (t < 0 || t >= index->num_terms || tf[i] <= 0.0f) {
+            continue;
+        }
+
+        if (index->pending_count[t] == index->pending_capacity[t]) {
+            int capacity = index->pending_capacity[t] ? index->pending_capacity[t] * 2 : 16;
+            uint32_t* docs = (uint32_t*)MEM_REALLOC(index->pending_docs[t], capacity * sizeof(uint32_t));
+            float* weights = (float*)MEM_REALLOC(index->pending_tf[t], capacity * sizeof(float));
+            if (!docs || !weights) {
+                fprintf(stderr, "Error: Memory allocation failed for posting list\n");
+                exit(EXIT_FAILURE);
+            }
+            index->pending_docs[t] = docs;
+            index->pending_tf[t] = weights;
+            index->pending_capacity[t] = capacity;
+        }
+        index->pending_docs[t][index->pending_count[t]] = (uint32_t)doc;
+        index->pending_tf[t][index->pending_count[t]] = tf[i];
+        index->pending_count[t]++;
+    }
+    return doc;
+}
+
+int inverted_index_add(InvertedIndex* index, const SpmHistogram* hist) {
+    int* terms = (int*)MEM_MALLOC((hist->length > 0 ? hist->length : 1) * sizeof(int));
+    float* tf = (float*)MEM_MALLOC((hist->length > 0 ? hist->length : 1) * sizeof(float));
+    int count = 0;
+    for (int t = 0; t < hist->length && t < index->num_terms; t++) {
+        if (hist->histogram[t] > 0.0f) {
+            terms[count] = t;
+            tf[count] = hist->histogram[t];
+            count++;
+        }
+    }
+
+    int doc = inverted_index_add_sparse(index, terms, tf, count);
+    MEM_FREE(terms);
+    MEM_FREE(tf);
+    return doc;
+}
+
+// 由倒排表计算 idf 与文档范数
+static void compute_weights(InvertedIndex* index) {
+    int num_docs = index->num_built_docs;
+    double* norms = (double*)MEM_CALLOC(num_docs > 0 ? num_docs : 1, sizeof(double));
+    float* inv_norms = (float*)MEM_REALLOC(index->inv_norms, (num_docs > 0 ? num_docs : 1) * sizeof(float));
+    if (!norms || !inv_norms) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index weights\n");
+        exit(EXIT_FAILURE);
+    }
+    index->inv_norms = inv_norms;
+
+    for (int t = 0; t < index->num_terms; t++) {
+        int64_t df = index->offsets[t + 1] - index->offsets[t];
+        index->idf[t] = df > 0 ? (float)log((double)num_docs / (double)df) : 0.0f;
+        for (int64_t p = index->offsets[t]; p < index->offsets[t + 1]; p++) {
+            double w = (double)index->tf[p] * index->idf[t];
+            norms[index->docs[p]] += w * w;
+        }
+    }
+    for (int d = 0; d < num_docs; d++) {
+        inv_norms[d] = norms[d] > 0.0 ? (float)(1.0 / sqrt(norms[d])) : 0.0f;
+    }
+    MEM_FREE(norms);
+}
+
+void inverted_index_build(InvertedIndex* index) {
+    if (index->num_docs == index->num_built_docs) {
+        return;
+    }
+
+    int64_t total = index->num_postings;
+    for (int t = 0; t < index->num_terms; t++) {
+        total += index->pending_count[t];
+    }
+
+    int64_t* offsets = (int64_t*)MEM_MALLOC((index->num_terms + 1) * sizeof(int64_t));
+    uint32_t* docs = (uint32_t*)MEM_MALLOC((total > 0 ? total : 1) * sizeof(uint32_t));
+    float* tf = (float*)MEM_MALLOC((total > 0 ? total : 1) * sizeof(float));
+    if (!offsets || !docs || !tf) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // 每个倒排表: 已构建部分在前，新文档在后 (文档编号保持递增)
+    int64_t pos = 0;
+    for (int t = 0; t < index->num_terms; t++) {
+        offsets[t] = pos;
+        int64_t old = index->offsets[t + 1] - index->offsets[t];
+        if (old > 0) {
+            memcpy(docs + pos, index->docs + index->offsets[t], old * sizeof(uint32_t));
+            memcpy(tf + pos, index->tf + index->offsets[t], old * sizeof(float));
+            pos += old;
+        }
+
+        int pending = index->pending_count[t];
+        if (pending > 0) {
+            memcpy(docs + pos, index->pending_docs[t], pending * sizeof(uint32_t));
+            memcpy(tf + pos, index->pending_tf[t], pending * sizeof(float));
+            pos += pending;
+        }
+
+        MEM_FREE(index->pending_docs[t]);
+        MEM_FREE(index->pending_tf[t]);
+        index->pending_docs[t] = NULL;
+        index->pending_tf[t] = NULL;
+        index->pending_count[t] = 0;
+        index->pending_capacity[t] = 0;
+    }
+    offsets[index->num_terms] = pos;
+
+    MEM_FREE(index->offsets);
+    MEM_FREE(index->docs);
+    MEM_FREE(index->tf);
+    index->offsets = offsets;
+    index->docs = docs;
+    index->tf = tf;
+    index->num_postings = total;
+    index->num_built_docs = index->num_docs;
+    compute_weights(index);
+}
+
+IndexScratch inverted_index_scratch(const InvertedIndex* index) {
+    IndexScratch scratch;
+    scratch.capacity = index->num_built_docs > 0 ? index->num_built_docs : 1;
+    scratch.scores = (float*)MEM_CALLOC(scratch.capacity, sizeof(float));
+    scratch.touched = (uint32_t*)MEM_MALLOC(scratch.capacity * sizeof(uint32_t));
+    scratch.num_touched = 0;
+    if (!scratch.scores || !scratch.touched) {
+        fprintf(stderr, "Error: Memory allocation failed for index scratch\n");
+        exit(EXIT_FAILURE);
+    }
+    return scratch;
+}
+
+void free_index_scratch(IndexScratch* scratch) {
+    if (scratch) {
+        MEM_FREE(scratch->scores);
+        MEM_FREE(scratch->touched);
+        scratch->scores = NULL;
+        scratch->touched = NULL;
+        scratch->capacity = 0;
+    }
+}
+
+typedef struct {
+    float weight;
+    int term;
+} QueryTerm;
+
+static int compare_query_terms(const void* a, const void* b) {
+    const QueryTerm* x = (const QueryTerm*)a;
+    const QueryTerm* y = (const QueryTerm*)b;
+    if (x->weight != y->weight) return x->weight < y->weight ? 1 : -1;
+    return x->term - y->term;
+}
+
+// a 排在 b 之后 (得分更低，同分时编号更大)
+static int hit_worse(const IndexHit* a, const IndexHit* b) {
+    return a->score < b->score || (a->score == b->score && a->doc > b->doc);
+}
+
+static int compare_hits(const void* a, const void* b) {
+    const IndexHit* x = (const IndexHit*)a;
+    const IndexHit* y = (const IndexHit*)b;
+    return hit_worse(x, y) ? 1 : (hit_worse(y, x) ? -1 : 0);
+}
+
+// 堆顶为当前 top-k 中最差的命中
+static void heap_sift_down(IndexHit* heap, int count, int pos) {
+    IndexHit hit = heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= count) break;
+        if (child + 1 < count && hit_worse(&heap[child + 1], &heap[child])) child++;
+        if (!hit_worse(&heap[child], &hit)) break;
+        heap[pos] = heap[child];
+        pos = child;
+    }
+    heap[pos] = hit;
+}
+
+static void heap_push(IndexHit* heap, int* count, IndexHit hit) {
+    int pos = (*count)++;
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!hit_worse(&hit, &heap[parent])) break;
+        heap[pos] = heap[parent];
+        pos = parent;
+    }
+    heap[pos] = hit;
+}
+
+int inverted_index_query(const InvertedIndex* index, const SpmHistogram* query, int k, int max_terms,
+                         IndexScratch* scratch, IndexHit* hits) {
+    if (k <= 0 || index->num_built_docs == 0) {
+        return 0;
+    }
+    if (scratch->capacity < index->num_built_docs) {
+        free_index_scratch(scratch);
+        *scratch = inverted_index_scratch(index);
+    }
+
+    // 查询的 tf-idf 权重 (只保留 idf > 0 的词项)
+    int length = query->length < index->num_terms ? query->length : index->num_terms;
+    QueryTerm* terms = (QueryTerm*)MEM_MALLOC((length > 0 ? length : 1) * sizeof(QueryTerm));
+    int num_terms = 0;
+    double norm = 0.0;
+    for (int t = 0; t < length; t++) {
+        float w = query->histogram[t] * index->idf[t];
+        if (w > 0.0f) {
+            terms[num_terms++] = (QueryTerm){w, t};
+            norm += (double)w * w;
+        }
+    }
+    if (max_terms > 0 && num_terms > max_terms) {
+        qsort(terms, num_terms, sizeof(QueryTerm), compare_query_terms);
+        num_terms = max_terms;
+    }
+    float inv_norm = norm > 0.0 ? (float)(1.0 / sqrt(norm)) : 0.0f;
+
+    // 累加: 只访问查询词项的倒排表
+    float* scores = scratch->scores;
+    scratch->num_touched = 0;
+    for (int i = 0; i < num_terms; i++) {
+        int t = terms[i].term;
+        float factor = terms[i].weight * index->idf[t] * inv_norm;
+        const uint32_t* docs = index->docs;
+        const float* tf = index->tf;
+        for (int64_t p = index->offsets[t]; p < index->offsets[t + 1]; p++) {
+            uint32_t d = docs[p];
+            if (scores[d] == 0.0f) {
+                scratch->touched[scratch->num_touched++] = d;
+            }
+            scores[d] += factor * tf[p];
+        }
+    }
+    MEM_FREE(terms);
+
+    // top-k: 大小为 k 的最小堆，同时清零被访问过的得分
+    int count = 0;
+    for (int i = 0; i < scratch->num_touched; i++) {
+        uint32_t d = scratch->touched[i];
+        IndexHit hit = {(int)d, scores[d] * index->inv_norms[d]};
+        scores[d] = 0.0f;
+        if (count < k) {
+            heap_push(hits, &count, hit);
+        } else if (hit_worse(&hits[0], &hit)) {
+            hits[0] = hit;
+            heap_sift_down(hits, count, 0);
+        }
+    }
+    scratch->num_touched = 0;
+
+    qsort(hits, count, sizeof(IndexHit), compare_hits);
+    return count;
+}
+
+typedef struct {
+    const InvertedIndex* index;
+    const SpmHistogram* queries;
+    int num_queries;
+    int k;
+    int max_terms;
+    IndexHit* hits;
+    int* num_hits;
+    atomic_int next_query;
+} QueryJob;
+
+static void* query_worker_main(void* arg) {
+    QueryJob* job = (QueryJob*)arg;
+    IndexScratch scratch = inverted_index_scratch(job->index);
+
+    for (;;) {
+        int q = atomic_fetch_add(&job->next_query, 1);
+        if (q >= job->num_queries) {
+            break;
+        }
+        job->num_hits[q] = inverted_index_query(job->index, &job->queries[q], job->k, job->max_terms,
+                                                &scratch, job->hits + (size_t)q * job->k);
+    }
+
+    free_index_scratch(&scratch);
+    return NULL;
+}
+
+void inverted_index_query_batch(const InvertedIndex* index, const SpmHistogram* queries, int num_queries, int k,
+                                int max_terms, int num_threads, IndexHit* hits, int* num_hits) {
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > num_queries) num_threads = num_queries > 0 ? num_queries : 1;
+
+    QueryJob job = {index, queries, num_queries, k, max_terms, hits, num_hits, 0};
+    pthread_t* threads = (pthread_t*)MEM_MALLOC(num_threads * sizeof(pthread_t));
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, query_worker_main, &job);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    MEM_FREE(threads);
+}
+
+// 文件格式: int[4] {magic, 词项数, 文档数, 0}，int64 倒排总数，
+// int64 offsets[词项数+1]，uint32 docs[倒排总数]，float tf[倒排总数] (idf 与范数在加载时重新计算)
+int inverted_index_save(const InvertedIndex* index, const char* filename) {
+    if (index->num_docs != index->num_built_docs) {
+        fprintf(stderr, "Error: Inverted index has unbuilt documents, call inverted_index_build first\n");
+        return 0;
+    }
+
+    int header[4] = {INVERTED_INDEX_FILE_MAGIC, index->num_terms, index->num_docs, 0};
+    size_t offsets_size = (size_t)(index->num_terms + 1) * sizeof(int64_t);
+    size_t postings_size = (size_t)index->num_postings * (sizeof(uint32_t) + sizeof(float));
+    size_t size = sizeof(header) + sizeof(int64_t) + offsets_size + postings_size;
+    unsigned char* buffer = (unsigned char*)MEM_MALLOC(size);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index file\n");
+        return 0;
+    }
+
+    unsigned char* p = buffer;
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, &index->num_postings, sizeof(int64_t));
+    p += sizeof(int64_t);
+    memcpy(p, index->offsets, offsets_size);
+    p += offsets_size;
+    memcpy(p, index->docs, (size_t)index->num_postings * sizeof(uint32_t));
+    p += (size_t)index->num_postings * sizeof(uint32_t);
+    memcpy(p, index->tf, (size_t)index->num_postings * sizeof(float));
+
+    int ok = write_file(filename, buffer, size);
+    MEM_FREE(buffer);
+    return ok;
+}
+
+InvertedIndex* inverted_index_load(const char* filename) {
+    size_t size;
+    unsigned char* data = read_file(filename, &size);
+    if (!data) {
+        return NULL;
+    }
+
+    int header[4];
+    int64_t num_postings = 0;
+    size_t fixed = sizeof(header) + sizeof(int64_t);
+    if (size >= fixed) {
+        memcpy(header, data, sizeof(header));
+        memcpy(&num_postings, data + sizeof(header), sizeof(int64_t));
+    }
+    if (size < fixed || header[0] != INVERTED_INDEX_FILE_MAGIC || header[1] <= 0 || header[2] < 0 ||
+        num_postings < 0 ||
+        size != fixed + (size_t)(header[1] + 1) * sizeof(int64_t) +
+                (size_t)num_postings * (sizeof(uint32_t) + sizeof(float))) {
+        fprintf(stderr, "Error: Invalid inverted index file %s\n", filename);
+        MEM_FREE(data);
+        return NULL;
+    }
+
+    InvertedIndex* index = inverted_index_create(header[1]);
+    index->num_docs = header[2];
+    index->num_built_docs = header[2];
+    index->num_postings = num_postings;
+
+    size_t offsets_size = (size_t)(header[1] + 1) * sizeof(int64_t);
+    const unsigned char* p = data + fixed;
+    memcpy(index->offsets, p, offsets_size);
+    p += offsets_size;
+    index->docs = (uint32_t*)MEM_MALLOC((num_postings > 0 ? num_postings : 1) * sizeof(uint32_t));
+    index->tf = (float*)MEM_MALLOC((num_postings > 0 ? num_postings : 1) * sizeof(float));
+    if (!index->docs || !index->tf) {
+        fprintf(stderr, "Error: Memory allocation failed for inverted index\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(index->docs, p, (size_t)num_postings * sizeof(uint32_t));
+    p += (size_t)num_postings * sizeof(uint32_t);
+    memcpy(index->tf, p, (size_t)num_postings * sizeof(float));
+    MEM_FREE(data);
+
+    // 校验倒排表的结构，避免损坏的文件导致越界访问
+    int valid = index->offsets[0] == 0 && index->offsets[header[1]] == num_postings;
+    for (int t = 0; valid && t < header[1]; t++) {
+        valid = index->offsets[t] <= index->offsets[t + 1];
+    }
+    for (int64_t i = 0; valid && i < num_postings; i++) {
+        valid = index->docs[i] < (uint32_t)header[2];
+    }
+    if (!valid) {
+        fprintf(stderr, "Error: Corrupt inverted index file %s\n", filename);
+        inverted_index_free(index);
+        return NULL;
+    }
+
+    compute_weights(index);
+    return index;
+}
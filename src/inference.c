@@ -0,0 +1,123 @@
+#define MEMTRACK_TAG MEM_TAG_SPM
+#include "inference.h"
+#include "sift.h"
+#include "trace.h"
+
+InferenceWorkspace* create_inference_workspace(int max_width, int max_height, Codebook* codebook, int level,
+                                               SVMModel** models, int num_classes) {
+    InferenceWorkspace* workspace = (InferenceWorkspace*)MEM_CALLOC(1, sizeof(InferenceWorkspace));
+    if (!workspace) {
+        fprintf(stderr, "Error: Memory allocation failed for inference workspace\n");
+        exit(EXIT_FAILURE);
+    }
+
+    workspace->max_width = max_width;
+    workspace->max_height = max_height;
+    workspace->level = level;
+    workspace->step = SPM_SIFT_STEP;
+    workspace->codebook = codebook;
+    workspace->models = models;
+    workspace->num_classes = num_classes;
+
+    workspace->gray = create_gray16_image(max_width, max_height);
+    workspace->planes = create_orientation_planes(max_width, max_height);
+
+    workspace->max_descriptors = dense_sift_grid_count(max_width, workspace->step) *
+                                 dense_sift_grid_count(max_height, workspace->step);
+    workspace->descriptors = allocate_float_array(workspace->max_descriptors * SIFT_DESC_SIZE + 1);
+    workspace->positions = allocate_float_array(workspace->max_descriptors * 2 + 1);
+    workspace->words = (int*)MEM_CALLOC(workspace->max_descriptors + 1, sizeof(int));
+
+    workspace->histogram_length = spm_histogram_length(codebook->num_clusters, level);
+    workspace->histogram = allocate_float_array(workspace->histogram_length);
+    workspace->features = (double*)MEM_CALLOC(workspace->histogram_length, sizeof(double));
+    workspace->scores = (double*)MEM_CALLOC(num_classes > 0 ? num_classes : 1, sizeof(double));
+
+    if (!workspace->words || !workspace->features || !workspace->scores) {
+        fprintf(stderr, "Error: Memory allocation failed for inference workspace\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return workspace;
+}
+
+void free_inference_workspace(InferenceWorkspace* workspace) {
+    if (workspace) {
+        free_gray16_image(&workspace->gray);
+        free_orientation_planes(&workspace->planes);
+        free_float_array(workspace->descriptors);
+        free_float_array(workspace->positions);
+        MEM_FREE(workspace->words);
+        free_float_array(workspace->histogram);
+        MEM_FREE(workspace->features);
+        MEM_FREE(workspace->scores);
+        MEM_FREE(workspace);
+    }
+}
+
+int compute_spm_feature_into(InferenceWorkspace* workspace, const Image* img) {
+    ImageView view = image_view(img);
+    return compute_spm_feature_view_into(workspace, &view);
+}
+
+int compute_spm_feature_view_into(InferenceWorkspace* workspace, const ImageView* img) {
+    if (img->width > workspace->max_width || img->height > workspace->max_height) {
+        fprintf(stderr, "Error: Image %dx%d exceeds inference workspace %dx%d\n",
+                img->width, img->height, workspace->max_width, workspace->max_height);
+        return 0;
+    }
+
+    convert_view_to_gray16_into(img, &workspace->gray);
+    compute_orientation_planes_gray16_into(&workspace->gray, &workspace->planes, SIFT_ORI_BINNING);
+
+    workspace->num_descriptors = extract_dense_sift_into(&workspace->planes, workspace->step, workspace->descriptors,
+                                                         workspace->positions, workspace->max_descriptors);
+
+    memset(workspace->histogram, 0, workspace->histogram_length * sizeof(float));
+    if (workspace->num_descriptors == 0) {
+        return 1;
+    }
+
+    TRACE_BEGIN(pyramid);
+    Codebook* codebook = workspace->codebook;
+    float inv_count = 1.0f / (float)workspace->num_descriptors;
+
+    for (int i = 0; i < workspace->num_descriptors; i++) {
+        int word = find_nearest_center(workspace->descriptors + (size_t)i * SIFT_DESC_SIZE, codebook);
+        spm_accumulate_word(workspace->histogram, codebook->num_clusters, workspace->level, word,
+                            workspace->positions[i * 2], workspace->positions[i * 2 + 1],
+                            img->width, img->height, inv_count);
+    }
+
+    TRACE_COUNT(TRACE_STAGE_PYRAMID, workspace->num_descriptors);
+    TRACE_END(pyramid, TRACE_STAGE_PYRAMID, (size_t)workspace->histogram_length * sizeof(float));
+    return 1;
+}
+
+int classify_image(InferenceWorkspace* workspace, const Image* img) {
+    ImageView view = image_view(img);
+    return classify_image_view(workspace, &view);
+}
+
+int classify_image_view(InferenceWorkspace* workspace, const ImageView* img) {
+    if (!compute_spm_feature_view_into(workspace, img)) {
+        return -1;
+    }
+
+    for (int i = 0; i < workspace->histogram_length; i++) {
+        workspace->features[i] = workspace->histogram[i];
+    }
+
+    // 一对多: 选择决策值最大的类别
+    int best_class = -1;
+    double best_score = -DBL_MAX;
+    for (int c = 0; c < workspace->num_classes; c++) {
+        workspace->scores[c] = svm_decision_value(workspace->models[c], workspace->features);
+        if (workspace->scores[c] > best_score) {
+            best_score = workspace->scores[c];
+            best_class = c;
+        }
+    }
+
+    return best_class;
+}
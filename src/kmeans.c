@@ -1,35 +1,24 @@
+#define MEMTRACK_TAG MEM_TAG_KMEANS
 #include "kmeans.h"
+#include "trace.h"
+#include "rng.h"
 
 // 随机初始化聚类中心
 static void initialize_centers(float** data, int num_points, int dim, int num_clusters, float** centers) {
-    // 使用Forgy方法：随机选择数据点作为初始中心
-    init_random();
-
-    // 跟踪已选择的点索引，确保不会选择同一个点两次
-    int* selected = (int*)malloc(num_points * sizeof(int));
-    memset(selected, 0, num_points * sizeof(int));
+    // 使用Forgy方法：无放回地随机选择数据点作为初始中心 (种子固定，结果可复现)
+    Rng rng = rng_create(rng_default_seed());
+    int* selected = (int*)MEM_MALLOC(num_clusters * sizeof(int));
+    rng_sample_indices(&rng, num_points, num_clusters, selected);
 
     for (int i = 0; i < num_clusters; i++) {
-        int idx;
-        // 寻找一个尚未被选择的点
-        do {
-            idx = random_int(0, num_points - 1);
-        } while (selected[idx]);
-
-        // 标记为已选择
-        selected[idx] = 1;
-
-        // 复制数据点到中心
-        for (int j = 0; j < dim; j++) {
-            centers[i][j] = data[idx][j];
-        }
+        memcpy(centers[i], data[selected[i]], dim * sizeof(float));
     }
 
-    free(selected);
+    MEM_FREE(selected);
 }
 
 // 为每个数据点分配最近的簇
-static void assign_clusters(float** data, int num_points, int dim, int num_clusters, float** centers, int* assignments) {
+void assign_clusters(float** data, int num_points, int dim, int num_clusters, float** centers, int* assignments) {
     for (int i = 0; i < num_points; i++) {
         float min_dist = FLT_MAX;
         int best_cluster = 0;
@@ -53,7 +42,7 @@ static int update_centers(float** data, int num_points, int dim, int num_cluster
 
     // 为每个聚类创建临时存储
     float** new_centers = allocate_float_matrix(num_clusters, dim);
-    int* counts = (int*)malloc(num_clusters * sizeof(int));
+    int* counts = (int*)MEM_MALLOC(num_clusters * sizeof(int));
     memset(counts, 0, num_clusters * sizeof(int));
 
     // 累加每个簇的所有点
@@ -83,21 +72,23 @@ static int update_centers(float** data, int num_points, int dim, int num_cluster
     }
 
     free_float_matrix(new_centers, num_clusters);
-    free(counts);
+    MEM_FREE(counts);
 
     return changed;
 }
 
 // 执行K-means聚类
 KMeansResult kmeans_cluster(float** data, int num_points, int dim, int num_clusters, int max_iter) {
-    KMeansResult result;
+    KMeansResult result = {NULL, NULL, 0, dim, num_points};
+    if (num_clusters <= 0 || num_points < num_clusters) {
+        fprintf(stderr, "Error: Cannot form %d clusters from %d points\n", num_clusters, num_points);
+        return result;
+    }
     result.num_clusters = num_clusters;
-    result.dim = dim;
-    result.num_points = num_points;
 
     // 分配内存
     result.centers = allocate_float_matrix(num_clusters, dim);
-    result.assignments = (int*)malloc(num_points * sizeof(int));
+    result.assignments = (int*)MEM_MALLOC(num_points * sizeof(int));
 
     // 随机初始化聚类中心
     initialize_centers(data, num_points, dim, num_clusters, result.centers);
@@ -107,12 +98,16 @@ KMeansResult kmeans_cluster(float** data, int num_points, int dim, int num_clust
     int changed = 1;
 
     while (changed && iteration < max_iter) {
+        TRACE_BEGIN(iter);
+
         // 为每个数据点分配簇
         assign_clusters(data, num_points, dim, num_clusters, result.centers, result.assignments);
 
         // 更新簇中心
         changed = update_centers(data, num_points, dim, num_clusters, result.assignments, result.centers);
 
+        TRACE_COUNT(TRACE_STAGE_KMEANS_ITER, (size_t)num_points * num_clusters);
+        TRACE_END(iter, TRACE_STAGE_KMEANS_ITER, (size_t)num_points * dim * sizeof(float));
         iteration++;
     }
 
@@ -125,7 +120,7 @@ KMeansResult kmeans_cluster(float** data, int num_points, int dim, int num_clust
 void free_kmeans_result(KMeansResult* result) {
     if (result) {
         free_float_matrix(result->centers, result->num_clusters);
-        free(result->assignments);
+        MEM_FREE(result->assignments);
         result->centers = NULL;
         result->assignments = NULL;
     }
@@ -133,6 +128,10 @@ void free_kmeans_result(KMeansResult* result) {
 
 // 从描述符列表构建码本
 Codebook build_codebook(DescriptorList* descriptors, int num_clusters) {
+    return build_codebook_with_stats(descriptors, num_clusters, NULL);
+}
+
+Codebook build_codebook_with_stats(DescriptorList* descriptors, int num_clusters, CodebookStats* stats) {
     Codebook codebook;
     codebook.num_clusters = num_clusters;
     codebook.dim = descriptors->count > 0 ? descriptors->descriptors[0].length : 0;
@@ -142,6 +141,12 @@ Codebook build_codebook(DescriptorList* descriptors, int num_clusters) {
         codebook.centers = NULL;
         return codebook;
     }
+    if (num_clusters <= 0 || descriptors->count < num_clusters) {
+        fprintf(stderr, "Error: Cannot build codebook with %d clusters from %d descriptors\n", num_clusters,
+                descriptors->count);
+        codebook.centers = NULL;
+        return codebook;
+    }
 
     // 将所有描述符收集到一个矩阵中
     float** data = allocate_float_matrix(descriptors->count, codebook.dim);
@@ -163,6 +168,18 @@ Codebook build_codebook(DescriptorList* descriptors, int num_clusters) {
         }
     }
 
+    // 最后一次分配即各中心的成员，直接累加得到统计量
+    if (stats) {
+        *stats = create_codebook_stats(num_clusters, codebook.dim);
+        for (int i = 0; i < descriptors->count; i++) {
+            double* sum = stats->sums + (size_t)kmeans.assignments[i] * codebook.dim;
+            stats->counts[kmeans.assignments[i]]++;
+            for (int j = 0; j < codebook.dim; j++) {
+                sum[j] += data[i][j];
+            }
+        }
+    }
+
     // 清理
     free_kmeans_result(&kmeans);
     free_float_matrix(data, descriptors->count);
@@ -170,6 +187,208 @@ Codebook build_codebook(DescriptorList* descriptors, int num_clusters) {
     return codebook;
 }
 
+Codebook build_codebook_from_store(DescriptorStore* store, int num_clusters, CodebookStats* stats) {
+    Codebook codebook = {NULL, num_clusters, store->dim};
+    int num_points = store->count;
+    int dim = store->dim;
+    if (num_clusters <= 0 || num_points < num_clusters || dim == 0) {
+        fprintf(stderr, "Error: Cannot build codebook from %d stored descriptors\n", num_points);
+        return codebook;
+    }
+
+    printf("Building codebook with %d clusters from %d stored descriptors%s\n", num_clusters, num_points,
+           descriptor_store_spilled(store) ? " (spilled to disk)" : "");
+
+    // Forgy初始化 (与 build_codebook 抽取相同的下标)
+    codebook.centers = allocate_float_matrix(num_clusters, dim);
+    int* selected = (int*)MEM_MALLOC(num_clusters * sizeof(int));
+    Rng rng = rng_create(rng_default_seed());
+    rng_sample_indices(&rng, num_points, num_clusters, selected);
+    for (int i = 0; i < num_clusters; i++) {
+        memcpy(codebook.centers[i], descriptor_store_row(store, selected[i]), dim * sizeof(float));
+    }
+    MEM_FREE(selected);
+
+    CodebookStats sums = create_codebook_stats(num_clusters, dim);
+    int num_chunks = descriptor_store_num_chunks(store);
+    int iteration = 0;
+    int changed = 1;
+
+    while (changed && iteration < 100) {
+        TRACE_BEGIN(iter);
+        memset(sums.sums, 0, (size_t)num_clusters * dim * sizeof(double));
+        memset(sums.counts, 0, num_clusters * sizeof(int64_t));
+
+        // 分配与累加: 顺序扫描所有块
+        for (int c = 0; c < num_chunks; c++) {
+            const float* rows;
+            int count = descriptor_store_chunk(store, c, &rows);
+            for (int i = 0; i < count; i++) {
+                float* row = (float*)(rows + (size_t)i * dim);
+                int center = find_nearest_center(row, &codebook);
+                double* sum = sums.sums + (size_t)center * dim;
+                sums.counts[center]++;
+                for (int j = 0; j < dim; j++) {
+                    sum[j] += row[j];
+                }
+            }
+        }
+
+        // 更新 (判据与 kmeans_cluster 相同)
+        changed = 0;
+        for (int i = 0; i < num_clusters; i++) {
+            if (sums.counts[i] == 0) continue;
+            const double* sum = sums.sums + (size_t)i * dim;
+            for (int j = 0; j < dim; j++) {
+                float value = (float)(sum[j] / (double)sums.counts[i]);
+                if (fabsf(value - codebook.centers[i][j]) > 1e-4) {
+                    changed = 1;
+                }
+                codebook.centers[i][j] = value;
+            }
+        }
+
+        TRACE_COUNT(TRACE_STAGE_KMEANS_ITER, (size_t)num_points * num_clusters);
+        TRACE_END(iter, TRACE_STAGE_KMEANS_ITER, (size_t)num_points * dim * sizeof(float));
+        iteration++;
+    }
+
+    printf("K-means converged after %d iterations\n", iteration);
+
+    // 最后一次扫描的累加结果即各中心的统计量
+    if (stats) {
+        *stats = sums;
+    } else {
+        free_codebook_stats(&sums);
+    }
+    return codebook;
+}
+
+void quantize_store(DescriptorStore* store, Codebook* codebook, int* words) {
+    TRACE_BEGIN(quantize);
+    int num_chunks = descriptor_store_num_chunks(store);
+    for (int c = 0; c < num_chunks; c++) {
+        const float* rows;
+        int count = descriptor_store_chunk(store, c, &rows);
+        for (int i = 0; i < count; i++) {
+            words[c * DESCRIPTOR_STORE_CHUNK_ROWS + i] =
+                find_nearest_center((float*)(rows + (size_t)i * store->dim), codebook);
+        }
+    }
+    TRACE_COUNT(TRACE_STAGE_QUANTIZE, store->count);
+    TRACE_END(quantize, TRACE_STAGE_QUANTIZE, (size_t)store->count * store->dim * sizeof(float));
+}
+
+Codebook build_codebook_packed(const PackedDescriptors* descriptors, int num_clusters) {
+    return build_codebook_packed_with_stats(descriptors, num_clusters, NULL);
+}
+
+// 在uint8描述符上执行K-means
+// 中心以uint8形式参与距离计算，均值在整数域累加后四舍五入回uint8
+Codebook build_codebook_packed_with_stats(const PackedDescriptors* descriptors, int num_clusters,
+                                          CodebookStats* stats) {
+    Codebook codebook;
+    codebook.num_clusters = num_clusters;
+    codebook.dim = descriptors->dim;
+    codebook.centers = NULL;
+
+    int num_points = descriptors->count;
+    int dim = descriptors->dim;
+    if (num_clusters <= 0 || num_points < num_clusters || dim == 0) {
+        fprintf(stderr, "Error: Cannot build codebook from %d packed descriptors\n", num_points);
+        return codebook;
+    }
+
+    printf("Building packed codebook with %d clusters from %d descriptors\n", num_clusters, num_points);
+
+    uint8_t* centers = (uint8_t*)MEM_MALLOC((size_t)num_clusters * dim);
+    uint64_t* sums = (uint64_t*)MEM_MALLOC((size_t)num_clusters * dim * sizeof(uint64_t));
+    int* counts = (int*)MEM_MALLOC(num_clusters * sizeof(int));
+    int* assignments = (int*)MEM_MALLOC(num_points * sizeof(int));
+    int* selected = (int*)MEM_MALLOC(num_clusters * sizeof(int));
+
+    // Forgy初始化
+    Rng rng = rng_create(rng_default_seed());
+    rng_sample_indices(&rng, num_points, num_clusters, selected);
+    for (int i = 0; i < num_clusters; i++) {
+        memcpy(centers + (size_t)i * dim, descriptors->data + (size_t)selected[i] * dim, dim);
+    }
+    MEM_FREE(selected);
+
+    PackedCodebook packed = {PACKED_U8, centers, NULL, num_clusters, dim};
+    int iteration = 0;
+    int changed = 1;
+
+    while (changed && iteration < 100) {
+        TRACE_BEGIN(iter);
+        changed = 0;
+
+        // 分配
+        for (int i = 0; i < num_points; i++) {
+            assignments[i] = find_nearest_center_u8(descriptors->data + (size_t)i * dim, &packed);
+        }
+
+        // 更新
+        memset(sums, 0, (size_t)num_clusters * dim * sizeof(uint64_t));
+        memset(counts, 0, num_clusters * sizeof(int));
+        for (int i = 0; i < num_points; i++) {
+            const uint8_t* row = descriptors->data + (size_t)i * dim;
+            uint64_t* sum = sums + (size_t)assignments[i] * dim;
+            counts[assignments[i]]++;
+            for (int j = 0; j < dim; j++) {
+                sum[j] += row[j];
+            }
+        }
+        for (int i = 0; i < num_clusters; i++) {
+            if (counts[i] == 0) continue;
+            uint8_t* center = centers + (size_t)i * dim;
+            const uint64_t* sum = sums + (size_t)i * dim;
+            uint64_t half = (uint64_t)counts[i] / 2;
+            for (int j = 0; j < dim; j++) {
+                uint8_t value = (uint8_t)((sum[j] + half) / (uint64_t)counts[i]);
+                if (value != center[j]) {
+                    center[j] = value;
+                    changed = 1;
+                }
+            }
+        }
+
+        TRACE_COUNT(TRACE_STAGE_KMEANS_ITER, (size_t)num_points * num_clusters);
+        TRACE_END(iter, TRACE_STAGE_KMEANS_ITER, (size_t)num_points * dim);
+        iteration++;
+    }
+
+    printf("Packed K-means converged after %d iterations\n", iteration);
+
+    // 统计量按最后一次分配累加解包后的描述符
+    if (stats) {
+        *stats = create_codebook_stats(num_clusters, dim);
+        for (int i = 0; i < num_points; i++) {
+            const uint8_t* row = descriptors->data + (size_t)i * dim;
+            double* sum = stats->sums + (size_t)assignments[i] * dim;
+            stats->counts[assignments[i]]++;
+            for (int j = 0; j < dim; j++) {
+                sum[j] += unpack_u8(row[j]);
+            }
+        }
+    }
+
+    // 解包为float码本，供其他模块使用
+    codebook.centers = allocate_float_matrix(num_clusters, dim);
+    for (int i = 0; i < num_clusters; i++) {
+        for (int j = 0; j < dim; j++) {
+            codebook.centers[i][j] = unpack_u8(centers[(size_t)i * dim + j]);
+        }
+    }
+
+    MEM_FREE(centers);
+    MEM_FREE(sums);
+    MEM_FREE(counts);
+    MEM_FREE(assignments);
+
+    return codebook;
+}
+
 // 释放码本
 void free_codebook(Codebook* codebook) {
     if (codebook && codebook->centers) {
@@ -180,6 +399,263 @@ void free_codebook(Codebook* codebook) {
     }
 }
 
+// 码本文件格式: magic, num_clusters, dim, 然后按行存放的float中心
+#define CODEBOOK_FILE_MAGIC 0x314B4243  // "CBK1"
+
+int save_codebook(const Codebook* codebook, const char* filename) {
+    size_t header_size = 3 * sizeof(int);
+    size_t row_size = codebook->dim * sizeof(float);
+    size_t size = header_size + codebook->num_clusters * row_size;
+    unsigned char* buffer = (unsigned char*)MEM_MALLOC(size);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed for codebook file\n");
+        return 0;
+    }
+
+    int header[3] = {CODEBOOK_FILE_MAGIC, codebook->num_clusters, codebook->dim};
+    memcpy(buffer, header, header_size);
+    for (int i = 0; i < codebook->num_clusters; i++) {
+        memcpy(buffer + header_size + i * row_size, codebook->centers[i], row_size);
+    }
+
+    int ok = write_file(filename, buffer, size);
+    MEM_FREE(buffer);
+    return ok;
+}
+
+Codebook load_codebook(const char* filename) {
+    Codebook codebook = {NULL, 0, 0};
+    size_t size;
+    unsigned char* data = read_file(filename, &size);
+    if (!data) {
+        return codebook;
+    }
+
+    int header[3];
+    size_t header_size = sizeof(header);
+    if (size < header_size) {
+        fprintf(stderr, "Error: Invalid codebook file %s\n", filename);
+        MEM_FREE(data);
+        return codebook;
+    }
+    memcpy(header, data, header_size);
+
+    size_t row_size = header[2] * sizeof(float);
+    if (header[0] != CODEBOOK_FILE_MAGIC || header[1] <= 0 || header[2] <= 0 ||
+        size != header_size + header[1] * row_size) {
+        fprintf(stderr, "Error: Invalid codebook file %s\n", filename);
+        MEM_FREE(data);
+        return codebook;
+    }
+
+    codebook.num_clusters = header[1];
+    codebook.dim = header[2];
+    codebook.centers = allocate_float_matrix(codebook.num_clusters, codebook.dim);
+    for (int i = 0; i < codebook.num_clusters; i++) {
+        memcpy(codebook.centers[i], data + header_size + i * row_size, row_size);
+    }
+
+    MEM_FREE(data);
+    return codebook;
+}
+
+CodebookStats create_codebook_stats(int num_clusters, int dim) {
+    CodebookStats stats;
+    stats.num_clusters = num_clusters;
+    stats.dim = dim;
+    stats.sums = (double*)MEM_CALLOC((size_t)num_clusters * dim, sizeof(double));
+    stats.counts = (int64_t*)MEM_CALLOC(num_clusters, sizeof(int64_t));
+    if (!stats.sums || !stats.counts) {
+        fprintf(stderr, "Error: Memory allocation failed for codebook statistics\n");
+        exit(EXIT_FAILURE);
+    }
+    return stats;
+}
+
+void free_codebook_stats(CodebookStats* stats) {
+    if (stats && stats->sums) {
+        MEM_FREE(stats->sums);
+        MEM_FREE(stats->counts);
+        stats->sums = NULL;
+        stats->counts = NULL;
+        stats->num_clusters = 0;
+        stats->dim = 0;
+    }
+}
+
+void accumulate_codebook_stats(CodebookStats* stats, Codebook* codebook, DescriptorList* descriptors) {
+    for (int i = 0; i < descriptors->count; i++) {
+        float* desc = descriptors->descriptors[i].data;
+        int center = find_nearest_center(desc, codebook);
+        double* sum = stats->sums + (size_t)center * stats->dim;
+        stats->counts[center]++;
+        for (int j = 0; j < stats->dim; j++) {
+            sum[j] += desc[j];
+        }
+    }
+}
+
+// 统计量文件格式: magic, num_clusters, dim, 然后是 int64 计数和按行存放的double向量和
+#define CODEBOOK_STATS_FILE_MAGIC 0x31534243  // "CBS1"
+
+int save_codebook_stats(const CodebookStats* stats, const char* filename) {
+    size_t header_size = 3 * sizeof(int);
+    size_t counts_size = stats->num_clusters * sizeof(int64_t);
+    size_t sums_size = (size_t)stats->num_clusters * stats->dim * sizeof(double);
+    size_t size = header_size + counts_size + sums_size;
+    unsigned char* buffer = (unsigned char*)MEM_MALLOC(size);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed for codebook statistics file\n");
+        return 0;
+    }
+
+    int header[3] = {CODEBOOK_STATS_FILE_MAGIC, stats->num_clusters, stats->dim};
+    memcpy(buffer, header, header_size);
+    memcpy(buffer + header_size, stats->counts, counts_size);
+    memcpy(buffer + header_size + counts_size, stats->sums, sums_size);
+
+    int ok = write_file(filename, buffer, size);
+    MEM_FREE(buffer);
+    return ok;
+}
+
+CodebookStats load_codebook_stats(const char* filename) {
+    CodebookStats stats = {NULL, NULL, 0, 0};
+    size_t size;
+    unsigned char* data = read_file(filename, &size);
+    if (!data) {
+        return stats;
+    }
+
+    int header[3];
+    size_t header_size = sizeof(header);
+    if (size < header_size) {
+        fprintf(stderr, "Error: Invalid codebook statistics file %s\n", filename);
+        MEM_FREE(data);
+        return stats;
+    }
+    memcpy(header, data, header_size);
+
+    size_t counts_size = header[1] > 0 ? header[1] * sizeof(int64_t) : 0;
+    size_t sums_size = header[1] > 0 && header[2] > 0 ? (size_t)header[1] * header[2] * sizeof(double) : 0;
+    if (header[0] != CODEBOOK_STATS_FILE_MAGIC || header[1] <= 0 || header[2] <= 0 ||
+        size != header_size + counts_size + sums_size) {
+        fprintf(stderr, "Error: Invalid codebook statistics file %s\n", filename);
+        MEM_FREE(data);
+        return stats;
+    }
+
+    stats = create_codebook_stats(header[1], header[2]);
+    memcpy(stats.counts, data + header_size, counts_size);
+    memcpy(stats.sums, data + header_size + counts_size, sums_size);
+
+    MEM_FREE(data);
+    return stats;
+}
+
+// 由统计量重算中心 i
+static void recompute_center(Codebook* codebook, const CodebookStats* stats, int i) {
+    if (stats->counts[i] == 0) {
+        return;
+    }
+    const double* sum = stats->sums + (size_t)i * stats->dim;
+    double inv = 1.0 / (double)stats->counts[i];
+    for (int j = 0; j < stats->dim; j++) {
+        codebook->centers[i][j] = (float)(sum[j] * inv);
+    }
+}
+
+// 将一个描述符计入 (sign = 1) 或移出 (sign = -1) 中心 i 的统计量
+static void move_descriptor(CodebookStats* stats, int i, const float* desc, int sign) {
+    double* sum = stats->sums + (size_t)i * stats->dim;
+    stats->counts[i] += sign;
+    for (int j = 0; j < stats->dim; j++) {
+        sum[j] += sign * (double)desc[j];
+    }
+}
+
+CodebookUpdate update_codebook(Codebook* codebook, CodebookStats* stats, DescriptorList* descriptors,
+                               int refine_iterations) {
+    int num_clusters = codebook->num_clusters;
+    int num_points = descriptors->count;
+    CodebookUpdate update = {num_points, 0, 0, 0, 0.0f, 0.0f};
+    if (num_points == 0 || stats->num_clusters != num_clusters || stats->dim != codebook->dim) {
+        return update;
+    }
+
+    float** previous = allocate_float_matrix(num_clusters, codebook->dim);
+    for (int i = 0; i < num_clusters; i++) {
+        memcpy(previous[i], codebook->centers[i], codebook->dim * sizeof(float));
+    }
+    int* assignments = (int*)MEM_MALLOC(num_points * sizeof(int));
+    unsigned char* touched = (unsigned char*)MEM_CALLOC(num_clusters, 1);
+    unsigned char* dirty = (unsigned char*)MEM_CALLOC(num_clusters, 1);
+
+    // 在线更新: 每个描述符立即并入最近的中心，后续描述符看到的是更新后的中心
+    for (int i = 0; i < num_points; i++) {
+        float* desc = descriptors->descriptors[i].data;
+        int center = find_nearest_center(desc, codebook);
+        assignments[i] = center;
+        move_descriptor(stats, center, desc, 1);
+        recompute_center(codebook, stats, center);
+        touched[center] = 1;
+    }
+
+    // 热启动Lloyd: 只有新描述符可以改变归属，只重算成员变化的中心
+    while (update.iterations < refine_iterations) {
+        TRACE_BEGIN(iter);
+        int moved = 0;
+        for (int i = 0; i < num_points; i++) {
+            float* desc = descriptors->descriptors[i].data;
+            int center = find_nearest_center(desc, codebook);
+            if (center != assignments[i]) {
+                move_descriptor(stats, assignments[i], desc, -1);
+                move_descriptor(stats, center, desc, 1);
+                dirty[assignments[i]] = 1;
+                dirty[center] = 1;
+                assignments[i] = center;
+                moved++;
+            }
+        }
+        for (int i = 0; i < num_clusters; i++) {
+            if (dirty[i]) {
+                recompute_center(codebook, stats, i);
+                touched[i] = 1;
+                dirty[i] = 0;
+            }
+        }
+
+        TRACE_COUNT(TRACE_STAGE_KMEANS_ITER, (size_t)num_points * num_clusters);
+        TRACE_END(iter, TRACE_STAGE_KMEANS_ITER, (size_t)num_points * codebook->dim * sizeof(float));
+        update.iterations++;
+        update.reassigned += moved;
+        if (moved == 0) {
+            break;
+        }
+    }
+
+    // 中心漂移
+    double total_drift = 0.0;
+    for (int i = 0; i < num_clusters; i++) {
+        if (!touched[i]) {
+            continue;
+        }
+        float drift = euclidean_distance(previous[i], codebook->centers[i], codebook->dim);
+        update.clusters_touched++;
+        total_drift += drift;
+        if (drift > update.max_drift) {
+            update.max_drift = drift;
+        }
+    }
+    update.mean_drift = update.clusters_touched > 0 ? (float)(total_drift / update.clusters_touched) : 0.0f;
+
+    free_float_matrix(previous, num_clusters);
+    MEM_FREE(assignments);
+    MEM_FREE(touched);
+    MEM_FREE(dirty);
+    return update;
+}
+
 // 查找最近的中心
 int find_nearest_center(float* desc, Codebook* codebook) {
     float min_dist = FLT_MAX;
@@ -198,6 +674,7 @@ int find_nearest_center(float* desc, Codebook* codebook) {
 
 // 将描述符量化为直方图
 float* quantize_descriptors(DescriptorList* descriptors, Codebook* codebook) {
+    TRACE_BEGIN(quantize);
     float* histogram = allocate_float_array(codebook->num_clusters);
 
     // 遍历所有描述符
@@ -212,5 +689,23 @@ float* quantize_descriptors(DescriptorList* descriptors, Codebook* codebook) {
     // 归一化直方图
     normalize_vector(histogram, codebook->num_clusters);
 
+    TRACE_COUNT(TRACE_STAGE_QUANTIZE, descriptors->count);
+    TRACE_END(quantize, TRACE_STAGE_QUANTIZE, (size_t)descriptors->count * codebook->dim * sizeof(float));
     return histogram;
-}
\ No newline at end of file
+}
+// 将uint8描述符量化为直方图
+float* quantize_packed_descriptors(const PackedDescriptors* descriptors, const PackedCodebook* codebook) {
+    TRACE_BEGIN(quantize);
+    float* histogram = allocate_float_array(codebook->num_clusters);
+
+    for (int i = 0; i < descriptors->count; i++) {
+        int center = find_nearest_center_u8(descriptors->data + (size_t)i * descriptors->dim, codebook);
+        histogram[center]++;
+    }
+
+    normalize_vector(histogram, codebook->num_clusters);
+
+    TRACE_COUNT(TRACE_STAGE_QUANTIZE, descriptors->count);
+    TRACE_END(quantize, TRACE_STAGE_QUANTIZE, (size_t)descriptors->count * descriptors->dim);
+    return histogram;
+}
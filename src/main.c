@@ -0,0 +1,855 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#include "image.h"
+#include "sift.h"
+#include "kmeans.h"
+#include "spm.h"
+#include "svm.h"
+#include "cache.h"
+#include "pipeline.h"
+#include "server.h"
+#include "rng.h"
+#include "sharded.h"
+#include "sampler.h"
+#include "cascade.h"
+#include "trace.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// CIFAR-10二进制版本的文件名
+static const char* const cifar_train_files[] = {
+    "data_batch_1.bin", "data_batch_2.bin", "data_batch_3.bin", "data_batch_4.bin", "data_batch_5.bin"
+};
+static const char* const cifar_test_files[] = {"test_batch.bin"};
+
+// 训练/评估参数
+typedef struct {
+    const char* data_dir;     // CIFAR-10二进制文件目录
+    const char* cache_dir;    // 特征缓存目录 (可选)
+    const char* save_prefix;  // 保存码本和模型的文件前缀 (可选)
+    int num_train;            // 训练图像数量上限
+    int num_test;             // 测试图像数量上限
+    int codebook_images;      // 用于构建码本的图像数量
+    int vocab_size;           // 码本大小
+    int level;                // 金字塔层数
+    int svm_iterations;       // SVM训练轮数
+    double svm_C;             // SVM参数
+    int svm_dual;             // 使用对偶坐标下降求解器 (svm_iterations 为最大轮数)
+    int queue_capacity;       // 阶段间队列容量
+    int threads_decode;       // 各阶段线程数
+    int threads_sift;
+    int threads_quantize;
+    int threads_pyramid;
+    int threads_svm;
+    int kmeans_shards;        // >0 时码本由多进程分片K-means构建
+    int ram_budget_mb;        // >0 时码本描述符放入超出内存的描述符存储
+    int sample_budget;        // >0 时码本描述符经蓄水池采样为固定数量
+    int sample_per_image;     // >0 时每幅图像至多贡献这么多描述符
+    int sample_by_class;      // 按类别分层采样
+    double cascade_agreement; // >0 时训练级联分类器，阈值按与完整模型的该一致率校准
+    int packed_codebook;      // 码本描述符以uint8存放，K-means直接在紧凑数据上运行
+} TrainOptions;
+
+static int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s train <cifar10-bin-dir> [options]\n"
+            "       %s serve <model-prefix> <socket> [--max-batch N] [--max-wait-us N] [--batchers N] [--max-image N]\n"
+            "       %s client <socket> <cifar-batch-file> [--count N]\n"
+            "       %s loadgen <socket> <cifar-batch-file> [--clients N] [--requests N]\n"
+            "       %s kmeans <K> <output.codebook> <descriptor-shard>...\n"
+            "train options:\n"
+            "  --train N            training images (default 10000)\n"
+            "  --test N             test images (default 2000)\n"
+            "  --codebook-images N  images sampled for the codebook (default 1000)\n"
+            "  --vocab K            codebook size (default 100)\n"
+            "  --level L            pyramid level (default 2)\n"
+            "  --svm-iters N        SVM epochs (default 10)\n"
+            "  --svm-C C            SVM parameter (default 1.0)\n"
+            "  --svm-solver S       primal (default) or dual coordinate descent; --svm-iters caps dual epochs\n"
+            "  --queue N            capacity of each stage queue (default 256)\n"
+            "  --threads-decode N   decode threads\n"
+            "  --threads-sift N     gradient/SIFT threads\n"
+            "  --threads-quantize N quantization threads\n"
+            "  --threads-pyramid N  pyramid threads\n"
+            "  --threads-svm N      SVM training threads\n"
+            "  --kmeans-shards N    build the codebook with N k-means worker processes\n"
+            "  --ram-budget MB      keep codebook descriptors in a store that spills to disk beyond MB\n"
+            "  --codebook-sample N  reservoir-sample N codebook descriptors (k-means cost bounded by N)\n"
+            "  --sample-per-image Q at most Q sampled descriptors per image\n"
+            "  --sample-by-class B  1 to split the sample budget evenly across classes\n"
+            "  --packed-codebook B  1 to keep codebook descriptors as uint8 and run k-means on the packed data\n"
+            "                       (not combined with --ram-budget or --kmeans-shards)\n"
+            "  --cascade A          also train a coarse-to-fine cascade calibrated to agree with the full\n"
+            "                       model on a fraction A of held-out images (e.g. 0.99) and compare it on the test set\n"
+            "  --cache DIR          feature cache directory\n"
+            "  --save PREFIX        write PREFIX.codebook, PREFIX.cbstats and PREFIX.svm\n"
+            "  --seed S             random seed (default 0x5EED5EED)\n",
+            prog, prog, prog, prog, prog);
+}
+
+// 读取并拼接多个CIFAR-10批次文件的原始记录
+static unsigned char* load_cifar_records(const char* dir, const char* const* names, int num_files,
+                                         int max_records, int* num_records) {
+    unsigned char* records = NULL;
+    size_t total = 0;
+    *num_records = 0;
+
+    for (int i = 0; i < num_files && *num_records < max_records; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+        size_t size;
+        unsigned char* data = read_file(path, &size);
+        if (!data) {
+            MEM_FREE(records);
+            return NULL;
+        }
+
+        int count = (int)(size / CIFAR_RECORD_SIZE);
+        if (count > max_records - *num_records) {
+            count = max_records - *num_records;
+        }
+
+        unsigned char* grown = (unsigned char*)MEM_REALLOC_TAG(MEM_TAG_IMAGE, records, total + (size_t)count * CIFAR_RECORD_SIZE);
+        if (!grown) {
+            fprintf(stderr, "Error: Memory allocation failed for CIFAR records\n");
+            exit(EXIT_FAILURE);
+        }
+        records = grown;
+        memcpy(records + total, data, (size_t)count * CIFAR_RECORD_SIZE);
+        total += (size_t)count * CIFAR_RECORD_SIZE;
+        *num_records += count;
+        MEM_FREE(data);
+    }
+
+    return records;
+}
+
+static void init_stages(PipelineStage* stages, const TrainOptions* options, PipelineContext* context) {
+    PipelineStageFn fns[4] = {pipeline_stage_decode, pipeline_stage_sift, pipeline_stage_quantize,
+                              pipeline_stage_pyramid};
+    const char* names[4] = {"decode", "sift", "quantize", "pyramid"};
+    int threads[4] = {options->threads_decode, options->threads_sift, options->threads_quantize,
+                      options->threads_pyramid};
+
+    for (int i = 0; i < 4; i++) {
+        stages[i].name = names[i];
+        stages[i].fn = fns[i];
+        stages[i].ctx = context;
+        stages[i].num_threads = threads[i];
+        atomic_init(&stages[i].items, 0);
+        atomic_init(&stages[i].busy_ns, 0);
+        atomic_init(&stages[i].starved_ns, 0);
+        atomic_init(&stages[i].blocked_ns, 0);
+    }
+}
+
+// 码本阶段: 收集描述符
+static void collect_descriptors_sink(PipelineItem* item, void* ctx) {
+    DescriptorList* all = (DescriptorList*)ctx;
+
+    for (int i = 0; i < item->descriptors.count; i++) {
+        add_descriptor(all, item->descriptors.descriptors[i]);
+    }
+    // 描述符的所有权已转移
+    item->descriptors.count = 0;
+    free_pipeline_item(item);
+}
+
+// 码本阶段 (紧凑存储时): 描述符打包为uint8后立即释放浮点副本
+static void pack_descriptors_sink(PipelineItem* item, void* ctx) {
+    PackedDescriptors* packed = (PackedDescriptors*)ctx;
+    append_packed_descriptors(packed, &item->descriptors);
+    free_pipeline_item(item);
+}
+
+// 码本阶段 (有内存预算时): 描述符逐行复制进描述符存储
+static void store_descriptors_sink(PipelineItem* item, void* ctx) {
+    DescriptorStore* store = (DescriptorStore*)ctx;
+    if (!descriptor_store_append_list(store, &item->descriptors)) {
+        exit(EXIT_FAILURE);
+    }
+    free_pipeline_item(item);
+}
+
+// 码本阶段 (采样时): 描述符交给蓄水池，按类别分层；键由图像序号决定，到达顺序不影响样本
+static void sample_descriptors_sink(PipelineItem* item, void* ctx) {
+    DescriptorSampler* sampler = (DescriptorSampler*)ctx;
+    descriptor_sampler_offer(sampler, 0, item->label, item->index, &item->descriptors);
+    free_pipeline_item(item);
+}
+
+// 特征阶段: 按序号保存直方图 (转换为SVM使用的double)
+typedef struct {
+    double** features;
+    int* labels;
+    int length;
+    double** coarse;      // 级联分类的粗网格特征 (未启用时为NULL)
+    int coarse_length;
+} FeatureSet;
+
+static double* copy_feature_row(const SpmHistogram* hist, int length) {
+    double* row = (double*)MEM_MALLOC_TAG(MEM_TAG_SPM, length * sizeof(double));
+    if (!row) {
+        fprintf(stderr, "Error: Memory allocation failed for feature row\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < length; i++) {
+        row[i] = hist->histogram[i];
+    }
+    return row;
+}
+
+static void collect_features_sink(PipelineItem* item, void* ctx) {
+    FeatureSet* set = (FeatureSet*)ctx;
+    set->features[item->index] = copy_feature_row(&item->histogram, set->length);
+    if (set->coarse) {
+        set->coarse[item->index] = copy_feature_row(&item->coarse, set->coarse_length);
+    }
+    set->labels[item->index] = item->label;
+    free_pipeline_item(item);
+}
+
+static FeatureSet compute_feature_set(const unsigned char* records, int num_records, Codebook* codebook,
+                                      const TrainOptions* options, const char* title) {
+    PipelineContext context = {records, num_records, SPM_SIFT_STEP, codebook, options->level,
+                               spm_get_feature_cache(), options->cascade_agreement > 0};
+
+    PipelineStage stages[4];
+    init_stages(stages, options, &context);
+
+    FeatureSet set;
+    set.length = spm_histogram_length(codebook->num_clusters, options->level);
+    set.features = (double**)MEM_CALLOC_TAG(MEM_TAG_SPM, num_records, sizeof(double*));
+    set.labels = (int*)MEM_CALLOC(num_records, sizeof(int));
+    set.coarse = context.cascade ? (double**)MEM_CALLOC_TAG(MEM_TAG_SPM, num_records, sizeof(double*)) : NULL;
+    set.coarse_length = cascade_feature_length(codebook->num_clusters, options->level);
+
+    double wall = run_pipeline(stages, 4, num_records, options->queue_capacity, collect_features_sink, &set);
+    printf("%s features: %d images in %.2fs (%.1f images/s)\n", title, num_records, wall,
+           wall > 0 ? num_records / wall : 0.0);
+    print_pipeline_stats(stages, 4, wall);
+    return set;
+}
+
+static void free_feature_set(FeatureSet* set, int count) {
+    for (int i = 0; i < count; i++) {
+        MEM_FREE(set->features[i]);
+        if (set->coarse) {
+            MEM_FREE(set->coarse[i]);
+        }
+    }
+    MEM_FREE(set->features);
+    MEM_FREE(set->coarse);
+    MEM_FREE(set->labels);
+}
+
+// 一对多SVM训练，每个类别一个线程任务
+typedef struct {
+    SVMModel** models;
+    const FeatureSet* set;
+    int num_samples;
+    int iterations;
+    int dual;
+    atomic_int next_class;
+} SvmJob;
+
+static void* svm_worker_main(void* arg) {
+    SvmJob* job = (SvmJob*)arg;
+    int* labels = (int*)MEM_MALLOC(job->num_samples * sizeof(int));
+
+    for (;;) {
+        int c = atomic_fetch_add(&job->next_class, 1);
+        if (c >= CIFAR_NUM_CLASSES) {
+            break;
+        }
+        for (int i = 0; i < job->num_samples; i++) {
+            labels[i] = job->set->labels[i] == c ? 1 : -1;
+        }
+        if (job->dual) {
+            SVMSolverOptions solver = {job->iterations, SVM_DEFAULT_TOLERANCE, SVM_DEFAULT_GAP_TOLERANCE};
+            int epochs = svm_train_dual(job->models[c], NULL, job->set->features, labels, job->num_samples, &solver);
+            printf("SVM class %d: dual solver stopped after %d epochs\n", c, epochs);
+        } else {
+            svm_train(job->models[c], job->set->features, labels, job->num_samples, job->iterations);
+        }
+    }
+
+    MEM_FREE(labels);
+    return NULL;
+}
+
+// 将描述符池均分写入临时目录中的分片文件，再用多进程分片K-means构建码本
+static Codebook build_codebook_in_shards(DescriptorList* pool, int vocab_size, int num_shards) {
+    Codebook codebook = {NULL, vocab_size, 0};
+    const char* tmp = getenv("TMPDIR");
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/cv-c-shards-XXXXXX", tmp ? tmp : "/tmp");
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Error: Could not create shard directory %s\n", dir);
+        return codebook;
+    }
+
+    char** paths = (char**)MEM_CALLOC(num_shards, sizeof(char*));
+    int ok = 1;
+    for (int s = 0; s < num_shards; s++) {
+        paths[s] = (char*)MEM_MALLOC(sizeof(dir) + 32);
+        snprintf(paths[s], sizeof(dir) + 32, "%s/shard-%03d.dsh", dir, s);
+        int begin = (int)((int64_t)pool->count * s / num_shards);
+        int end = (int)((int64_t)pool->count * (s + 1) / num_shards);
+        ok = ok && write_descriptor_shard(paths[s], pool, begin, end);
+    }
+
+    if (ok) {
+        codebook = build_codebook_sharded((const char* const*)paths, num_shards, vocab_size, 100);
+    }
+
+    for (int s = 0; s < num_shards; s++) {
+        unlink(paths[s]);
+        MEM_FREE(paths[s]);
+    }
+    MEM_FREE(paths);
+    rmdir(dir);
+    return codebook;
+}
+
+// 一对多: 选择决策值最大的类别
+static int predict_class(SVMModel** models, const double* features) {
+    int best = 0;
+    double best_score = -DBL_MAX;
+    for (int c = 0; c < CIFAR_NUM_CLASSES; c++) {
+        double score = svm_decision_value(models[c], features);
+        if (score > best_score) {
+            best_score = score;
+            best = c;
+        }
+    }
+    return best;
+}
+
+static double elapsed_seconds(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// 级联分类: 子模型在训练集前部训练，阈值在末尾留出的样本上校准，
+// 然后在测试集上与完整推理路径比较准确率和吞吐 (单线程)
+static void evaluate_cascade(const TrainOptions* options, Codebook* codebook, SVMModel** models,
+                             const FeatureSet* train_set, int num_train, const unsigned char* test_records,
+                             int num_test) {
+    int num_calibration = (int)(num_train * CASCADE_CALIBRATION_FRACTION);
+    int num_fit = num_train - num_calibration;
+    if (num_calibration <= 0 || num_fit <= 0) {
+        fprintf(stderr, "Error: Too few training images to calibrate the cascade\n");
+        return;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    CascadeClassifier* cascade = cascade_train(train_set->coarse, train_set->labels, num_fit,
+                                               codebook->num_clusters, options->level, CIFAR_NUM_CLASSES,
+                                               options->svm_C, options->svm_iterations, options->svm_dual);
+    if (!cascade) {
+        return;
+    }
+
+    int* full_predictions = (int*)MEM_MALLOC(num_calibration * sizeof(int));
+    if (!full_predictions) {
+        fprintf(stderr, "Error: Memory allocation failed for cascade calibration\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_calibration; i++) {
+        full_predictions[i] = predict_class(models, train_set->features[num_fit + i]);
+    }
+    cascade_calibrate(cascade, train_set->coarse + num_fit, full_predictions, num_calibration,
+                      options->cascade_agreement);
+    MEM_FREE(full_predictions);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("Cascade: %d coarse stages trained on %d images, calibrated on %d for %.1f%% agreement in %.2fs\n",
+           cascade->num_coarse, num_fit, num_calibration, 100.0 * options->cascade_agreement,
+           elapsed_seconds(&t0, &t1));
+
+    InferenceWorkspace* workspace = create_inference_workspace(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, codebook,
+                                                               options->level, models, CIFAR_NUM_CLASSES);
+    CascadeStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int* full = (int*)MEM_MALLOC((num_test + 1) * sizeof(int));
+    int* predicted = (int*)MEM_MALLOC((num_test + 1) * sizeof(int));
+    if (!full || !predicted) {
+        fprintf(stderr, "Error: Memory allocation failed for cascade evaluation\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // 两种路径各自完整扫描测试集，按 完整-级联-级联-完整 的顺序计时，
+    // 使先运行的一方预热的缓存和时钟频率的漂移对两者的影响相同；统计量只在第一次级联扫描中累加
+    double full_seconds = 0.0, cascade_seconds = 0.0;
+    static const int pass_is_cascade[4] = {0, 1, 1, 0};
+    for (int pass = 0; pass < 4; pass++) {
+        int use_cascade = pass_is_cascade[pass];
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < num_test; i++) {
+            ImageView view = cifar_record_view(test_records + (size_t)i * CIFAR_RECORD_SIZE);
+            if (use_cascade) {
+                predicted[i] = classify_image_cascade_view(workspace, cascade, &view, NULL,
+                                                           pass == 1 ? &stats : NULL);
+            } else {
+                full[i] = classify_image_view(workspace, &view);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        *(use_cascade ? &cascade_seconds : &full_seconds) += elapsed_seconds(&t0, &t1);
+    }
+
+    int correct_full = 0, correct_cascade = 0, agreements = 0;
+    for (int i = 0; i < num_test; i++) {
+        int label = test_records[(size_t)i * CIFAR_RECORD_SIZE];
+        correct_full += full[i] == label;
+        correct_cascade += predicted[i] == label;
+        agreements += predicted[i] == full[i];
+    }
+    MEM_FREE(full);
+    MEM_FREE(predicted);
+    // 每种路径扫描了两遍
+    full_seconds /= 2.0;
+    cascade_seconds /= 2.0;
+
+    printf("Cascade accuracy: %.2f%% vs full %.2f%% (%.2f%% agreement)\n", 100.0 * correct_cascade / num_test,
+           100.0 * correct_full / num_test, 100.0 * agreements / num_test);
+    printf("Cascade throughput: %.1f vs full %.1f images/s (%.2fx)\n",
+           cascade_seconds > 0 ? num_test / cascade_seconds : 0.0, full_seconds > 0 ? num_test / full_seconds : 0.0,
+           cascade_seconds > 0 ? full_seconds / cascade_seconds : 0.0);
+    cascade_print_stats(cascade, &stats);
+
+    free_inference_workspace(workspace);
+    cascade_free(cascade);
+}
+
+static int run_train(const char* prog, int argc, char** argv) {
+    if (argc < 1) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    int cpus = cpu_count();
+    TrainOptions options = {argv[0], NULL, NULL, 10000, 2000, 1000, 100, SPM_LEVEL_2, 10, 1.0, 0, 256,
+                            1, cpus > 2 ? cpus / 2 : 1, cpus > 2 ? cpus / 2 : 1, 1, cpus, 0, 0, 0, 0, 0, 0.0, 0};
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            print_usage(prog);
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(arg, "--train") == 0) options.num_train = atoi(value);
+        else if (strcmp(arg, "--test") == 0) options.num_test = atoi(value);
+        else if (strcmp(arg, "--codebook-images") == 0) options.codebook_images = atoi(value);
+        else if (strcmp(arg, "--vocab") == 0) options.vocab_size = atoi(value);
+        else if (strcmp(arg, "--level") == 0) options.level = atoi(value);
+        else if (strcmp(arg, "--svm-iters") == 0) options.svm_iterations = atoi(value);
+        else if (strcmp(arg, "--svm-C") == 0) options.svm_C = atof(value);
+        else if (strcmp(arg, "--svm-solver") == 0 && strcmp(value, "primal") == 0) options.svm_dual = 0;
+        else if (strcmp(arg, "--svm-solver") == 0 && strcmp(value, "dual") == 0) options.svm_dual = 1;
+        else if (strcmp(arg, "--queue") == 0) options.queue_capacity = atoi(value);
+        else if (strcmp(arg, "--threads-decode") == 0) options.threads_decode = atoi(value);
+        else if (strcmp(arg, "--threads-sift") == 0) options.threads_sift = atoi(value);
+        else if (strcmp(arg, "--threads-quantize") == 0) options.threads_quantize = atoi(value);
+        else if (strcmp(arg, "--threads-pyramid") == 0) options.threads_pyramid = atoi(value);
+        else if (strcmp(arg, "--threads-svm") == 0) options.threads_svm = atoi(value);
+        else if (strcmp(arg, "--kmeans-shards") == 0) options.kmeans_shards = atoi(value);
+        else if (strcmp(arg, "--ram-budget") == 0) options.ram_budget_mb = atoi(value);
+        else if (strcmp(arg, "--codebook-sample") == 0) options.sample_budget = atoi(value);
+        else if (strcmp(arg, "--sample-per-image") == 0) options.sample_per_image = atoi(value);
+        else if (strcmp(arg, "--sample-by-class") == 0) options.sample_by_class = atoi(value);
+        else if (strcmp(arg, "--cascade") == 0) options.cascade_agreement = atof(value);
+        else if (strcmp(arg, "--packed-codebook") == 0) options.packed_codebook = atoi(value);
+        else if (strcmp(arg, "--cache") == 0) options.cache_dir = value;
+        else if (strcmp(arg, "--save") == 0) options.save_prefix = value;
+        else if (strcmp(arg, "--seed") == 0) rng_set_default_seed(strtoull(value, NULL, 0));
+        else {
+            print_usage(prog);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+
+    if (options.packed_codebook && (options.ram_budget_mb > 0 || options.kmeans_shards > 0)) {
+        fprintf(stderr, "Error: --packed-codebook cannot be combined with --ram-budget or --kmeans-shards\n");
+        return EXIT_FAILURE;
+    }
+
+    int num_train, num_test;
+    unsigned char* train_records = load_cifar_records(options.data_dir, cifar_train_files, 5,
+                                                      options.num_train, &num_train);
+    unsigned char* test_records = load_cifar_records(options.data_dir, cifar_test_files, 1,
+                                                     options.num_test, &num_test);
+    if (!train_records || !test_records || num_train == 0) {
+        fprintf(stderr, "Error: Could not load CIFAR-10 from %s\n", options.data_dir);
+        MEM_FREE(train_records);
+        MEM_FREE(test_records);
+        return EXIT_FAILURE;
+    }
+    printf("Loaded %d training and %d test images\n", num_train, num_test);
+
+    FeatureCache* cache = NULL;
+    if (options.cache_dir) {
+        cache = feature_cache_open(options.cache_dir, FEATURE_CACHE_DEFAULT_SHARDS);
+        spm_set_feature_cache(cache);
+    }
+
+    // 1. 码本: 解码 → SIFT，收集描述符
+    MEM_STAGE_BEGIN("descriptors");
+    int codebook_images = min_int(options.codebook_images, num_train);
+    PipelineContext context = {train_records, num_train, SPM_SIFT_STEP, NULL, options.level, cache, 0};
+    PipelineStage stages[4];
+    init_stages(stages, &options, &context);
+
+    DescriptorList pool = create_descriptor_list(0);
+    DescriptorStore* store = NULL;
+    PackedDescriptors packed = create_packed_descriptors(SIFT_DESC_SIZE);
+    double wall;
+    if (options.sample_budget > 0) {
+        SamplerOptions sampler_options = {options.sample_budget, options.sample_per_image,
+                                          options.sample_by_class ? CIFAR_NUM_CLASSES : 1, 1, rng_default_seed()};
+        DescriptorSampler* sampler = descriptor_sampler_create(&sampler_options, SIFT_DESC_SIZE);
+        wall = run_pipeline(stages, 2, codebook_images, options.queue_capacity, sample_descriptors_sink, sampler);
+        free_descriptor_list(&pool);
+        pool = descriptor_sampler_finish(sampler);
+        descriptor_sampler_free(sampler);
+        printf("Codebook sample: %d descriptors (budget %d)\n", pool.count, options.sample_budget);
+        if (options.packed_codebook) {
+            append_packed_descriptors(&packed, &pool);
+            free_descriptor_list(&pool);
+        }
+    } else if (options.ram_budget_mb > 0) {
+        store = descriptor_store_create(SIFT_DESC_SIZE, (size_t)options.ram_budget_mb << 20, NULL);
+        wall = run_pipeline(stages, 2, codebook_images, options.queue_capacity, store_descriptors_sink, store);
+    } else if (options.packed_codebook) {
+        wall = run_pipeline(stages, 2, codebook_images, options.queue_capacity, pack_descriptors_sink, &packed);
+    } else {
+        wall = run_pipeline(stages, 2, codebook_images, options.queue_capacity, collect_descriptors_sink, &pool);
+    }
+    printf("Codebook descriptors: %d from %d images in %.2fs%s\n",
+           store ? store->count : options.packed_codebook ? packed.count : pool.count, codebook_images, wall,
+           options.packed_codebook ? " (packed uint8)" : "");
+    print_pipeline_stats(stages, 2, wall);
+    MEM_STAGE_END();
+
+    MEM_STAGE_BEGIN("kmeans");
+    CodebookStats codebook_stats = {NULL, NULL, 0, 0};
+    Codebook codebook;
+    if (store) {
+        codebook = build_codebook_from_store(store, options.vocab_size, &codebook_stats);
+        descriptor_store_free(store);
+    } else if (options.packed_codebook) {
+        codebook = build_codebook_packed_with_stats(&packed, options.vocab_size, &codebook_stats);
+    } else if (options.kmeans_shards > 0) {
+        codebook = build_codebook_in_shards(&pool, options.vocab_size, options.kmeans_shards);
+        if (codebook.centers) {
+            codebook_stats = create_codebook_stats(codebook.num_clusters, codebook.dim);
+            accumulate_codebook_stats(&codebook_stats, &codebook, &pool);
+        }
+    } else {
+        codebook = build_codebook_with_stats(&pool, options.vocab_size, &codebook_stats);
+    }
+    free_descriptor_list(&pool);
+    free_packed_descriptors(&packed);
+    MEM_STAGE_END();
+    if (!codebook.centers) {
+        MEM_FREE(train_records);
+        MEM_FREE(test_records);
+        feature_cache_close(cache);
+        return EXIT_FAILURE;
+    }
+
+    // 2. SPM特征: 解码 → SIFT → 量化 → 金字塔
+    MEM_STAGE_BEGIN("features");
+    FeatureSet train_set = compute_feature_set(train_records, num_train, &codebook, &options, "Training");
+    FeatureSet test_set = compute_feature_set(test_records, num_test, &codebook, &options, "Test");
+    MEM_STAGE_END();
+
+    // 3. 一对多SVM
+    MEM_STAGE_BEGIN("svm");
+    SVMModel* models[CIFAR_NUM_CLASSES];
+    for (int c = 0; c < CIFAR_NUM_CLASSES; c++) {
+        models[c] = svm_create(train_set.length, options.svm_C);
+    }
+
+    SvmJob job = {models, &train_set, num_train, options.svm_iterations, options.svm_dual, 0};
+    int svm_threads = min_int(options.threads_svm > 0 ? options.threads_svm : 1, CIFAR_NUM_CLASSES);
+    pthread_t threads[CIFAR_NUM_CLASSES];
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < svm_threads; i++) {
+        pthread_create(&threads[i], NULL, svm_worker_main, &job);
+    }
+    for (int i = 0; i < svm_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("SVM: %d one-vs-rest models trained in %.2fs\n", CIFAR_NUM_CLASSES, elapsed_seconds(&t0, &t1));
+    MEM_STAGE_END();
+
+    // 4. 评估
+    MEM_STAGE_BEGIN("evaluate");
+    int correct = 0;
+    for (int i = 0; i < num_test; i++) {
+        if (predict_class(models, test_set.features[i]) == test_set.labels[i]) {
+            correct++;
+        }
+    }
+    printf("Test accuracy: %.2f%% (%d/%d)\n", num_test > 0 ? 100.0 * correct / num_test : 0.0, correct, num_test);
+    MEM_STAGE_END();
+
+    // 5. 级联分类 (可选)
+    if (options.cascade_agreement > 0 && num_test > 0) {
+        MEM_STAGE_BEGIN("cascade");
+        evaluate_cascade(&options, &codebook, models, &train_set, num_train, test_records, num_test);
+        MEM_STAGE_END();
+    }
+
+    if (options.save_prefix) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s.codebook", options.save_prefix);
+        int ok = save_codebook(&codebook, path);
+        // 码本统计量供之后增量更新码本使用
+        snprintf(path, sizeof(path), "%s.cbstats", options.save_prefix);
+        ok = ok && save_codebook_stats(&codebook_stats, path);
+        snprintf(path, sizeof(path), "%s.svm", options.save_prefix);
+        ok = ok && svm_save_models(models, CIFAR_NUM_CLASSES, path);
+        printf("%s model to %s.{codebook,cbstats,svm}\n", ok ? "Saved" : "Failed to save", options.save_prefix);
+    }
+
+    if (cache) {
+        feature_cache_print_stats(cache);
+        spm_set_feature_cache(NULL);
+        feature_cache_close(cache);
+    }
+
+    for (int c = 0; c < CIFAR_NUM_CLASSES; c++) {
+        svm_free(models[c]);
+    }
+    free_feature_set(&train_set, num_train);
+    free_feature_set(&test_set, num_test);
+    free_codebook(&codebook);
+    free_codebook_stats(&codebook_stats);
+    MEM_FREE(train_records);
+    MEM_FREE(test_records);
+    return EXIT_SUCCESS;
+}
+
+static int run_serve(const char* prog, int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    ServerConfig config = {argv[0], argv[1], SERVER_DEFAULT_MAX_BATCH, SERVER_DEFAULT_MAX_WAIT_US,
+                           cpu_count(), SERVER_DEFAULT_MAX_IMAGE_SIZE};
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--max-batch") == 0) config.max_batch = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--max-wait-us") == 0) config.max_wait_us = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--batchers") == 0) config.num_batchers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--max-image") == 0) config.max_image_size = atoi(argv[i + 1]);
+        else {
+            print_usage(prog);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return run_server(&config);
+}
+
+// 本地客户端: 逐条发送CIFAR记录并统计准确率
+static int run_client(const char* prog, int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    int count = 10;
+    if (argc >= 4 && strcmp(argv[2], "--count") == 0) {
+        count = atoi(argv[3]);
+    }
+
+    size_t size;
+    unsigned char* records = read_file(argv[1], &size);
+    int fd = records ? server_connect(argv[0]) : -1;
+    if (fd < 0) {
+        MEM_FREE(records);
+        return EXIT_FAILURE;
+    }
+
+    count = min_int(count, (int)(size / CIFAR_RECORD_SIZE));
+    int correct = 0;
+    for (int i = 0; i < count; i++) {
+        const unsigned char* record = records + (size_t)i * CIFAR_RECORD_SIZE;
+        int label = server_classify_cifar(fd, record, NULL, 0);
+        if (label < -1) {
+            fprintf(stderr, "Error: Request %d failed\n", i);
+            break;
+        }
+        printf("%d: predicted %d, label %d\n", i, label, record[0]);
+        correct += label == record[0];
+    }
+    printf("Accuracy: %d/%d\n", correct, count);
+
+    close(fd);
+    MEM_FREE(records);
+    return EXIT_SUCCESS;
+}
+
+// 负载生成: 多个并发连接，统计客户端延迟和吞吐
+typedef struct {
+    const char* socket_path;
+    const unsigned char* records;
+    int num_records;
+    int num_requests;
+    int client_id;
+    double* latencies_us;
+    int failed;
+} LoadgenClient;
+
+static void* loadgen_client_main(void* arg) {
+    LoadgenClient* client = (LoadgenClient*)arg;
+    int fd = server_connect(client->socket_path);
+    if (fd < 0) {
+        client->failed = client->num_requests;
+        return NULL;
+    }
+
+    for (int i = 0; i < client->num_requests; i++) {
+        int idx = (client->client_id * client->num_requests + i) % client->num_records;
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int label = server_classify_cifar(fd, client->records + (size_t)idx * CIFAR_RECORD_SIZE, NULL, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        if (label < -1) {
+            client->failed = client->num_requests - i;
+            break;
+        }
+        client->latencies_us[i] = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double va = *(const double*)a;
+    double vb = *(const double*)b;
+    return (va > vb) - (va < vb);
+}
+
+static int run_loadgen(const char* prog, int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    int num_clients = 8;
+    int num_requests = 100;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--clients") == 0) num_clients = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--requests") == 0) num_requests = atoi(argv[i + 1]);
+        else {
+            print_usage(prog);
+            return EXIT_FAILURE;
+        }
+    }
+    if (num_clients < 1) num_clients = 1;
+    if (num_requests < 1) num_requests = 1;
+
+    size_t size;
+    unsigned char* records = read_file(argv[1], &size);
+    if (!records || size < CIFAR_RECORD_SIZE) {
+        MEM_FREE(records);
+        return EXIT_FAILURE;
+    }
+
+    int total = num_clients * num_requests;
+    double* latencies = (double*)MEM_CALLOC(total, sizeof(double));
+    LoadgenClient* clients = (LoadgenClient*)MEM_CALLOC(num_clients, sizeof(LoadgenClient));
+    pthread_t* threads = (pthread_t*)MEM_MALLOC(num_clients * sizeof(pthread_t));
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int c = 0; c < num_clients; c++) {
+        clients[c] = (LoadgenClient){argv[0], records, (int)(size / CIFAR_RECORD_SIZE), num_requests, c,
+                                     latencies + (size_t)c * num_requests, 0};
+        pthread_create(&threads[c], NULL, loadgen_client_main, &clients[c]);
+    }
+    int failed = 0;
+    for (int c = 0; c < num_clients; c++) {
+        pthread_join(threads[c], NULL);
+        failed += clients[c].failed;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    qsort(latencies, total, sizeof(double), compare_double);
+    int ok = total - failed;
+    // 失败的请求延迟为0，排序后位于前部
+    const double* done = latencies + failed;
+    printf("Load: %d clients x %d requests, %d ok, %d failed in %.2fs (%.1f req/s)\n",
+           num_clients, num_requests, ok, failed, wall, wall > 0 ? ok / wall : 0.0);
+    if (ok > 0) {
+        printf("Client latency us: p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n", done[(int)(0.50 * (ok - 1))],
+               done[(int)(0.90 * (ok - 1))], done[(int)(0.99 * (ok - 1))], done[ok - 1]);
+    }
+
+    int fd = server_connect(argv[0]);
+    char* stats = fd >= 0 ? server_fetch_stats(fd) : NULL;
+    if (stats) {
+        printf("Server stats: %s\n", stats);
+        MEM_FREE(stats);
+    }
+    if (fd >= 0) close(fd);
+
+    MEM_FREE(threads);
+    MEM_FREE(clients);
+    MEM_FREE(latencies);
+    MEM_FREE(records);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int run_kmeans(const char* prog, int argc, char** argv) {
+    if (argc < 3) {
+        print_usage(prog);
+        return EXIT_FAILURE;
+    }
+
+    Codebook codebook = build_codebook_sharded((const char* const*)(argv + 2), argc - 2, atoi(argv[0]), 100);
+    int ok = codebook.centers && save_codebook(&codebook, argv[1]);
+    free_codebook(&codebook);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+    int status;
+    if (argc >= 2 && strcmp(argv[1], "train") == 0) {
+        status = run_train(argv[0], argc - 2, argv + 2);
+    } else if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+        status = run_serve(argv[0], argc - 2, argv + 2);
+    } else if (argc >= 2 && strcmp(argv[1], "client") == 0) {
+        status = run_client(argv[0], argc - 2, argv + 2);
+    } else if (argc >= 2 && strcmp(argv[1], "loadgen") == 0) {
+        status = run_loadgen(argv[0], argc - 2, argv + 2);
+    } else if (argc >= 2 && strcmp(argv[1], "kmeans") == 0) {
+        status = run_kmeans(argv[0], argc - 2, argv + 2);
+    } else {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // 各子命令返回前已汇合所有记录插桩的线程
+    TRACE_FLUSH();
+    return status;
+}
@@ -0,0 +1,285 @@
+#define _POSIX_C_SOURCE 200809L
+#include "memtrack.h"
+
+#ifdef CV_MEMTRACK
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define MEM_TABLE_BUCKETS (1 << 20)
+#define MEM_TABLE_STRIPES 256
+#define MEM_REPORT_SITES 10
+
+// 每个存活分配一项，按指针散列到桶中；每个锁条带保护一组桶，并维护一个空闲节点链表
+typedef struct MemEntry {
+    void* ptr;
+    size_t size;
+    const char* file;
+    int line;
+    int tag;
+    struct MemEntry* next;
+} MemEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    MemEntry* free_nodes;
+} MemStripe;
+
+static MemEntry** mem_buckets = NULL;
+static MemStripe mem_stripes[MEM_TABLE_STRIPES];
+static pthread_once_t mem_once = PTHREAD_ONCE_INIT;
+
+static const char* tag_names[MEM_TAG_COUNT] = {"other", "image", "sift", "kmeans", "spm", "svm"};
+
+// 计数器
+static atomic_llong current_bytes[MEM_TAG_COUNT];
+static atomic_llong peak_bytes[MEM_TAG_COUNT];
+static atomic_llong live_count[MEM_TAG_COUNT];
+static atomic_llong total_count[MEM_TAG_COUNT];
+static atomic_llong total_bytes[MEM_TAG_COUNT];
+static atomic_llong current_all;
+static atomic_llong peak_all;
+
+// 当前阶段的峰值
+static const char* stage_name = NULL;
+static atomic_llong stage_peak[MEM_TAG_COUNT];
+static atomic_llong stage_peak_all;
+static long long stage_start_all;
+
+static void mem_init(void) {
+    mem_buckets = (MemEntry**)calloc(MEM_TABLE_BUCKETS, sizeof(MemEntry*));
+    if (!mem_buckets) {
+        fprintf(stderr, "Error: Memory allocation failed for allocation table\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < MEM_TABLE_STRIPES; i++) {
+        pthread_mutex_init(&mem_stripes[i].lock, NULL);
+        mem_stripes[i].free_nodes = NULL;
+    }
+    atexit(mem_report);
+}
+
+static size_t bucket_of(const void* ptr) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 44) & (MEM_TABLE_BUCKETS - 1);
+}
+
+static void atomic_max(atomic_llong* target, long long value) {
+    long long seen = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak(target, &seen, value)) {
+    }
+}
+
+static void account(int tag, long long bytes, int count) {
+    long long tag_now = atomic_fetch_add(&current_bytes[tag], bytes) + bytes;
+    long long all_now = atomic_fetch_add(&current_all, bytes) + bytes;
+    atomic_fetch_add(&live_count[tag], count);
+    if (bytes > 0) {
+        atomic_fetch_add(&total_count[tag], 1);
+        atomic_fetch_add(&total_bytes[tag], bytes);
+        atomic_max(&peak_bytes[tag], tag_now);
+        atomic_max(&peak_all, all_now);
+        atomic_max(&stage_peak[tag], tag_now);
+        atomic_max(&stage_peak_all, all_now);
+    }
+}
+
+static void table_insert(void* ptr, size_t size, int tag, const char* file, int line) {
+    size_t bucket = bucket_of(ptr);
+    MemStripe* stripe = &mem_stripes[bucket % MEM_TABLE_STRIPES];
+
+    pthread_mutex_lock(&stripe->lock);
+    MemEntry* entry = stripe->free_nodes;
+    if (entry) {
+        stripe->free_nodes = entry->next;
+    } else {
+        entry = (MemEntry*)malloc(sizeof(MemEntry));
+        if (!entry) {
+            pthread_mutex_unlock(&stripe->lock);
+            fprintf(stderr, "Error: Memory allocation failed for allocation table entry\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    *entry = (MemEntry){ptr, size, file, line, tag, mem_buckets[bucket]};
+    mem_buckets[bucket] = entry;
+    pthread_mutex_unlock(&stripe->lock);
+
+    account(tag, (long long)size, 1);
+}
+
+// 移除记录，返回是否找到 (removed 非NULL时复制被移除的记录)
+static int table_remove(void* ptr, MemEntry* removed) {
+    size_t bucket = bucket_of(ptr);
+    MemStripe* stripe = &mem_stripes[bucket % MEM_TABLE_STRIPES];
+    size_t size = 0;
+    int tag = 0;
+    int found = 0;
+
+    pthread_mutex_lock(&stripe->lock);
+    for (MemEntry** link = &mem_buckets[bucket]; *link; link = &(*link)->next) {
+        MemEntry* entry = *link;
+        if (entry->ptr == ptr) {
+            *link = entry->next;
+            size = entry->size;
+            tag = entry->tag;
+            if (removed) {
+                *removed = *entry;
+            }
+            entry->next = stripe->free_nodes;
+            stripe->free_nodes = entry;
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    if (found) {
+        account(tag, -(long long)size, -1);
+    }
+    return found;
+}
+
+void* mem_malloc(MemTag tag, size_t size, const char* file, int line) {
+    pthread_once(&mem_once, mem_init);
+    void* ptr = malloc(size);
+    if (ptr) {
+        table_insert(ptr, size, tag, file, line);
+    }
+    return ptr;
+}
+
+void* mem_calloc(MemTag tag, size_t count, size_t size, const char* file, int line) {
+    pthread_once(&mem_once, mem_init);
+    void* ptr = calloc(count, size);
+    if (ptr) {
+        table_insert(ptr, count * size, tag, file, line);
+    }
+    return ptr;
+}
+
+void* mem_realloc(MemTag tag, void* ptr, size_t size, const char* file, int line) {
+    pthread_once(&mem_once, mem_init);
+    // 先移除再 realloc: 旧地址被释放后可能立即被其他线程重新分配，不能在 realloc 之后再按旧地址移除
+    MemEntry original;
+    int tracked = ptr && table_remove(ptr, &original);
+    void* grown = realloc(ptr, size);
+    if (grown) {
+        table_insert(grown, size, tag, file, line);
+    } else if (tracked && size > 0) {
+        // 失败时原指针仍然有效，恢复原来的记录
+        table_insert(ptr, original.size, original.tag, original.file, original.line);
+    }
+    return grown;
+}
+
+void mem_free(void* ptr) {
+    if (ptr) {
+        pthread_once(&mem_once, mem_init);
+        table_remove(ptr, NULL);
+        free(ptr);
+    }
+}
+
+static double to_mb(long long bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+void mem_stage_begin(const char* name) {
+    pthread_once(&mem_once, mem_init);
+    stage_name = name;
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        atomic_store(&stage_peak[t], atomic_load(&current_bytes[t]));
+    }
+    stage_start_all = atomic_load(&current_all);
+    atomic_store(&stage_peak_all, stage_start_all);
+}
+
+void mem_stage_end(void) {
+    long long now = atomic_load(&current_all);
+    fprintf(stderr, "[mem] stage %-10s peak %9.2f MB  current %9.2f MB  (%+.2f MB) |",
+            stage_name ? stage_name : "?", to_mb(atomic_load(&stage_peak_all)), to_mb(now),
+            to_mb(now - stage_start_all));
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        long long peak = atomic_load(&stage_peak[t]);
+        if (peak > 0) {
+            fprintf(stderr, " %s %.2f", tag_names[t], to_mb(peak));
+        }
+    }
+    fprintf(stderr, "\n");
+    stage_name = NULL;
+}
+
+typedef struct {
+    const char* file;
+    int line;
+    int tag;
+    long long bytes;
+    long long count;
+} LeakSite;
+
+static int compare_sites(const void* a, const void* b) {
+    long long x = ((const LeakSite*)a)->bytes;
+    long long y = ((const LeakSite*)b)->bytes;
+    return (x < y) - (x > y);
+}
+
+void mem_report(void) {
+    pthread_once(&mem_once, mem_init);
+    fprintf(stderr, "[mem] %-8s %14s %14s %12s %12s %12s\n", "tag", "allocs", "allocated MB", "peak MB",
+            "live", "live MB");
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        if (atomic_load(&total_count[t]) == 0) {
+            continue;
+        }
+        fprintf(stderr, "[mem] %-8s %14lld %14.2f %12.2f %12lld %12.2f\n", tag_names[t],
+                (long long)atomic_load(&total_count[t]), to_mb(atomic_load(&total_bytes[t])),
+                to_mb(atomic_load(&peak_bytes[t])), (long long)atomic_load(&live_count[t]),
+                to_mb(atomic_load(&current_bytes[t])));
+    }
+    fprintf(stderr, "[mem] total peak %.2f MB\n", to_mb(atomic_load(&peak_all)));
+
+    // 按分配位置汇总仍存活的分配
+    int capacity = 64;
+    int num_sites = 0;
+    LeakSite* sites = (LeakSite*)malloc(capacity * sizeof(LeakSite));
+    for (int s = 0; s < MEM_TABLE_STRIPES; s++) {
+        pthread_mutex_lock(&mem_stripes[s].lock);
+    }
+    for (size_t b = 0; sites && b < MEM_TABLE_BUCKETS; b++) {
+        for (MemEntry* entry = mem_buckets[b]; entry; entry = entry->next) {
+            int i = 0;
+            while (i < num_sites && (sites[i].line != entry->line || strcmp(sites[i].file, entry->file) != 0)) {
+                i++;
+            }
+            if (i == num_sites) {
+                if (num_sites == capacity) {
+                    LeakSite* grown = (LeakSite*)realloc(sites, capacity * 2 * sizeof(LeakSite));
+                    if (!grown) break;
+                    sites = grown;
+                    capacity *= 2;
+                }
+                sites[num_sites++] = (LeakSite){entry->file, entry->line, entry->tag, 0, 0};
+            }
+            sites[i].bytes += (long long)entry->size;
+            sites[i].count++;
+        }
+    }
+    for (int s = 0; s < MEM_TABLE_STRIPES; s++) {
+        pthread_mutex_unlock(&mem_stripes[s].lock);
+    }
+
+    if (num_sites > 0) {
+        qsort(sites, num_sites, sizeof(LeakSite), compare_sites);
+        fprintf(stderr, "[mem] %d allocation sites still live, largest:\n", num_sites);
+        for (int i = 0; i < num_sites && i < MEM_REPORT_SITES; i++) {
+            fprintf(stderr, "[mem]   %s:%d (%s) %lld blocks, %.2f MB\n", sites[i].file, sites[i].line,
+                    tag_names[sites[i].tag], sites[i].count, to_mb(sites[i].bytes));
+        }
+    }
+    free(sites);
+}
+
+#endif /* CV_MEMTRACK */
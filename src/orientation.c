@@ -0,0 +1,429 @@
+#include "orientation.h"
+#include "trace.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ORIENTATION_HAVE_X86 1
+#endif
+
+// atan(r) / (pi/4) 在 [0,1] 上的多项式近似，最大误差约0.002个bin
+#define ATAN_C0 0.3115734f
+#define ATAN_C1 0.0844159f
+
+OrientationPlanes create_orientation_planes(int width, int height) {
+    OrientationPlanes planes;
+    planes.width = width;
+    planes.height = height;
+    planes.data = allocate_float_array(width * height * ORIENTATION_BINS);
+    return planes;
+}
+
+void free_orientation_planes(OrientationPlanes* planes) {
+    if (planes && planes->data) {
+        free_float_array(planes->data);
+        planes->data = NULL;
+        planes->width = 0;
+        planes->height = 0;
+    }
+}
+
+// 单个像素: 标量实现，也是SIMD版本逐位对照的参考
+// 运算顺序与SIMD版本保持一致，两者结果逐位相同
+static void bin_gradient(float gx, float gy, OrientationBinning binning, float* out) {
+    float mag = sqrtf(gx * gx + gy * gy);
+    float ax = fabsf(gx);
+    float ay = fabsf(gy);
+
+    // 象限: 0 [0,90), 1 [90,180), 2 [180,270), 3 [270,360)
+    int quadrant = 0;
+    if (gx <= 0 && gy > 0) quadrant = 1;
+    else if (gx < 0 && gy <= 0) quadrant = 2;
+    else if (gx >= 0 && gy < 0) quadrant = 3;
+
+    // 奇数象限中角度随 |gx|/|gy| 增大，交换后统一处理
+    float u = (quadrant & 1) ? ay : ax;
+    float v = (quadrant & 1) ? ax : ay;
+    int first_half = v < u;
+
+    memset(out, 0, ORIENTATION_BINS * sizeof(float));
+
+    if (binning == ORIENTATION_HARD) {
+        out[2 * quadrant + !first_half] = mag;
+        return;
+    }
+
+    float lo = ax < ay ? ax : ay;
+    float hi = ax < ay ? ay : ax;
+    float r = hi > 0 ? lo / hi : 0.0f;
+    float f = r + r * (1.0f - r) * (ATAN_C0 + ATAN_C1 * r);
+    float phi = first_half ? f : 2.0f - f;
+
+    // 以bin中心为插值节点
+    float p = (2.0f * (float)quadrant + phi) - 0.5f;
+    float lower = floorf(p);
+    float w = p - lower;
+    int lb = lower < 0 ? (int)lower + ORIENTATION_BINS : (int)lower;
+    int ub = lb + 1 == ORIENTATION_BINS ? 0 : lb + 1;
+
+    out[lb] = mag * (1.0f - w);
+    out[ub] = mag * w;
+}
+
+static void compute_pixel(const GrayView* img, int x, int y, OrientationBinning binning, float* out) {
+    float gx = gray_view_pixel(img, x + 1, y) - gray_view_pixel(img, x - 1, y);
+    float gy = gray_view_pixel(img, x, y + 1) - gray_view_pixel(img, x, y - 1);
+    bin_gradient(gx, gy, binning, out);
+}
+
+static void compute_row_scalar(const GrayView* img, int y, int x0, int x1, OrientationBinning binning,
+                               float* out) {
+    for (int x = x0; x < x1; x++) {
+        compute_pixel(img, x, y, binning, out + (size_t)x * ORIENTATION_BINS);
+    }
+}
+
+// 定点路径: 整数中心差分 (边界复制)，缩放为float后与浮点路径共用分bin
+#define GRAY16_INV_SCALE (1.0f / GRAY16_SCALE)
+
+// 批量布局中一行及其上下行、一个像素及其左右邻居的位置 (边界复制)
+#define BATCH_OUT_STRIDE ((size_t)ORIENTATION_BINS * IMAGE_BATCH_LANES)
+#define BATCH_ROW_POINTERS(gray, y)                                                                       \
+    const int width = (gray)->width;                                                                      \
+    const int16_t* row = (gray)->data + (size_t)(y) * width * IMAGE_BATCH_LANES;                          \
+    const int16_t* above = (gray)->data + (size_t)((y) > 0 ? (y) - 1 : 0) * width * IMAGE_BATCH_LANES;    \
+    const int16_t* below = (gray)->data +                                                                 \
+        (size_t)((y) < (gray)->height - 1 ? (y) + 1 : (y)) * width * IMAGE_BATCH_LANES
+#define BATCH_PIXEL_POINTERS(x)                                                                           \
+    const int16_t* left = row + (size_t)((x) > 0 ? (x) - 1 : 0) * IMAGE_BATCH_LANES;                      \
+    const int16_t* right = row + (size_t)((x) < width - 1 ? (x) + 1 : (x)) * IMAGE_BATCH_LANES;           \
+    const int16_t* up = above + (size_t)(x) * IMAGE_BATCH_LANES;                                          \
+    const int16_t* down = below + (size_t)(x) * IMAGE_BATCH_LANES
+
+static void compute_row_gray16_scalar(const Gray16Image* img, int y, int x0, int x1, OrientationBinning binning,
+                                      float* out) {
+    const int16_t* row = img->data + (size_t)y * img->width;
+    const int16_t* above = img->data + (size_t)(y > 0 ? y - 1 : 0) * img->width;
+    const int16_t* below = img->data + (size_t)(y < img->height - 1 ? y + 1 : y) * img->width;
+
+    for (int x = x0; x < x1; x++) {
+        int left = x > 0 ? x - 1 : 0;
+        int right = x < img->width - 1 ? x + 1 : x;
+        int gx = row[right] - row[left];
+        int gy = below[x] - above[x];
+        bin_gradient((float)gx * GRAY16_INV_SCALE, (float)gy * GRAY16_INV_SCALE, binning,
+                     out + (size_t)x * ORIENTATION_BINS);
+    }
+}
+
+#ifdef ORIENTATION_HAVE_X86
+
+// 8个梯度的分bin结果: 每个梯度落入 lower_bin (权重后的幅值 lower_value)，
+// 软分bin时还落入 upper_bin (upper_value)；逐位复现 bin_gradient 的运算顺序
+typedef struct {
+    __m256 lower_bin;
+    __m256 lower_value;
+    __m256 upper_bin;
+    __m256 upper_value;
+} BinnedGradients;
+
+__attribute__((target("avx2"), always_inline))
+static inline BinnedGradients classify_gradients_avx2(__m256 gx, __m256 gy, OrientationBinning binning) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 bins = _mm256_set1_ps((float)ORIENTATION_BINS);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    BinnedGradients binned;
+
+    __m256 mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)));
+    __m256 ax = _mm256_andnot_ps(sign, gx);
+    __m256 ay = _mm256_andnot_ps(sign, gy);
+
+    // 象限掩码互不相交，可直接按位或
+    __m256 q1 = _mm256_and_ps(_mm256_cmp_ps(gx, zero, _CMP_LE_OQ), _mm256_cmp_ps(gy, zero, _CMP_GT_OQ));
+    __m256 q2 = _mm256_and_ps(_mm256_cmp_ps(gx, zero, _CMP_LT_OQ), _mm256_cmp_ps(gy, zero, _CMP_LE_OQ));
+    __m256 q3 = _mm256_and_ps(_mm256_cmp_ps(gx, zero, _CMP_GE_OQ), _mm256_cmp_ps(gy, zero, _CMP_LT_OQ));
+    __m256 quadrant = _mm256_or_ps(_mm256_and_ps(q1, one),
+                      _mm256_or_ps(_mm256_and_ps(q2, two), _mm256_and_ps(q3, _mm256_set1_ps(3.0f))));
+    __m256 odd = _mm256_or_ps(q1, q3);
+    __m256 u = _mm256_blendv_ps(ax, ay, odd);
+    __m256 v = _mm256_blendv_ps(ay, ax, odd);
+    __m256 first_half = _mm256_cmp_ps(v, u, _CMP_LT_OQ);
+    __m256 base = _mm256_mul_ps(two, quadrant);
+
+    if (binning == ORIENTATION_HARD) {
+        binned.lower_bin = _mm256_add_ps(base, _mm256_andnot_ps(first_half, one));
+        binned.lower_value = mag;
+        binned.upper_bin = _mm256_set1_ps(-1.0f);
+        binned.upper_value = zero;
+        return binned;
+    }
+
+    __m256 lo = _mm256_min_ps(ax, ay);
+    __m256 hi = _mm256_max_ps(ax, ay);
+    __m256 r = _mm256_and_ps(_mm256_cmp_ps(hi, zero, _CMP_GT_OQ), _mm256_div_ps(lo, hi));
+    __m256 poly = _mm256_add_ps(_mm256_set1_ps(ATAN_C0), _mm256_mul_ps(_mm256_set1_ps(ATAN_C1), r));
+    __m256 f = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, _mm256_sub_ps(one, r)), poly));
+    __m256 phi = _mm256_blendv_ps(_mm256_sub_ps(two, f), f, first_half);
+
+    __m256 p = _mm256_sub_ps(_mm256_add_ps(base, phi), half);
+    __m256 lower = _mm256_floor_ps(p);
+    __m256 w = _mm256_sub_ps(p, lower);
+    __m256 lb = _mm256_add_ps(lower, _mm256_and_ps(_mm256_cmp_ps(lower, zero, _CMP_LT_OQ), bins));
+    __m256 ub = _mm256_add_ps(lb, one);
+
+    binned.lower_bin = lb;
+    binned.lower_value = _mm256_mul_ps(mag, _mm256_sub_ps(one, w));
+    binned.upper_bin = _mm256_andnot_ps(_mm256_cmp_ps(ub, bins, _CMP_EQ_OQ), ub);
+    binned.upper_value = _mm256_mul_ps(mag, w);
+    return binned;
+}
+
+// 8个相邻像素的梯度 → 方向平面 (out 为第一个像素的输出位置)，每个像素的8个bin写成一个向量
+__attribute__((target("avx2"), always_inline))
+static inline void bin_gradients_avx2(__m256 gx, __m256 gy, OrientationBinning binning, float* out) {
+    const __m256 iota = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    float lb_lane[8], lv_lane[8], ub_lane[8], uv_lane[8];
+    BinnedGradients binned = classify_gradients_avx2(gx, gy, binning);
+
+    _mm256_storeu_ps(lb_lane, binned.lower_bin);
+    _mm256_storeu_ps(lv_lane, binned.lower_value);
+    if (binning == ORIENTATION_HARD) {
+        for (int j = 0; j < 8; j++) {
+            __m256 hit = _mm256_cmp_ps(iota, _mm256_set1_ps(lb_lane[j]), _CMP_EQ_OQ);
+            _mm256_storeu_ps(out + (size_t)j * ORIENTATION_BINS, _mm256_and_ps(hit, _mm256_set1_ps(lv_lane[j])));
+        }
+        return;
+    }
+
+    _mm256_storeu_ps(ub_lane, binned.upper_bin);
+    _mm256_storeu_ps(uv_lane, binned.upper_value);
+    for (int j = 0; j < 8; j++) {
+        __m256 hit_lower = _mm256_cmp_ps(iota, _mm256_set1_ps(lb_lane[j]), _CMP_EQ_OQ);
+        __m256 hit_upper = _mm256_cmp_ps(iota, _mm256_set1_ps(ub_lane[j]), _CMP_EQ_OQ);
+        _mm256_storeu_ps(out + (size_t)j * ORIENTATION_BINS,
+                         _mm256_or_ps(_mm256_and_ps(hit_lower, _mm256_set1_ps(lv_lane[j])),
+                                      _mm256_and_ps(hit_upper, _mm256_set1_ps(uv_lane[j]))));
+    }
+}
+
+// 内部行每次处理8个像素，返回处理到的位置 (要求视图的像素步长为1)
+__attribute__((target("avx2")))
+static int compute_row_avx2(const GrayView* img, int y, int x0, int x1, OrientationBinning binning,
+                            float* out) {
+    const float* row = img->data + y * img->row_stride;
+    const float* above = row - img->row_stride;
+    const float* below = row + img->row_stride;
+    int x = x0;
+
+    for (; x + 8 <= x1; x += 8) {
+        __m256 gx = _mm256_sub_ps(_mm256_loadu_ps(row + x + 1), _mm256_loadu_ps(row + x - 1));
+        __m256 gy = _mm256_sub_ps(_mm256_loadu_ps(below + x), _mm256_loadu_ps(above + x));
+        bin_gradients_avx2(gx, gy, binning, out + (size_t)x * ORIENTATION_BINS);
+    }
+
+    return x;
+}
+
+// 定点内部行: 每条整数指令处理16个像素的中心差分，缩放为float后分两组分bin
+__attribute__((target("avx2")))
+static int compute_row_gray16_avx2(const Gray16Image* img, int y, int x0, int x1, OrientationBinning binning,
+                                   float* out) {
+    const int16_t* row = img->data + (size_t)y * img->width;
+    const int16_t* above = row - img->width;
+    const int16_t* below = row + img->width;
+    const __m256 scale = _mm256_set1_ps(GRAY16_INV_SCALE);
+    int x = x0;
+
+    for (; x + 16 <= x1; x += 16) {
+        __m256i gx = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)(row + x + 1)),
+                                      _mm256_loadu_si256((const __m256i*)(row + x - 1)));
+        __m256i gy = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)(below + x)),
+                                      _mm256_loadu_si256((const __m256i*)(above + x)));
+
+        for (int h = 0; h < 2; h++) {
+            __m128i gx_half = h ? _mm256_extracti128_si256(gx, 1) : _mm256_castsi256_si128(gx);
+            __m128i gy_half = h ? _mm256_extracti128_si256(gy, 1) : _mm256_castsi256_si128(gy);
+            __m256 fx = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(gx_half)), scale);
+            __m256 fy = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(gy_half)), scale);
+            bin_gradients_avx2(fx, fy, binning, out + (size_t)(x + 8 * h) * ORIENTATION_BINS);
+        }
+    }
+
+    return x;
+}
+
+// 批量版本的一行: 8个通道为8幅图像，bin b 的8个通道直接写成一个向量，无需逐通道分散
+// 边界只改变读取的像素下标，对所有通道相同
+__attribute__((target("avx2")))
+static void compute_batch_row_avx2(const Gray16Batch* gray, int y, OrientationBinning binning, float* out) {
+    const __m256 scale = _mm256_set1_ps(GRAY16_INV_SCALE);
+    BATCH_ROW_POINTERS(gray, y);
+
+    for (int x = 0; x < width; x++, out += BATCH_OUT_STRIDE) {
+        BATCH_PIXEL_POINTERS(x);
+        __m128i gx = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)right), _mm_loadu_si128((const __m128i*)left));
+        __m128i gy = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)down), _mm_loadu_si128((const __m128i*)up));
+        __m256 fx = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(gx)), scale);
+        __m256 fy = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(gy)), scale);
+        BinnedGradients binned = classify_gradients_avx2(fx, fy, binning);
+
+        for (int b = 0; b < ORIENTATION_BINS; b++) {
+            __m256 bin = _mm256_set1_ps((float)b);
+            __m256 value = _mm256_and_ps(_mm256_cmp_ps(binned.lower_bin, bin, _CMP_EQ_OQ), binned.lower_value);
+            if (binning != ORIENTATION_HARD) {
+                value = _mm256_or_ps(value, _mm256_and_ps(_mm256_cmp_ps(binned.upper_bin, bin, _CMP_EQ_OQ),
+                                                          binned.upper_value));
+            }
+            _mm256_storeu_ps(out + b * IMAGE_BATCH_LANES, value);
+        }
+    }
+}
+
+#endif /* ORIENTATION_HAVE_X86 */
+
+static int orientation_use_avx2 = -1;
+
+static int detect_orientation_kernel(void) {
+    if (orientation_use_avx2 < 0) {
+        int use_avx2 = 0;
+#ifdef ORIENTATION_HAVE_X86
+        __builtin_cpu_init();
+        use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+        orientation_use_avx2 = use_avx2;
+    }
+    return orientation_use_avx2;
+}
+
+const char* orientation_kernel_name(void) {
+    return detect_orientation_kernel() ? "avx2" : "scalar";
+}
+
+void compute_orientation_planes_into(const GrayImage* img, OrientationPlanes* planes, OrientationBinning binning) {
+    GrayView view = gray_view(img);
+    compute_orientation_planes_view_into(&view, planes, binning);
+}
+
+void compute_orientation_planes_view_into(const GrayView* img, OrientationPlanes* planes,
+                                          OrientationBinning binning) {
+    TRACE_BEGIN(gradient);
+    int width = img->width;
+    int height = img->height;
+    planes->width = width;
+    planes->height = height;
+
+    for (int y = 0; y < height; y++) {
+        float* out = planes->data + (size_t)y * width * ORIENTATION_BINS;
+
+        // 首末行和首末列需要边界复制，走标量路径
+        if (y == 0 || y == height - 1 || width < 3) {
+            compute_row_scalar(img, y, 0, width, binning, out);
+            continue;
+        }
+
+        int x = 1;
+        compute_row_scalar(img, y, 0, 1, binning, out);
+#ifdef ORIENTATION_HAVE_X86
+        if (img->pixel_stride == 1 && detect_orientation_kernel()) {
+            x = compute_row_avx2(img, y, 1, width - 1, binning, out);
+        }
+#endif
+        compute_row_scalar(img, y, x, width, binning, out);
+    }
+
+    TRACE_END(gradient, TRACE_STAGE_GRADIENT, (size_t)width * height * ORIENTATION_BINS * sizeof(float));
+}
+
+void compute_orientation_planes_gray16_into(const Gray16Image* img, OrientationPlanes* planes,
+                                            OrientationBinning binning) {
+    TRACE_BEGIN(gradient);
+    int width = img->width;
+    int height = img->height;
+    planes->width = width;
+    planes->height = height;
+
+    for (int y = 0; y < height; y++) {
+        float* out = planes->data + (size_t)y * width * ORIENTATION_BINS;
+
+        if (y == 0 || y == height - 1 || width < 3) {
+            compute_row_gray16_scalar(img, y, 0, width, binning, out);
+            continue;
+        }
+
+        int x = 1;
+        compute_row_gray16_scalar(img, y, 0, 1, binning, out);
+#ifdef ORIENTATION_HAVE_X86
+        if (detect_orientation_kernel()) {
+            x = compute_row_gray16_avx2(img, y, 1, width - 1, binning, out);
+        }
+#endif
+        compute_row_gray16_scalar(img, y, x, width, binning, out);
+    }
+
+    TRACE_END(gradient, TRACE_STAGE_GRADIENT, (size_t)width * height * ORIENTATION_BINS * sizeof(float));
+}
+
+OrientationPlanesBatch create_orientation_planes_batch(int width, int height) {
+    OrientationPlanesBatch planes;
+    planes.width = width;
+    planes.height = height;
+    planes.count = 0;
+    planes.data = allocate_float_array(width * height * ORIENTATION_BINS * IMAGE_BATCH_LANES);
+    return planes;
+}
+
+void free_orientation_planes_batch(OrientationPlanesBatch* planes) {
+    if (planes && planes->data) {
+        free_float_array(planes->data);
+        planes->data = NULL;
+        planes->width = 0;
+        planes->height = 0;
+        planes->count = 0;
+    }
+}
+
+static void compute_batch_row_scalar(const Gray16Batch* gray, int y, OrientationBinning binning, float* out) {
+    float bins[ORIENTATION_BINS];
+    BATCH_ROW_POINTERS(gray, y);
+
+    for (int x = 0; x < width; x++, out += BATCH_OUT_STRIDE) {
+        BATCH_PIXEL_POINTERS(x);
+        for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+            int gx = right[lane] - left[lane];
+            int gy = down[lane] - up[lane];
+            bin_gradient((float)gx * GRAY16_INV_SCALE, (float)gy * GRAY16_INV_SCALE, binning, bins);
+            for (int b = 0; b < ORIENTATION_BINS; b++) {
+                out[b * IMAGE_BATCH_LANES + lane] = bins[b];
+            }
+        }
+    }
+}
+
+void compute_orientation_planes_batch_into(const Gray16Batch* gray, OrientationPlanesBatch* planes,
+                                           OrientationBinning binning) {
+    TRACE_BEGIN(gradient);
+    planes->width = gray->width;
+    planes->height = gray->height;
+    planes->count = gray->count;
+
+    for (int y = 0; y < gray->height; y++) {
+        float* out = planes->data + (size_t)y * gray->width * BATCH_OUT_STRIDE;
+#ifdef ORIENTATION_HAVE_X86
+        if (detect_orientation_kernel()) {
+            compute_batch_row_avx2(gray, y, binning, out);
+            continue;
+        }
+#endif
+        compute_batch_row_scalar(gray, y, binning, out);
+    }
+
+    TRACE_END(gradient, TRACE_STAGE_GRADIENT, (size_t)gray->width * gray->height * BATCH_OUT_STRIDE * sizeof(float));
+}
+
+OrientationPlanes compute_orientation_planes(const GrayImage* img, OrientationBinning binning) {
+    OrientationPlanes planes = create_orientation_planes(img->width, img->height);
+    compute_orientation_planes_into(img, &planes, binning);
+    return planes;
+}
@@ -0,0 +1,398 @@
+#define MEMTRACK_TAG MEM_TAG_KMEANS
+#include "packed.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PACKED_HAVE_X86 1
+#endif
+
+// 标量转换
+uint8_t pack_u8(float value) {
+    float scaled = value * PACKED_U8_SCALE;
+    if (scaled <= 0.0f) return 0;
+    if (scaled >= 255.0f) return 255;
+    return (uint8_t)scaled;
+}
+
+float unpack_u8(uint8_t value) {
+    return value / PACKED_U8_SCALE;
+}
+
+// 舍入到最近偶数
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));  // Inf/NaN
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);  // 溢出
+    }
+    if (exponent <= 0) {
+        // 非规格化数
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+            half_mantissa++;
+        }
+        return (uint16_t)(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;  // 进位可能传到指数，结果仍然正确
+    }
+    return (uint16_t)half;
+}
+
+float half_to_float(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    int32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // 规格化非规格化数
+            exponent = 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3ff;
+            bits = sign | ((uint32_t)(exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((uint32_t)(exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// 打包与释放
+PackedDescriptors pack_descriptors(const DescriptorList* descriptors) {
+    PackedDescriptors packed;
+    packed.count = descriptors->count;
+    packed.capacity = descriptors->count;
+    packed.dim = descriptors->count > 0 ? descriptors->descriptors[0].length : 0;
+    packed.data = (uint8_t*)MEM_MALLOC((size_t)packed.count * packed.dim + 1);
+    packed.positions = allocate_float_array(packed.count * 2 + 1);
+
+    if (!packed.data) {
+        fprintf(stderr, "Error: Memory allocation failed for packed descriptors\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < packed.count; i++) {
+        const Descriptor* desc = &descriptors->descriptors[i];
+        uint8_t* row = packed.data + (size_t)i * packed.dim;
+        for (int j = 0; j < packed.dim; j++) {
+            row[j] = pack_u8(desc->data[j]);
+        }
+        packed.positions[i * 2] = desc->x;
+        packed.positions[i * 2 + 1] = desc->y;
+    }
+
+    return packed;
+}
+
+PackedDescriptors create_packed_descriptors(int dim) {
+    PackedDescriptors packed = {NULL, NULL, 0, dim, 0};
+    return packed;
+}
+
+void append_packed_descriptors(PackedDescriptors* packed, const DescriptorList* descriptors) {
+    int needed = packed->count + descriptors->count;
+    if (needed > packed->capacity) {
+        // 容量按倍数增长，逐幅图像追加时总复制量与描述符数成线性关系
+        int capacity = packed->capacity > 0 ? packed->capacity : 1024;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint8_t* data = (uint8_t*)MEM_REALLOC(packed->data, (size_t)capacity * packed->dim);
+        float* positions = (float*)MEM_REALLOC(packed->positions, (size_t)capacity * 2 * sizeof(float));
+        if (!data || !positions) {
+            fprintf(stderr, "Error: Memory allocation failed for packed descriptors\n");
+            exit(EXIT_FAILURE);
+        }
+        packed->data = data;
+        packed->positions = positions;
+        packed->capacity = capacity;
+    }
+
+    for (int i = 0; i < descriptors->count; i++) {
+        const Descriptor* desc = &descriptors->descriptors[i];
+        uint8_t* row = packed->data + (size_t)packed->count * packed->dim;
+        for (int j = 0; j < packed->dim; j++) {
+            row[j] = pack_u8(desc->data[j]);
+        }
+        packed->positions[packed->count * 2] = desc->x;
+        packed->positions[packed->count * 2 + 1] = desc->y;
+        packed->count++;
+    }
+}
+
+void free_packed_descriptors(PackedDescriptors* packed) {
+    if (packed) {
+        MEM_FREE(packed->data);
+        free_float_array(packed->positions);
+        packed->data = NULL;
+        packed->positions = NULL;
+        packed->count = 0;
+        packed->capacity = 0;
+    }
+}
+
+PackedCodebook pack_codebook(const Codebook* codebook, PackedFormat format) {
+    PackedCodebook packed;
+    size_t size = (size_t)codebook->num_clusters * codebook->dim;
+    packed.format = format;
+    packed.num_clusters = codebook->num_clusters;
+    packed.dim = codebook->dim;
+    packed.u8 = NULL;
+    packed.f16 = NULL;
+
+    // 混合格式查找在栈上转换查询向量，维度受 PACKED_MAX_DIM 限制
+    if (codebook->dim > PACKED_MAX_DIM) {
+        fprintf(stderr, "Error: Packed codebook dimension %d exceeds %d\n", codebook->dim, PACKED_MAX_DIM);
+        packed.num_clusters = 0;
+        packed.dim = 0;
+        return packed;
+    }
+
+    if (format == PACKED_U8) {
+        packed.u8 = (uint8_t*)MEM_MALLOC(size + 1);
+    } else {
+        packed.f16 = (uint16_t*)MEM_MALLOC((size + 1) * sizeof(uint16_t));
+    }
+    if (!packed.u8 && !packed.f16) {
+        fprintf(stderr, "Error: Memory allocation failed for packed codebook\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < codebook->num_clusters; i++) {
+        for (int j = 0; j < codebook->dim; j++) {
+            size_t idx = (size_t)i * codebook->dim + j;
+            if (format == PACKED_U8) {
+                packed.u8[idx] = pack_u8(codebook->centers[i][j]);
+            } else {
+                packed.f16[idx] = float_to_half(codebook->centers[i][j]);
+            }
+        }
+    }
+
+    return packed;
+}
+
+void free_packed_codebook(PackedCodebook* packed) {
+    if (packed) {
+        MEM_FREE(packed->u8);
+        MEM_FREE(packed->f16);
+        packed->u8 = NULL;
+        packed->f16 = NULL;
+        packed->num_clusters = 0;
+    }
+}
+
+// 距离内核
+static uint32_t squared_distance_u8_scalar(const uint8_t* a, const uint8_t* b, int dim) {
+    uint32_t sum = 0;
+    for (int i = 0; i < dim; i++) {
+        int diff = (int)a[i] - (int)b[i];
+        sum += (uint32_t)(diff * diff);
+    }
+    return sum;
+}
+
+static float squared_distance_f16_scalar(const float* a, const uint16_t* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        float diff = a[i] - half_to_float(b[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+#ifdef PACKED_HAVE_X86
+
+// 差值扩展到int16后用 PMADDWD 求平方和，结果精确
+__attribute__((target("sse2")))
+static uint32_t squared_distance_u8_sse2(const uint8_t* a, const uint8_t* b, int dim) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 16 <= dim; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+    }
+
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+    uint32_t sum = (uint32_t)_mm_cvtsi128_si32(acc);
+    return sum + squared_distance_u8_scalar(a + i, b + i, dim - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t squared_distance_u8_avx2(const uint8_t* a, const uint8_t* b, int dim) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 16 <= dim; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256i diff = _mm256_sub_epi16(va, vb);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+    }
+
+    __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0x4E));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0xB1));
+    uint32_t sum = (uint32_t)_mm_cvtsi128_si32(sum4);
+    return sum + squared_distance_u8_scalar(a + i, b + i, dim - i);
+}
+
+__attribute__((target("avx2,f16c,fma")))
+static float squared_distance_f16_avx2(const float* a, const uint16_t* b, int dim) {
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+
+    for (; i + 8 <= dim; i += 8) {
+        __m256 vb = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), vb);
+        acc = _mm256_fmadd_ps(diff, diff, acc);
+    }
+
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 0x55));
+    return _mm_cvtss_f32(sum4) + squared_distance_f16_scalar(a + i, b + i, dim - i);
+}
+
+#endif /* PACKED_HAVE_X86 */
+
+// 运行时选择内核
+typedef enum {
+    PACKED_KERNEL_UNKNOWN = 0,
+    PACKED_KERNEL_SCALAR,
+    PACKED_KERNEL_SSE2,
+    PACKED_KERNEL_AVX2,
+    PACKED_KERNEL_AVX2_F16C
+} PackedKernel;
+
+static PackedKernel packed_kernel = PACKED_KERNEL_UNKNOWN;
+
+static PackedKernel detect_packed_kernel(void) {
+    if (packed_kernel == PACKED_KERNEL_UNKNOWN) {
+        PackedKernel kernel = PACKED_KERNEL_SCALAR;
+#ifdef PACKED_HAVE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernel = __builtin_cpu_supports("f16c") ? PACKED_KERNEL_AVX2_F16C : PACKED_KERNEL_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            kernel = PACKED_KERNEL_SSE2;
+        }
+#endif
+        packed_kernel = kernel;
+    }
+    return packed_kernel;
+}
+
+const char* packed_kernel_name(void) {
+    switch (detect_packed_kernel()) {
+        case PACKED_KERNEL_AVX2_F16C: return "avx2+f16c";
+        case PACKED_KERNEL_AVX2: return "avx2";
+        case PACKED_KERNEL_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+uint32_t squared_distance_u8(const uint8_t* a, const uint8_t* b, int dim) {
+#ifdef PACKED_HAVE_X86
+    switch (detect_packed_kernel()) {
+        case PACKED_KERNEL_AVX2_F16C:
+        case PACKED_KERNEL_AVX2: return squared_distance_u8_avx2(a, b, dim);
+        case PACKED_KERNEL_SSE2: return squared_distance_u8_sse2(a, b, dim);
+        default: break;
+    }
+#endif
+    return squared_distance_u8_scalar(a, b, dim);
+}
+
+float squared_distance_f16(const float* a, const uint16_t* b, int dim) {
+#ifdef PACKED_HAVE_X86
+    if (detect_packed_kernel() == PACKED_KERNEL_AVX2_F16C) {
+        return squared_distance_f16_avx2(a, b, dim);
+    }
+#endif
+    return squared_distance_f16_scalar(a, b, dim);
+}
+
+// 最近中心查找
+int find_nearest_center_u8(const uint8_t* desc, const PackedCodebook* codebook) {
+    int best_center = 0;
+
+    if (codebook->format == PACKED_U8) {
+        uint32_t min_dist = UINT32_MAX;
+        for (int i = 0; i < codebook->num_clusters; i++) {
+            uint32_t dist = squared_distance_u8(desc, codebook->u8 + (size_t)i * codebook->dim, codebook->dim);
+            if (dist < min_dist) {
+                min_dist = dist;
+                best_center = i;
+            }
+        }
+        return best_center;
+    }
+
+    // float16码本: 先把描述符解包为float
+    float unpacked[PACKED_MAX_DIM];
+    for (int j = 0; j < codebook->dim; j++) {
+        unpacked[j] = unpack_u8(desc[j]);
+    }
+    return find_nearest_center_packed(unpacked, codebook);
+}
+
+int find_nearest_center_packed(const float* desc, const PackedCodebook* codebook) {
+    int best_center = 0;
+
+    if (codebook->format == PACKED_F16) {
+        float min_dist = FLT_MAX;
+        for (int i = 0; i < codebook->num_clusters; i++) {
+            float dist = squared_distance_f16(desc, codebook->f16 + (size_t)i * codebook->dim, codebook->dim);
+            if (dist < min_dist) {
+                min_dist = dist;
+                best_center = i;
+            }
+        }
+        return best_center;
+    }
+
+    // uint8码本: 先把描述符打包
+    uint8_t packed[PACKED_MAX_DIM];
+    for (int j = 0; j < codebook->dim; j++) {
+        packed[j] = pack_u8(desc[j]);
+    }
+    return find_nearest_center_u8(packed, codebook);
+}
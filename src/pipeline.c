@@ -0,0 +1,388 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#include "pipeline.h"
+#include "sift.h"
+#include "cache.h"
+#include "cascade.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define QUEUE_SPIN_LIMIT 64       // 让出CPU若干次后转为短暂休眠
+#define QUEUE_SLEEP_NS 50000
+
+static uint64_t pipeline_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void queue_backoff(int* spins) {
+    if (++(*spins) < QUEUE_SPIN_LIMIT) {
+        sched_yield();
+    } else {
+        struct timespec ts = {0, QUEUE_SLEEP_NS};
+        nanosleep(&ts, NULL);
+    }
+}
+
+// 有界MPMC队列
+BoundedQueue* create_bounded_queue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    BoundedQueue* queue = (BoundedQueue*)MEM_CALLOC(1, sizeof(BoundedQueue));
+    if (!queue) {
+        fprintf(stderr, "Error: Memory allocation failed for queue\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue->cells = (QueueCell*)MEM_MALLOC(size * sizeof(QueueCell));
+    if (!queue->cells) {
+        fprintf(stderr, "Error: Memory allocation failed for queue cells\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].data = NULL;
+    }
+
+    queue->mask = size - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->closed, 0);
+    return queue;
+}
+
+void free_bounded_queue(BoundedQueue* queue) {
+    if (queue) {
+        MEM_FREE(queue->cells);
+        MEM_FREE(queue);
+    }
+}
+
+int queue_try_push(BoundedQueue* queue, void* data) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        QueueCell* cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->data = data;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // 队列已满
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+int queue_try_pop(BoundedQueue* queue, void** data) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+    for (;;) {
+        QueueCell* cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *data = cell->data;
+                atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // 队列为空
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t queue_push(BoundedQueue* queue, void* data) {
+    if (queue_try_push(queue, data)) {
+        return 0;
+    }
+
+    uint64_t start = pipeline_now_ns();
+    int spins = 0;
+    while (!queue_try_push(queue, data)) {
+        queue_backoff(&spins);
+    }
+    return pipeline_now_ns() - start;
+}
+
+int queue_pop(BoundedQueue* queue, void** data, uint64_t* waited_ns) {
+    if (queue_try_pop(queue, data)) {
+        return 1;
+    }
+
+    uint64_t start = pipeline_now_ns();
+    int spins = 0;
+    int result = 0;
+
+    for (;;) {
+        if (queue_try_pop(queue, data)) {
+            result = 1;
+            break;
+        }
+        // 关闭后再检查一次，避免错过关闭前最后写入的元素
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+            result = queue_try_pop(queue, data);
+            break;
+        }
+        queue_backoff(&spins);
+    }
+
+    if (waited_ns) {
+        *waited_ns += pipeline_now_ns() - start;
+    }
+    return result;
+}
+
+void queue_close(BoundedQueue* queue) {
+    atomic_store_explicit(&queue->closed, 1, memory_order_release);
+}
+
+void free_pipeline_item(PipelineItem* item) {
+    if (item) {
+        free_image(&item->image);
+        free_descriptor_list(&item->descriptors);
+        MEM_FREE(item->words);
+        free_spm_histogram(&item->histogram);
+        free_spm_histogram(&item->coarse);
+        MEM_FREE(item);
+    }
+}
+
+// 阶段工作线程
+typedef struct {
+    PipelineStage* stage;
+    BoundedQueue* input;
+    BoundedQueue* output;
+    atomic_int* remaining;   // 本阶段尚未退出的线程数
+} StageWorker;
+
+static void* stage_worker_main(void* arg) {
+    StageWorker* worker = (StageWorker*)arg;
+    PipelineStage* stage = worker->stage;
+    uint64_t busy = 0, starved = 0, blocked = 0;
+    long items = 0;
+    void* data;
+
+    while (queue_pop(worker->input, &data, &starved)) {
+        PipelineItem* item = (PipelineItem*)data;
+
+        uint64_t start = pipeline_now_ns();
+        int keep = stage->fn(item, stage->ctx);
+        busy += pipeline_now_ns() - start;
+        items++;
+
+        if (keep) {
+            blocked += queue_push(worker->output, item);
+        } else {
+            free_pipeline_item(item);
+        }
+    }
+
+    atomic_fetch_add(&stage->items, items);
+    atomic_fetch_add(&stage->busy_ns, busy);
+    atomic_fetch_add(&stage->starved_ns, starved);
+    atomic_fetch_add(&stage->blocked_ns, blocked);
+
+    // 最后一个退出的线程关闭下游队列
+    if (atomic_fetch_sub(worker->remaining, 1) == 1) {
+        queue_close(worker->output);
+    }
+    return NULL;
+}
+
+// 数据源线程: 按序号生成样本
+typedef struct {
+    BoundedQueue* output;
+    int num_items;
+} FeederArgs;
+
+static void* feeder_main(void* arg) {
+    FeederArgs* args = (FeederArgs*)arg;
+
+    for (int i = 0; i < args->num_items; i++) {
+        PipelineItem* item = (PipelineItem*)MEM_CALLOC(1, sizeof(PipelineItem));
+        if (!item) {
+            fprintf(stderr, "Error: Memory allocation failed for pipeline item\n");
+            exit(EXIT_FAILURE);
+        }
+        item->index = i;
+        queue_push(args->output, item);
+    }
+
+    queue_close(args->output);
+    return NULL;
+}
+
+double run_pipeline(PipelineStage* stages, int num_stages, int num_items, int queue_capacity,
+                    PipelineSinkFn sink, void* sink_ctx) {
+    uint64_t start = pipeline_now_ns();
+
+    // queues[i] 是第i个阶段的输入，queues[num_stages] 交给 sink
+    BoundedQueue** queues = (BoundedQueue**)MEM_MALLOC((num_stages + 1) * sizeof(BoundedQueue*));
+    atomic_int* remaining = (atomic_int*)MEM_MALLOC(num_stages * sizeof(atomic_int));
+    int total_threads = 0;
+
+    for (int i = 0; i <= num_stages; i++) {
+        queues[i] = create_bounded_queue(queue_capacity);
+    }
+    for (int i = 0; i < num_stages; i++) {
+        if (stages[i].num_threads < 1) stages[i].num_threads = 1;
+        atomic_init(&remaining[i], stages[i].num_threads);
+        total_threads += stages[i].num_threads;
+    }
+
+    StageWorker* workers = (StageWorker*)MEM_MALLOC(total_threads * sizeof(StageWorker));
+    pthread_t* threads = (pthread_t*)MEM_MALLOC(total_threads * sizeof(pthread_t));
+
+    int t = 0;
+    for (int i = 0; i < num_stages; i++) {
+        for (int j = 0; j < stages[i].num_threads; j++, t++) {
+            workers[t].stage = &stages[i];
+            workers[t].input = queues[i];
+            workers[t].output = queues[i + 1];
+            workers[t].remaining = &remaining[i];
+            pthread_create(&threads[t], NULL, stage_worker_main, &workers[t]);
+        }
+    }
+
+    FeederArgs feeder_args = {queues[0], num_items};
+    pthread_t feeder;
+    pthread_create(&feeder, NULL, feeder_main, &feeder_args);
+
+    // 在调用线程上汇聚结果
+    void* data;
+    while (queue_pop(queues[num_stages], &data, NULL)) {
+        sink((PipelineItem*)data, sink_ctx);
+    }
+
+    pthread_join(feeder, NULL);
+    for (int i = 0; i < total_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i <= num_stages; i++) {
+        free_bounded_queue(queues[i]);
+    }
+    MEM_FREE(queues);
+    MEM_FREE(remaining);
+    MEM_FREE(workers);
+    MEM_FREE(threads);
+
+    return (pipeline_now_ns() - start) / 1e9;
+}
+
+void print_pipeline_stats(const PipelineStage* stages, int num_stages, double wall_seconds) {
+    printf("%-10s %8s %8s %10s %10s %10s\n", "stage", "threads", "items", "busy", "starved", "blocked");
+    for (int i = 0; i < num_stages; i++) {
+        double capacity = wall_seconds * 1e9 * stages[i].num_threads;
+        if (capacity <= 0) capacity = 1.0;
+        printf("%-10s %8d %8ld %9.1f%% %9.1f%% %9.1f%%\n", stages[i].name, stages[i].num_threads,
+               (long)atomic_load(&stages[i].items),
+               100.0 * atomic_load(&stages[i].busy_ns) / capacity,
+               100.0 * atomic_load(&stages[i].starved_ns) / capacity,
+               100.0 * atomic_load(&stages[i].blocked_ns) / capacity);
+    }
+}
+
+// 标准阶段
+int pipeline_stage_decode(PipelineItem* item, void* ctx) {
+    PipelineContext* context = (PipelineContext*)ctx;
+    if (item->index < 0 || item->index >= context->num_records) {
+        return 0;
+    }
+
+    const unsigned char* record = context->records + (size_t)item->index * CIFAR_RECORD_SIZE;
+    item->label = record[0];
+    item->image = decode_cifar_record(record);
+    return 1;
+}
+
+int pipeline_stage_sift(PipelineItem* item, void* ctx) {
+    PipelineContext* context = (PipelineContext*)ctx;
+
+    if (context->cache) {
+        uint64_t key = feature_cache_sift_key(&item->image, context->step);
+        if (!feature_cache_get_sift(context->cache, key, &item->descriptors)) {
+            item->descriptors = extract_dense_sift(&item->image, context->step);
+            feature_cache_put_sift(context->cache, key, &item->descriptors);
+        }
+        return 1;
+    }
+
+    item->descriptors = extract_dense_sift(&item->image, context->step);
+    return 1;
+}
+
+int pipeline_stage_quantize(PipelineItem* item, void* ctx) {
+    PipelineContext* context = (PipelineContext*)ctx;
+
+    item->words = (int*)MEM_MALLOC((item->descriptors.count + 1) * sizeof(int));
+    if (!item->words) {
+        fprintf(stderr, "Error: Memory allocation failed for visual words\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < item->descriptors.count; i++) {
+        item->words[i] = find_nearest_center(item->descriptors.descriptors[i].data, context->codebook);
+    }
+    return 1;
+}
+
+int pipeline_stage_pyramid(PipelineItem* item, void* ctx) {
+    PipelineContext* context = (PipelineContext*)ctx;
+    int num_clusters = context->codebook->num_clusters;
+
+    item->histogram.length = spm_histogram_length(num_clusters, context->level);
+    item->histogram.histogram = allocate_float_array(item->histogram.length);
+
+    if (item->descriptors.count > 0) {
+        float inv_count = 1.0f / (float)item->descriptors.count;
+        for (int i = 0; i < item->descriptors.count; i++) {
+            const Descriptor* desc = &item->descriptors.descriptors[i];
+            spm_accumulate_word(item->histogram.histogram, num_clusters, context->level, item->words[i],
+                                desc->x, desc->y, item->image.width, item->image.height, inv_count);
+        }
+    }
+
+    if (context->cascade) {
+        item->coarse.length = cascade_feature_length(num_clusters, context->level);
+        item->coarse.histogram = allocate_float_array(item->coarse.length);
+
+        int num_coarse = 0;
+        for (int i = 0; i < item->descriptors.count; i++) {
+            const Descriptor* desc = &item->descriptors.descriptors[i];
+            num_coarse += dense_grid_is_coarse((int)desc->x, (int)desc->y, context->step, CASCADE_COARSE_STRIDE);
+        }
+        for (int i = 0; i < item->descriptors.count && num_coarse > 0; i++) {
+            const Descriptor* desc = &item->descriptors.descriptors[i];
+            if (dense_grid_is_coarse((int)desc->x, (int)desc->y, context->step, CASCADE_COARSE_STRIDE)) {
+                cascade_accumulate_word(item->coarse.histogram, num_clusters, context->level, item->words[i],
+                                        desc->x, desc->y, item->image.width, item->image.height,
+                                        1.0f / (float)num_coarse);
+            }
+        }
+    }
+
+    // 后续阶段只需要直方图
+    free_descriptor_list(&item->descriptors);
+    MEM_FREE(item->words);
+    item->words = NULL;
+    return 1;
+}
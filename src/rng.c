@@ -0,0 +1,335 @@
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#include "rng.h"
+#include "memtrack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RNG_HAVE_X86 1
+#endif
+
+#define RNG_BULK_CHUNK 256   // 批量转换时的缓冲区大小 (u64个数)
+
+static uint64_t default_seed = RNG_DEFAULT_SEED;
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    uint64_t state = seed;
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&state);
+    }
+}
+
+Rng rng_create(uint64_t seed) {
+    Rng rng;
+    rng_seed(&rng, seed);
+    return rng;
+}
+
+Rng rng_create_stream(uint64_t seed, int stream) {
+    Rng rng = rng_create(seed);
+    for (int i = 0; i < stream; i++) {
+        rng_jump(&rng);
+    }
+    return rng;
+}
+
+uint64_t rng_next_u64(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+void rng_jump(Rng* rng) {
+    static const uint64_t JUMP[] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                    0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (JUMP[i] & (1ULL << b)) {
+                s0 ^= rng->s[0];
+                s1 ^= rng->s[1];
+                s2 ^= rng->s[2];
+                s3 ^= rng->s[3];
+            }
+            rng_next_u64(rng);
+        }
+    }
+
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
+
+void rng_split(Rng* rng, Rng* child) {
+    *child = *rng;
+    rng_jump(rng);
+}
+
+uint32_t rng_next_u32(Rng* rng) {
+    return (uint32_t)(rng_next_u64(rng) >> 32);
+}
+
+float rng_uniform_float(Rng* rng) {
+    return (float)(rng_next_u64(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+double rng_uniform_double(Rng* rng) {
+    return (double)(rng_next_u64(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint32_t rng_bounded(Rng* rng, uint32_t bound) {
+    uint64_t m = (uint64_t)rng_next_u32(rng) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = (uint32_t)(-bound) % bound;
+        while (low < threshold) {
+            m = (uint64_t)rng_next_u32(rng) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+int rng_range_int(Rng* rng, int min, int max) {
+    return min + (int)rng_bounded(rng, (uint32_t)(max - min) + 1u);
+}
+
+// 批量生成: 子流 l 的第 b 个输出写入 out[b * RNG_BULK_LANES + l]
+// 子流状态按结构体数组存放: lanes[w * RNG_BULK_LANES + l] 为子流 l 的第 w 个状态字
+static void bulk_scalar(uint64_t* lanes, uint64_t* out, size_t blocks) {
+    for (size_t b = 0; b < blocks; b++) {
+        for (int l = 0; l < RNG_BULK_LANES; l++) {
+            Rng lane = {{lanes[l], lanes[RNG_BULK_LANES + l], lanes[2 * RNG_BULK_LANES + l],
+                         lanes[3 * RNG_BULK_LANES + l]}};
+            out[b * RNG_BULK_LANES + l] = rng_next_u64(&lane);
+            for (int w = 0; w < 4; w++) {
+                lanes[w * RNG_BULK_LANES + l] = lane.s[w];
+            }
+        }
+    }
+}
+
+#ifdef RNG_HAVE_X86
+
+// AVX2没有64位乘法，乘5和乘9用移位加法代替
+__attribute__((target("avx2")))
+static void bulk_avx2(uint64_t* lanes, uint64_t* out, size_t blocks) {
+    __m256i s0 = _mm256_loadu_si256((const __m256i*)(lanes + 0 * RNG_BULK_LANES));
+    __m256i s1 = _mm256_loadu_si256((const __m256i*)(lanes + 1 * RNG_BULK_LANES));
+    __m256i s2 = _mm256_loadu_si256((const __m256i*)(lanes + 2 * RNG_BULK_LANES));
+    __m256i s3 = _mm256_loadu_si256((const __m256i*)(lanes + 3 * RNG_BULK_LANES));
+
+    for (size_t b = 0; b < blocks; b++) {
+        __m256i x5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        __m256i r = _mm256_or_si256(_mm256_slli_epi64(x5, 7), _mm256_srli_epi64(x5, 57));
+        __m256i result = _mm256_add_epi64(_mm256_slli_epi64(r, 3), r);
+        _mm256_storeu_si256((__m256i*)(out + b * RNG_BULK_LANES), result);
+
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+    }
+
+    _mm256_storeu_si256((__m256i*)(lanes + 0 * RNG_BULK_LANES), s0);
+    _mm256_storeu_si256((__m256i*)(lanes + 1 * RNG_BULK_LANES), s1);
+    _mm256_storeu_si256((__m256i*)(lanes + 2 * RNG_BULK_LANES), s2);
+    _mm256_storeu_si256((__m256i*)(lanes + 3 * RNG_BULK_LANES), s3);
+}
+
+#endif /* RNG_HAVE_X86 */
+
+static int rng_use_avx2 = -1;
+
+static int detect_rng_kernel(void) {
+    if (rng_use_avx2 < 0) {
+        int use_avx2 = 0;
+#ifdef RNG_HAVE_X86
+        __builtin_cpu_init();
+        use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+        rng_use_avx2 = use_avx2;
+    }
+    return rng_use_avx2;
+}
+
+const char* rng_kernel_name(void) {
+    return detect_rng_kernel() ? "avx2" : "scalar";
+}
+
+static void bulk_blocks(uint64_t* lanes, uint64_t* out, size_t blocks) {
+#ifdef RNG_HAVE_X86
+    if (detect_rng_kernel()) {
+        bulk_avx2(lanes, out, blocks);
+        return;
+    }
+#endif
+    bulk_scalar(lanes, out, blocks);
+}
+
+// 子流由 rng 的输出重新播种，rng 前进 RNG_BULK_LANES 步
+static void init_bulk_lanes(Rng* rng, uint64_t* lanes) {
+    for (int l = 0; l < RNG_BULK_LANES; l++) {
+        Rng lane = rng_create(rng_next_u64(rng));
+        for (int w = 0; w < 4; w++) {
+            lanes[w * RNG_BULK_LANES + l] = lane.s[w];
+        }
+    }
+}
+
+// 写满 out[0, count)，末尾不足一组时多生成一组并丢弃多余的值
+static void bulk_generate(uint64_t* lanes, uint64_t* out, size_t count) {
+    size_t full = count / RNG_BULK_LANES;
+    bulk_blocks(lanes, out, full);
+    if (count % RNG_BULK_LANES) {
+        uint64_t tail[RNG_BULK_LANES];
+        bulk_blocks(lanes, tail, 1);
+        memcpy(out + full * RNG_BULK_LANES, tail, (count % RNG_BULK_LANES) * sizeof(uint64_t));
+    }
+}
+
+void rng_fill_u64(Rng* rng, uint64_t* out, size_t count) {
+    uint64_t lanes[4 * RNG_BULK_LANES];
+    init_bulk_lanes(rng, lanes);
+    bulk_generate(lanes, out, count);
+}
+
+// 每个u64拆成两个24位尾数
+void rng_fill_uniform(Rng* rng, float* out, size_t count) {
+    uint64_t lanes[4 * RNG_BULK_LANES];
+    uint64_t buffer[RNG_BULK_CHUNK];
+    init_bulk_lanes(rng, lanes);
+
+    for (size_t i = 0; i < count; i += 2 * RNG_BULK_CHUNK) {
+        size_t n = count - i < 2 * RNG_BULK_CHUNK ? count - i : 2 * RNG_BULK_CHUNK;
+        size_t words = (n + 1) / 2;
+        bulk_generate(lanes, buffer, words);
+        for (size_t j = 0; j < n; j++) {
+            uint64_t x = buffer[j / 2];
+            uint32_t bits = (j & 1) ? (uint32_t)(x >> 8) & 0xFFFFFFu : (uint32_t)(x >> 40);
+            out[i + j] = (float)bits * (1.0f / 16777216.0f);
+        }
+    }
+}
+
+// 每个u64拆成两个u32，按Lemire方法映射；需要拒绝时改由 rng 补抽，保证无偏
+void rng_fill_bounded(Rng* rng, uint32_t* out, size_t count, uint32_t bound) {
+    uint64_t lanes[4 * RNG_BULK_LANES];
+    uint64_t buffer[RNG_BULK_CHUNK];
+    if (bound == 0) {
+        memset(out, 0, count * sizeof(uint32_t));
+        return;
+    }
+    uint32_t threshold = (uint32_t)(-bound) % bound;
+    init_bulk_lanes(rng, lanes);
+
+    for (size_t i = 0; i < count; i += 2 * RNG_BULK_CHUNK) {
+        size_t n = count - i < 2 * RNG_BULK_CHUNK ? count - i : 2 * RNG_BULK_CHUNK;
+        size_t words = (n + 1) / 2;
+        bulk_generate(lanes, buffer, words);
+        for (size_t j = 0; j < n; j++) {
+            uint64_t x = buffer[j / 2];
+            uint32_t r = (j & 1) ? (uint32_t)x : (uint32_t)(x >> 32);
+            uint64_t m = (uint64_t)r * bound;
+            while ((uint32_t)m < threshold) {
+                m = (uint64_t)rng_next_u32(rng) * bound;
+            }
+            out[i + j] = (uint32_t)(m >> 32);
+        }
+    }
+}
+
+void rng_shuffle_int(Rng* rng, int* values, int count) {
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int)rng_bounded(rng, (uint32_t)i + 1u);
+        int tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+// 已选下标的开放寻址哈希集合，槽位存放 下标+1 (0表示空槽)，容量为不小于 2k 的2的幂
+static int sample_set_insert(int* slots, uint32_t mask, int value) {
+    uint32_t i = ((uint32_t)value * 0x9E3779B1u) & mask;
+    while (slots[i] != 0) {
+        if (slots[i] == value + 1) {
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+    slots[i] = value + 1;
+    return 1;
+}
+
+int rng_sample_indices(Rng* rng, int n, int k, int* out) {
+    if (k < 0 || k > n) {
+        fprintf(stderr, "Error: Cannot sample %d distinct indices from %d\n", k, n);
+        return 0;
+    }
+
+    uint32_t capacity = 16;
+    while (capacity < 2u * (uint32_t)k) {
+        capacity <<= 1;
+    }
+    int* slots = (int*)MEM_CALLOC(capacity, sizeof(int));
+    if (!slots) {
+        fprintf(stderr, "Error: Memory allocation failed for sample indices\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Floyd: 对 j = n-k .. n-1 抽取 t∈[0,j]，若已被选中则取 j (j 此前不可能被选中)
+    int count = 0;
+    for (int j = n - k; j < n; j++) {
+        int t = (int)rng_bounded(rng, (uint32_t)j + 1u);
+        int pick = t;
+        if (!sample_set_insert(slots, capacity - 1, t)) {
+            pick = j;
+            sample_set_insert(slots, capacity - 1, j);
+        }
+        out[count++] = pick;
+    }
+
+    MEM_FREE(slots);
+    return 1;
+}
+
+uint64_t rng_hash(uint64_t seed, uint64_t a, uint64_t b) {
+    uint64_t state = seed ^ rotl(a * 0x9E3779B97F4A7C15ULL, 17);
+    state = splitmix64(&state) ^ b;
+    return splitmix64(&state);
+}
+
+void rng_set_default_seed(uint64_t seed) {
+    default_seed = seed;
+}
+
+uint64_t rng_default_seed(void) {
+    return default_seed;
+}
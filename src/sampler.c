@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_KMEANS
+#include "sampler.h"
+#include "sift.h"
+#include "rng.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+void reservoir_init(Reservoir* reservoir, int capacity, int dim) {
+    memset(reservoir, 0, sizeof(Reservoir));
+    reservoir->capacity = capacity > 0 ? capacity : 0;
+    reservoir->dim = dim;
+}
+
+void reservoir_free(Reservoir* reservoir) {
+    if (reservoir) {
+        MEM_FREE(reservoir->rows);
+        MEM_FREE(reservoir->keys);
+        MEM_FREE(reservoir->heap);
+        reservoir->rows = NULL;
+        reservoir->keys = NULL;
+        reservoir->heap = NULL;
+        reservoir->rows_allocated = 0;
+        reservoir->count = 0;
+    }
+}
+
+// 样本未满时按需扩容
+static void reservoir_grow(Reservoir* reservoir) {
+    int rows = reservoir->rows_allocated ? reservoir->rows_allocated * 2 : 256;
+    if (rows > reservoir->capacity) rows = reservoir->capacity;
+
+    float* grown_rows = (float*)MEM_REALLOC(reservoir->rows, (size_t)rows * reservoir->dim * sizeof(float));
+    uint64_t* grown_keys = (uint64_t*)MEM_REALLOC(reservoir->keys, rows * sizeof(uint64_t));
+    int* grown_heap = (int*)MEM_REALLOC(reservoir->heap, rows * sizeof(int));
+    if (!grown_rows || !grown_keys || !grown_heap) {
+        fprintf(stderr, "Error: Memory allocation failed for descriptor reservoir\n");
+        exit(EXIT_FAILURE);
+    }
+    reservoir->rows = grown_rows;
+    reservoir->keys = grown_keys;
+    reservoir->heap = grown_heap;
+    reservoir->rows_allocated = rows;
+}
+
+static void sift_up(Reservoir* reservoir, int pos) {
+    int* heap = reservoir->heap;
+    const uint64_t* keys = reservoir->keys;
+    int slot = heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (keys[heap[parent]] >= keys[slot]) break;
+        heap[pos] = heap[parent];
+        pos = parent;
+    }
+    heap[pos] = slot;
+}
+
+static void sift_down(Reservoir* reservoir, int pos) {
+    int* heap = reservoir->heap;
+    const uint64_t* keys = reservoir->keys;
+    int count = reservoir->count;
+    int slot = heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= count) break;
+        if (child + 1 < count && keys[heap[child + 1]] > keys[heap[child]]) child++;
+        if (keys[heap[child]] <= keys[slot]) break;
+        heap[pos] = heap[child];
+        pos = child;
+    }
+    heap[pos] = slot;
+}
+
+void reservoir_offer(Reservoir* reservoir, uint64_t key, const float* row) {
+    reservoir->seen++;
+    if (reservoir->capacity == 0) {
+        return;
+    }
+
+    int slot;
+    if (reservoir->count < reservoir->capacity) {
+        if (reservoir->count == reservoir->rows_allocated) {
+            reservoir_grow(reservoir);
+        }
+        slot = reservoir->count;
+        reservoir->keys[slot] = key;
+        reservoir->heap[reservoir->count++] = slot;
+        sift_up(reservoir, reservoir->count - 1);
+    } else {
+        // 已满: 只有键小于堆顶 (当前最大键) 时才替换
+        slot = reservoir->heap[0];
+        if (key >= reservoir->keys[slot]) {
+            return;
+        }
+        reservoir->keys[slot] = key;
+        sift_down(reservoir, 0);
+    }
+    memcpy(reservoir->rows + (size_t)slot * reservoir->dim, row, reservoir->dim * sizeof(float));
+}
+
+void reservoir_merge(Reservoir* into, const Reservoir* other) {
+    int64_t seen = into->seen;
+    for (int i = 0; i < other->count; i++) {
+        reservoir_offer(into, other->keys[i], other->rows + (size_t)i * other->dim);
+    }
+    into->seen = seen + other->seen;
+}
+
+DescriptorSampler* descriptor_sampler_create(const SamplerOptions* options, int dim) {
+    DescriptorSampler* sampler = (DescriptorSampler*)MEM_CALLOC(1, sizeof(DescriptorSampler));
+    if (!sampler) {
+        fprintf(stderr, "Error: Memory allocation failed for descriptor sampler\n");
+        exit(EXIT_FAILURE);
+    }
+    sampler->options = *options;
+    if (sampler->options.num_strata < 1) sampler->options.num_strata = 1;
+    if (sampler->options.num_threads < 1) sampler->options.num_threads = 1;
+    sampler->dim = dim;
+
+    // 预算不能整除时余数分给前面的层，各层容量之和恰好为 budget
+    int num_strata = sampler->options.num_strata;
+    int num_reservoirs = sampler->options.num_threads * num_strata;
+    int per_stratum = sampler->options.budget / num_strata;
+    int remainder = sampler->options.budget % num_strata;
+    sampler->reservoirs = (Reservoir*)MEM_CALLOC(num_reservoirs, sizeof(Reservoir));
+    for (int i = 0; i < num_reservoirs; i++) {
+        int stratum = i % num_strata;
+        reservoir_init(&sampler->reservoirs[i], per_stratum + (stratum < remainder), dim);
+    }
+    return sampler;
+}
+
+void descriptor_sampler_free(DescriptorSampler* sampler) {
+    if (!sampler) {
+        return;
+    }
+    for (int i = 0; i < sampler->options.num_threads * sampler->options.num_strata; i++) {
+        reservoir_free(&sampler->reservoirs[i]);
+    }
+    MEM_FREE(sampler->reservoirs);
+    MEM_FREE(sampler);
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+void descriptor_sampler_offer(DescriptorSampler* sampler, int thread, int stratum, int64_t item,
+                              const DescriptorList* descriptors) {
+    int num_strata = sampler->options.num_strata;
+    // 负的分层号同样映射到 [0, num_strata)
+    int index = ((stratum % num_strata) + num_strata) % num_strata;
+    Reservoir* reservoir = &sampler->reservoirs[thread * num_strata + index];
+    int count = descriptors->count;
+    if (count == 0) {
+        return;
+    }
+
+    uint64_t* keys = (uint64_t*)MEM_MALLOC(count * sizeof(uint64_t));
+    for (int i = 0; i < count; i++) {
+        keys[i] = rng_hash(sampler->options.seed, (uint64_t)item, (uint64_t)i);
+    }
+
+    // 图像内配额: 只保留本图像中键最小的 quota 个 (仍是图像内的均匀抽样)
+    uint64_t threshold = UINT64_MAX;
+    int quota = sampler->options.per_image_quota;
+    if (quota > 0 && count > quota) {
+        uint64_t* sorted = (uint64_t*)MEM_MALLOC(count * sizeof(uint64_t));
+        memcpy(sorted, keys, count * sizeof(uint64_t));
+        qsort(sorted, count, sizeof(uint64_t), compare_keys);
+        threshold = sorted[quota - 1];
+        MEM_FREE(sorted);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (keys[i] <= threshold) {
+            reservoir_offer(reservoir, keys[i], descriptors->descriptors[i].data);
+        }
+    }
+    MEM_FREE(keys);
+}
+
+typedef struct {
+    uint64_t key;
+    int slot;
+} KeySlot;
+
+static int compare_key_slots(const void* a, const void* b) {
+    return compare_keys(&((const KeySlot*)a)->key, &((const KeySlot*)b)->key);
+}
+
+DescriptorList descriptor_sampler_finish(DescriptorSampler* sampler) {
+    int num_threads = sampler->options.num_threads;
+    int num_strata = sampler->options.num_strata;
+    DescriptorList list = create_descriptor_list(sampler->options.budget);
+
+    for (int s = 0; s < num_strata; s++) {
+        Reservoir* merged = &sampler->reservoirs[s];
+        for (int t = 1; t < num_threads; t++) {
+            reservoir_merge(merged, &sampler->reservoirs[t * num_strata + s]);
+        }
+
+        // 按键排序，使输出顺序与提交顺序无关
+        KeySlot* order = (KeySlot*)MEM_MALLOC((merged->count > 0 ? merged->count : 1) * sizeof(KeySlot));
+        for (int i = 0; i < merged->count; i++) {
+            order[i].key = merged->keys[i];
+            order[i].slot = i;
+        }
+        qsort(order, merged->count, sizeof(KeySlot), compare_key_slots);
+
+        for (int i = 0; i < merged->count; i++) {
+            Descriptor desc = create_descriptor(sampler->dim);
+            memcpy(desc.data, merged->rows + (size_t)order[i].slot * sampler->dim, sampler->dim * sizeof(float));
+            add_descriptor(&list, desc);
+        }
+        MEM_FREE(order);
+    }
+    return list;
+}
+
+int sampler_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+typedef struct {
+    DescriptorSampler* sampler;
+    const Image* images;
+    const int* strata;
+    int num_images;
+    int step;
+    atomic_int next_image;
+} SampleJob;
+
+typedef struct {
+    SampleJob* job;
+    int thread;
+} SampleWorker;
+
+static void* sample_worker_main(void* arg) {
+    SampleWorker* worker = (SampleWorker*)arg;
+    SampleJob* job = worker->job;
+
+    for (;;) {
+        int i = atomic_fetch_add(&job->next_image, 1);
+        if (i >= job->num_images) {
+            break;
+        }
+        DescriptorList descriptors = extract_dense_sift(&job->images[i], job->step);
+        descriptor_sampler_offer(job->sampler, worker->thread, job->strata ? job->strata[i] : 0, i, &descriptors);
+        free_descriptor_list(&descriptors);
+    }
+    return NULL;
+}
+
+DescriptorList sample_dense_sift(const Image* images, int num_images, const int* strata, int step,
+                                 const SamplerOptions* options) {
+    DescriptorSampler* sampler = descriptor_sampler_create(options, SIFT_DESC_SIZE);
+    int num_threads = sampler->options.num_threads;
+    SampleJob job = {sampler, images, strata, num_images, step, 0};
+    pthread_t* threads = (pthread_t*)MEM_MALLOC(num_threads * sizeof(pthread_t));
+    SampleWorker* workers = (SampleWorker*)MEM_MALLOC(num_threads * sizeof(SampleWorker));
+
+    for (int t = 0; t < num_threads; t++) {
+        workers[t] = (SampleWorker){&job, t};
+        pthread_create(&threads[t], NULL, sample_worker_main, &workers[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    DescriptorList sample = descriptor_sampler_finish(sampler);
+    MEM_FREE(threads);
+    MEM_FREE(workers);
+    descriptor_sampler_free(sampler);
+    return sample;
+}
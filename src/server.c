@@ -0,0 +1,624 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_OTHER
+#include "server.h"
+#include "inference.h"
+#include "pipeline.h"
+#include "sift.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static uint64_t server_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 完整读写，处理被信号中断和部分传输
+static int read_full(int fd, void* buffer, size_t size) {
+    unsigned char* p = (unsigned char*)buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void* buffer, size_t size) {
+    const unsigned char* p = (const unsigned char*)buffer;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+// 延迟直方图
+void latency_histogram_add(LatencyHistogram* hist, uint64_t value_us) {
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && value_us >= (1ULL << bucket)) {
+        bucket++;
+    }
+    atomic_fetch_add(&hist->buckets[bucket], 1);
+    atomic_fetch_add(&hist->count, 1);
+    atomic_fetch_add(&hist->total_us, value_us);
+}
+
+uint64_t latency_histogram_percentile(const LatencyHistogram* hist, double p) {
+    unsigned long count = atomic_load(&hist->count);
+    if (count == 0) {
+        return 0;
+    }
+
+    unsigned long target = (unsigned long)(p * count);
+    unsigned long seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load(&hist->buckets[i]);
+        if (seen > target) {
+            return 1ULL << i;
+        }
+    }
+    return 1ULL << (LATENCY_BUCKETS - 1);
+}
+
+static int latency_histogram_json(const LatencyHistogram* hist, char* out, size_t size) {
+    unsigned long count = atomic_load(&hist->count);
+    int n = snprintf(out, size, "{\"count\": %lu, \"mean\": %.1f, \"p50\": %llu, \"p99\": %llu, \"buckets\": [",
+                     count, count ? (double)atomic_load(&hist->total_us) / count : 0.0,
+                     (unsigned long long)latency_histogram_percentile(hist, 0.50),
+                     (unsigned long long)latency_histogram_percentile(hist, 0.99));
+    for (int i = 0; i < LATENCY_BUCKETS && n < (int)size; i++) {
+        n += snprintf(out + n, size - n, "%s%lu", i ? ", " : "", atomic_load(&hist->buckets[i]));
+    }
+    if (n < (int)size) {
+        n += snprintf(out + n, size - n, "]}");
+    }
+    return n;
+}
+
+// 等待分类的请求 (图像视图直接指向连接线程的接收缓冲区，请求完成前该缓冲区不会被复用)
+typedef struct {
+    ImageView image;
+    int label;
+    float* scores;
+    uint64_t arrival_ns;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} PendingRequest;
+
+typedef struct {
+    ServerConfig config;
+    Codebook codebook;
+    SVMModel** models;
+    int num_classes;
+    int level;
+    BoundedQueue* queue;
+
+    LatencyHistogram latency;      // 请求到达 → 回复就绪
+    LatencyHistogram queue_wait;   // 请求到达 → 开始处理
+    LatencyHistogram batch_size;   // 每个微批的样本数
+    atomic_long requests;
+    atomic_long batches;
+} Server;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+static int server_stats_json(Server* server, char* out, size_t size) {
+    int n = snprintf(out, size, "{\"requests\": %ld, \"batches\": %ld, \"latency_us\": ",
+                     atomic_load(&server->requests), atomic_load(&server->batches));
+    n += latency_histogram_json(&server->latency, out + n, size - n);
+    n += snprintf(out + n, size - n, ", \"queue_wait_us\": ");
+    n += latency_histogram_json(&server->queue_wait, out + n, size - n);
+    n += snprintf(out + n, size - n, ", \"batch_size\": ");
+    n += latency_histogram_json(&server->batch_size, out + n, size - n);
+    n += snprintf(out + n, size - n, "}");
+    return n;
+}
+
+// 批处理线程的工作区，按最大批大小一次性分配
+typedef struct {
+    InferenceWorkspace* inference;   // 灰度/梯度缓冲区
+    float* descriptors;              // max_batch * max_descriptors * SIFT_DESC_SIZE
+    float* positions;
+    float* best_dist;
+    int* words;
+    int* counts;                     // 每幅图像的描述符数
+    float* histograms;               // max_batch * histogram_length
+    double* features;
+    Gray16Batch gray_batch;          // CIFAR尺寸图像的跨图像批处理缓冲区 (最大尺寸小于32时不分配)
+    OrientationPlanesBatch planes_batch;
+} BatchWorkspace;
+
+static BatchWorkspace* create_batch_workspace(Server* server) {
+    int max_batch = server->config.max_batch;
+    int size = server->config.max_image_size;
+
+    BatchWorkspace* ws = (BatchWorkspace*)MEM_CALLOC(1, sizeof(BatchWorkspace));
+    ws->inference = create_inference_workspace(size, size, &server->codebook, server->level,
+                                               server->models, server->num_classes);
+    int max_desc = ws->inference->max_descriptors;
+    int hist_len = ws->inference->histogram_length;
+
+    ws->descriptors = allocate_float_array(max_batch * max_desc * SIFT_DESC_SIZE + 1);
+    ws->positions = allocate_float_array(max_batch * max_desc * 2 + 1);
+    ws->best_dist = allocate_float_array(max_batch * max_desc + 1);
+    ws->words = (int*)MEM_MALLOC((max_batch * max_desc + 1) * sizeof(int));
+    ws->counts = (int*)MEM_MALLOC(max_batch * sizeof(int));
+    ws->histograms = allocate_float_array(max_batch * hist_len);
+    ws->features = (double*)MEM_MALLOC(hist_len * sizeof(double));
+    if (size >= CIFAR_IMAGE_SIZE) {
+        ws->gray_batch = create_gray16_batch(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE);
+        ws->planes_batch = create_orientation_planes_batch(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE);
+    }
+    return ws;
+}
+
+static void free_batch_workspace(BatchWorkspace* ws) {
+    free_inference_workspace(ws->inference);
+    free_float_array(ws->descriptors);
+    free_float_array(ws->positions);
+    free_float_array(ws->best_dist);
+    MEM_FREE(ws->words);
+    MEM_FREE(ws->counts);
+    free_float_array(ws->histograms);
+    MEM_FREE(ws->features);
+    free_gray16_batch(&ws->gray_batch);
+    free_orientation_planes_batch(&ws->planes_batch);
+    MEM_FREE(ws);
+}
+
+static int is_cifar_sized(const ImageView* img) {
+    return img->width == CIFAR_IMAGE_SIZE && img->height == CIFAR_IMAGE_SIZE;
+}
+
+// 连续的至多 IMAGE_BATCH_LANES 幅CIFAR尺寸图像交错后一起提取SIFT (结果与逐幅提取相同)
+// 描述符从第 total 个位置起写入，每幅图像的数量写入 counts，返回描述符总数
+static int extract_cifar_run(BatchWorkspace* ws, PendingRequest** batch, int run, int total, int* counts) {
+    InferenceWorkspace* inference = ws->inference;
+    ImageView views[IMAGE_BATCH_LANES];
+    float* outputs[IMAGE_BATCH_LANES];
+    int per_image = dense_sift_grid_count(CIFAR_IMAGE_SIZE, inference->step) *
+                    dense_sift_grid_count(CIFAR_IMAGE_SIZE, inference->step);
+    if (per_image > inference->max_descriptors) {
+        per_image = inference->max_descriptors;
+    }
+
+    for (int i = 0; i < run; i++) {
+        views[i] = batch[i]->image;
+        outputs[i] = ws->descriptors + (size_t)(total + i * per_image) * SIFT_DESC_SIZE;
+    }
+    convert_views_to_gray16_batch(views, run, &ws->gray_batch);
+    compute_orientation_planes_batch_into(&ws->gray_batch, &ws->planes_batch, SIFT_ORI_BINNING);
+    float* positions = ws->positions + (size_t)total * 2;
+    int count = extract_dense_sift_batch_into(&ws->planes_batch, inference->step, outputs, positions, per_image);
+
+    for (int i = 0; i < run; i++) {
+        counts[i] = count;
+        if (i > 0) {
+            memcpy(positions + (size_t)i * count * 2, positions, (size_t)count * 2 * sizeof(float));
+        }
+    }
+    return run * count;
+}
+
+// 处理一个微批: 逐图提取SIFT (CIFAR尺寸的图像跨图像成组处理)，整批量化 (码本中心在外层循环，整批共享一次码本读取)，
+// 再逐图构建金字塔，最后按模型在外层循环打分
+static void process_batch(Server* server, BatchWorkspace* ws, PendingRequest** batch, int n) {
+    InferenceWorkspace* inference = ws->inference;
+    int max_desc = inference->max_descriptors;
+    int hist_len = inference->histogram_length;
+    Codebook* codebook = &server->codebook;
+    int total = 0;
+
+    for (int b = 0; b < n; b++) {
+        int run = 0;
+        while (ws->gray_batch.data && run < IMAGE_BATCH_LANES && b + run < n && is_cifar_sized(&batch[b + run]->image)) {
+            run++;
+        }
+        if (run > 1) {
+            total += extract_cifar_run(ws, batch + b, run, total, ws->counts + b);
+            b += run - 1;
+            continue;
+        }
+
+        const ImageView* img = &batch[b]->image;
+        convert_view_to_gray16_into(img, &inference->gray);
+        compute_orientation_planes_gray16_into(&inference->gray, &inference->planes, SIFT_ORI_BINNING);
+        ws->counts[b] = extract_dense_sift_into(&inference->planes, inference->step,
+                                                ws->descriptors + (size_t)total * SIFT_DESC_SIZE,
+                                                ws->positions + (size_t)total * 2, max_desc);
+        total += ws->counts[b];
+    }
+
+    for (int d = 0; d < total; d++) {
+        ws->best_dist[d] = FLT_MAX;
+        ws->words[d] = 0;
+    }
+    for (int c = 0; c < codebook->num_clusters; c++) {
+        for (int d = 0; d < total; d++) {
+            float dist = euclidean_distance(ws->descriptors + (size_t)d * SIFT_DESC_SIZE, codebook->centers[c],
+                                            codebook->dim);
+            if (dist < ws->best_dist[d]) {
+                ws->best_dist[d] = dist;
+                ws->words[d] = c;
+            }
+        }
+    }
+
+    memset(ws->histograms, 0, (size_t)n * hist_len * sizeof(float));
+    int offset = 0;
+    for (int b = 0; b < n; b++) {
+        float* hist = ws->histograms + (size_t)b * hist_len;
+        if (ws->counts[b] > 0) {
+            float inv_count = 1.0f / (float)ws->counts[b];
+            for (int d = offset; d < offset + ws->counts[b]; d++) {
+                spm_accumulate_word(hist, codebook->num_clusters, server->level, ws->words[d],
+                                    ws->positions[d * 2], ws->positions[d * 2 + 1],
+                                    batch[b]->image.width, batch[b]->image.height, inv_count);
+            }
+        }
+        offset += ws->counts[b];
+    }
+
+    for (int m = 0; m < server->num_classes; m++) {
+        const SVMModel* model = server->models[m];
+        for (int b = 0; b < n; b++) {
+            const float* hist = ws->histograms + (size_t)b * hist_len;
+            double score = 0.0;
+            for (int i = 0; i < hist_len; i++) {
+                score += model->weights[i] * hist[i];
+            }
+            batch[b]->scores[m] = (float)score;
+        }
+    }
+
+    for (int b = 0; b < n; b++) {
+        PendingRequest* request = batch[b];
+        int best = 0;
+        for (int m = 1; m < server->num_classes; m++) {
+            if (request->scores[m] > request->scores[best]) best = m;
+        }
+
+        pthread_mutex_lock(&request->lock);
+        request->label = best;
+        request->done = 1;
+        pthread_cond_signal(&request->cond);
+        pthread_mutex_unlock(&request->lock);
+    }
+}
+
+static void* batcher_main(void* arg) {
+    Server* server = (Server*)arg;
+    BatchWorkspace* ws = create_batch_workspace(server);
+    PendingRequest** batch = (PendingRequest**)MEM_MALLOC(server->config.max_batch * sizeof(PendingRequest*));
+    void* data;
+
+    while (queue_pop(server->queue, &data, NULL)) {
+        int n = 0;
+        batch[n++] = (PendingRequest*)data;
+
+        // 在等待期限内尽量凑满一批
+        uint64_t deadline = server_now_ns() + (uint64_t)server->config.max_wait_us * 1000ULL;
+        while (n < server->config.max_batch) {
+            if (queue_try_pop(server->queue, &data)) {
+                batch[n++] = (PendingRequest*)data;
+            } else if (server_now_ns() >= deadline) {
+                break;
+            } else {
+                sched_yield();
+            }
+        }
+
+        uint64_t start = server_now_ns();
+        for (int b = 0; b < n; b++) {
+            latency_histogram_add(&server->queue_wait, (start - batch[b]->arrival_ns) / 1000);
+        }
+        latency_histogram_add(&server->batch_size, (uint64_t)n);
+        atomic_fetch_add(&server->batches, 1);
+
+        process_batch(server, ws, batch, n);
+    }
+
+    MEM_FREE(batch);
+    free_batch_workspace(ws);
+    return NULL;
+}
+
+typedef struct {
+    Server* server;
+    int fd;
+} Connection;
+
+static int send_error_reply(int fd) {
+    ServerReplyHeader reply = {SERVER_MAGIC, -1, 0, 0};
+    return write_full(fd, &reply, sizeof(reply));
+}
+
+static void* connection_main(void* arg) {
+    Connection* connection = (Connection*)arg;
+    Server* server = connection->server;
+    int fd = connection->fd;
+    MEM_FREE(connection);
+
+    float* scores = (float*)MEM_MALLOC(server->num_classes * sizeof(float));
+    unsigned char* payload = NULL;
+    size_t payload_capacity = 0;
+    ServerRequestHeader header;
+
+    while (read_full(fd, &header, sizeof(header))) {
+        if (header.magic != SERVER_MAGIC) {
+            break;
+        }
+
+        if (header.type == SERVER_REQUEST_STATS) {
+            char json[4096];
+            int len = server_stats_json(server, json, sizeof(json));
+            if (len >= (int)sizeof(json)) len = (int)sizeof(json) - 1;
+            ServerReplyHeader reply = {SERVER_MAGIC, -1, 0, (uint32_t)len};
+            if (!write_full(fd, &reply, sizeof(reply)) || !write_full(fd, json, len)) break;
+            continue;
+        }
+
+        size_t size;
+        if (header.type == SERVER_REQUEST_CIFAR) {
+            header.width = CIFAR_IMAGE_SIZE;
+            header.height = CIFAR_IMAGE_SIZE;
+            size = CIFAR_RECORD_SIZE;
+        } else if (header.type == SERVER_REQUEST_RGB) {
+            // 超出工作区尺寸的图像在读取负载之前拒绝: 不为其分配内存，未读的负载使后续请求无法对齐，因此关闭连接
+            if (header.width == 0 || header.height == 0 ||
+                header.width > (uint32_t)server->config.max_image_size ||
+                header.height > (uint32_t)server->config.max_image_size) {
+                send_error_reply(fd);
+                break;
+            }
+            size = (size_t)header.width * header.height * 3;
+        } else {
+            break;
+        }
+
+        if (size > payload_capacity) {
+            unsigned char* grown = (unsigned char*)MEM_REALLOC(payload, size);
+            if (!grown) break;
+            payload = grown;
+            payload_capacity = size;
+        }
+        if (!read_full(fd, payload, size)) {
+            break;
+        }
+
+        // CIFAR负载长度固定，已完整读取，工作区不足32x32时只拒绝这个请求
+        if (header.width > (uint32_t)server->config.max_image_size) {
+            if (!send_error_reply(fd)) break;
+            continue;
+        }
+
+        PendingRequest request;
+        memset(&request, 0, sizeof(request));
+        request.arrival_ns = server_now_ns();
+        request.scores = scores;
+        pthread_mutex_init(&request.lock, NULL);
+        pthread_cond_init(&request.cond, NULL);
+
+        if (header.type == SERVER_REQUEST_CIFAR) {
+            request.image = cifar_record_view(payload);
+        } else {
+            ImageView view = {payload, (int)header.width, (int)header.height, 3,
+                              (ptrdiff_t)header.width * 3, 3, 1};
+            request.image = view;
+        }
+
+        queue_push(server->queue, &request);
+
+        pthread_mutex_lock(&request.lock);
+        while (!request.done) {
+            pthread_cond_wait(&request.cond, &request.lock);
+        }
+        pthread_mutex_unlock(&request.lock);
+
+        latency_histogram_add(&server->latency, (server_now_ns() - request.arrival_ns) / 1000);
+        atomic_fetch_add(&server->requests, 1);
+
+        pthread_mutex_destroy(&request.lock);
+        pthread_cond_destroy(&request.cond);
+
+        ServerReplyHeader reply = {SERVER_MAGIC, request.label, (uint32_t)server->num_classes, 0};
+        if (!write_full(fd, &reply, sizeof(reply)) ||
+            !write_full(fd, scores, server->num_classes * sizeof(float))) {
+            break;
+        }
+    }
+
+    MEM_FREE(payload);
+    MEM_FREE(scores);
+    close(fd);
+    return NULL;
+}
+
+// 加载码本和模型，并由特征长度推出金字塔层数
+static int load_server_models(Server* server) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.codebook", server->config.model_prefix);
+    server->codebook = load_codebook(path);
+    if (!server->codebook.centers) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s.svm", server->config.model_prefix);
+    server->models = svm_load_models(path, &server->num_classes);
+    if (!server->models) {
+        free_codebook(&server->codebook);
+        return 0;
+    }
+
+    server->level = -1;
+    for (int l = 0; l <= 4; l++) {
+        if (spm_histogram_length(server->codebook.num_clusters, l) == server->models[0]->num_features) {
+            server->level = l;
+        }
+    }
+    if (server->level < 0) {
+        fprintf(stderr, "Error: SVM feature length does not match the codebook\n");
+        return 0;
+    }
+    return 1;
+}
+
+int run_server(const ServerConfig* config) {
+    Server* server = (Server*)MEM_CALLOC(1, sizeof(Server));
+    server->config = *config;
+    if (server->config.max_batch < 1) server->config.max_batch = 1;
+    if (server->config.num_batchers < 1) server->config.num_batchers = 1;
+
+    if (!load_server_models(server)) {
+        MEM_FREE(server);
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", config->socket_path);
+    unlink(config->socket_path);
+
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 128) != 0) {
+        fprintf(stderr, "Error: Could not listen on %s (%s)\n", config->socket_path, strerror(errno));
+        if (listen_fd >= 0) close(listen_fd);
+        MEM_FREE(server);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+
+    server->queue = create_bounded_queue(SERVER_QUEUE_CAPACITY);
+    pthread_t* batchers = (pthread_t*)MEM_MALLOC(server->config.num_batchers * sizeof(pthread_t));
+    for (int i = 0; i < server->config.num_batchers; i++) {
+        pthread_create(&batchers[i], NULL, batcher_main, server);
+    }
+
+    printf("Serving %d classes (K=%d, L=%d) on %s, max batch %d, max wait %d us\n",
+           server->num_classes, server->codebook.num_clusters, server->level, config->socket_path,
+           server->config.max_batch, server->config.max_wait_us);
+    fflush(stdout);
+
+    while (!server_stop) {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        Connection* connection = (Connection*)MEM_MALLOC(sizeof(Connection));
+        connection->server = server;
+        connection->fd = fd;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, connection_main, connection) != 0) {
+            close(fd);
+            MEM_FREE(connection);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    close(listen_fd);
+    unlink(config->socket_path);
+    queue_close(server->queue);
+    for (int i = 0; i < server->config.num_batchers; i++) {
+        pthread_join(batchers[i], NULL);
+    }
+
+    char json[4096];
+    server_stats_json(server, json, sizeof(json));
+    printf("%s\n", json);
+
+    // 连接线程可能仍持有服务状态，进程随后退出，不再释放模型
+    MEM_FREE(batchers);
+    return EXIT_SUCCESS;
+}
+
+// 客户端
+int server_connect(const char* socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Error: Could not connect to %s (%s)\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_classify_cifar(int fd, const unsigned char* record, float* scores, int max_scores) {
+    ServerRequestHeader header = {SERVER_MAGIC, SERVER_REQUEST_CIFAR, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE};
+    if (!write_full(fd, &header, sizeof(header)) || !write_full(fd, record, CIFAR_RECORD_SIZE)) {
+        return -2;
+    }
+
+    ServerReplyHeader reply;
+    if (!read_full(fd, &reply, sizeof(reply)) || reply.magic != SERVER_MAGIC) {
+        return -2;
+    }
+
+    for (uint32_t i = 0; i < reply.num_scores; i++) {
+        float score;
+        if (!read_full(fd, &score, sizeof(score))) {
+            return -2;
+        }
+        if (scores && (int)i < max_scores) {
+            scores[i] = score;
+        }
+    }
+    return reply.label;
+}
+
+char* server_fetch_stats(int fd) {
+    ServerRequestHeader header = {SERVER_MAGIC, SERVER_REQUEST_STATS, 0, 0};
+    ServerReplyHeader reply;
+    if (!write_full(fd, &header, sizeof(header)) || !read_full(fd, &reply, sizeof(reply)) ||
+        reply.magic != SERVER_MAGIC) {
+        return NULL;
+    }
+
+    char* json = (char*)MEM_MALLOC(reply.payload_size + 1);
+    if (!json || !read_full(fd, json, reply.payload_size)) {
+        MEM_FREE(json);
+        return NULL;
+    }
+    json[reply.payload_size] = '\0';
+    return json;
+}
@@ -0,0 +1,510 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_KMEANS
+#include "sharded.h"
+#include "rng.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define SHARDED_ALIGN 64
+#define SHARDED_POLL_MS 100   // 协调进程在屏障上检查工作进程存活的间隔
+
+typedef struct {
+    uint32_t magic;
+    uint32_t dim;
+    uint64_t count;
+} DescriptorShardHeader;
+
+int write_descriptor_shard(const char* path, const DescriptorList* descriptors, int begin, int end) {
+    int dim = end > begin ? descriptors->descriptors[begin].length : 0;
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open descriptor shard %s for writing\n", path);
+        return 0;
+    }
+
+    DescriptorShardHeader header = {DESCRIPTOR_SHARD_MAGIC, (uint32_t)dim, (uint64_t)(end - begin)};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = begin; ok && i < end; i++) {
+        ok = fwrite(descriptors->descriptors[i].data, sizeof(float), dim, file) == (size_t)dim;
+    }
+
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error: Could not write descriptor shard %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+int open_descriptor_shard(DescriptorShard* shard, const char* path) {
+    memset(shard, 0, sizeof(DescriptorShard));
+    shard->fd = open(path, O_RDONLY);
+    if (shard->fd < 0) {
+        fprintf(stderr, "Error: Could not open descriptor shard %s\n", path);
+        return 0;
+    }
+
+    struct stat st;
+    DescriptorShardHeader header;
+    if (fstat(shard->fd, &st) != 0 || (size_t)st.st_size < sizeof(header) ||
+        pread(shard->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != DESCRIPTOR_SHARD_MAGIC || header.count > INT32_MAX ||
+        (size_t)st.st_size != sizeof(header) + header.count * header.dim * sizeof(float)) {
+        fprintf(stderr, "Error: Invalid descriptor shard %s\n", path);
+        close(shard->fd);
+        shard->fd = -1;
+        return 0;
+    }
+
+    shard->map_size = (size_t)st.st_size;
+    shard->map = mmap(NULL, shard->map_size, PROT_READ, MAP_SHARED, shard->fd, 0);
+    if (shard->map == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map descriptor shard %s (%s)\n", path, strerror(errno));
+        close(shard->fd);
+        shard->fd = -1;
+        shard->map = NULL;
+        return 0;
+    }
+    // 分配阶段按顺序扫描整个分片
+    posix_madvise(shard->map, shard->map_size, POSIX_MADV_SEQUENTIAL);
+
+    shard->data = (const float*)((const unsigned char*)shard->map + sizeof(header));
+    shard->count = (int)header.count;
+    shard->dim = (int)header.dim;
+    return 1;
+}
+
+void close_descriptor_shard(DescriptorShard* shard) {
+    if (shard && shard->map) {
+        munmap(shard->map, shard->map_size);
+        close(shard->fd);
+        memset(shard, 0, sizeof(DescriptorShard));
+        shard->fd = -1;
+    }
+}
+
+// 进程间屏障: pthread_barrier_t 无法中止，进程共享的条件变量在等待者被杀死后也可能使广播永远阻塞，
+// 因此用原子到达计数 + 两个交替使用的进程共享信号量实现 (第 g 代使用 gates[g & 1]，
+// 任何进程到达第 g+2 代之前，所有进程都已离开第 g 代)。进程死亡不会破坏信号量的状态；
+// 协调进程等待时定期 waitpid 检查工作进程，发现有进程退出即置 aborted 并唤醒所有等待者
+typedef struct {
+    sem_t gates[2];
+    atomic_int arrived;
+    atomic_uint generation;
+    atomic_int aborted;
+    int parties;
+} ShardedBarrier;
+
+// 共享内存段: 控制块之后依次为中心、每个工作进程的部分和与计数
+typedef struct {
+    ShardedBarrier barrier;      // 协调进程 + 所有工作进程
+    int stop;                    // 协调进程置1后工作进程退出
+    int num_workers;
+    int num_clusters;
+    int dim;
+    float* centers;              // [num_clusters * dim]
+    double* sums;                // [num_workers][num_clusters * dim]
+    int64_t* counts;             // [num_workers][num_clusters]
+    int* status;                 // [num_workers] 1 表示分片映射成功
+    int* changed;                // [num_workers] 本工作进程负责的簇是否移动
+} ShardedSegment;
+
+static void barrier_init(ShardedBarrier* barrier, int parties) {
+    sem_init(&barrier->gates[0], 1, 0);
+    sem_init(&barrier->gates[1], 1, 0);
+    atomic_init(&barrier->arrived, 0);
+    atomic_init(&barrier->generation, 0);
+    atomic_init(&barrier->aborted, 0);
+    barrier->parties = parties;
+}
+
+static void barrier_destroy(ShardedBarrier* barrier) {
+    sem_destroy(&barrier->gates[0]);
+    sem_destroy(&barrier->gates[1]);
+}
+
+// 中止后所有正在或将要等待的进程都从 barrier_wait 返回0
+static void barrier_abort(ShardedBarrier* barrier) {
+    atomic_store(&barrier->aborted, 1);
+    for (int g = 0; g < 2; g++) {
+        for (int p = 0; p < barrier->parties; p++) {
+            sem_post(&barrier->gates[g]);
+        }
+    }
+}
+
+// 回收已退出的工作进程 (pids 中置0)，返回是否有进程退出。
+// 工作进程只在协调进程置 stop 后退出，因此屏障等待期间的任何退出都是异常的
+static int reap_exited_workers(pid_t* pids, int num_workers) {
+    int exited = 0;
+    for (int w = 0; w < num_workers; w++) {
+        int status;
+        if (pids[w] > 0 && waitpid(pids[w], &status, WNOHANG) == pids[w]) {
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "Error: K-means worker %d killed by signal %d\n", w, WTERMSIG(status));
+            } else {
+                fprintf(stderr, "Error: K-means worker %d exited with status %d\n", w, WEXITSTATUS(status));
+            }
+            pids[w] = 0;
+            exited = 1;
+        }
+    }
+    return exited;
+}
+
+// 所有参与者到达后返回1，屏障被中止时返回0。
+// pids 非NULL时 (协调进程) 每 SHARDED_POLL_MS 检查一次工作进程
+static int barrier_wait(ShardedBarrier* barrier, pid_t* pids, int num_workers) {
+    if (atomic_load(&barrier->aborted)) {
+        return 0;
+    }
+
+    // 本代的所有到达者读到相同的代数: 代数只在本代最后一个进程到达后才增加
+    unsigned generation = atomic_load(&barrier->generation);
+    sem_t* gate = &barrier->gates[generation & 1];
+    if (atomic_fetch_add(&barrier->arrived, 1) + 1 == barrier->parties) {
+        atomic_store(&barrier->arrived, 0);
+        atomic_fetch_add(&barrier->generation, 1);
+        for (int p = 0; p < barrier->parties - 1; p++) {
+            sem_post(gate);
+        }
+        return !atomic_load(&barrier->aborted);
+    }
+
+    for (;;) {
+        if (!pids) {
+            if (sem_wait(gate) == 0) break;
+            if (errno != EINTR) return 0;
+            continue;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SHARDED_POLL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(gate, &deadline) == 0) break;
+        if (errno != ETIMEDOUT && errno != EINTR) return 0;
+        if (reap_exited_workers(pids, num_workers)) {
+            barrier_abort(barrier);
+        }
+    }
+    return !atomic_load(&barrier->aborted);
+}
+
+static size_t align_up(size_t size) {
+    return (size + SHARDED_ALIGN - 1) & ~(size_t)(SHARDED_ALIGN - 1);
+}
+
+// POSIX共享内存段，映射后立即 shm_unlink: fork后由所有进程共享 (指针在各进程中相同)，
+// 所有进程解除映射后自动回收
+static void* map_shared_segment(size_t size) {
+    char name[64];
+    snprintf(name, sizeof(name), "/cv-c-kmeans-%ld", (long)getpid());
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return MAP_FAILED;
+    }
+    shm_unlink(name);
+
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return map;
+}
+
+static ShardedSegment* create_segment(int num_workers, int num_clusters, int dim, size_t* total) {
+    size_t center_size = align_up((size_t)num_clusters * dim * sizeof(float));
+    size_t sums_size = align_up((size_t)num_clusters * dim * sizeof(double));
+    size_t counts_size = align_up((size_t)num_clusters * sizeof(int64_t));
+    size_t header = align_up(sizeof(ShardedSegment));
+    size_t flags = align_up((size_t)num_workers * sizeof(int));
+
+    *total = header + center_size + num_workers * (sums_size + counts_size) + 2 * flags;
+    void* map = map_shared_segment(*total);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not create shared k-means segment (%s)\n", strerror(errno));
+        return NULL;
+    }
+
+    unsigned char* base = (unsigned char*)map;
+    ShardedSegment* segment = (ShardedSegment*)base;
+    segment->num_workers = num_workers;
+    segment->num_clusters = num_clusters;
+    segment->dim = dim;
+    segment->centers = (float*)(base + header);
+    segment->sums = (double*)(base + header + center_size);
+    segment->counts = (int64_t*)(base + header + center_size + num_workers * sums_size);
+    segment->status = (int*)(base + header + center_size + num_workers * (sums_size + counts_size));
+    segment->changed = (int*)((unsigned char*)segment->status + flags);
+
+    barrier_init(&segment->barrier, num_workers + 1);
+    return segment;
+}
+
+// 每个工作进程的槽位起点按缓存行对齐，避免工作进程之间伪共享
+static double* worker_sums(ShardedSegment* segment, int worker) {
+    size_t stride = align_up((size_t)segment->num_clusters * segment->dim * sizeof(double)) / sizeof(double);
+    return segment->sums + worker * stride;
+}
+
+static int64_t* worker_counts(ShardedSegment* segment, int worker) {
+    size_t stride = align_up((size_t)segment->num_clusters * sizeof(int64_t)) / sizeof(int64_t);
+    return segment->counts + worker * stride;
+}
+
+// 分配本分片的所有描述符并累加部分和
+static void accumulate_shard(ShardedSegment* segment, const DescriptorShard* shard, int worker) {
+    int num_clusters = segment->num_clusters;
+    int dim = segment->dim;
+    double* sums = worker_sums(segment, worker);
+    int64_t* counts = worker_counts(segment, worker);
+    memset(sums, 0, (size_t)num_clusters * dim * sizeof(double));
+    memset(counts, 0, num_clusters * sizeof(int64_t));
+
+    for (int i = 0; i < shard->count; i++) {
+        float* row = (float*)(shard->data + (size_t)i * dim);
+        float min_dist = FLT_MAX;
+        int best = 0;
+        for (int c = 0; c < num_clusters; c++) {
+            float dist = euclidean_distance(row, segment->centers + (size_t)c * dim, dim);
+            if (dist < min_dist) {
+                min_dist = dist;
+                best = c;
+            }
+        }
+
+        double* sum = sums + (size_t)best * dim;
+        counts[best]++;
+        for (int j = 0; j < dim; j++) {
+            sum[j] += row[j];
+        }
+    }
+}
+
+// 归约 [begin, end) 簇的部分和并写回中心，返回是否有中心移动
+static int reduce_clusters(ShardedSegment* segment, int begin, int end) {
+    int dim = segment->dim;
+    int changed = 0;
+
+    for (int c = begin; c < end; c++) {
+        int64_t count = 0;
+        for (int w = 0; w < segment->num_workers; w++) {
+            count += worker_counts(segment, w)[c];
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        float* center = segment->centers + (size_t)c * dim;
+        for (int j = 0; j < dim; j++) {
+            double sum = 0.0;
+            for (int w = 0; w < segment->num_workers; w++) {
+                sum += worker_sums(segment, w)[(size_t)c * dim + j];
+            }
+            float value = (float)(sum / (double)count);
+            if (fabsf(value - center[j]) > 1e-4) {
+                changed = 1;
+            }
+            center[j] = value;
+        }
+    }
+
+    return changed;
+}
+
+static void worker_main(ShardedSegment* segment, const char* path, int worker) {
+    DescriptorShard shard;
+    int ok = open_descriptor_shard(&shard, path) && shard.dim == segment->dim;
+    segment->status[worker] = ok;
+    if (!barrier_wait(&segment->barrier, NULL, 0)) {
+        if (ok) close_descriptor_shard(&shard);
+        return;
+    }
+
+    int per_worker = (segment->num_clusters + segment->num_workers - 1) / segment->num_workers;
+    int begin = min_int(worker * per_worker, segment->num_clusters);
+    int end = min_int(begin + per_worker, segment->num_clusters);
+
+    for (;;) {
+        // 屏障1: 中心和停止标志已就绪
+        if (!barrier_wait(&segment->barrier, NULL, 0) || segment->stop) {
+            break;
+        }
+
+        accumulate_shard(segment, &shard, worker);
+        // 屏障2: 所有部分和已写入
+        if (!barrier_wait(&segment->barrier, NULL, 0)) {
+            break;
+        }
+
+        segment->changed[worker] = reduce_clusters(segment, begin, end);
+        // 屏障3: 新中心已全部写回
+        if (!barrier_wait(&segment->barrier, NULL, 0)) {
+            break;
+        }
+    }
+
+    if (ok) {
+        close_descriptor_shard(&shard);
+    }
+}
+
+// 按拼接后的全局下标读取初始中心 (与 build_codebook 的Forgy抽样一致)
+static int read_initial_centers(const char* const* shard_paths, int num_shards, const int* counts, int total,
+                                int num_clusters, int dim, float* centers) {
+    int* selected = (int*)MEM_MALLOC(num_clusters * sizeof(int));
+    Rng rng = rng_create(rng_default_seed());
+    int ok = rng_sample_indices(&rng, total, num_clusters, selected);
+    for (int s = 0, first = 0; ok && s < num_shards; first += counts[s], s++) {
+        DescriptorShard shard;
+        int mapped = 0;
+        for (int i = 0; ok && i < num_clusters; i++) {
+            if (selected[i] < first || selected[i] >= first + counts[s]) {
+                continue;
+            }
+            if (!mapped) {
+                ok = mapped = open_descriptor_shard(&shard, shard_paths[s]);
+                if (!ok) break;
+            }
+            memcpy(centers + (size_t)i * dim, shard.data + (size_t)(selected[i] - first) * dim, dim * sizeof(float));
+        }
+        if (mapped) {
+            close_descriptor_shard(&shard);
+        }
+    }
+
+    MEM_FREE(selected);
+    return ok;
+}
+
+Codebook build_codebook_sharded(const char* const* shard_paths, int num_shards, int num_clusters, int max_iter) {
+    Codebook codebook = {NULL, num_clusters, 0};
+    if (num_shards <= 0) {
+        fprintf(stderr, "Error: No descriptor shards given\n");
+        return codebook;
+    }
+
+    // 读取各分片的头部，检查维度一致
+    int* counts = (int*)MEM_MALLOC(num_shards * sizeof(int));
+    int64_t total = 0;
+    int dim = 0;
+    for (int s = 0; s < num_shards; s++) {
+        DescriptorShard shard;
+        if (!open_descriptor_shard(&shard, shard_paths[s])) {
+            MEM_FREE(counts);
+            return codebook;
+        }
+        if (s > 0 && shard.dim != dim) {
+            fprintf(stderr, "Error: Descriptor shard %s has dimension %d, expected %d\n", shard_paths[s], shard.dim,
+                    dim);
+            close_descriptor_shard(&shard);
+            MEM_FREE(counts);
+            return codebook;
+        }
+        dim = shard.dim;
+        counts[s] = shard.count;
+        total += shard.count;
+        close_descriptor_shard(&shard);
+    }
+    if (total < num_clusters || total > INT32_MAX || dim == 0) {
+        fprintf(stderr, "Error: Cannot build codebook from %lld sharded descriptors\n", (long long)total);
+        MEM_FREE(counts);
+        return codebook;
+    }
+
+    size_t segment_size;
+    ShardedSegment* segment = create_segment(num_shards, num_clusters, dim, &segment_size);
+    if (!segment || !read_initial_centers(shard_paths, num_shards, counts, (int)total, num_clusters, dim,
+                                          segment->centers)) {
+        if (segment) munmap(segment, segment_size);
+        MEM_FREE(counts);
+        return codebook;
+    }
+    MEM_FREE(counts);
+
+    printf("Building sharded codebook with %d clusters from %lld descriptors in %d shards\n", num_clusters,
+           (long long)total, num_shards);
+    fflush(stdout);
+
+    pid_t* pids = (pid_t*)MEM_MALLOC(num_shards * sizeof(pid_t));
+    int started = 0;
+    for (; started < num_shards; started++) {
+        pids[started] = fork();
+        if (pids[started] == 0) {
+            worker_main(segment, shard_paths[started], started);
+            _exit(0);
+        }
+        if (pids[started] < 0) {
+            fprintf(stderr, "Error: Could not fork k-means worker (%s)\n", strerror(errno));
+            break;
+        }
+    }
+
+    int iteration = 0;
+    if (started == num_shards) {
+        int ok = barrier_wait(&segment->barrier, pids, num_shards);
+        for (int w = 0; ok && w < num_shards; w++) {
+            ok = segment->status[w];
+        }
+        segment->stop = !ok || max_iter <= 0;
+
+        for (;;) {
+            if (!barrier_wait(&segment->barrier, pids, num_shards)) {
+                ok = 0;
+                break;
+            }
+            if (segment->stop) {
+                break;
+            }
+            TRACE_BEGIN(iter);
+            if (!barrier_wait(&segment->barrier, pids, num_shards) ||
+                !barrier_wait(&segment->barrier, pids, num_shards)) {
+                ok = 0;
+                break;
+            }
+            TRACE_COUNT(TRACE_STAGE_KMEANS_ITER, (size_t)total * num_clusters);
+            TRACE_END(iter, TRACE_STAGE_KMEANS_ITER, (size_t)total * dim * sizeof(float));
+            iteration++;
+
+            int changed = 0;
+            for (int w = 0; w < num_shards; w++) {
+                changed |= segment->changed[w];
+            }
+            segment->stop = !changed || iteration >= max_iter;
+        }
+
+        if (ok) {
+            codebook.dim = dim;
+            codebook.centers = allocate_float_matrix(num_clusters, dim);
+            for (int i = 0; i < num_clusters; i++) {
+                memcpy(codebook.centers[i], segment->centers + (size_t)i * dim, dim * sizeof(float));
+            }
+            printf("Sharded K-means converged after %d iterations\n", iteration);
+        }
+    } else {
+        // 部分工作进程未能启动，中止屏障让已启动的进程退出
+        barrier_abort(&segment->barrier);
+    }
+
+    for (int w = 0; w < started; w++) {
+        if (pids[w] > 0) {
+            waitpid(pids[w], NULL, 0);
+        }
+    }
+    MEM_FREE(pids);
+    barrier_destroy(&segment->barrier);
+    munmap(segment, segment_size);
+    return codebook;
+}
@@ -1,11 +1,23 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_SIFT
 #include "sift.h"
+#include "trace.h"
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIFT_HAVE_X86 1
+#endif
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
+
+const int sift_default_cell_sizes[SIFT_NUM_DEFAULT_SCALES] = {4, 6, 8, 10};
+
 // 添加关键点到列表
 static void add_keypoint(KeyPointList* list, float x, float y, float scale, float orientation) {
-    KeyPoint* new_points = (KeyPoint*)realloc(list->points, (list->count + 1) * sizeof(KeyPoint));
+    KeyPoint* new_points = (KeyPoint*)MEM_REALLOC(list->points, (list->count + 1) * sizeof(KeyPoint));
 
     if (!new_points) {
         fprintf(stderr, "Error: Memory reallocation failed for keypoint list\n");
@@ -22,7 +34,7 @@ static void add_keypoint(KeyPointList* list, float x, float y, float scale, floa
 
 // 增加SIFT描述符到列表
 static void add_sift_descriptor(SiftDescriptorList* list, SiftDescriptor desc) {
-    SiftDescriptor* new_descs = (SiftDescriptor*)realloc(list->descriptors,
+    SiftDescriptor* new_descs = (SiftDescriptor*)MEM_REALLOC(list->descriptors,
                                                          (list->count + 1) * sizeof(SiftDescriptor));
 
     if (!new_descs) {
@@ -35,6 +47,109 @@ static void add_sift_descriptor(SiftDescriptorList* list, SiftDescriptor desc) {
     list->count++;
 }
 
+// 归一化描述符
+static void normalize_descriptor(float* descriptor) {
+    float sum = 0.0f;
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        sum += descriptor[i] * descriptor[i];
+    }
+
+    if (sum > 0) {
+        float norm = 1.0f / sqrtf(sum);
+        for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+            descriptor[i] *= norm;
+        }
+    }
+}
+
+// 计算以(x,y)为中心的SIFT描述符
+// 描述符是4x4的网格，每个单元有8个方向直方图，每个单元的大小为4x4像素
+// 方向平面中每个像素已按bin分好幅值，单元格直方图只需逐像素累加8个bin
+static void compute_grid_descriptor(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    int grid_size = SIFT_GRID_SIZE;
+    int cell_size = SIFT_CELL_SIZE;
+    int bins = SIFT_ORI_BINS;  // 8个方向
+
+    memset(descriptor, 0, SIFT_DESC_SIZE * sizeof(float));
+
+    // 以(x,y)为中心提取描述符
+    int half_width = grid_size * cell_size / 2;
+
+    for (int grid_y = 0; grid_y < grid_size; grid_y++) {
+        for (int grid_x = 0; grid_x < grid_size; grid_x++) {
+            // 计算当前单元格的起始位置
+            int cell_start_x = x - half_width + grid_x * cell_size;
+            int cell_start_y = y - half_width + grid_y * cell_size;
+            float* histogram = descriptor + (grid_y * grid_size + grid_x) * bins;
+
+            // 遍历单元格内的每个像素
+            for (int cell_y = 0; cell_y < cell_size; cell_y++) {
+                for (int cell_x = 0; cell_x < cell_size; cell_x++) {
+                    int px = cell_start_x + cell_x;
+                    int py = cell_start_y + cell_y;
+
+                    // 确保在图像边界内
+                    if (px >= 0 && px < planes->width && py >= 0 && py < planes->height) {
+                        const float* pixel = planes->data + ((size_t)py * planes->width + px) * bins;
+                        for (int b = 0; b < bins; b++) {
+                            histogram[b] += pixel[b];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    normalize_descriptor(descriptor);
+}
+
+// 描述符窗口半宽
+#define SIFT_HALF_WINDOW (SIFT_GRID_SIZE * SIFT_CELL_SIZE / 2)
+
+// 描述符窗口完全位于图像内部时的特化版本: 无边界判断，单元格循环完全展开
+// WIDTH 为编译期常量时行跨度也在编译期确定；累加顺序与 compute_grid_descriptor 相同，结果逐位一致
+#define DEFINE_INTERIOR_GRID_DESCRIPTOR(NAME, WIDTH)                                                   \
+    static void NAME(const OrientationPlanes* planes, int x, int y, float* descriptor) {              \
+        const int width = (WIDTH);                                                                     \
+        const float* origin = planes->data +                                                           \
+            ((size_t)(y - SIFT_HALF_WINDOW) * width + (x - SIFT_HALF_WINDOW)) * SIFT_ORI_BINS;         \
+        memset(descriptor, 0, SIFT_DESC_SIZE * sizeof(float));                                         \
+        for (int grid_y = 0; grid_y < SIFT_GRID_SIZE; grid_y++) {                                      \
+            for (int grid_x = 0; grid_x < SIFT_GRID_SIZE; grid_x++) {                                  \
+                float* histogram = descriptor + (grid_y * SIFT_GRID_SIZE + grid_x) * SIFT_ORI_BINS;    \
+                const float* cell = origin +                                                           \
+                    ((size_t)grid_y * SIFT_CELL_SIZE * width + grid_x * SIFT_CELL_SIZE) * SIFT_ORI_BINS; \
+                UNROLL_LOOP                                                                            \
+                for (int cell_y = 0; cell_y < SIFT_CELL_SIZE; cell_y++) {                              \
+                    UNROLL_LOOP                                                                        \
+                    for (int cell_x = 0; cell_x < SIFT_CELL_SIZE; cell_x++) {                          \
+                        const float* pixel = cell + ((size_t)cell_y * width + cell_x) * SIFT_ORI_BINS; \
+                        UNROLL_LOOP                                                                    \
+                        for (int b = 0; b < SIFT_ORI_BINS; b++) {                                      \
+                            histogram[b] += pixel[b];                                                  \
+                        }                                                                              \
+                    }                                                                                  \
+                }                                                                                      \
+            }                                                                                          \
+        }                                                                                              \
+        normalize_descriptor(descriptor);                                                              \
+    }
+
+DEFINE_INTERIOR_GRID_DESCRIPTOR(compute_interior_descriptor, planes->width)
+DEFINE_INTERIOR_GRID_DESCRIPTOR(compute_interior_descriptor_cifar, CIFAR_IMAGE_SIZE)
+
+// 按形状选择描述符内核: 边界点走通用版本，内部点走展开版本；只有CIFAR宽度有编译期跨度的实例
+static void compute_dense_descriptor(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    if (x < SIFT_HALF_WINDOW || y < SIFT_HALF_WINDOW ||
+        x + SIFT_HALF_WINDOW > planes->width || y + SIFT_HALF_WINDOW > planes->height) {
+        compute_grid_descriptor(planes, x, y, descriptor);
+    } else if (planes->width == CIFAR_IMAGE_SIZE) {
+        compute_interior_descriptor_cifar(planes, x, y, descriptor);
+    } else {
+        compute_interior_descriptor(planes, x, y, descriptor);
+    }
+}
+
 // 简化版关键点检测
 // 注意：这是SIFT算法的一个非常简化版本，实际中应该使用完整的DoG+极值检测
 KeyPointList detect_keypoints(const Image* img) {
@@ -43,9 +158,8 @@ KeyPointList detect_keypoints(const Image* img) {
     // 将图像转换为灰度
     GrayImage gray = convert_to_gray(img);
 
-    // 计算梯度幅值和方向
+    // 计算梯度幅值，方向只在保留的关键点上计算
     GrayImage magnitude = compute_gradient_magnitude(&gray);
-    GrayImage orientation = compute_gradient_orientation(&gray);
 
     // 简化起见，我们以规则网格上的点作为关键点
     // 实际的SIFT应该寻找DoG空间中的局部极值点
@@ -56,7 +170,10 @@ KeyPointList detect_keypoints(const Image* img) {
 
             // 只保留梯度幅值足够大的点
             if (grad_mag > SIFT_CONTRAST_THRESH) {
-                float angle = get_pixel_gray(&orientation, x, y);
+                float gx = get_pixel_gray(&gray, x + 1, y) - get_pixel_gray(&gray, x - 1, y);
+                float gy = get_pixel_gray(&gray, x, y + 1) - get_pixel_gray(&gray, x, y - 1);
+                float angle = atan2f(gy, gx);
+                if (angle < 0) angle += 2.0f * M_PI;
                 add_keypoint(&list, (float)x, (float)y, SIFT_SIGMA, angle);
             }
         }
@@ -64,14 +181,13 @@ KeyPointList detect_keypoints(const Image* img) {
 
     free_gray_image(&gray);
     free_gray_image(&magnitude);
-    free_gray_image(&orientation);
 
     return list;
 }
 
 void free_keypoint_list(KeyPointList* list) {
     if (list && list->points) {
-        free(list->points);
+        MEM_FREE(list->points);
         list->points = NULL;
         list->count = 0;
     }
@@ -81,76 +197,19 @@ void free_keypoint_list(KeyPointList* list) {
 // 注意：这是一个简化版本
 SiftDescriptor compute_sift_descriptor(const Image* img, KeyPoint kp) {
     SiftDescriptor desc;
-    memset(desc.descriptor, 0, SIFT_DESC_SIZE * sizeof(float));
     desc.x = kp.x;
     desc.y = kp.y;
 
     // 将图像转换为灰度
     GrayImage gray = convert_to_gray(img);
 
-    // 计算梯度幅值和方向
-    GrayImage magnitude = compute_gradient_magnitude(&gray);
-    GrayImage orientation = compute_gradient_orientation(&gray);
-
-    // SIFT描述符是4x4的网格，每个单元有8个方向直方图
-    // 假设每个单元的大小为4x4像素
-    int grid_size = 4;
-    int cell_size = 4;
-    int bins = 8;  // 8个方向
-
-    // 以关键点为中心提取描述符
-    int half_width = grid_size * cell_size / 2;
-
-    for (int grid_y = 0; grid_y < grid_size; grid_y++) {
-        for (int grid_x = 0; grid_x < grid_size; grid_x++) {
-            // 计算当前单元格的起始位置
-            int cell_start_x = (int)kp.x - half_width + grid_x * cell_size;
-            int cell_start_y = (int)kp.y - half_width + grid_y * cell_size;
-
-            // 遍历单元格内的每个像素
-            for (int cell_y = 0; cell_y < cell_size; cell_y++) {
-                for (int cell_x = 0; cell_x < cell_size; cell_x++) {
-                    int x = cell_start_x + cell_x;
-                    int y = cell_start_y + cell_y;
-
-                    // 确保在图像边界内
-                    if (x >= 0 && x < img->width && y >= 0 && y < img->height) {
-                        float mag = get_pixel_gray(&magnitude, x, y);
-                        float angle = get_pixel_gray(&orientation, x, y);
-
-                        // 将角度归一化到0-2PI
-                        if (angle < 0) angle += 2.0f * M_PI;
-
-                        // 计算角度所在的bin
-                        int bin = (int)(bins * angle / (2.0f * M_PI)) % bins;
+    // 方向平面取软分bin，配合空间上的高斯加权与双线性插值即为三线性插值
+    OrientationPlanes planes = compute_orientation_planes(&gray, ORIENTATION_SOFT);
 
-                        // 计算对应的描述符索引
-                        int descriptor_idx = (grid_y * grid_size + grid_x) * bins + bin;
-
-                        // 累加梯度幅值
-                        desc.descriptor[descriptor_idx] += mag;
-                    }
-                }
-            }
-        }
-    }
-
-    // 归一化描述符
-    float sum = 0.0f;
-    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
-        sum += desc.descriptor[i] * desc.descriptor[i];
-    }
-
-    if (sum > 0) {
-        float norm = 1.0f / sqrtf(sum);
-        for (int i = 0; i < SIFT_DESC_SIZE; i++) {
-            desc.descriptor[i] *= norm;
-        }
-    }
+    compute_trilinear_descriptor(&planes, (int)kp.x, (int)kp.y, desc.descriptor);
 
     free_gray_image(&gray);
-    free_gray_image(&magnitude);
-    free_gray_image(&orientation);
+    free_orientation_planes(&planes);
 
     return desc;
 }
@@ -175,7 +234,7 @@ SiftDescriptorList extract_sift_features(const Image* img) {
 
 void free_sift_descriptor_list(SiftDescriptorList* list) {
     if (list && list->descriptors) {
-        free(list->descriptors);
+        MEM_FREE(list->descriptors);
         list->descriptors = NULL;
         list->count = 0;
     }
@@ -203,16 +262,23 @@ DescriptorList convert_sift_to_descriptors(const SiftDescriptorList* sift_list)
 
 // 提取密集SIFT特征 (在规则网格上提取)
 DescriptorList extract_dense_sift(const Image* img, int step) {
+    ImageView view = image_view(img);
+    return extract_dense_sift_view(&view, step);
+}
+
+DescriptorList extract_dense_sift_view(const ImageView* img, int step) {
     DescriptorList list = create_descriptor_list(0);
 
-    // 将图像转换为灰度
-    GrayImage gray = convert_to_gray(img);
+    // 定点灰度与整数梯度，只在写入方向平面时转换为float
+    Gray16Image gray = create_gray16_image(img->width, img->height);
+    convert_view_to_gray16_into(img, &gray);
 
-    // 计算梯度幅值和方向
-    GrayImage magnitude = compute_gradient_magnitude(&gray);
-    GrayImage orientation = compute_gradient_orientation(&gray);
+    // 计算方向平面
+    OrientationPlanes planes = create_orientation_planes(img->width, img->height);
+    compute_orientation_planes_gray16_into(&gray, &planes, SIFT_ORI_BINNING);
 
     // 在规则网格上提取SIFT特征
+    TRACE_BEGIN(sift);
     for (int y = step; y < img->height - step; y += step) {
         for (int x = step; x < img->width - step; x += step) {
             // 创建一个描述符
@@ -220,68 +286,541 @@ DescriptorList extract_dense_sift(const Image* img, int step) {
             desc.x = (float)x;
             desc.y = (float)y;
 
-            // SIFT描述符参数
-            int grid_size = 4;  // 4x4网格
-            int cell_size = 4;  // 每个单元格4x4像素
-            int bins = 8;       // 8个方向
+            compute_dense_descriptor(&planes, x, y, desc.data);
+
+            add_descriptor(&list, desc);
+        }
+    }
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, list.count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)list.count * SIFT_DESC_SIZE * sizeof(float));
+
+    free_gray16_image(&gray);
+    free_orientation_planes(&planes);
+
+    return list;
+}
+
+// 密集网格在一个方向上的采样点数
+int dense_sift_grid_count(int size, int step) {
+    if (step <= 0 || size <= 2 * step) {
+        return 0;
+    }
+    return (size - 2 * step + step - 1) / step;
+}
 
-            // 以(x,y)为中心提取描述符
-            int half_width = grid_size * cell_size / 2;
+// 在预分配的缓冲区上提取密集SIFT特征，不进行堆分配
+// descriptors 至少容纳 max_count * SIFT_DESC_SIZE 个float，positions 至少容纳 max_count * 2 个float
+int extract_dense_sift_into(const OrientationPlanes* planes, int step,
+                            float* descriptors, float* positions, int max_count) {
+    TRACE_BEGIN(sift);
+    int count = 0;
+
+    for (int y = step; y < planes->height - step && count < max_count; y += step) {
+        for (int x = step; x < planes->width - step && count < max_count; x += step) {
+            compute_dense_descriptor(planes, x, y, descriptors + (size_t)count * SIFT_DESC_SIZE);
+            positions[count * 2] = (float)x;
+            positions[count * 2 + 1] = (float)y;
+            count++;
+        }
+    }
 
-            for (int grid_y = 0; grid_y < grid_size; grid_y++) {
-                for (int grid_x = 0; grid_x < grid_size; grid_x++) {
-                    // 计算当前单元格的起始位置
-                    int cell_start_x = x - half_width + grid_x * cell_size;
-                    int cell_start_y = y - half_width + grid_y * cell_size;
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)count * SIFT_DESC_SIZE * sizeof(float));
+    return count;
+}
 
-                    // 遍历单元格内的每个像素
-                    for (int cell_y = 0; cell_y < cell_size; cell_y++) {
-                        for (int cell_x = 0; cell_x < cell_size; cell_x++) {
-                            int px = cell_start_x + cell_x;
-                            int py = cell_start_y + cell_y;
+// 分条处理: planes 只覆盖图像的一部分行，网格与边界判断仍按整幅图像进行
+int extract_dense_sift_rows_into(const OrientationPlanes* planes, int step, int row_offset, int image_height,
+                                 int y_begin, int y_end, float* descriptors, float* positions, int max_count) {
+    TRACE_BEGIN(sift);
+    int count = 0;
+    int y = y_begin > step ? (y_begin + step - 1) / step * step : step;
+
+    for (; y < y_end && y < image_height - step && count < max_count; y += step) {
+        for (int x = step; x < planes->width - step && count < max_count; x += step) {
+            compute_dense_descriptor(planes, x, y - row_offset, descriptors + (size_t)count * SIFT_DESC_SIZE);
+            positions[count * 2] = (float)x;
+            positions[count * 2 + 1] = (float)y;
+            count++;
+        }
+    }
 
-                            // 确保在图像边界内
-                            if (px >= 0 && px < img->width && py >= 0 && py < img->height) {
-                                float mag = get_pixel_gray(&magnitude, px, py);
-                                float angle = get_pixel_gray(&orientation, px, py);
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)count * SIFT_DESC_SIZE * sizeof(float));
+    return count;
+}
 
-                                // 将角度归一化到0-2PI
-                                if (angle < 0) angle += 2.0f * M_PI;
+int dense_grid_is_coarse(int x, int y, int step, int stride) {
+    return (x / step - 1) % stride == 0 && (y / step - 1) % stride == 0;
+}
 
-                                // 计算角度所在的bin
-                                int bin = (int)(bins * angle / (2.0f * M_PI)) % bins;
+// 只提取网格的一个子集，遍历顺序与 extract_dense_sift_into 相同
+int extract_dense_sift_subset_into(const OrientationPlanes* planes, int step, int stride, DenseGridSubset subset,
+                                   float* descriptors, float* positions, int max_count) {
+    TRACE_BEGIN(sift);
+    int count = 0;
 
-                                // 计算对应的描述符索引
-                                int descriptor_idx = (grid_y * grid_size + grid_x) * bins + bin;
+    for (int y = step; y < planes->height - step && count < max_count; y += step) {
+        for (int x = step; x < planes->width - step && count < max_count; x += step) {
+            if (dense_grid_is_coarse(x, y, step, stride) != (subset == DENSE_GRID_COARSE)) {
+                continue;
+            }
+            compute_dense_descriptor(planes, x, y, descriptors + (size_t)count * SIFT_DESC_SIZE);
+            positions[count * 2] = (float)x;
+            positions[count * 2 + 1] = (float)y;
+            count++;
+        }
+    }
 
-                                // 累加梯度幅值
-                                desc.data[descriptor_idx] += mag;
-                            }
-                        }
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)count * SIFT_DESC_SIZE * sizeof(float));
+    return count;
+}
+
+// 批量描述符: hist[(cell * SIFT_ORI_BINS + b) * IMAGE_BATCH_LANES + lane]
+// 单元格内逐像素累加、越界像素跳过，每个通道的累加顺序与 compute_grid_descriptor 相同
+#define BATCH_PLANE_STRIDE ((size_t)SIFT_ORI_BINS * IMAGE_BATCH_LANES)
+
+static void compute_batch_descriptor_scalar(const OrientationPlanesBatch* planes, int x, int y, float* hist) {
+    for (int cell = 0; cell < SIFT_GRID_SIZE * SIFT_GRID_SIZE; cell++) {
+        int cell_x0 = x - SIFT_HALF_WINDOW + (cell % SIFT_GRID_SIZE) * SIFT_CELL_SIZE;
+        int cell_y0 = y - SIFT_HALF_WINDOW + (cell / SIFT_GRID_SIZE) * SIFT_CELL_SIZE;
+        float* out = hist + cell * BATCH_PLANE_STRIDE;
+        memset(out, 0, BATCH_PLANE_STRIDE * sizeof(float));
+
+        for (int py = cell_y0; py < cell_y0 + SIFT_CELL_SIZE; py++) {
+            for (int px = cell_x0; px < cell_x0 + SIFT_CELL_SIZE; px++) {
+                if (px >= 0 && px < planes->width && py >= 0 && py < planes->height) {
+                    const float* pixel = planes->data + ((size_t)py * planes->width + px) * BATCH_PLANE_STRIDE;
+                    for (size_t i = 0; i < BATCH_PLANE_STRIDE; i++) {
+                        out[i] += pixel[i];
                     }
                 }
             }
+        }
+    }
 
-            // 归一化描述符
-            float sum = 0.0f;
+    // 逐通道归一化，平方和的累加顺序与 normalize_descriptor 相同
+    float sums[IMAGE_BATCH_LANES] = {0};
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+            float v = hist[i * IMAGE_BATCH_LANES + lane];
+            sums[lane] += v * v;
+        }
+    }
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        if (sums[lane] > 0) {
+            float norm = 1.0f / sqrtf(sums[lane]);
             for (int i = 0; i < SIFT_DESC_SIZE; i++) {
-                sum += desc.data[i] * desc.data[i];
+                hist[i * IMAGE_BATCH_LANES + lane] *= norm;
             }
+        }
+    }
+}
+
+#ifdef SIFT_HAVE_X86
 
-            if (sum > 0) {
-                float norm = 1.0f / sqrtf(sum);
+__attribute__((target("avx2")))
+static void compute_batch_descriptor_avx2(const OrientationPlanesBatch* planes, int x, int y, float* hist) {
+    for (int cell = 0; cell < SIFT_GRID_SIZE * SIFT_GRID_SIZE; cell++) {
+        int cell_x0 = x - SIFT_HALF_WINDOW + (cell % SIFT_GRID_SIZE) * SIFT_CELL_SIZE;
+        int cell_y0 = y - SIFT_HALF_WINDOW + (cell / SIFT_GRID_SIZE) * SIFT_CELL_SIZE;
+        __m256 acc[SIFT_ORI_BINS];
+        for (int b = 0; b < SIFT_ORI_BINS; b++) {
+            acc[b] = _mm256_setzero_ps();
+        }
+
+        for (int py = cell_y0; py < cell_y0 + SIFT_CELL_SIZE; py++) {
+            for (int px = cell_x0; px < cell_x0 + SIFT_CELL_SIZE; px++) {
+                if (px >= 0 && px < planes->width && py >= 0 && py < planes->height) {
+                    const float* pixel = planes->data + ((size_t)py * planes->width + px) * BATCH_PLANE_STRIDE;
+                    for (int b = 0; b < SIFT_ORI_BINS; b++) {
+                        acc[b] = _mm256_add_ps(acc[b], _mm256_loadu_ps(pixel + b * IMAGE_BATCH_LANES));
+                    }
+                }
+            }
+        }
+
+        for (int b = 0; b < SIFT_ORI_BINS; b++) {
+            _mm256_storeu_ps(hist + cell * BATCH_PLANE_STRIDE + b * IMAGE_BATCH_LANES, acc[b]);
+        }
+    }
+
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        __m256 v = _mm256_loadu_ps(hist + i * IMAGE_BATCH_LANES);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+    }
+    // 平方和为0的通道保持不变 (避免 0*inf)
+    __m256 nonzero = _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_GT_OQ);
+    __m256 norm = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(sum));
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        __m256 v = _mm256_loadu_ps(hist + i * IMAGE_BATCH_LANES);
+        _mm256_storeu_ps(hist + i * IMAGE_BATCH_LANES, _mm256_blendv_ps(v, _mm256_mul_ps(v, norm), nonzero));
+    }
+}
+
+static int sift_use_avx2 = -1;
+static int sift_use_fma = -1;
+
+static int detect_sift_kernel(void) {
+    if (sift_use_avx2 < 0) {
+        __builtin_cpu_init();
+        sift_use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return sift_use_avx2;
+}
+
+static int detect_sift_fma_kernel(void) {
+    if (sift_use_fma < 0) {
+        sift_use_fma = detect_sift_kernel() && __builtin_cpu_supports("fma") ? 1 : 0;
+    }
+    return sift_use_fma;
+}
+
+#endif /* SIFT_HAVE_X86 */
+
+int extract_dense_sift_batch_into(const OrientationPlanesBatch* planes, int step, float* const* descriptors,
+                                  float* positions, int max_count) {
+    TRACE_BEGIN(sift);
+    float hist[SIFT_DESC_SIZE * IMAGE_BATCH_LANES];
+    void (*kernel)(const OrientationPlanesBatch*, int, int, float*) = compute_batch_descriptor_scalar;
+#ifdef SIFT_HAVE_X86
+    if (detect_sift_kernel()) {
+        kernel = compute_batch_descriptor_avx2;
+    }
+#endif
+    int count = 0;
+
+    for (int y = step; y < planes->height - step && count < max_count; y += step) {
+        for (int x = step; x < planes->width - step && count < max_count; x += step) {
+            kernel(planes, x, y, hist);
+
+            // 转置回每幅图像各自的描述符
+            for (int lane = 0; lane < planes->count; lane++) {
+                if (!descriptors[lane]) {
+                    continue;
+                }
+                float* out = descriptors[lane] + (size_t)count * SIFT_DESC_SIZE;
                 for (int i = 0; i < SIFT_DESC_SIZE; i++) {
-                    desc.data[i] *= norm;
+                    out[i] = hist[i * IMAGE_BATCH_LANES + lane];
                 }
             }
+            positions[count * 2] = (float)x;
+            positions[count * 2 + 1] = (float)y;
+            count++;
+        }
+    }
 
-            add_descriptor(&list, desc);
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, count * planes->count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)count * planes->count * SIFT_DESC_SIZE * sizeof(float));
+    return count;
+}
+
+// 三线性插值描述符
+// 窗口内像素 i (0-15) 的中心位于单元格坐标 c = (i + 0.5) / SIFT_CELL_SIZE - 0.5，按小数部分双线性地计入
+// 相邻两个单元格。为去掉分支，直方图两侧各补一行/一列单元格 (padded 坐标 = 单元格坐标 + 1)，
+// 像素 i 总是计入 padded 列 (i + 2) / 4 与其右侧一列，补出的单元格最后丢弃
+#define SIFT_PATCH_SIZE (SIFT_GRID_SIZE * SIFT_CELL_SIZE)
+#define SIFT_PATCH_SIGMA (0.5f * SIFT_PATCH_SIZE)
+#define SIFT_PADDED_GRID (SIFT_GRID_SIZE + 2)
+#define PADDED_CELL_FIRST(i) (((i) + SIFT_CELL_SIZE / 2) / SIFT_CELL_SIZE)
+
+// 每个像素对 (上,左) (上,右) (下,左) (下,右) 四个 padded 单元格的权重 = 高斯空间权重 × 两个方向的插值系数
+static float trilinear_weights[SIFT_PATCH_SIZE * SIFT_PATCH_SIZE][4];
+static pthread_once_t trilinear_once = PTHREAD_ONCE_INIT;
+
+static void build_trilinear_weights(void) {
+    float frac[SIFT_PATCH_SIZE];
+    float gauss[SIFT_PATCH_SIZE];
+    for (int i = 0; i < SIFT_PATCH_SIZE; i++) {
+        float c = (i + 0.5f) / SIFT_CELL_SIZE - 0.5f;
+        frac[i] = c - (float)(PADDED_CELL_FIRST(i) - 1);
+        float d = (i + 0.5f) - 0.5f * SIFT_PATCH_SIZE;
+        gauss[i] = expf(-d * d / (2.0f * SIFT_PATCH_SIGMA * SIFT_PATCH_SIGMA));
+    }
+
+    for (int py = 0; py < SIFT_PATCH_SIZE; py++) {
+        for (int px = 0; px < SIFT_PATCH_SIZE; px++) {
+            float g = gauss[py] * gauss[px];
+            float* w = trilinear_weights[py * SIFT_PATCH_SIZE + px];
+            w[0] = g * (1.0f - frac[py]) * (1.0f - frac[px]);
+            w[1] = g * (1.0f - frac[py]) * frac[px];
+            w[2] = g * frac[py] * (1.0f - frac[px]);
+            w[3] = g * frac[py] * frac[px];
         }
     }
+}
 
-    free_gray_image(&gray);
-    free_gray_image(&magnitude);
-    free_gray_image(&orientation);
+// 去掉补出的单元格并归一化
+static void finish_trilinear_descriptor(const float* padded, float* descriptor) {
+    for (int cy = 0; cy < SIFT_GRID_SIZE; cy++) {
+        const float* row = padded + ((size_t)(cy + 1) * SIFT_PADDED_GRID + 1) * SIFT_ORI_BINS;
+        memcpy(descriptor + (size_t)cy * SIFT_GRID_SIZE * SIFT_ORI_BINS, row,
+               SIFT_GRID_SIZE * SIFT_ORI_BINS * sizeof(float));
+    }
+    normalize_descriptor(descriptor);
+}
+
+static void compute_trilinear_descriptor_scalar(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    float padded[SIFT_PADDED_GRID * SIFT_PADDED_GRID * SIFT_ORI_BINS] = {0};
+
+    for (int py = 0; py < SIFT_PATCH_SIZE; py++) {
+        int iy = y - SIFT_HALF_WINDOW + py;
+        if (iy < 0 || iy >= planes->height) {
+            continue;
+        }
+        float* upper = padded + (size_t)PADDED_CELL_FIRST(py) * SIFT_PADDED_GRID * SIFT_ORI_BINS;
+
+        for (int px = 0; px < SIFT_PATCH_SIZE; px++) {
+            int ix = x - SIFT_HALF_WINDOW + px;
+            if (ix < 0 || ix >= planes->width) {
+                continue;
+            }
+            const float* pixel = planes->data + ((size_t)iy * planes->width + ix) * SIFT_ORI_BINS;
+            const float* w = trilinear_weights[py * SIFT_PATCH_SIZE + px];
+            // 四个单元格相对于左上单元格的偏移为常量，编译器可以确定它们互不重叠并向量化
+            float* cell = upper + PADDED_CELL_FIRST(px) * SIFT_ORI_BINS;
+            for (int b = 0; b < SIFT_ORI_BINS; b++) {
+                cell[b] += w[0] * pixel[b];
+                cell[SIFT_ORI_BINS + b] += w[1] * pixel[b];
+                cell[SIFT_PADDED_GRID * SIFT_ORI_BINS + b] += w[2] * pixel[b];
+                cell[(SIFT_PADDED_GRID + 1) * SIFT_ORI_BINS + b] += w[3] * pixel[b];
+            }
+        }
+    }
+
+    finish_trilinear_descriptor(padded, descriptor);
+}
+
+#ifdef SIFT_HAVE_X86
+
+// 每行涉及的两行 padded 单元格 (12个向量) 在整行内保持在寄存器中；列循环完全展开后单元格下标为常量
+// 每个像素: 1次载入8个bin，4次广播权重与乘加。CHECK 为0时窗口须完全位于图像内
+__attribute__((target("avx2,fma"), always_inline))
+static inline void trilinear_descriptor_avx2(const OrientationPlanes* planes, int x, int y, float* descriptor,
+                                             const int check) {
+    float padded[SIFT_PADDED_GRID * SIFT_PADDED_GRID * SIFT_ORI_BINS] = {0};
+
+    for (int py = 0; py < SIFT_PATCH_SIZE; py++) {
+        int iy = y - SIFT_HALF_WINDOW + py;
+        if (check && (iy < 0 || iy >= planes->height)) {
+            continue;
+        }
+        float* upper = padded + (size_t)PADDED_CELL_FIRST(py) * SIFT_PADDED_GRID * SIFT_ORI_BINS;
+        float* lower = upper + SIFT_PADDED_GRID * SIFT_ORI_BINS;
+        const float* row = planes->data + ((size_t)iy * planes->width + (x - SIFT_HALF_WINDOW)) * SIFT_ORI_BINS;
+        const float (*w)[4] = trilinear_weights + py * SIFT_PATCH_SIZE;
+
+        __m256 acc_upper[SIFT_PADDED_GRID], acc_lower[SIFT_PADDED_GRID];
+        UNROLL_LOOP
+        for (int c = 0; c < SIFT_PADDED_GRID; c++) {
+            acc_upper[c] = _mm256_loadu_ps(upper + c * SIFT_ORI_BINS);
+            acc_lower[c] = _mm256_loadu_ps(lower + c * SIFT_ORI_BINS);
+        }
+
+        UNROLL_LOOP
+        for (int px = 0; px < SIFT_PATCH_SIZE; px++) {
+            int ix = x - SIFT_HALF_WINDOW + px;
+            if (check && (ix < 0 || ix >= planes->width)) {
+                continue;
+            }
+            __m256 v = _mm256_loadu_ps(row + px * SIFT_ORI_BINS);
+            const int c = PADDED_CELL_FIRST(px);
+            acc_upper[c] = _mm256_fmadd_ps(_mm256_broadcast_ss(&w[px][0]), v, acc_upper[c]);
+            acc_upper[c + 1] = _mm256_fmadd_ps(_mm256_broadcast_ss(&w[px][1]), v, acc_upper[c + 1]);
+            acc_lower[c] = _mm256_fmadd_ps(_mm256_broadcast_ss(&w[px][2]), v, acc_lower[c]);
+            acc_lower[c + 1] = _mm256_fmadd_ps(_mm256_broadcast_ss(&w[px][3]), v, acc_lower[c + 1]);
+        }
+
+        UNROLL_LOOP
+        for (int c = 0; c < SIFT_PADDED_GRID; c++) {
+            _mm256_storeu_ps(upper + c * SIFT_ORI_BINS, acc_upper[c]);
+            _mm256_storeu_ps(lower + c * SIFT_ORI_BINS, acc_lower[c]);
+        }
+    }
+
+    finish_trilinear_descriptor(padded, descriptor);
+}
+
+__attribute__((target("avx2,fma")))
+static void compute_trilinear_interior_avx2(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    trilinear_descriptor_avx2(planes, x, y, descriptor, 0);
+}
+
+__attribute__((target("avx2,fma")))
+static void compute_trilinear_border_avx2(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    trilinear_descriptor_avx2(planes, x, y, descriptor, 1);
+}
+
+#endif /* SIFT_HAVE_X86 */
+
+const char* sift_trilinear_kernel_name(void) {
+#ifdef SIFT_HAVE_X86
+    if (detect_sift_fma_kernel()) {
+        return "avx2+fma";
+    }
+#endif
+    return "scalar";
+}
+
+void compute_trilinear_descriptor(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    pthread_once(&trilinear_once, build_trilinear_weights);
+#ifdef SIFT_HAVE_X86
+    if (detect_sift_fma_kernel()) {
+        if (x < SIFT_HALF_WINDOW || y < SIFT_HALF_WINDOW ||
+            x + SIFT_HALF_WINDOW > planes->width || y + SIFT_HALF_WINDOW > planes->height) {
+            compute_trilinear_border_avx2(planes, x, y, descriptor);
+        } else {
+            compute_trilinear_interior_avx2(planes, x, y, descriptor);
+        }
+        return;
+    }
+#endif
+    compute_trilinear_descriptor_scalar(planes, x, y, descriptor);
+}
+
+int extract_dense_sift_trilinear_into(const OrientationPlanes* planes, int step,
+                                      float* descriptors, float* positions, int max_count) {
+    TRACE_BEGIN(sift);
+    int count = 0;
+
+    for (int y = step; y < planes->height - step && count < max_count; y += step) {
+        for (int x = step; x < planes->width - step && count < max_count; x += step) {
+            compute_trilinear_descriptor(planes, x, y, descriptors + (size_t)count * SIFT_DESC_SIZE);
+            positions[count * 2] = (float)x;
+            positions[count * 2 + 1] = (float)y;
+            count++;
+        }
+    }
+
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)count * SIFT_DESC_SIZE * sizeof(float));
+    return count;
+}
+
+// 由方向平面构建积分图
+OrientationIntegral build_orientation_integral(const OrientationPlanes* planes) {
+    OrientationIntegral integral;
+    integral.width = planes->width;
+    integral.height = planes->height;
+
+    int stride = (integral.width + 1) * SIFT_ORI_BINS;
+    integral.sums = (double*)MEM_CALLOC((size_t)stride * (integral.height + 1), sizeof(double));
+    if (!integral.sums) {
+        fprintf(stderr, "Error: Memory allocation failed for orientation integral\n");
+        exit(EXIT_FAILURE);
+    }
+
+    TRACE_BEGIN(integral);
+    double row_sums[SIFT_ORI_BINS];
+    for (int y = 0; y < integral.height; y++) {
+        const double* above = integral.sums + (size_t)y * stride;
+        double* current = integral.sums + (size_t)(y + 1) * stride;
+        memset(row_sums, 0, sizeof(row_sums));
+
+        for (int x = 0; x < integral.width; x++) {
+            const float* pixel = planes->data + ((size_t)y * planes->width + x) * SIFT_ORI_BINS;
+            const double* up = above + (x + 1) * SIFT_ORI_BINS;
+            double* out = current + (x + 1) * SIFT_ORI_BINS;
+            for (int b = 0; b < SIFT_ORI_BINS; b++) {
+                row_sums[b] += pixel[b];
+                out[b] = up[b] + row_sums[b];
+            }
+        }
+    }
+    TRACE_END(integral, TRACE_STAGE_INTEGRAL, (size_t)stride * (integral.height + 1) * sizeof(double));
+
+    return integral;
+}
+
+void free_orientation_integral(OrientationIntegral* integral) {
+    if (integral && integral->sums) {
+        MEM_FREE(integral->sums);
+        integral->sums = NULL;
+        integral->width = 0;
+        integral->height = 0;
+    }
+}
+
+// 矩形 [x0,x1)x[y0,y1) 内的方向直方图，矩形先裁剪到图像范围内
+static void integral_cell_histogram(const OrientationIntegral* integral, int x0, int y0, int x1, int y1,
+                                    float* histogram) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > integral->width) x1 = integral->width;
+    if (y1 > integral->height) y1 = integral->height;
+
+    if (x0 >= x1 || y0 >= y1) {
+        memset(histogram, 0, SIFT_ORI_BINS * sizeof(float));
+        return;
+    }
+
+    int stride = (integral->width + 1) * SIFT_ORI_BINS;
+    const double* a = integral->sums + (size_t)y0 * stride + x0 * SIFT_ORI_BINS;
+    const double* b = integral->sums + (size_t)y0 * stride + x1 * SIFT_ORI_BINS;
+    const double* c = integral->sums + (size_t)y1 * stride + x0 * SIFT_ORI_BINS;
+    const double* d = integral->sums + (size_t)y1 * stride + x1 * SIFT_ORI_BINS;
+    for (int bin = 0; bin < SIFT_ORI_BINS; bin++) {
+        histogram[bin] = (float)(d[bin] - b[bin] - c[bin] + a[bin]);
+    }
+}
+
+// 从积分图计算描述符，每个单元格只需4次查表
+void compute_integral_descriptor(const OrientationIntegral* integral, int x, int y, int cell_size, float* descriptor) {
+    int half_width = SIFT_GRID_SIZE * cell_size / 2;
+
+    for (int grid_y = 0; grid_y < SIFT_GRID_SIZE; grid_y++) {
+        for (int grid_x = 0; grid_x < SIFT_GRID_SIZE; grid_x++) {
+            int cell_start_x = x - half_width + grid_x * cell_size;
+            int cell_start_y = y - half_width + grid_y * cell_size;
+            float* histogram = descriptor + (grid_y * SIFT_GRID_SIZE + grid_x) * SIFT_ORI_BINS;
+
+            integral_cell_histogram(integral, cell_start_x, cell_start_y,
+                                    cell_start_x + cell_size, cell_start_y + cell_size, histogram);
+        }
+    }
+
+    normalize_descriptor(descriptor);
+}
+
+// 多尺度密集SIFT: 梯度与积分图只计算一次，各尺度的代价只与网格点数有关
+DescriptorList extract_dense_sift_multiscale(const Image* img, int step, const int* cell_sizes, int num_scales) {
+    int grid_w = dense_sift_grid_count(img->width, step);
+    int grid_h = dense_sift_grid_count(img->height, step);
+
+    if (grid_w == 0 || grid_h == 0 || num_scales <= 0) {
+        return create_descriptor_list(0);
+    }
+
+    ImageView view = image_view(img);
+    Gray16Image gray = create_gray16_image(img->width, img->height);
+    convert_view_to_gray16_into(&view, &gray);
+    OrientationPlanes planes = create_orientation_planes(img->width, img->height);
+    compute_orientation_planes_gray16_into(&gray, &planes, SIFT_ORI_BINNING);
+    OrientationIntegral integral = build_orientation_integral(&planes);
+
+    // 一次性分配描述符数组，避免逐个 realloc
+    DescriptorList list = create_descriptor_list(grid_w * grid_h * num_scales);
+
+    TRACE_BEGIN(sift);
+    for (int s = 0; s < num_scales; s++) {
+        for (int y = step; y < img->height - step; y += step) {
+            for (int x = step; x < img->width - step; x += step) {
+                Descriptor desc = create_descriptor(SIFT_DESC_SIZE);
+                desc.x = (float)x;
+                desc.y = (float)y;
+                compute_integral_descriptor(&integral, x, y, cell_sizes[s], desc.data);
+                list.descriptors[list.count++] = desc;
+            }
+        }
+    }
+    TRACE_COUNT(TRACE_STAGE_DENSE_SIFT, list.count);
+    TRACE_END(sift, TRACE_STAGE_DENSE_SIFT, (size_t)list.count * SIFT_DESC_SIZE * sizeof(float));
+
+    free_orientation_integral(&integral);
+    free_gray16_image(&gray);
+    free_orientation_planes(&planes);
 
     return list;
-}
\ No newline at end of file
+}
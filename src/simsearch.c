@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_SPM
+#include "simsearch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMSEARCH_HAVE_X86 1
+#endif
+
+// 标量内核: 一个查询对一个图库向量
+static float similarity_scalar(const float* a, const float* b, int length, SpmSimilarity kind) {
+    float sum = 0.0f;
+    switch (kind) {
+        case SPM_SIMILARITY_CHI2:
+            for (int i = 0; i < length; i++) {
+                float s = a[i] + b[i];
+                if (s > 0) {
+                    float d = a[i] - b[i];
+                    sum += (d * d) / s;
+                }
+            }
+            return 1.0f - sum;
+        case SPM_SIMILARITY_INTERSECTION:
+            for (int i = 0; i < length; i++) {
+                sum += a[i] < b[i] ? a[i] : b[i];
+            }
+            return sum;
+        case SPM_SIMILARITY_L2:
+        default:
+            for (int i = 0; i < length; i++) {
+                float d = a[i] - b[i];
+                sum += d * d;
+            }
+            return -sum;
+    }
+}
+
+#ifdef SIMSEARCH_HAVE_X86
+
+__attribute__((target("avx2")))
+static inline float hsum256(__m256 v) {
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 0x55));
+    return _mm_cvtss_f32(sum4);
+}
+
+// nq (<= SIMSEARCH_QUERY_BLOCK) 个查询对一个图库向量: 图库的每8个分量只载入一次，供各查询共用
+// 以常数 nq 调用时循环会被完全展开
+__attribute__((target("avx2,fma"), always_inline))
+static inline void similarity_rows_avx2(const float* const* queries, int nq, const float* g, int length,
+                                        SpmSimilarity kind, float* out) {
+    __m256 acc[SIMSEARCH_QUERY_BLOCK];
+    for (int j = 0; j < nq; j++) {
+        acc[j] = _mm256_setzero_ps();
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+
+    switch (kind) {
+        case SPM_SIMILARITY_CHI2:
+            for (; i + 8 <= length; i += 8) {
+                __m256 vg = _mm256_loadu_ps(g + i);
+                for (int j = 0; j < nq; j++) {
+                    __m256 vq = _mm256_loadu_ps(queries[j] + i);
+                    __m256 s = _mm256_add_ps(vq, vg);
+                    __m256 d = _mm256_sub_ps(vq, vg);
+                    // 0/0 的分量被掩码清零
+                    __m256 t = _mm256_div_ps(_mm256_mul_ps(d, d), s);
+                    acc[j] = _mm256_add_ps(acc[j], _mm256_and_ps(t, _mm256_cmp_ps(s, zero, _CMP_GT_OQ)));
+                }
+            }
+            break;
+        case SPM_SIMILARITY_INTERSECTION:
+            for (; i + 8 <= length; i += 8) {
+                __m256 vg = _mm256_loadu_ps(g + i);
+                for (int j = 0; j < nq; j++) {
+                    acc[j] = _mm256_add_ps(acc[j], _mm256_min_ps(_mm256_loadu_ps(queries[j] + i), vg));
+                }
+            }
+            break;
+        case SPM_SIMILARITY_L2:
+        default:
+            for (; i + 8 <= length; i += 8) {
+                __m256 vg = _mm256_loadu_ps(g + i);
+                for (int j = 0; j < nq; j++) {
+                    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(queries[j] + i), vg);
+                    acc[j] = _mm256_fmadd_ps(d, d, acc[j]);
+                }
+            }
+            break;
+    }
+
+    // 尾部分量用标量内核 (其结果带有 chi2 的常数项1，合并时保留)
+    for (int j = 0; j < nq; j++) {
+        float tail = similarity_scalar(queries[j] + i, g + i, length - i, kind);
+        float sum = hsum256(acc[j]);
+        out[j] = kind == SPM_SIMILARITY_INTERSECTION ? tail + sum : tail - sum;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void similarity_block_avx2(const float* const* queries, const float* g, int length, SpmSimilarity kind,
+                                  float* out) {
+    similarity_rows_avx2(queries, SIMSEARCH_QUERY_BLOCK, g, length, kind, out);
+}
+
+__attribute__((target("avx2,fma")))
+static float similarity_pair_avx2(const float* a, const float* b, int length, SpmSimilarity kind) {
+    float out;
+    similarity_rows_avx2(&a, 1, b, length, kind, &out);
+    return out;
+}
+
+#endif /* SIMSEARCH_HAVE_X86 */
+
+// 运行时选择内核
+typedef enum {
+    SIMSEARCH_KERNEL_UNKNOWN = 0,
+    SIMSEARCH_KERNEL_SCALAR,
+    SIMSEARCH_KERNEL_AVX2
+} SimSearchKernel;
+
+static SimSearchKernel simsearch_kernel = SIMSEARCH_KERNEL_UNKNOWN;
+
+static SimSearchKernel detect_simsearch_kernel(void) {
+    if (simsearch_kernel == SIMSEARCH_KERNEL_UNKNOWN) {
+        SimSearchKernel kernel = SIMSEARCH_KERNEL_SCALAR;
+#ifdef SIMSEARCH_HAVE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernel = SIMSEARCH_KERNEL_AVX2;
+        }
+#endif
+        simsearch_kernel = kernel;
+    }
+    return simsearch_kernel;
+}
+
+const char* simsearch_kernel_name(void) {
+    return detect_simsearch_kernel() == SIMSEARCH_KERNEL_AVX2 ? "avx2" : "scalar";
+}
+
+// SIMSEARCH_QUERY_BLOCK 个查询对一个图库向量
+static void similarity_block(const float* const* queries, const float* g, int length, SpmSimilarity kind,
+                             float* out) {
+#ifdef SIMSEARCH_HAVE_X86
+    if (detect_simsearch_kernel() == SIMSEARCH_KERNEL_AVX2) {
+        similarity_block_avx2(queries, g, length, kind, out);
+        return;
+    }
+#endif
+    for (int j = 0; j < SIMSEARCH_QUERY_BLOCK; j++) {
+        out[j] = similarity_scalar(queries[j], g, length, kind);
+    }
+}
+
+float spm_similarity(const float* a, const float* b, int length, SpmSimilarity kind) {
+#ifdef SIMSEARCH_HAVE_X86
+    if (detect_simsearch_kernel() == SIMSEARCH_KERNEL_AVX2) {
+        return similarity_pair_avx2(a, b, length, kind);
+    }
+#endif
+    return similarity_scalar(a, b, length, kind);
+}
+
+// a 排在 b 之后 (相似度更低，同分时下标更大)
+static int hit_worse(const IndexHit* a, const IndexHit* b) {
+    return a->score < b->score || (a->score == b->score && a->doc > b->doc);
+}
+
+static int compare_hits(const void* a, const void* b) {
+    const IndexHit* x = (const IndexHit*)a;
+    const IndexHit* y = (const IndexHit*)b;
+    return hit_worse(x, y) ? 1 : (hit_worse(y, x) ? -1 : 0);
+}
+
+// 大小为 k 的最小堆，堆顶为当前最差的命中
+typedef struct {
+    IndexHit* hits;
+    int count;
+} TopK;
+
+static void topk_offer(TopK* heap, int k, IndexHit hit) {
+    IndexHit* h = heap->hits;
+    int pos;
+    if (heap->count < k) {
+        pos = heap->count++;
+        while (pos > 0) {
+            int parent = (pos - 1) / 2;
+            if (!hit_worse(&hit, &h[parent])) break;
+            h[pos] = h[parent];
+            pos = parent;
+        }
+        h[pos] = hit;
+        return;
+    }
+    if (!hit_worse(&h[0], &hit)) {
+        return;
+    }
+
+    pos = 0;
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && hit_worse(&h[child + 1], &h[child])) child++;
+        if (!hit_worse(&h[child], &hit)) break;
+        h[pos] = h[child];
+        pos = child;
+    }
+    h[pos] = hit;
+}
+
+typedef struct {
+    const SpmHistogram* queries;
+    int num_queries;
+    const SpmHistogram* gallery;
+    int num_gallery;
+    int length;
+    SpmSimilarity kind;
+    int k;
+    int tile_gallery;          // 一个分块中的图库数 (约 SIMSEARCH_TILE_BYTES)
+    int group_queries;         // 一个工作项中的查询数 (SIMSEARCH_QUERY_BLOCK 的倍数)
+    int stripe_gallery;        // 一个工作项中的图库数 (若干分块)
+    int num_groups;
+    int num_stripes;
+    atomic_int next_item;
+} SearchJob;
+
+typedef struct {
+    SearchJob* job;
+    TopK* heaps;               // 每个查询一个
+    IndexHit* storage;
+} SearchWorker;
+
+// 一个工作项: 一组查询对一段图库
+// 图库按分块遍历，每个分块在缓存中时依次与组内所有查询块计算，结果立即并入各查询的堆
+static void search_item(SearchJob* job, SearchWorker* worker, int item) {
+    int group = item % job->num_groups;
+    int stripe = item / job->num_groups;
+    int q_begin = group * job->group_queries;
+    int q_end = q_begin + job->group_queries < job->num_queries ? q_begin + job->group_queries : job->num_queries;
+    int g_begin = stripe * job->stripe_gallery;
+    int g_end = g_begin + job->stripe_gallery < job->num_gallery ? g_begin + job->stripe_gallery : job->num_gallery;
+
+    float scores[SIMSEARCH_QUERY_BLOCK];
+    for (int tile = g_begin; tile < g_end; tile += job->tile_gallery) {
+        int tile_end = tile + job->tile_gallery < g_end ? tile + job->tile_gallery : g_end;
+
+        for (int q0 = q_begin; q0 < q_end; q0 += SIMSEARCH_QUERY_BLOCK) {
+            int nq = q_end - q0 < SIMSEARCH_QUERY_BLOCK ? q_end - q0 : SIMSEARCH_QUERY_BLOCK;
+            if (nq < SIMSEARCH_QUERY_BLOCK) {
+                // 不足一个查询块的剩余查询逐个计算
+                for (int j = 0; j < nq; j++) {
+                    const float* row = job->queries[q0 + j].histogram;
+                    for (int g = tile; g < tile_end; g++) {
+                        float score = spm_similarity(row, job->gallery[g].histogram, job->length, job->kind);
+                        topk_offer(&worker->heaps[q0 + j], job->k, (IndexHit){g, score});
+                    }
+                }
+                continue;
+            }
+
+            const float* rows[SIMSEARCH_QUERY_BLOCK];
+            for (int j = 0; j < SIMSEARCH_QUERY_BLOCK; j++) {
+                rows[j] = job->queries[q0 + j].histogram;
+            }
+            for (int g = tile; g < tile_end; g++) {
+                similarity_block(rows, job->gallery[g].histogram, job->length, job->kind, scores);
+                for (int j = 0; j < SIMSEARCH_QUERY_BLOCK; j++) {
+                    topk_offer(&worker->heaps[q0 + j], job->k, (IndexHit){g, scores[j]});
+                }
+            }
+        }
+    }
+}
+
+static void* search_worker_main(void* arg) {
+    SearchWorker* worker = (SearchWorker*)arg;
+    SearchJob* job = worker->job;
+    int num_items = job->num_groups * job->num_stripes;
+
+    for (;;) {
+        int item = atomic_fetch_add(&job->next_item, 1);
+        if (item >= num_items) {
+            break;
+        }
+        search_item(job, worker, item);
+    }
+    return NULL;
+}
+
+int spm_topk_search(const SpmHistogram* queries, int num_queries, const SpmHistogram* gallery, int num_gallery,
+                    SpmSimilarity kind, int k, int num_threads, IndexHit* hits, int* num_hits,
+                    SimSearchStats* stats) {
+    if (num_queries <= 0 || k <= 0) {
+        return 1;
+    }
+    int length = queries[0].length;
+    for (int i = 0; i < num_queries; i++) {
+        if (queries[i].length != length) return 0;
+    }
+    for (int i = 0; i < num_gallery; i++) {
+        if (gallery[i].length != length) return 0;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    SearchJob job;
+    job.queries = queries;
+    job.num_queries = num_queries;
+    job.gallery = gallery;
+    job.num_gallery = num_gallery;
+    job.length = length;
+    job.kind = kind;
+    job.k = k;
+    size_t row_bytes = (size_t)length * sizeof(float);
+    job.tile_gallery = row_bytes < SIMSEARCH_TILE_BYTES ? (int)(SIMSEARCH_TILE_BYTES / row_bytes) : 1;
+    // 查询组与图库分块大小相近，两者同时留在缓存中
+    job.group_queries = (job.tile_gallery + SIMSEARCH_QUERY_BLOCK - 1) / SIMSEARCH_QUERY_BLOCK * SIMSEARCH_QUERY_BLOCK;
+    job.num_groups = (num_queries + job.group_queries - 1) / job.group_queries;
+
+    // 查询组数不足以分给所有线程时，把图库切成多段
+    if (num_threads < 1) num_threads = 1;
+    int stripes = (num_threads * 4 + job.num_groups - 1) / job.num_groups;
+    int max_stripes = (num_gallery + job.tile_gallery - 1) / job.tile_gallery;
+    if (stripes > max_stripes) stripes = max_stripes;
+    if (stripes < 1) stripes = 1;
+    job.stripe_gallery = (num_gallery + stripes - 1) / stripes;
+    job.num_stripes = job.stripe_gallery > 0 ? (num_gallery + job.stripe_gallery - 1) / job.stripe_gallery : 0;
+    atomic_init(&job.next_item, 0);
+
+    SearchWorker* workers = (SearchWorker*)MEM_MALLOC(num_threads * sizeof(SearchWorker));
+    pthread_t* threads = (pthread_t*)MEM_MALLOC(num_threads * sizeof(pthread_t));
+    for (int t = 0; t < num_threads; t++) {
+        workers[t].job = &job;
+        workers[t].heaps = (TopK*)MEM_MALLOC(num_queries * sizeof(TopK));
+        workers[t].storage = (IndexHit*)MEM_MALLOC((size_t)num_queries * k * sizeof(IndexHit));
+        if (!workers[t].heaps || !workers[t].storage) {
+            fprintf(stderr, "Error: Memory allocation failed for similarity search\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int q = 0; q < num_queries; q++) {
+            workers[t].heaps[q] = (TopK){workers[t].storage + (size_t)q * k, 0};
+        }
+    }
+    for (int t = 1; t < num_threads; t++) {
+        pthread_create(&threads[t], NULL, search_worker_main, &workers[t]);
+    }
+    search_worker_main(&workers[0]);
+    for (int t = 1; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // 合并各线程的堆
+    for (int q = 0; q < num_queries; q++) {
+        TopK merged = {hits + (size_t)q * k, 0};
+        for (int t = 0; t < num_threads; t++) {
+            for (int i = 0; i < workers[t].heaps[q].count; i++) {
+                topk_offer(&merged, k, workers[t].heaps[q].hits[i]);
+            }
+        }
+        qsort(merged.hits, merged.count, sizeof(IndexHit), compare_hits);
+        num_hits[q] = merged.count;
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+        MEM_FREE(workers[t].heaps);
+        MEM_FREE(workers[t].storage);
+    }
+    MEM_FREE(workers);
+    MEM_FREE(threads);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (stats) {
+        stats->pairs = (int64_t)num_queries * num_gallery;
+        stats->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        stats->pairs_per_second = stats->seconds > 0 ? stats->pairs / stats->seconds : 0.0;
+    }
+    return 1;
+}
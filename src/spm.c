@@ -1,14 +1,32 @@
+#define MEMTRACK_TAG MEM_TAG_SPM
 #include "spm.h"
 #include "kmeans.h"
+#include "sift.h"
+#include "cache.h"
+#include "trace.h"
+#include "sampler.h"
+#include "rng.h"
+#include "simsearch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+// 特征缓存 (NULL表示不使用缓存)
+static FeatureCache* spm_cache = NULL;
+
+void spm_set_feature_cache(FeatureCache* cache) {
+    spm_cache = cache;
+}
+
+FeatureCache* spm_get_feature_cache(void) {
+    return spm_cache;
+}
+
 // 将图像分成金字塔层次的网格并提取描述符
 DescriptorList* extract_pyramid_descriptors(const Image* img, int level) {
     // 根据 SPM 的 level，将图像分成网格
     int grid_size = 1 << level; // 2^level
-    DescriptorList* descriptors = (DescriptorList*)malloc(grid_size * grid_size * sizeof(DescriptorList));
+    DescriptorList* descriptors = (DescriptorList*)MEM_MALLOC(grid_size * grid_size * sizeof(DescriptorList));
 
     int cell_width = img->width / grid_size;
     int cell_height = img->height / grid_size;
@@ -23,90 +41,154 @@ DescriptorList* extract_pyramid_descriptors(const Image* img, int level) {
     return descriptors;
 }
 
-// 从一个区域提取描述符
+// 从一个区域提取描述符 (通过视图访问子区域，不复制像素)
 DescriptorList extract_region_descriptors(const Image* img, int x, int y, int width, int height) {
-    DescriptorList descriptors;
-    // 简单的占位符实现
-    descriptors.count = (width * height) / 100; // 假设每 100 个像素提取一个描述符
-    descriptors.descriptors = (Descriptor*)malloc(descriptors.count * sizeof(Descriptor));
+    ImageView view = image_view(img);
+    ImageView region = image_view_roi(&view, x, y, width, height);
+    DescriptorList descriptors = extract_dense_sift_view(&region, SPM_SIFT_STEP);
 
+    // 将坐标换算回原图像坐标系
     for (int i = 0; i < descriptors.count; i++) {
-        // 模拟填充描述符
-        descriptors.descriptors[i].data = (float*)malloc(128 * sizeof(float)); // 假设每个描述符有 128 维
-        memset(descriptors.descriptors[i].data, 0, 128 * sizeof(float));
+        descriptors.descriptors[i].x += (float)x;
+        descriptors.descriptors[i].y += (float)y;
     }
 
     return descriptors;
 }
 
-// 构建空间金字塔直方图
-SpmHistogram build_spatial_pyramid(const Image* img, Codebook* codebook, int level) {
+// 金字塔直方图的总长度
+int spm_histogram_length(int num_clusters, int level) {
+    return num_clusters * ((1 << (2 * (level + 1))) - 1) / 3;
+}
+
+// 将一个视觉词累加到金字塔各层对应的单元中
+// 第l层的权重为 1/2^(L-l+1)，第0层为 1/2^L (Lazebnik et al.)
+void spm_accumulate_word(float* histogram, int num_clusters, int level, int word,
+                         float x, float y, int width, int height, float scale) {
+    int offset = 0;
+    for (int l = 0; l <= level; l++) {
+        int grid_size = 1 << l;
+        int cx = (int)(x * grid_size / width);
+        int cy = (int)(y * grid_size / height);
+        if (cx >= grid_size) cx = grid_size - 1;
+        if (cy >= grid_size) cy = grid_size - 1;
+
+        float weight = (l == 0) ? 1.0f / (float)(1 << level)
+                                : 1.0f / (float)(1 << (level - l + 1));
+
+        histogram[offset + (cy * grid_size + cx) * num_clusters + word] += weight * scale;
+        offset += grid_size * grid_size * num_clusters;
+    }
+}
+
+// 由已提取的描述符构建空间金字塔直方图
+SpmHistogram build_spatial_pyramid_from_descriptors(const DescriptorList* descriptors, int width, int height,
+                                                    Codebook* codebook, int level) {
     SpmHistogram hist;
-    int total_bins = codebook->size * ((1 << (2 * (level + 1))) - 1) / 3; // 计算所有金字塔层的总 bin 数
-    hist.histogram = (float*)calloc(total_bins, sizeof(float));
-    hist.length = total_bins;
+    int num_clusters = codebook->num_clusters;
+    hist.length = spm_histogram_length(num_clusters, level);
+    hist.histogram = (float*)MEM_CALLOC(hist.length, sizeof(float));
 
-    DescriptorList* descriptors = extract_pyramid_descriptors(img, level);
+    if (!hist.histogram) {
+        fprintf(stderr, "Error: Memory allocation failed for SPM histogram\n");
+        exit(EXIT_FAILURE);
+    }
 
-    // 根据描述符更新直方图
-    for (int i = 0; i < (1 << level) * (1 << level); i++) {
-        for (int j = 0; j < descriptors[i].count; j++) {
-            int bin = kmeans_assign_to_cluster(codebook, descriptors[i].descriptors[j].data);
-            hist.histogram[bin]++;
-        }
-        free(descriptors[i].descriptors);
+    if (descriptors->count == 0) {
+        return hist;
     }
-    free(descriptors);
+
+    TRACE_BEGIN(pyramid);
+    float inv_count = 1.0f / (float)descriptors->count;
+
+    for (int i = 0; i < descriptors->count; i++) {
+        const Descriptor* desc = &descriptors->descriptors[i];
+        int word = find_nearest_center(desc->data, codebook);
+        spm_accumulate_word(hist.histogram, num_clusters, level, word, desc->x, desc->y,
+                            width, height, inv_count);
+    }
+
+    TRACE_COUNT(TRACE_STAGE_PYRAMID, descriptors->count);
+    TRACE_END(pyramid, TRACE_STAGE_PYRAMID, (size_t)hist.length * sizeof(float));
 
     return hist;
 }
 
+// 构建空间金字塔直方图
+SpmHistogram build_spatial_pyramid(const Image* img, Codebook* codebook, int level) {
+    DescriptorList descriptors = extract_dense_sift(img, SPM_SIFT_STEP);
+    SpmHistogram hist = build_spatial_pyramid_from_descriptors(&descriptors, img->width, img->height,
+                                                               codebook, level);
+    free_descriptor_list(&descriptors);
+    return hist;
+}
+
 // 释放SPM直方图
 void free_spm_histogram(SpmHistogram* hist) {
     if (hist && hist->histogram) {
-        free(hist->histogram);
+        MEM_FREE(hist->histogram);
         hist->histogram = NULL;
         hist->length = 0;
     }
 }
 
-// 计算两个SPM直方图之间的相似度（使用chi-square距离）
+// 计算两个SPM直方图之间的相似度（使用chi-square距离，SIMD内核见 simsearch.c）
 float compute_spm_similarity(const SpmHistogram* hist1, const SpmHistogram* hist2) {
     if (!hist1 || !hist2 || hist1->length != hist2->length) {
         return -1.0f; // 错误处理
     }
 
-    float similarity = 0.0f;
-    for (int i = 0; i < hist1->length; i++) {
-        if (hist1->histogram[i] + hist2->histogram[i] > 0) {
-            float diff = hist1->histogram[i] - hist2->histogram[i];
-            similarity += (diff * diff) / (hist1->histogram[i] + hist2->histogram[i]);
-        }
-    }
-
-    return 1.0f - similarity; // 返回相似度
+    return spm_similarity(hist1->histogram, hist2->histogram, hist1->length, SPM_SIMILARITY_CHI2);
 }
 
-// 从图像构建码本
+// 从图像构建码本: 多线程提取密集SIFT，蓄水池采样固定数量的描述符后聚类
+// 聚类代价只取决于采样预算，与图像数无关
 Codebook build_codebook_from_images(Image* images, int num_images, int voc_size) {
-    Codebook codebook;
-    codebook.size = voc_size;
-    codebook.centroids = (float**)malloc(voc_size * sizeof(float*));
-
-    // 模拟 KMeans 训练
-    for (int i = 0; i < voc_size; i++) {
-        codebook.centroids[i] = (float*)malloc(128 * sizeof(float)); // 假设每个特征有 128 维
-        memset(codebook.centroids[i], 0, 128 * sizeof(float));
+    SamplerOptions options = {SAMPLER_DEFAULT_BUDGET, 0, 1, sampler_cpu_count(), rng_default_seed()};
+    DescriptorList sample = sample_dense_sift(images, num_images, NULL, SPM_SIFT_STEP, &options);
+    Codebook codebook = build_codebook(&sample, voc_size);
+    free_descriptor_list(&sample);
+    return codebook;
+}
+
+// 计算单幅图像的SPM特征，命中缓存时跳过对应阶段
+static SpmHistogram compute_spm_feature_cached(const Image* img, Codebook* codebook, int level,
+                                               uint64_t codebook_key) {
+    SpmHistogram hist;
+    uint64_t sift_key = feature_cache_sift_key(img, SPM_SIFT_STEP);
+    uint64_t spm_key = feature_cache_spm_key(sift_key, level, codebook_key);
+
+    if (feature_cache_get_spm(spm_cache, spm_key, &hist)) {
+        return hist;
     }
 
-    return codebook;
+    DescriptorList descriptors;
+    if (!feature_cache_get_sift(spm_cache, sift_key, &descriptors)) {
+        descriptors = extract_dense_sift(img, SPM_SIFT_STEP);
+        feature_cache_put_sift(spm_cache, sift_key, &descriptors);
+    }
+
+    hist = build_spatial_pyramid_from_descriptors(&descriptors, img->width, img->height, codebook, level);
+    feature_cache_put_spm(spm_cache, spm_key, &hist);
+
+    free_descriptor_list(&descriptors);
+    return hist;
 }
 
 // 计算一组图像的SPM特征
 SpmHistogram* compute_spm_features(Image* images, int num_images, Codebook* codebook, int level) {
-    SpmHistogram* histograms = (SpmHistogram*)malloc(num_images * sizeof(SpmHistogram));
+    SpmHistogram* histograms = (SpmHistogram*)MEM_MALLOC(num_images * sizeof(SpmHistogram));
+
+    if (spm_cache) {
+        uint64_t codebook_key = feature_cache_codebook_key(codebook);
+        for (int i = 0; i < num_images; i++) {
+            histograms[i] = compute_spm_feature_cached(&images[i], codebook, level, codebook_key);
+        }
+        return histograms;
+    }
+
     for (int i = 0; i < num_images; i++) {
         histograms[i] = build_spatial_pyramid(&images[i], codebook, level);
     }
     return histograms;
-}
\ No newline at end of file
+}
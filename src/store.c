@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+#define MEMTRACK_TAG MEM_TAG_KMEANS
+#include "store.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static size_t chunk_bytes(const DescriptorStore* store) {
+    return (size_t)DESCRIPTOR_STORE_CHUNK_ROWS * store->dim * sizeof(float);
+}
+
+DescriptorStore* descriptor_store_create(int dim, size_t ram_budget, const char* spill_dir) {
+    DescriptorStore* store = (DescriptorStore*)MEM_CALLOC(1, sizeof(DescriptorStore));
+    if (!store) {
+        fprintf(stderr, "Error: Memory allocation failed for descriptor store\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char* dir = spill_dir ? spill_dir : getenv("TMPDIR");
+    snprintf(store->spill_dir, sizeof(store->spill_dir), "%s", dir ? dir : "/tmp");
+    store->dim = dim;
+    store->ram_budget = ram_budget;
+    store->fd = -1;
+    return store;
+}
+
+static void unmap_store(DescriptorStore* store) {
+    if (store->map) {
+        munmap(store->map, store->map_size);
+        store->map = NULL;
+        store->map_size = 0;
+    }
+}
+
+void descriptor_store_free(DescriptorStore* store) {
+    if (!store) {
+        return;
+    }
+    for (int i = 0; i < store->num_chunks; i++) {
+        MEM_FREE(store->chunks[i]);
+    }
+    MEM_FREE(store->chunks);
+    unmap_store(store);
+    if (store->fd >= 0) {
+        close(store->fd);
+        unlink(store->path);
+    }
+    MEM_FREE(store);
+}
+
+static int write_all(int fd, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return 1;
+}
+
+// 把内存中写满的块追加到文件并释放
+static int flush_full_chunks(DescriptorStore* store) {
+    int full = store->num_chunks;
+    if (store->count % DESCRIPTOR_STORE_CHUNK_ROWS != 0) {
+        full--;
+    }
+
+    for (int i = 0; i < full; i++) {
+        if (!write_all(store->fd, store->chunks[i], chunk_bytes(store))) {
+            fprintf(stderr, "Error: Could not write descriptor store %s (%s)\n", store->path, strerror(errno));
+            return 0;
+        }
+        MEM_FREE(store->chunks[i]);
+        store->file_chunks++;
+    }
+
+    memmove(store->chunks, store->chunks + full, (store->num_chunks - full) * sizeof(float*));
+    store->num_chunks -= full;
+    return 1;
+}
+
+// 超出预算时创建溢出文件并写出已满的块 (文件在释放存储时删除)
+static int spill(DescriptorStore* store) {
+    snprintf(store->path, sizeof(store->path), "%s/cv-c-store-XXXXXX", store->spill_dir);
+    store->fd = mkstemp(store->path);
+    if (store->fd < 0) {
+        fprintf(stderr, "Error: Could not create descriptor store file in %s\n", store->spill_dir);
+        return 0;
+    }
+    posix_fadvise(store->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    printf("Descriptor store: %d descriptors exceed the %.1f MB budget, spilling to %s\n", store->count,
+           store->ram_budget / (1024.0 * 1024.0), store->path);
+    return flush_full_chunks(store);
+}
+
+int descriptor_store_append(DescriptorStore* store, const float* row) {
+    int offset = store->count % DESCRIPTOR_STORE_CHUNK_ROWS;
+    if (offset == 0) {
+        // 上一块已写满: 已溢出时写入文件，否则检查预算
+        if (store->fd >= 0) {
+            if (!flush_full_chunks(store)) return 0;
+        } else if (store->ram_budget > 0 && store->num_chunks > 0 &&
+                   (size_t)(store->num_chunks + 1) * chunk_bytes(store) > store->ram_budget) {
+            if (!spill(store)) return 0;
+        }
+
+        if (store->num_chunks == store->chunk_capacity) {
+            int capacity = store->chunk_capacity ? store->chunk_capacity * 2 : 16;
+            float** chunks = (float**)MEM_REALLOC(store->chunks, capacity * sizeof(float*));
+            if (!chunks) {
+                fprintf(stderr, "Error: Memory allocation failed for descriptor store\n");
+                exit(EXIT_FAILURE);
+            }
+            store->chunks = chunks;
+            store->chunk_capacity = capacity;
+        }
+        store->chunks[store->num_chunks] = (float*)MEM_MALLOC(chunk_bytes(store));
+        if (!store->chunks[store->num_chunks]) {
+            fprintf(stderr, "Error: Memory allocation failed for descriptor store chunk\n");
+            exit(EXIT_FAILURE);
+        }
+        store->num_chunks++;
+    }
+
+    memcpy(store->chunks[store->num_chunks - 1] + (size_t)offset * store->dim, row, store->dim * sizeof(float));
+    store->count++;
+    return 1;
+}
+
+int descriptor_store_append_list(DescriptorStore* store, const DescriptorList* descriptors) {
+    for (int i = 0; i < descriptors->count; i++) {
+        if (!descriptor_store_append(store, descriptors->descriptors[i].data)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int descriptor_store_spilled(const DescriptorStore* store) {
+    return store->fd >= 0;
+}
+
+size_t descriptor_store_memory(const DescriptorStore* store) {
+    return (size_t)store->num_chunks * chunk_bytes(store);
+}
+
+int descriptor_store_num_chunks(const DescriptorStore* store) {
+    return (store->count + DESCRIPTOR_STORE_CHUNK_ROWS - 1) / DESCRIPTOR_STORE_CHUNK_ROWS;
+}
+
+// 文件中的块逐块映射，任何时刻只保留一个块的映射
+static const float* map_chunk(DescriptorStore* store, int chunk) {
+    if (store->map && store->map_chunk == chunk) {
+        return (const float*)store->map;
+    }
+
+    unmap_store(store);
+    size_t size = chunk_bytes(store);
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, store->fd, (off_t)chunk * (off_t)size);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map descriptor store %s (%s)\n", store->path, strerror(errno));
+        return NULL;
+    }
+    store->map = map;
+    store->map_size = size;
+    store->map_chunk = chunk;
+    return (const float*)map;
+}
+
+int descriptor_store_chunk(DescriptorStore* store, int chunk, const float** rows) {
+    int num_chunks = descriptor_store_num_chunks(store);
+    if (chunk < 0 || chunk >= num_chunks) {
+        *rows = NULL;
+        return 0;
+    }
+
+    int count = chunk == num_chunks - 1 ? store->count - chunk * DESCRIPTOR_STORE_CHUNK_ROWS
+                                        : DESCRIPTOR_STORE_CHUNK_ROWS;
+    if (chunk < store->file_chunks) {
+        *rows = map_chunk(store, chunk);
+        if (!*rows) {
+            return 0;
+        }
+    } else {
+        *rows = store->chunks[chunk - store->file_chunks];
+    }
+    return count;
+}
+
+const float* descriptor_store_row(DescriptorStore* store, int i) {
+    const float* rows;
+    if (i < 0 || i >= store->count ||
+        !descriptor_store_chunk(store, i / DESCRIPTOR_STORE_CHUNK_ROWS, &rows)) {
+        return NULL;
+    }
+    return rows + (size_t)(i % DESCRIPTOR_STORE_CHUNK_ROWS) * store->dim;
+}
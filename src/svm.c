@@ -1,12 +1,17 @@
+#define MEMTRACK_TAG MEM_TAG_SVM
 #include "svm.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include "utils.h"
+#include "rng.h"
 
 // 初始化 SVM 模型
 SVMModel* svm_create(int num_features, double C) {
-    SVMModel* model = (SVMModel*)malloc(sizeof(SVMModel));
-    model->weights = (double*)calloc(num_features, sizeof(double));
+    SVMModel* model = (SVMModel*)MEM_MALLOC(sizeof(SVMModel));
+    model->weights = (double*)MEM_CALLOC(num_features, sizeof(double));
     model->num_features = num_features;
     model->C = C;
     return model;
@@ -15,6 +20,7 @@ SVMModel* svm_create(int num_features, double C) {
 // 训练 SVM 模型
 void svm_train(SVMModel* model, double** data, int* labels, int num_samples, int max_iterations) {
     for (int iter = 0; iter < max_iterations; iter++) {
+        TRACE_BEGIN(epoch);
         for (int i = 0; i < num_samples; i++) {
             double prediction = 0.0;
             for (int j = 0; j < model->num_features; j++) {
@@ -26,22 +32,280 @@ void svm_train(SVMModel* model, double** data, int* labels, int num_samples, int
                 }
             }
         }
+        TRACE_COUNT(TRACE_STAGE_SVM_EPOCH, num_samples);
+        TRACE_END(epoch, TRACE_STAGE_SVM_EPOCH, (size_t)num_samples * model->num_features * sizeof(double));
     }
 }
 
-// 使用 SVM 进行预测
-int svm_predict(SVMModel* model, double* feature_vector) {
+SVMModel* svm_copy(const SVMModel* model) {
+    SVMModel* copy = svm_create(model->num_features, model->C);
+    memcpy(copy->weights, model->weights, model->num_features * sizeof(double));
+    return copy;
+}
+
+SVMDualState svm_create_dual_state(int num_samples) {
+    SVMDualState state;
+    state.alpha = (double*)MEM_CALLOC(num_samples > 0 ? num_samples : 1, sizeof(double));
+    state.num_samples = num_samples;
+    return state;
+}
+
+void svm_free_dual_state(SVMDualState* state) {
+    if (state && state->alpha) {
+        MEM_FREE(state->alpha);
+        state->alpha = NULL;
+        state->num_samples = 0;
+    }
+}
+
+void svm_resize_dual_state(SVMDualState* state, int num_samples) {
+    double* alpha = (double*)MEM_REALLOC(state->alpha, (num_samples > 0 ? num_samples : 1) * sizeof(double));
+    if (!alpha) {
+        fprintf(stderr, "Error: Memory allocation failed for SVM dual state\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = state->num_samples; i < num_samples; i++) {
+        alpha[i] = 0.0;
+    }
+    state->alpha = alpha;
+    state->num_samples = num_samples;
+}
+
+static double dot(const double* a, const double* b, int n) {
+    double sum = 0.0;
+    for (int j = 0; j < n; j++) {
+        sum += a[j] * b[j];
+    }
+    return sum;
+}
+
+// 相对对偶间隙: P(w) = ½‖w‖² + C Σ max(0, 1 - y_i w·x_i)，D(α) = Σ α_i - ½‖w‖²
+static double relative_duality_gap(const SVMModel* model, const double* alpha, double** data, int* labels,
+                                   int num_samples) {
+    int n = model->num_features;
+    double norm = dot(model->weights, model->weights, n);
+    double hinge = 0.0;
+    double alpha_sum = 0.0;
+    for (int i = 0; i < num_samples; i++) {
+        double loss = 1.0 - labels[i] * dot(model->weights, data[i], n);
+        if (loss > 0) {
+            hinge += loss;
+        }
+        alpha_sum += alpha[i];
+    }
+    double primal = 0.5 * norm + model->C * hinge;
+    double dual = alpha_sum - 0.5 * norm;
+    return primal > 0 ? (primal - dual) / primal : 0.0;
+}
+
+// Hsieh et al. 2008 的对偶坐标下降
+// 每轮按随机顺序逐个更新活动集中的 alpha_i，梯度 G = y_i w·x_i - 1，w 随之增量更新
+int svm_train_dual(SVMModel* model, SVMDualState* state, double** data, int* labels, int num_samples,
+                   const SVMSolverOptions* options) {
+    int n = model->num_features;
+    double C = model->C;
+    SVMDualState local = {NULL, 0};
+    if (!state) {
+        local = svm_create_dual_state(num_samples);
+        state = &local;
+    } else if (state->num_samples < num_samples) {
+        svm_resize_dual_state(state, num_samples);
+    }
+    double* alpha = state->alpha;
+
+    // 由对偶变量重建权重，保证 w 与 alpha 一致 (换C后先截断)
+    double* qdiag = (double*)MEM_MALLOC(num_samples * sizeof(double));
+    int* order = (int*)MEM_MALLOC(num_samples * sizeof(int));
+    memset(model->weights, 0, n * sizeof(double));
+    for (int i = 0; i < num_samples; i++) {
+        if (alpha[i] > C) alpha[i] = C;
+        if (alpha[i] > 0) {
+            double scale = alpha[i] * labels[i];
+            for (int j = 0; j < n; j++) {
+                model->weights[j] += scale * data[i][j];
+            }
+        }
+        qdiag[i] = dot(data[i], data[i], n);
+        order[i] = i;
+    }
+
+    // 收缩: 位于边界且梯度明显指向可行域外的样本暂时移出活动集，
+    // 活动集上收敛后再在全部样本上确认一次
+    Rng rng = rng_create(rng_default_seed());
+    int active_size = num_samples;
+    double pg_max_old = DBL_MAX;
+    double pg_min_old = -DBL_MAX;
+    int iter = 0;
+    while (iter < options->max_iterations) {
+        TRACE_BEGIN(epoch);
+        double pg_max = -DBL_MAX;
+        double pg_min = DBL_MAX;
+        rng_shuffle_int(&rng, order, active_size);
+
+        for (int k = 0; k < active_size; k++) {
+            int i = order[k];
+            double G = labels[i] * dot(model->weights, data[i], n) - 1.0;
+
+            double pg = 0.0;
+            if (alpha[i] <= 0) {
+                if (G > pg_max_old) {
+                    order[k--] = order[--active_size];
+                    order[active_size] = i;
+                    continue;
+                }
+                if (G < 0) pg = G;
+            } else if (alpha[i] >= C) {
+                if (G < pg_min_old) {
+                    order[k--] = order[--active_size];
+                    order[active_size] = i;
+                    continue;
+                }
+                if (G > 0) pg = G;
+            } else {
+                pg = G;
+            }
+            if (pg > pg_max) pg_max = pg;
+            if (pg < pg_min) pg_min = pg;
+
+            if (fabs(pg) > 1e-12 && qdiag[i] > 0) {
+                double old_alpha = alpha[i];
+                double new_alpha = old_alpha - G / qdiag[i];
+                alpha[i] = new_alpha < 0 ? 0 : (new_alpha > C ? C : new_alpha);
+                double delta = (alpha[i] - old_alpha) * labels[i];
+                for (int j = 0; j < n; j++) {
+                    model->weights[j] += delta * data[i][j];
+                }
+            }
+        }
+
+        TRACE_COUNT(TRACE_STAGE_SVM_EPOCH, active_size);
+        TRACE_END(epoch, TRACE_STAGE_SVM_EPOCH, (size_t)active_size * n * sizeof(double));
+        iter++;
+
+        if (options->gap_tolerance > 0 &&
+            relative_duality_gap(model, alpha, data, labels, num_samples) <= options->gap_tolerance) {
+            break;
+        }
+        if (pg_max - pg_min <= options->tolerance) {
+            if (active_size == num_samples) {
+                break;
+            }
+            active_size = num_samples;
+            pg_max_old = DBL_MAX;
+            pg_min_old = -DBL_MAX;
+            continue;
+        }
+        pg_max_old = pg_max > 0 ? pg_max : DBL_MAX;
+        pg_min_old = pg_min < 0 ? pg_min : -DBL_MAX;
+    }
+
+    MEM_FREE(qdiag);
+    MEM_FREE(order);
+    svm_free_dual_state(&local);
+    return iter;
+}
+
+void svm_train_path(SVMModel** models, const double* Cs, int num_C, double** data, int* labels, int num_samples,
+                    int num_features, const SVMSolverOptions* options, int* iterations) {
+    SVMDualState state = svm_create_dual_state(num_samples);
+    for (int k = 0; k < num_C; k++) {
+        models[k] = svm_create(num_features, Cs[k]);
+        int iters = svm_train_dual(models[k], &state, data, labels, num_samples, options);
+        if (iterations) {
+            iterations[k] = iters;
+        }
+    }
+    svm_free_dual_state(&state);
+}
+
+// 计算决策函数值 w·x
+double svm_decision_value(const SVMModel* model, const double* feature_vector) {
     double result = 0.0;
     for (int i = 0; i < model->num_features; i++) {
         result += model->weights[i] * feature_vector[i];
     }
-    return result >= 0 ? 1 : -1;
+    return result;
+}
+
+// 使用 SVM 进行预测
+int svm_predict(SVMModel* model, double* feature_vector) {
+    return svm_decision_value(model, feature_vector) >= 0 ? 1 : -1;
+}
+
+// 多个模型的文件格式: magic, num_models, num_features, 然后每个模型的 C 和权重
+#define SVM_FILE_MAGIC 0x314D5653  // "SVM1"
+
+int svm_save_models(SVMModel** models, int num_models, const char* filename) {
+    if (num_models <= 0) {
+        return 0;
+    }
+
+    int num_features = models[0]->num_features;
+    size_t header_size = 3 * sizeof(int);
+    size_t model_size = sizeof(double) * (1 + num_features);
+    size_t size = header_size + num_models * model_size;
+    unsigned char* buffer = (unsigned char*)MEM_MALLOC(size);
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed for SVM file\n");
+        return 0;
+    }
+
+    int header[3] = {SVM_FILE_MAGIC, num_models, num_features};
+    memcpy(buffer, header, header_size);
+    for (int m = 0; m < num_models; m++) {
+        unsigned char* dst = buffer + header_size + m * model_size;
+        memcpy(dst, &models[m]->C, sizeof(double));
+        memcpy(dst + sizeof(double), models[m]->weights, num_features * sizeof(double));
+    }
+
+    int ok = write_file(filename, buffer, size);
+    MEM_FREE(buffer);
+    return ok;
+}
+
+SVMModel** svm_load_models(const char* filename, int* num_models) {
+    *num_models = 0;
+    size_t size;
+    unsigned char* data = read_file(filename, &size);
+    if (!data) {
+        return NULL;
+    }
+
+    int header[3];
+    size_t header_size = sizeof(header);
+    if (size < header_size) {
+        fprintf(stderr, "Error: Invalid SVM file %s\n", filename);
+        MEM_FREE(data);
+        return NULL;
+    }
+    memcpy(header, data, header_size);
+
+    size_t model_size = sizeof(double) * (1 + (size_t)header[2]);
+    if (header[0] != SVM_FILE_MAGIC || header[1] <= 0 || header[2] <= 0 ||
+        size != header_size + header[1] * model_size) {
+        fprintf(stderr, "Error: Invalid SVM file %s\n", filename);
+        MEM_FREE(data);
+        return NULL;
+    }
+
+    SVMModel** models = (SVMModel**)MEM_MALLOC(header[1] * sizeof(SVMModel*));
+    for (int m = 0; m < header[1]; m++) {
+        const unsigned char* src = data + header_size + m * model_size;
+        double C;
+        memcpy(&C, src, sizeof(double));
+        models[m] = svm_create(header[2], C);
+        memcpy(models[m]->weights, src + sizeof(double), header[2] * sizeof(double));
+    }
+
+    *num_models = header[1];
+    MEM_FREE(data);
+    return models;
 }
 
 // 释放 SVM 模型
 void svm_free(SVMModel* model) {
     if (model) {
-        free(model->weights);
-        free(model);
+        MEM_FREE(model->weights);
+        MEM_FREE(model);
     }
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#define MEMTRACK_TAG MEM_TAG_IMAGE
+#include "tiled.h"
+#include "orientation.h"
+
+int extract_dense_sift_tiled(const ImageView* view, int step, int strip_rows, TiledDescriptorFn fn, void* ctx) {
+    int width = view->width;
+    int height = view->height;
+    int grid_x = dense_sift_grid_count(width, step);
+    if (grid_x == 0 || dense_sift_grid_count(height, step) == 0) {
+        return 0;
+    }
+
+    // 条带边界与网格行对齐，每个条带输出 rows / step 行网格点
+    int rows = strip_rows < step ? step : (strip_rows + step - 1) / step * step;
+    int buffer_rows = min_int(height, rows + 2 * TILED_HALO);
+    int max_count = grid_x * (rows / step);
+
+    Gray16Image gray = create_gray16_image(width, buffer_rows);
+    OrientationPlanes planes = create_orientation_planes(width, buffer_rows);
+    float* descriptors = allocate_float_array(max_count * SIFT_DESC_SIZE);
+    float* positions = allocate_float_array(max_count * 2);
+
+    int total = 0;
+    for (int y_begin = 0; y_begin < height - step; y_begin += rows) {
+        int y_end = min_int(height, y_begin + rows);
+
+        // 描述符窗口在网格点上下各覆盖半个窗口，梯度再向外各需1行；
+        // 条带缓冲区首末行按图像边界规则计算，它们只在确实是图像边界时才会被窗口用到
+        int top = y_begin > TILED_HALO ? y_begin - TILED_HALO : 0;
+        int bottom = min_int(height, y_end + TILED_HALO);
+        ImageView strip = image_view_roi(view, 0, top, width, bottom - top);
+
+        convert_view_to_gray16_into(&strip, &gray);
+        compute_orientation_planes_gray16_into(&gray, &planes, SIFT_ORI_BINNING);
+
+        int count = extract_dense_sift_rows_into(&planes, step, top, height, y_begin, y_end, descriptors, positions,
+                                                 max_count);
+        if (count > 0) {
+            fn(descriptors, positions, count, ctx);
+            total += count;
+        }
+    }
+
+    free_gray16_image(&gray);
+    free_orientation_planes(&planes);
+    free_float_array(descriptors);
+    free_float_array(positions);
+    return total;
+}
+
+// 金字塔累加的上下文: 归一化系数由网格点总数预先确定，累加顺序与整幅图像处理相同
+typedef struct {
+    SpmHistogram* hist;
+    Codebook* codebook;
+    int level;
+    int width;
+    int height;
+    float inv_count;
+} TiledPyramid;
+
+static void accumulate_strip(float* descriptors, const float* positions, int count, void* ctx) {
+    TiledPyramid* pyramid = (TiledPyramid*)ctx;
+    for (int i = 0; i < count; i++) {
+        int word = find_nearest_center(descriptors + (size_t)i * SIFT_DESC_SIZE, pyramid->codebook);
+        spm_accumulate_word(pyramid->hist->histogram, pyramid->codebook->num_clusters, pyramid->level, word,
+                            positions[i * 2], positions[i * 2 + 1], pyramid->width, pyramid->height,
+                            pyramid->inv_count);
+    }
+}
+
+SpmHistogram build_spatial_pyramid_tiled(const ImageView* view, Codebook* codebook, int level, int strip_rows) {
+    SpmHistogram hist;
+    hist.length = spm_histogram_length(codebook->num_clusters, level);
+    hist.histogram = (float*)MEM_CALLOC(hist.length, sizeof(float));
+    if (!hist.histogram) {
+        fprintf(stderr, "Error: Memory allocation failed for SPM histogram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int count = dense_sift_grid_count(view->width, SPM_SIFT_STEP) *
+                dense_sift_grid_count(view->height, SPM_SIFT_STEP);
+    if (count == 0) {
+        return hist;
+    }
+
+    TiledPyramid pyramid = {&hist, codebook, level, view->width, view->height, 1.0f / (float)count};
+    extract_dense_sift_tiled(view, SPM_SIFT_STEP, strip_rows, accumulate_strip, &pyramid);
+    return hist;
+}
@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+
+#ifdef CV_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t bytes;
+    int stage;
+} TraceEvent;
+
+// 每个线程的缓冲区，仅由所属线程写入
+typedef struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    int num_events;
+    int thread_id;
+    uint64_t dropped;                     // 缓冲区满后丢弃的事件数
+    uint64_t scopes[TRACE_STAGE_COUNT];   // 每个阶段的计时次数
+    uint64_t total_ns[TRACE_STAGE_COUNT]; // 每个阶段的总耗时
+    uint64_t bytes[TRACE_STAGE_COUNT];    // 每个阶段处理的字节数
+    uint64_t items[TRACE_STAGE_COUNT];    // 每个阶段的计数器
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+static const char* stage_names[TRACE_STAGE_COUNT] = {
+    "load", "gray", "gradient", "dense_sift", "integral", "quantize", "pyramid", "kmeans_iter", "svm_epoch"
+};
+
+static _Atomic(TraceBuffer*) trace_buffers = NULL;
+static atomic_int trace_next_thread_id = 0;
+static atomic_int trace_initialized = 0;
+static uint64_t trace_origin_ns = 0;
+static char trace_summary_path[512] = "cv-c-trace-summary.json";
+static char trace_event_path[512] = "cv-c-trace.json";
+static _Thread_local TraceBuffer* local_buffer = NULL;
+
+uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void trace_ensure_initialized(void) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&trace_initialized, &expected, 1)) {
+        trace_origin_ns = trace_now_ns();
+    }
+}
+
+void trace_init(const char* summary_path, const char* trace_path) {
+    snprintf(trace_summary_path, sizeof(trace_summary_path), "%s", summary_path ? summary_path : "");
+    snprintf(trace_event_path, sizeof(trace_event_path), "%s", trace_path ? trace_path : "");
+    trace_ensure_initialized();
+}
+
+// 取得当前线程的缓冲区，首次使用时分配并以CAS挂入全局链表
+static TraceBuffer* trace_local_buffer(void) {
+    if (local_buffer) {
+        return local_buffer;
+    }
+
+    trace_ensure_initialized();
+
+    TraceBuffer* buffer = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed for trace buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->thread_id = atomic_fetch_add(&trace_next_thread_id, 1);
+
+    TraceBuffer* head = atomic_load(&trace_buffers);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak(&trace_buffers, &head, buffer));
+
+    local_buffer = buffer;
+    return buffer;
+}
+
+void trace_record(TraceStage stage, uint64_t start_ns, uint64_t end_ns, uint64_t bytes) {
+    TraceBuffer* buffer = trace_local_buffer();
+    uint64_t duration = end_ns - start_ns;
+
+    buffer->scopes[stage]++;
+    buffer->total_ns[stage] += duration;
+    buffer->bytes[stage] += bytes;
+
+    if (buffer->num_events < TRACE_BUFFER_EVENTS) {
+        TraceEvent* event = &buffer->events[buffer->num_events++];
+        event->start_ns = start_ns;
+        event->duration_ns = duration;
+        event->bytes = bytes;
+        event->stage = stage;
+    } else {
+        buffer->dropped++;
+    }
+}
+
+void trace_count(TraceStage stage, uint64_t items) {
+    trace_local_buffer()->items[stage] += items;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t va = *(const uint64_t*)a;
+    uint64_t vb = *(const uint64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+static double percentile_us(const uint64_t* sorted, int n, double p) {
+    if (n == 0) {
+        return 0.0;
+    }
+    int idx = (int)(p * (n - 1) + 0.5);
+    return sorted[idx] / 1000.0;
+}
+
+static void write_summary(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s for writing\n", path);
+        return;
+    }
+
+    uint64_t dropped = 0;
+    for (TraceBuffer* b = atomic_load(&trace_buffers); b; b = b->next) {
+        dropped += b->dropped;
+    }
+
+    fprintf(file, "{\n  \"dropped_events\": %llu,\n  \"stages\": {", (unsigned long long)dropped);
+
+    int first = 1;
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        uint64_t scopes = 0, total_ns = 0, bytes = 0, items = 0;
+        int samples = 0;
+        for (TraceBuffer* b = atomic_load(&trace_buffers); b; b = b->next) {
+            scopes += b->scopes[s];
+            total_ns += b->total_ns[s];
+            bytes += b->bytes[s];
+            items += b->items[s];
+            for (int i = 0; i < b->num_events; i++) {
+                if (b->events[i].stage == s) samples++;
+            }
+        }
+        if (scopes == 0 && items == 0) {
+            continue;
+        }
+
+        // 百分位数由保留下来的事件计算
+        uint64_t* durations = (uint64_t*)malloc((samples + 1) * sizeof(uint64_t));
+        int n = 0;
+        for (TraceBuffer* b = atomic_load(&trace_buffers); b; b = b->next) {
+            for (int i = 0; i < b->num_events; i++) {
+                if (b->events[i].stage == s) durations[n++] = b->events[i].duration_ns;
+            }
+        }
+        qsort(durations, n, sizeof(uint64_t), compare_u64);
+
+        fprintf(file, "%s\n    \"%s\": {\"count\": %llu, \"items\": %llu, \"bytes\": %llu, "
+                      "\"total_ms\": %.3f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f}",
+                first ? "" : ",", stage_names[s],
+                (unsigned long long)scopes, (unsigned long long)items, (unsigned long long)bytes,
+                total_ns / 1e6, scopes ? total_ns / 1e3 / scopes : 0.0,
+                percentile_us(durations, n, 0.50), percentile_us(durations, n, 0.99));
+        first = 0;
+        free(durations);
+    }
+
+    fprintf(file, "\n  }\n}\n");
+    fclose(file);
+}
+
+static void write_trace_events(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s for writing\n", path);
+        return;
+    }
+
+    // 以最早的事件作为时间原点
+    uint64_t origin_ns = trace_origin_ns;
+    for (TraceBuffer* b = atomic_load(&trace_buffers); b; b = b->next) {
+        for (int i = 0; i < b->num_events; i++) {
+            if (b->events[i].start_ns < origin_ns) origin_ns = b->events[i].start_ns;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    int first = 1;
+    for (TraceBuffer* b = atomic_load(&trace_buffers); b; b = b->next) {
+        for (int i = 0; i < b->num_events; i++) {
+            const TraceEvent* e = &b->events[i];
+            fprintf(file, "%s\n{\"name\": \"%s\", \"cat\": \"cv-c\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                          "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"bytes\": %llu}}",
+                    first ? "" : ",", stage_names[e->stage], b->thread_id,
+                    (e->start_ns - origin_ns) / 1000.0, e->duration_ns / 1000.0,
+                    (unsigned long long)e->bytes);
+            first = 0;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+void trace_flush(void) {
+    if (trace_summary_path[0]) {
+        write_summary(trace_summary_path);
+    }
+    if (trace_event_path[0]) {
+        write_trace_events(trace_event_path);
+    }
+}
+
+#endif /* CV_TRACE */
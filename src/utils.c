@@ -1,8 +1,48 @@
+#define MEMTRACK_TAG MEM_TAG_OTHER
 #include "utils.h"
+#include "rng.h"
+#include <stdatomic.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // 内存分配函数
+#ifdef CV_MEMTRACK
+float* allocate_float_array_tagged(int size, MemTag tag, const char* file, int line) {
+    float* array = (float*)mem_malloc(tag, size * sizeof(float), file, line);
+    if (!array) {
+        fprintf(stderr, "Error: Memory allocation failed for float array\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(array, 0, size * sizeof(float));
+    return array;
+}
+
+float** allocate_float_matrix_tagged(int rows, int cols, MemTag tag, const char* file, int line) {
+    float** matrix = (float**)mem_malloc(tag, rows * sizeof(float*), file, line);
+    if (!matrix) {
+        fprintf(stderr, "Error: Memory allocation failed for matrix rows\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < rows; i++) {
+        matrix[i] = allocate_float_array_tagged(cols, tag, file, line);
+    }
+    return matrix;
+}
+
+// 不带位置信息的版本 (函数指针或未包含本头文件的调用者)
+float* (allocate_float_array)(int size) {
+    return allocate_float_array_tagged(size, MEM_TAG_OTHER, __FILE__, __LINE__);
+}
+
+float** (allocate_float_matrix)(int rows, int cols) {
+    return allocate_float_matrix_tagged(rows, cols, MEM_TAG_OTHER, __FILE__, __LINE__);
+}
+#else
 float* allocate_float_array(int size) {
-    float* array = (float*)malloc(size * sizeof(float));
+    float* array = (float*)MEM_MALLOC(size * sizeof(float));
     if (!array) {
         fprintf(stderr, "Error: Memory allocation failed for float array\n");
         exit(EXIT_FAILURE);
@@ -12,7 +52,7 @@ float* allocate_float_array(int size) {
 }
 
 float** allocate_float_matrix(int rows, int cols) {
-    float** matrix = (float**)malloc(rows * sizeof(float*));
+    float** matrix = (float**)MEM_MALLOC(rows * sizeof(float*));
     if (!matrix) {
         fprintf(stderr, "Error: Memory allocation failed for matrix rows\n");
         exit(EXIT_FAILURE);
@@ -23,10 +63,11 @@ float** allocate_float_matrix(int rows, int cols) {
     }
     return matrix;
 }
+#endif /* CV_MEMTRACK */
 
 void free_float_array(float* array) {
     if (array) {
-        free(array);
+        MEM_FREE(array);
     }
 }
 
@@ -35,32 +76,71 @@ void free_float_matrix(float** matrix, int rows) {
         for (int i = 0; i < rows; i++) {
             free_float_array(matrix[i]);
         }
-        free(matrix);
+        MEM_FREE(matrix);
     }
 }
 
 // 描述符操作函数
-Descriptor create_descriptor(int length) {
+#ifdef CV_MEMTRACK
+Descriptor create_descriptor_tagged(int length, MemTag tag, const char* file, int line) {
     Descriptor desc;
     desc.length = length;
-    desc.data = allocate_float_array(length);
+    desc.data = allocate_float_array_tagged(length, tag, file, line);
     desc.x = 0.0f;
     desc.y = 0.0f;
     return desc;
 }
 
-void free_descriptor(Descriptor* desc) {
-    if (desc && desc->data) {
-        free_float_array(desc->data);
-        desc->data = NULL;
-        desc->length = 0;
+DescriptorList create_descriptor_list_tagged(int initial_capacity, MemTag tag, const char* file, int line) {
+    DescriptorList list;
+    list.count = 0;
+    list.descriptors = (Descriptor*)mem_malloc(tag, initial_capacity * sizeof(Descriptor), file, line);
+    if (!list.descriptors) {
+        fprintf(stderr, "Error: Memory allocation failed for descriptor list\n");
+        exit(EXIT_FAILURE);
     }
+    return list;
+}
+
+void add_descriptor_tagged(DescriptorList* list, Descriptor desc, MemTag tag, const char* file, int line) {
+    Descriptor* new_array = (Descriptor*)mem_realloc(tag, list->descriptors, (list->count + 1) * sizeof(Descriptor),
+                                                     file, line);
+    if (!new_array) {
+        fprintf(stderr, "Error: Memory reallocation failed for descriptor list\n");
+        exit(EXIT_FAILURE);
+    }
+
+    list->descriptors = new_array;
+    list->descriptors[list->count] = desc;
+    list->count++;
+}
+
+// 不带位置信息的版本
+Descriptor (create_descriptor)(int length) {
+    return create_descriptor_tagged(length, MEM_TAG_OTHER, __FILE__, __LINE__);
+}
+
+DescriptorList (create_descriptor_list)(int initial_capacity) {
+    return create_descriptor_list_tagged(initial_capacity, MEM_TAG_OTHER, __FILE__, __LINE__);
+}
+
+void (add_descriptor)(DescriptorList* list, Descriptor desc) {
+    add_descriptor_tagged(list, desc, MEM_TAG_OTHER, __FILE__, __LINE__);
+}
+#else
+Descriptor create_descriptor(int length) {
+    Descriptor desc;
+    desc.length = length;
+    desc.data = allocate_float_array(length);
+    desc.x = 0.0f;
+    desc.y = 0.0f;
+    return desc;
 }
 
 DescriptorList create_descriptor_list(int initial_capacity) {
     DescriptorList list;
     list.count = 0;
-    list.descriptors = (Descriptor*)malloc(initial_capacity * sizeof(Descriptor));
+    list.descriptors = (Descriptor*)MEM_MALLOC(initial_capacity * sizeof(Descriptor));
     if (!list.descriptors) {
         fprintf(stderr, "Error: Memory allocation failed for descriptor list\n");
         exit(EXIT_FAILURE);
@@ -68,21 +148,10 @@ DescriptorList create_descriptor_list(int initial_capacity) {
     return list;
 }
 
-void free_descriptor_list(DescriptorList* list) {
-    if (list && list->descriptors) {
-        for (int i = 0; i < list->count; i++) {
-            free_descriptor(&list->descriptors[i]);
-        }
-        free(list->descriptors);
-        list->descriptors = NULL;
-        list->count = 0;
-    }
-}
-
 void add_descriptor(DescriptorList* list, Descriptor desc) {
     // 动态扩容，这里简化处理，实际应用中应该更智能地扩容
-    Descriptor* new_array = (Descriptor*)realloc(list->descriptors,
-                                                 (list->count + 1) * sizeof(Descriptor));
+    Descriptor* new_array = (Descriptor*)MEM_REALLOC(list->descriptors,
+                                                     (list->count + 1) * sizeof(Descriptor));
     if (!new_array) {
         fprintf(stderr, "Error: Memory reallocation failed for descriptor list\n");
         exit(EXIT_FAILURE);
@@ -92,17 +161,110 @@ void add_descriptor(DescriptorList* list, Descriptor desc) {
     list->descriptors[list->count] = desc;
     list->count++;
 }
+#endif /* CV_MEMTRACK */
+
+void free_descriptor(Descriptor* desc) {
+    if (desc && desc->data) {
+        free_float_array(desc->data);
+        desc->data = NULL;
+        desc->length = 0;
+    }
+}
+
+void free_descriptor_list(DescriptorList* list) {
+    if (list && list->descriptors) {
+        for (int i = 0; i < list->count; i++) {
+            free_descriptor(&list->descriptors[i]);
+        }
+        MEM_FREE(list->descriptors);
+        list->descriptors = NULL;
+        list->count = 0;
+    }
+}
 
 // 数学工具函数
-float euclidean_distance(float* v1, float* v2, int dim) {
-    float sum = 0.0f;
-    for (int i = 0; i < dim; i++) {
+// 欧氏距离按16路部分和累加 (4个SSE累加器，隐藏加法延迟)
+// 通用版本与特化版本的累加顺序完全相同，因此结果逐位一致
+#define DISTANCE_LANES 16
+
+static float reduce_lanes(float* lanes) {
+    for (int width = DISTANCE_LANES / 2; width >= 1; width /= 2) {
+        for (int j = 0; j < width; j++) {
+            lanes[j] += lanes[j + width];
+        }
+    }
+    return lanes[0];
+}
+
+static float euclidean_distance_generic(const float* v1, const float* v2, int dim) {
+    float lanes[DISTANCE_LANES] = {0};
+    int i = 0;
+    for (; i + DISTANCE_LANES <= dim; i += DISTANCE_LANES) {
+        for (int j = 0; j < DISTANCE_LANES; j++) {
+            float diff = v1[i + j] - v2[i + j];
+            lanes[j] += diff * diff;
+        }
+    }
+
+    float sum = reduce_lanes(lanes);
+    for (; i < dim; i++) {
         float diff = v1[i] - v2[i];
         sum += diff * diff;
     }
     return sqrtf(sum);
 }
 
+// 固定维度的特化版本: 循环完全展开，按16字节对齐加载
+#if defined(__SSE2__)
+#define DEFINE_EUCLIDEAN_DISTANCE(DIM)                                              \
+    static float euclidean_distance_##DIM(const float* v1, const float* v2) {       \
+        __m128 acc[DISTANCE_LANES / 4];                                             \
+        for (int k = 0; k < DISTANCE_LANES / 4; k++) {                              \
+            acc[k] = _mm_setzero_ps();                                              \
+        }                                                                           \
+        UNROLL_LOOP                                                                 \
+        for (int i = 0; i < (DIM); i += DISTANCE_LANES) {                           \
+            UNROLL_LOOP                                                             \
+            for (int k = 0; k < DISTANCE_LANES / 4; k++) {                          \
+                __m128 diff = _mm_sub_ps(_mm_load_ps(v1 + i + 4 * k),               \
+                                         _mm_load_ps(v2 + i + 4 * k));              \
+                acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(diff, diff));                \
+            }                                                                       \
+        }                                                                           \
+        float lanes[DISTANCE_LANES];                                                \
+        for (int k = 0; k < DISTANCE_LANES / 4; k++) {                              \
+            _mm_storeu_ps(lanes + 4 * k, acc[k]);                                   \
+        }                                                                           \
+        return sqrtf(reduce_lanes(lanes));                                          \
+    }
+#else
+#define DEFINE_EUCLIDEAN_DISTANCE(DIM)                                              \
+    static float euclidean_distance_##DIM(const float* v1, const float* v2) {       \
+        const float* a = (const float*)ASSUME_ALIGNED(v1, 16);                      \
+        const float* b = (const float*)ASSUME_ALIGNED(v2, 16);                      \
+        float lanes[DISTANCE_LANES] = {0};                                          \
+        UNROLL_LOOP                                                                 \
+        for (int i = 0; i < (DIM); i += DISTANCE_LANES) {                           \
+            for (int j = 0; j < DISTANCE_LANES; j++) {                              \
+                float diff = a[i + j] - b[i + j];                                   \
+                lanes[j] += diff * diff;                                            \
+            }                                                                       \
+        }                                                                           \
+        return sqrtf(reduce_lanes(lanes));                                          \
+    }
+#endif
+
+DEFINE_EUCLIDEAN_DISTANCE(64)
+DEFINE_EUCLIDEAN_DISTANCE(128)
+
+float euclidean_distance(float* v1, float* v2, int dim) {
+    if (IS_ALIGNED(v1, 16) && IS_ALIGNED(v2, 16)) {
+        if (dim == 128) return euclidean_distance_128(v1, v2);
+        if (dim == 64) return euclidean_distance_64(v1, v2);
+    }
+    return euclidean_distance_generic(v1, v2, dim);
+}
+
 float chi_square_distance(float* v1, float* v2, int dim) {
     float sum = 0.0f;
     for (int i = 0; i < dim; i++) {
@@ -122,17 +284,30 @@ float min_float(float a, float b) {
     return (a < b) ? a : b;
 }
 
-// 随机数生成
+// 随机数生成: 每个线程一个独立的流，由默认种子和线程首次使用的顺序决定
+static atomic_int next_thread_stream = 0;
+static _Thread_local Rng thread_rng;
+static _Thread_local int thread_stream = -1;
+
+static Rng* current_thread_rng(void) {
+    if (thread_stream < 0) {
+        thread_stream = atomic_fetch_add(&next_thread_stream, 1);
+        thread_rng = rng_create_stream(rng_default_seed(), thread_stream);
+    }
+    return &thread_rng;
+}
+
 void init_random() {
-    srand((unsigned int)time(NULL));
+    current_thread_rng();
+    thread_rng = rng_create_stream(rng_default_seed(), thread_stream);
 }
 
 int random_int(int min, int max) {
-    return min + rand() % (max - min + 1);
+    return rng_range_int(current_thread_rng(), min, max);
 }
 
 float random_float(float min, float max) {
-    float scale = rand() / (float)RAND_MAX;
+    float scale = rng_uniform_float(current_thread_rng());
     return min + scale * (max - min);
 }
 
@@ -185,7 +360,7 @@ unsigned char* read_file(const char* filename, size_t* size) {
     *size = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    unsigned char* buffer = (unsigned char*)malloc(*size);
+    unsigned char* buffer = (unsigned char*)MEM_MALLOC(*size);
     if (!buffer) {
         fprintf(stderr, "Error: Memory allocation failed for file buffer\n");
         fclose(file);
@@ -197,7 +372,7 @@ unsigned char* read_file(const char* filename, size_t* size) {
 
     if (bytes_read != *size) {
         fprintf(stderr, "Error: Could not read entire file %s\n", filename);
-        free(buffer);
+        MEM_FREE(buffer);
         return NULL;
     }
 
@@ -0,0 +1,126 @@
+// 跨图像批处理内核与逐幅路径的一致性测试
+// 定点灰度、方向平面和密集SIFT的每个通道须与 convert_view_to_gray16_into / compute_orientation_planes_gray16_into /
+// extract_dense_sift_into 的结果逐位相同，包括不满 IMAGE_BATCH_LANES 幅的批和非CIFAR尺寸
+#include "test_common.h"
+#include "orientation.h"
+#include "sift.h"
+#include "spm.h"
+
+static void check_batch(const ImageView* views, int count, int width, int height, OrientationBinning binning) {
+    int max_count = dense_sift_grid_count(width, SPM_SIFT_STEP) * dense_sift_grid_count(height, SPM_SIFT_STEP);
+    size_t pixels = (size_t)width * height;
+
+    Gray16Batch gray_batch = create_gray16_batch(width, height);
+    OrientationPlanesBatch planes_batch = create_orientation_planes_batch(width, height);
+    CHECK(convert_views_to_gray16_batch(views, count, &gray_batch));
+    compute_orientation_planes_batch_into(&gray_batch, &planes_batch, binning);
+    CHECK(planes_batch.count == count);
+
+    float* batch_descriptors[IMAGE_BATCH_LANES];
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        batch_descriptors[lane] = lane < count ? allocate_float_array(max_count * SIFT_DESC_SIZE) : NULL;
+    }
+    float* batch_positions = allocate_float_array(max_count * 2);
+    int batch_count = extract_dense_sift_batch_into(&planes_batch, SPM_SIFT_STEP, batch_descriptors,
+                                                    batch_positions, max_count);
+    CHECK(batch_count == max_count);
+
+    Gray16Image gray = create_gray16_image(width, height);
+    OrientationPlanes planes = create_orientation_planes(width, height);
+    float* descriptors = allocate_float_array(max_count * SIFT_DESC_SIZE);
+    float* positions = allocate_float_array(max_count * 2);
+
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        if (lane >= count) {
+            // 空闲通道置0
+            int zero = 1;
+            for (size_t p = 0; p < pixels; p++) {
+                zero = zero && gray_batch.data[p * IMAGE_BATCH_LANES + lane] == 0;
+            }
+            CHECK(zero);
+            continue;
+        }
+
+        convert_view_to_gray16_into(&views[lane], &gray);
+        int same_gray = 1;
+        for (size_t p = 0; p < pixels; p++) {
+            same_gray = same_gray && gray_batch.data[p * IMAGE_BATCH_LANES + lane] == gray.data[p];
+        }
+        CHECK(same_gray);
+
+        compute_orientation_planes_gray16_into(&gray, &planes, binning);
+        int same_planes = 1;
+        for (size_t i = 0; i < pixels * ORIENTATION_BINS; i++) {
+            same_planes = same_planes &&
+                          memcmp(&planes_batch.data[i * IMAGE_BATCH_LANES + lane], &planes.data[i], sizeof(float)) == 0;
+        }
+        CHECK(same_planes);
+
+        int n = extract_dense_sift_into(&planes, SPM_SIFT_STEP, descriptors, positions, max_count);
+        CHECK(n == batch_count);
+        CHECK(memcmp(batch_descriptors[lane], descriptors, (size_t)n * SIFT_DESC_SIZE * sizeof(float)) == 0);
+        CHECK(memcmp(batch_positions, positions, (size_t)n * 2 * sizeof(float)) == 0);
+    }
+
+    free_float_array(descriptors);
+    free_float_array(positions);
+    free_orientation_planes(&planes);
+    free_gray16_image(&gray);
+    free_float_array(batch_positions);
+    for (int lane = 0; lane < count; lane++) {
+        free_float_array(batch_descriptors[lane]);
+    }
+    free_orientation_planes_batch(&planes_batch);
+    free_gray16_batch(&gray_batch);
+}
+
+int main(void) {
+    // CIFAR尺寸: 普通图像、CIFAR记录视图和翻转视图混合
+    Image images[IMAGE_BATCH_LANES];
+    ImageView views[IMAGE_BATCH_LANES];
+    unsigned char records[2][CIFAR_RECORD_SIZE];
+    Rng rng = rng_create(5);
+    for (int r = 0; r < 2; r++) {
+        for (int i = 0; i < CIFAR_RECORD_SIZE; i++) {
+            records[r][i] = (unsigned char)(rng_next_u64(&rng) & 0xFF);
+        }
+    }
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        images[lane] = make_random_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, 200 + lane);
+        views[lane] = image_view(&images[lane]);
+    }
+    views[1] = cifar_record_view(records[0]);
+    views[4] = cifar_record_view(records[1]);
+    views[6] = image_view_flip_horizontal(&views[6]);
+
+    check_batch(views, IMAGE_BATCH_LANES, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, ORIENTATION_HARD);
+    check_batch(views, IMAGE_BATCH_LANES, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, ORIENTATION_SOFT);
+    check_batch(views, 5, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, ORIENTATION_SOFT);
+    check_batch(views, 1, CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, ORIENTATION_HARD);
+
+    // 尺寸不符或数量超出时拒绝
+    Gray16Batch batch = create_gray16_batch(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE);
+    Image odd = make_random_image(40, 28, 300);
+    ImageView mixed[2] = {views[0], image_view(&odd)};
+    CHECK(!convert_views_to_gray16_batch(mixed, 2, &batch));
+    CHECK(!convert_views_to_gray16_batch(views, IMAGE_BATCH_LANES + 1, &batch));
+    free_gray16_batch(&batch);
+
+    // 非CIFAR尺寸 (宽度不是向量宽度的倍数)
+    Image others[3];
+    ImageView other_views[3];
+    for (int i = 0; i < 3; i++) {
+        others[i] = make_random_image(40, 28, 400 + i);
+        other_views[i] = image_view(&others[i]);
+    }
+    check_batch(other_views, 3, 40, 28, ORIENTATION_SOFT);
+
+    for (int i = 0; i < 3; i++) {
+        free_image(&others[i]);
+    }
+    free_image(&odd);
+    for (int lane = 0; lane < IMAGE_BATCH_LANES; lane++) {
+        free_image(&images[lane]);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,65 @@
+// 级联分类的完整阶段: 粗网格与细网格描述符按密集网格顺序累加，
+// 直方图须与 build_spatial_pyramid 逐位相同，类别与 classify_image 相同
+#include "test_common.h"
+#include "cascade.h"
+#include "kmeans.h"
+#include "sift.h"
+
+#define NUM_CLASSES 10
+#define NUM_IMAGES 6
+
+int main(void) {
+    Codebook codebook = make_random_codebook(50, SIFT_DESC_SIZE, 21);
+    int length = spm_histogram_length(codebook.num_clusters, SPM_LEVEL_2);
+    SVMModel* models[NUM_CLASSES];
+    Rng rng = rng_create(22);
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        models[c] = svm_create(length, 1.0);
+        for (int i = 0; i < length; i++) {
+            models[c]->weights[i] = rng_uniform_double(&rng) - 0.5;
+        }
+    }
+
+    // 粗网格阶段的阈值为 DBL_MAX，每幅图像都走到完整阶段
+    int num_coarse = cascade_num_coarse(SPM_LEVEL_2);
+    SVMModel* stage_models[CASCADE_MAX_STAGES * NUM_CLASSES];
+    CascadeClassifier cascade = {SPM_LEVEL_2, num_coarse, NUM_CLASSES, codebook.num_clusters, stage_models, {0}};
+    for (int s = 0; s < num_coarse; s++) {
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            stage_models[s * NUM_CLASSES + c] = svm_create(spm_histogram_length(codebook.num_clusters, s), 1.0);
+        }
+        cascade.thresholds[s] = DBL_MAX;
+    }
+
+    InferenceWorkspace* workspace = create_inference_workspace(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, &codebook,
+                                                               SPM_LEVEL_2, models, NUM_CLASSES);
+    CascadeStats stats = {0};
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        // 包括网格点数为奇数的尺寸
+        int size = i % 2 == 0 ? CIFAR_IMAGE_SIZE : CIFAR_IMAGE_SIZE - 4;
+        Image img = make_random_image(size, size, 300 + i);
+        SpmHistogram expected = build_spatial_pyramid(&img, &codebook, SPM_LEVEL_2);
+        int expected_label = classify_image(workspace, &img);
+
+        ImageView view = image_view(&img);
+        int stage = -1;
+        int label = classify_image_cascade_view(workspace, &cascade, &view, &stage, &stats);
+        CHECK(stage == num_coarse);
+        CHECK(label == expected_label);
+        CHECK(memcmp(workspace->histogram, expected.histogram, length * sizeof(float)) == 0);
+
+        free_spm_histogram(&expected);
+        free_image(&img);
+    }
+    CHECK(stats.descriptors == stats.dense_descriptors);
+
+    free_inference_workspace(workspace);
+    for (int i = 0; i < num_coarse * NUM_CLASSES; i++) {
+        svm_free(stage_models[i]);
+    }
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        svm_free(models[c]);
+    }
+    free_codebook(&codebook);
+    return TEST_RESULT();
+}
@@ -0,0 +1,43 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include "image.h"
+#include "rng.h"
+#include "utils.h"
+
+// 测试辅助: 断言失败时记录位置并计数，main 以失败数作为返回值
+static int test_failures = 0;
+
+#define CHECK(cond)                                                               \
+    do {                                                                          \
+        if (!(cond)) {                                                            \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                      \
+        }                                                                         \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+// 固定种子的随机RGB图像
+static inline Image make_random_image(int width, int height, uint64_t seed) {
+    Rng rng = rng_create(seed);
+    Image img = create_image(width, height, 3);
+    for (size_t i = 0; i < (size_t)width * height * 3; i++) {
+        img.data[i] = (unsigned char)(rng_next_u64(&rng) & 0xFF);
+    }
+    return img;
+}
+
+// 随机码本 (中心在描述符的取值范围内)
+static inline Codebook make_random_codebook(int num_clusters, int dim, uint64_t seed) {
+    Rng rng = rng_create(seed);
+    Codebook codebook = {allocate_float_matrix(num_clusters, dim), num_clusters, dim};
+    for (int i = 0; i < num_clusters; i++) {
+        for (int j = 0; j < dim; j++) {
+            codebook.centers[i][j] = 0.2f * rng_uniform_float(&rng);
+        }
+    }
+    return codebook;
+}
+
+#endif /* TEST_COMMON_H */
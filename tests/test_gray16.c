@@ -0,0 +1,127 @@
+// 定点灰度与整数梯度前端对浮点路径的误差测试
+// 灰度除以 GRAY16_SCALE 后与 convert_view_to_gray_into 之差小于 1/GRAY16_SCALE；
+// 方向平面每个像素的幅值 (各bin之和) 与浮点路径之差小于 3/GRAY16_SCALE；
+// 硬分bin结果不同的像素，其浮点梯度与象限/对角线边界的距离也在 3/GRAY16_SCALE 以内
+#include "test_common.h"
+#include "orientation.h"
+
+#define GRAY_BOUND (1.0f / GRAY16_SCALE)
+#define GRADIENT_BOUND (3.0f / GRAY16_SCALE)
+
+static float gray_at(const GrayImage* gray, int x, int y) {
+    x = x < 0 ? 0 : (x >= gray->width ? gray->width - 1 : x);
+    y = y < 0 ? 0 : (y >= gray->height ? gray->height - 1 : y);
+    return gray->data[(size_t)y * gray->width + x];
+}
+
+// 梯度到8个方向bin边界 (gx=0, gy=0, |gx|=|gy|) 的最近距离
+static float boundary_distance(float gx, float gy) {
+    float ax = fabsf(gx);
+    float ay = fabsf(gy);
+    float d = ax < ay ? ax : ay;
+    float diagonal = fabsf(ax - ay) * 0.70710678f;
+    return diagonal < d ? diagonal : d;
+}
+
+static float pixel_magnitude(const float* bins) {
+    float sum = 0.0f;
+    for (int b = 0; b < ORIENTATION_BINS; b++) {
+        sum += bins[b];
+    }
+    return sum;
+}
+
+static int hard_bin(const float* bins) {
+    for (int b = 0; b < ORIENTATION_BINS; b++) {
+        if (bins[b] != 0.0f) return b;
+    }
+    return -1;
+}
+
+static void check_view(const ImageView* view) {
+    int width = view->width;
+    int height = view->height;
+    size_t pixels = (size_t)width * height;
+    GrayImage gray = create_gray_image(width, height);
+    Gray16Image gray16 = create_gray16_image(width, height);
+    OrientationPlanes reference = create_orientation_planes(width, height);
+    OrientationPlanes fixed = create_orientation_planes(width, height);
+
+    convert_view_to_gray_into(view, &gray);
+    convert_view_to_gray16_into(view, &gray16);
+    float gray_error = 0.0f;
+    for (size_t p = 0; p < pixels; p++) {
+        float error = fabsf((float)gray16.data[p] / GRAY16_SCALE - gray.data[p]);
+        if (error > gray_error) gray_error = error;
+    }
+    CHECK(gray_error < GRAY_BOUND);
+
+    float magnitude_error = 0.0f;
+    int flipped = 0;
+    int unexplained = 0;
+    OrientationBinning binnings[2] = {ORIENTATION_HARD, ORIENTATION_SOFT};
+    for (int i = 0; i < 2; i++) {
+        compute_orientation_planes_into(&gray, &reference, binnings[i]);
+        compute_orientation_planes_gray16_into(&gray16, &fixed, binnings[i]);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t offset = ((size_t)y * width + x) * ORIENTATION_BINS;
+                const float* a = reference.data + offset;
+                const float* b = fixed.data + offset;
+                float error = fabsf(pixel_magnitude(a) - pixel_magnitude(b));
+                if (error > magnitude_error) magnitude_error = error;
+
+                if (binnings[i] == ORIENTATION_HARD && hard_bin(a) != hard_bin(b)) {
+                    float gx = gray_at(&gray, x + 1, y) - gray_at(&gray, x - 1, y);
+                    float gy = gray_at(&gray, x, y + 1) - gray_at(&gray, x, y - 1);
+                    flipped++;
+                    unexplained += boundary_distance(gx, gy) >= GRADIENT_BOUND;
+                }
+            }
+        }
+    }
+    printf("gray16 %dx%d: gray error %.3g, magnitude error %.3g, %d hard bins differ\n",
+           width, height, gray_error, magnitude_error, flipped);
+    CHECK(magnitude_error < GRADIENT_BOUND);
+    CHECK(unexplained == 0);
+
+    free_orientation_planes(&fixed);
+    free_orientation_planes(&reference);
+    free_gray16_image(&gray16);
+    free_gray_image(&gray);
+}
+
+int main(void) {
+    for (int i = 0; i < 4; i++) {
+        Image img = make_random_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, 700 + i);
+        ImageView view = image_view(&img);
+        check_view(&view);
+        free_image(&img);
+    }
+
+    // 非CIFAR尺寸 (宽度不是向量宽度的倍数)、子区域和翻转视图
+    Image large = make_random_image(77, 53, 710);
+    ImageView large_view = image_view(&large);
+    check_view(&large_view);
+    ImageView roi = image_view_roi(&large_view, 5, 3, 41, 37);
+    check_view(&roi);
+    ImageView flipped = image_view_flip_horizontal(&roi);
+    check_view(&flipped);
+    free_image(&large);
+
+    // 平滑图像: 梯度小，分bin更依赖低位精度
+    Image smooth = create_image(48, 40, 3);
+    for (int y = 0; y < smooth.height; y++) {
+        for (int x = 0; x < smooth.width; x++) {
+            unsigned char* pixel = smooth.data + ((size_t)y * smooth.width + x) * 3;
+            pixel[0] = (unsigned char)(x * 3 + y);
+            pixel[1] = (unsigned char)(x + y * 2);
+            pixel[2] = (unsigned char)(128 + (x - y));
+        }
+    }
+    ImageView smooth_view = image_view(&smooth);
+    check_view(&smooth_view);
+    free_image(&smooth);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+// 推理路径的零分配测试
+// 以 -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free 链接，所有堆调用 (包括静态库内部的) 经过计数包装；
+// 工作区创建之后，classify_image 不得再进行任何堆分配，且直方图与 build_spatial_pyramid 逐位相同
+#include "test_common.h"
+#include "inference.h"
+#include "kmeans.h"
+#include "sift.h"
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static long heap_calls = 0;
+
+void* __wrap_malloc(size_t size) {
+    heap_calls++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    heap_calls++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    heap_calls++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) {
+        heap_calls++;
+    }
+    __real_free(ptr);
+}
+
+#define NUM_CLASSES 10
+#define NUM_IMAGES 8
+
+int main(void) {
+    Codebook codebook = make_random_codebook(50, SIFT_DESC_SIZE, 1);
+    SVMModel* models[NUM_CLASSES];
+    int length = spm_histogram_length(codebook.num_clusters, SPM_LEVEL_2);
+    Rng rng = rng_create(2);
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        models[c] = svm_create(length, 1.0);
+        for (int i = 0; i < length; i++) {
+            models[c]->weights[i] = rng_uniform_double(&rng) - 0.5;
+        }
+    }
+
+    Image images[NUM_IMAGES];
+    SpmHistogram expected[NUM_IMAGES];
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        // 包括小于工作区的图像
+        int size = i % 2 == 0 ? CIFAR_IMAGE_SIZE : CIFAR_IMAGE_SIZE - 8;
+        images[i] = make_random_image(size, size, 100 + i);
+        expected[i] = build_spatial_pyramid(&images[i], &codebook, SPM_LEVEL_2);
+    }
+
+    // 包装确实生效: 创建工作区时的分配被计数
+    heap_calls = 0;
+    InferenceWorkspace* workspace = create_inference_workspace(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, &codebook,
+                                                               SPM_LEVEL_2, models, NUM_CLASSES);
+    CHECK(heap_calls > 0);
+
+    heap_calls = 0;
+    int labels[NUM_IMAGES];
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        labels[i] = classify_image(workspace, &images[i]);
+        CHECK(memcmp(workspace->histogram, expected[i].histogram, length * sizeof(float)) == 0);
+    }
+    long calls = heap_calls;
+
+    printf("classify_image: %ld heap calls for %d images\n", calls, NUM_IMAGES);
+    CHECK(calls == 0);
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        CHECK(labels[i] >= 0 && labels[i] < NUM_CLASSES);
+    }
+
+    // 超出工作区的图像被拒绝，同样不分配
+    Image large = make_random_image(CIFAR_IMAGE_SIZE + 1, CIFAR_IMAGE_SIZE, 7);
+    heap_calls = 0;
+    CHECK(classify_image(workspace, &large) == -1);
+    CHECK(heap_calls == 0);
+
+    free_image(&large);
+    free_inference_workspace(workspace);
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        free_spm_histogram(&expected[i]);
+        free_image(&images[i]);
+    }
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        svm_free(models[c]);
+    }
+    free_codebook(&codebook);
+    return TEST_RESULT();
+}
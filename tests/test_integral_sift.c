@@ -0,0 +1,43 @@
+// 积分图描述符与密集SIFT的一致性测试
+// 积分图以double按矩形求和，密集路径按像素以float累加，cell_size为4时两者只相差舍入误差:
+// 每个分量之差不超过 INTEGRAL_SIFT_TOLERANCE (见 sift.h)
+#include "test_common.h"
+#include "sift.h"
+#include "spm.h"
+
+static void check_image(const Image* img) {
+    ImageView view = image_view(img);
+    int cell_sizes[1] = {SIFT_CELL_SIZE};
+    DescriptorList dense = extract_dense_sift_view(&view, SPM_SIFT_STEP);
+    DescriptorList integral = extract_dense_sift_multiscale(img, SPM_SIFT_STEP, cell_sizes, 1);
+    CHECK(dense.count > 0);
+    CHECK(integral.count == dense.count);
+
+    float max_error = 0.0f;
+    for (int i = 0; i < dense.count && i < integral.count; i++) {
+        const Descriptor* a = &dense.descriptors[i];
+        const Descriptor* b = &integral.descriptors[i];
+        CHECK(a->x == b->x && a->y == b->y);
+        for (int j = 0; j < SIFT_DESC_SIZE; j++) {
+            float error = fabsf(a->data[j] - b->data[j]);
+            if (error > max_error) max_error = error;
+        }
+    }
+    printf("integral vs dense %dx%d: max error %.3g\n", img->width, img->height, max_error);
+    CHECK(max_error <= INTEGRAL_SIFT_TOLERANCE);
+
+    free_descriptor_list(&dense);
+    free_descriptor_list(&integral);
+}
+
+int main(void) {
+    for (int i = 0; i < 4; i++) {
+        Image img = make_random_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, 500 + i);
+        check_image(&img);
+        free_image(&img);
+    }
+    Image large = make_random_image(97, 64, 510);
+    check_image(&large);
+    free_image(&large);
+    return TEST_RESULT();
+}
@@ -0,0 +1,44 @@
+// 无放回抽样与有界批量生成的边界情况
+#include "test_common.h"
+
+int main(void) {
+    int out[64];
+    unsigned char seen[1000];
+
+    // 抽取的下标互不相同且在范围内
+    int ns[] = {64, 100, 1000};
+    for (int t = 0; t < 3; t++) {
+        Rng rng = rng_create(t);
+        CHECK(rng_sample_indices(&rng, ns[t], 64, out));
+        memset(seen, 0, sizeof(seen));
+        for (int i = 0; i < 64; i++) {
+            CHECK(out[i] >= 0 && out[i] < ns[t]);
+            CHECK(!seen[out[i]]);
+            seen[out[i]] = 1;
+        }
+    }
+
+    // k > n 被拒绝，不写入 out
+    Rng rng = rng_create(7);
+    out[0] = -1;
+    CHECK(!rng_sample_indices(&rng, 10, 11, out));
+    CHECK(!rng_sample_indices(&rng, 10, -1, out));
+    CHECK(out[0] == -1);
+    CHECK(rng_sample_indices(&rng, 0, 0, out));
+
+    // bound 为0时输出0且 rng 不前进
+    uint32_t values[9];
+    Rng before = rng;
+    memset(values, 0xFF, sizeof(values));
+    rng_fill_bounded(&rng, values, 9, 0);
+    for (int i = 0; i < 9; i++) {
+        CHECK(values[i] == 0);
+    }
+    CHECK(memcmp(&before, &rng, sizeof(Rng)) == 0);
+    rng_fill_bounded(&rng, values, 9, 3);
+    for (int i = 0; i < 9; i++) {
+        CHECK(values[i] < 3);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,182 @@
+// 描述符蓄水池采样测试
+// 样本数恰好为预算 (预算不能被分层数整除时也是)，各层按预算分配，图像内配额生效，
+// 负的分层号不越界；结果与提交线程数和图像到达顺序无关
+#include "test_common.h"
+#include "sampler.h"
+#include "spm.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DIM 4
+#define NUM_ITEMS 120
+#define PER_ITEM 50
+#define NUM_STRATA 7
+#define BUDGET 1003
+#define QUOTA 30
+
+// 每个描述符记录 (分层, 图像序号, 描述符序号, 0)，从样本即可还原其来源
+static DescriptorList items[NUM_ITEMS];
+
+static int item_stratum(int item) {
+    // 包括负的分层号: -1 与 NUM_STRATA-1 属于同一层
+    return item % 11 == 0 ? -1 : item % NUM_STRATA;
+}
+
+static void make_items(void) {
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        int stratum = item_stratum(i);
+        items[i] = create_descriptor_list(PER_ITEM);
+        for (int j = 0; j < PER_ITEM; j++) {
+            Descriptor desc = create_descriptor(DIM);
+            desc.data[0] = (float)(((stratum % NUM_STRATA) + NUM_STRATA) % NUM_STRATA);
+            desc.data[1] = (float)i;
+            desc.data[2] = (float)j;
+            add_descriptor(&items[i], desc);
+        }
+    }
+}
+
+static SamplerOptions make_options(int num_threads) {
+    SamplerOptions options = {BUDGET, QUOTA, NUM_STRATA, num_threads, 77};
+    return options;
+}
+
+// 单线程按给定顺序提交，thread 序号轮流使用
+static DescriptorList sample_in_order(const int* order, int num_threads) {
+    SamplerOptions options = make_options(num_threads);
+    DescriptorSampler* sampler = descriptor_sampler_create(&options, DIM);
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        int item = order[i];
+        descriptor_sampler_offer(sampler, i % num_threads, item_stratum(item), item, &items[item]);
+    }
+    DescriptorList sample = descriptor_sampler_finish(sampler);
+    descriptor_sampler_free(sampler);
+    return sample;
+}
+
+typedef struct {
+    DescriptorSampler* sampler;
+    atomic_int next;
+} OfferJob;
+
+typedef struct {
+    OfferJob* job;
+    int thread;
+} OfferWorker;
+
+static void* offer_worker_main(void* arg) {
+    OfferWorker* worker = (OfferWorker*)arg;
+    for (;;) {
+        int item = atomic_fetch_add(&worker->job->next, 1);
+        if (item >= NUM_ITEMS) {
+            break;
+        }
+        descriptor_sampler_offer(worker->job->sampler, worker->thread, item_stratum(item), item, &items[item]);
+    }
+    return NULL;
+}
+
+// 多个线程并发提交，到达顺序由调度决定
+static DescriptorList sample_concurrently(int num_threads) {
+    SamplerOptions options = make_options(num_threads);
+    OfferJob job = {descriptor_sampler_create(&options, DIM), 0};
+    pthread_t threads[8];
+    OfferWorker workers[8];
+    for (int t = 0; t < num_threads; t++) {
+        workers[t] = (OfferWorker){&job, t};
+        pthread_create(&threads[t], NULL, offer_worker_main, &workers[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    DescriptorList sample = descriptor_sampler_finish(job.sampler);
+    descriptor_sampler_free(job.sampler);
+    return sample;
+}
+
+static int same_sample(const DescriptorList* a, const DescriptorList* b) {
+    if (a->count != b->count) {
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        if (a->descriptors[i].length != b->descriptors[i].length ||
+            memcmp(a->descriptors[i].data, b->descriptors[i].data, a->descriptors[i].length * sizeof(float)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(void) {
+    make_items();
+
+    int order[NUM_ITEMS];
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        order[i] = i;
+    }
+    DescriptorList reference = sample_in_order(order, 1);
+
+    // 预算: 1003 = 7 * 143 + 2，前两层各多一个
+    CHECK(reference.count == BUDGET);
+    int per_stratum[NUM_STRATA] = {0};
+    int per_item[NUM_ITEMS] = {0};
+    int previous = 0;
+    int ordered = 1;
+    for (int i = 0; i < reference.count; i++) {
+        const float* data = reference.descriptors[i].data;
+        int stratum = (int)data[0];
+        CHECK(stratum >= 0 && stratum < NUM_STRATA);
+        if (stratum < 0 || stratum >= NUM_STRATA) continue;
+        per_stratum[stratum]++;
+        per_item[(int)data[1]]++;
+        // 各层依次排列
+        ordered = ordered && stratum >= previous;
+        previous = stratum;
+    }
+    CHECK(ordered);
+    for (int s = 0; s < NUM_STRATA; s++) {
+        CHECK(per_stratum[s] == BUDGET / NUM_STRATA + (s < BUDGET % NUM_STRATA));
+    }
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        CHECK(per_item[i] <= QUOTA);
+    }
+
+    // 打乱到达顺序、改变线程数，样本逐位相同
+    Rng rng = rng_create(78);
+    for (int round = 0; round < 3; round++) {
+        rng_shuffle_int(&rng, order, NUM_ITEMS);
+        DescriptorList shuffled = sample_in_order(order, 1 + round * 2);
+        CHECK(same_sample(&reference, &shuffled));
+        free_descriptor_list(&shuffled);
+    }
+    for (int threads = 2; threads <= 8; threads *= 2) {
+        DescriptorList concurrent = sample_concurrently(threads);
+        CHECK(same_sample(&reference, &concurrent));
+        free_descriptor_list(&concurrent);
+    }
+
+    // 端到端: sample_dense_sift 的结果与线程数无关
+    Image images[12];
+    int strata[12];
+    for (int i = 0; i < 12; i++) {
+        images[i] = make_random_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, 600 + i);
+        strata[i] = i % 3;
+    }
+    SamplerOptions sift_options = {101, 20, 3, 1, 79};
+    DescriptorList one = sample_dense_sift(images, 12, strata, SPM_SIFT_STEP, &sift_options);
+    sift_options.num_threads = 4;
+    DescriptorList four = sample_dense_sift(images, 12, strata, SPM_SIFT_STEP, &sift_options);
+    CHECK(one.count == 101);
+    CHECK(same_sample(&one, &four));
+    free_descriptor_list(&one);
+    free_descriptor_list(&four);
+    for (int i = 0; i < 12; i++) {
+        free_image(&images[i]);
+    }
+
+    free_descriptor_list(&reference);
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        free_descriptor_list(&items[i]);
+    }
+    return TEST_RESULT();
+}
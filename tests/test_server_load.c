@@ -0,0 +1,217 @@
+// 服务端负载测试
+// 保存随机码本和模型，在子进程中启动服务，多个线程并发发送CIFAR记录，
+// 检查每个回复的类别与决策值与本地 build_spatial_pyramid 的结果一致，超大的请求头被拒绝，最后用 SIGTERM 停止服务
+#define _POSIX_C_SOURCE 200809L
+#include "test_common.h"
+#include "server.h"
+#include "kmeans.h"
+#include "sift.h"
+#include "spm.h"
+#include "svm.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_CLASSES 10
+#define NUM_RECORDS 48
+#define NUM_CLIENTS 6
+#define NUM_REQUESTS 40
+#define SCORE_TOLERANCE 1e-4f
+
+typedef struct {
+    const char* socket_path;
+    const unsigned char* records;
+    const float* expected;   // 每条记录的本地决策值
+    int client_id;
+    int answered;
+    int mismatches;
+} LoadClient;
+
+static int argmax(const float* scores) {
+    int best = 0;
+    for (int c = 1; c < NUM_CLASSES; c++) {
+        if (scores[c] > scores[best]) best = c;
+    }
+    return best;
+}
+
+static void* load_client_main(void* arg) {
+    LoadClient* client = (LoadClient*)arg;
+    int fd = server_connect(client->socket_path);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    float scores[NUM_CLASSES];
+    for (int i = 0; i < NUM_REQUESTS; i++) {
+        int idx = (client->client_id * 7 + i) % NUM_RECORDS;
+        int label = server_classify_cifar(fd, client->records + (size_t)idx * CIFAR_RECORD_SIZE, scores,
+                                          NUM_CLASSES);
+        if (label < 0) {
+            break;
+        }
+        client->answered++;
+
+        const float* expected = client->expected + (size_t)idx * NUM_CLASSES;
+        int ok = label == argmax(scores);
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            ok = ok && fabsf(scores[c] - expected[c]) <= SCORE_TOLERANCE;
+        }
+        client->mismatches += !ok;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+// 服务启动后才能连接，轮询等待 (最多约10秒)
+static int wait_for_server(const char* socket_path, pid_t pid) {
+    struct timespec pause = {0, 20 * 1000 * 1000};
+    for (int attempt = 0; attempt < 500; attempt++) {
+        if (waitpid(pid, NULL, WNOHANG) == pid) {
+            return 0;
+        }
+        if (access(socket_path, F_OK) == 0) {
+            int fd = server_connect(socket_path);
+            if (fd >= 0) {
+                close(fd);
+                return 1;
+            }
+        }
+        nanosleep(&pause, NULL);
+    }
+    return 0;
+}
+
+int main(void) {
+    char dir[] = "/tmp/cv-c-server-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    char prefix[128], codebook_path[256], svm_path[256], socket_path[256];
+    snprintf(prefix, sizeof(prefix), "%s/model", dir);
+    snprintf(codebook_path, sizeof(codebook_path), "%s.codebook", prefix);
+    snprintf(svm_path, sizeof(svm_path), "%s.svm", prefix);
+    snprintf(socket_path, sizeof(socket_path), "%s/serve.sock", dir);
+
+    Codebook codebook = make_random_codebook(40, SIFT_DESC_SIZE, 11);
+    int length = spm_histogram_length(codebook.num_clusters, SPM_LEVEL_2);
+    SVMModel* models[NUM_CLASSES];
+    Rng rng = rng_create(12);
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        models[c] = svm_create(length, 1.0);
+        for (int i = 0; i < length; i++) {
+            models[c]->weights[i] = rng_uniform_double(&rng) - 0.5;
+        }
+    }
+    CHECK(save_codebook(&codebook, codebook_path));
+    CHECK(svm_save_models(models, NUM_CLASSES, svm_path));
+
+    // 本地参考: 使用服务端加载的同一份模型文件
+    Codebook loaded = load_codebook(codebook_path);
+    int num_loaded = 0;
+    SVMModel** loaded_models = svm_load_models(svm_path, &num_loaded);
+    CHECK(loaded.centers && loaded_models && num_loaded == NUM_CLASSES);
+    if (!loaded.centers || !loaded_models || num_loaded != NUM_CLASSES) {
+        return TEST_RESULT();
+    }
+
+    unsigned char* records = (unsigned char*)malloc((size_t)NUM_RECORDS * CIFAR_RECORD_SIZE);
+    float* expected = (float*)malloc((size_t)NUM_RECORDS * NUM_CLASSES * sizeof(float));
+    for (int r = 0; r < NUM_RECORDS; r++) {
+        unsigned char* record = records + (size_t)r * CIFAR_RECORD_SIZE;
+        record[0] = (unsigned char)(r % NUM_CLASSES);
+        for (int i = 1; i < CIFAR_RECORD_SIZE; i++) {
+            record[i] = (unsigned char)(rng_next_u64(&rng) & 0xFF);
+        }
+
+        Image img = decode_cifar_record(record);
+        SpmHistogram hist = build_spatial_pyramid(&img, &loaded, SPM_LEVEL_2);
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            double score = 0.0;
+            for (int i = 0; i < hist.length; i++) {
+                score += loaded_models[c]->weights[i] * hist.histogram[i];
+            }
+            expected[(size_t)r * NUM_CLASSES + c] = (float)score;
+        }
+        free_spm_histogram(&hist);
+        free_image(&img);
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        ServerConfig config = {prefix, socket_path, 8, 200, 2, SERVER_DEFAULT_MAX_IMAGE_SIZE};
+        _exit(run_server(&config));
+    }
+    CHECK(pid > 0);
+
+    if (pid > 0 && wait_for_server(socket_path, pid)) {
+        pthread_t threads[NUM_CLIENTS];
+        LoadClient clients[NUM_CLIENTS];
+        for (int c = 0; c < NUM_CLIENTS; c++) {
+            clients[c] = (LoadClient){socket_path, records, expected, c, 0, 0};
+            pthread_create(&threads[c], NULL, load_client_main, &clients[c]);
+        }
+        int answered = 0;
+        int mismatches = 0;
+        for (int c = 0; c < NUM_CLIENTS; c++) {
+            pthread_join(threads[c], NULL);
+            answered += clients[c].answered;
+            mismatches += clients[c].mismatches;
+        }
+        printf("server load: %d/%d answered, %d mismatched\n", answered, NUM_CLIENTS * NUM_REQUESTS, mismatches);
+        CHECK(answered == NUM_CLIENTS * NUM_REQUESTS);
+        CHECK(mismatches == 0);
+
+        // 超大的RGB请求头: 读取负载之前就回复错误并关闭连接
+        int big = server_connect(socket_path);
+        CHECK(big >= 0);
+        if (big >= 0) {
+            ServerRequestHeader header = {SERVER_MAGIC, SERVER_REQUEST_RGB, 100000, 100000};
+            ServerReplyHeader reply;
+            char extra;
+            CHECK(write(big, &header, sizeof(header)) == (ssize_t)sizeof(header));
+            CHECK(read(big, &reply, sizeof(reply)) == (ssize_t)sizeof(reply));
+            CHECK(reply.magic == SERVER_MAGIC && reply.label == -1 && reply.num_scores == 0);
+            CHECK(read(big, &extra, 1) == 0);
+            close(big);
+        }
+
+        // 服务端统计包含全部请求 (被拒绝的请求不计入)
+        int fd = server_connect(socket_path);
+        char* stats = fd >= 0 ? server_fetch_stats(fd) : NULL;
+        char needle[64];
+        snprintf(needle, sizeof(needle), "\"requests\": %d,", NUM_CLIENTS * NUM_REQUESTS);
+        CHECK(stats && strstr(stats, needle));
+        MEM_FREE(stats);
+        if (fd >= 0) close(fd);
+    } else {
+        CHECK(!"server did not start");
+    }
+
+    if (pid > 0) {
+        int status = 0;
+        kill(pid, SIGTERM);
+        CHECK(waitpid(pid, &status, 0) == pid);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+
+    unlink(codebook_path);
+    unlink(svm_path);
+    unlink(socket_path);
+    rmdir(dir);
+    free(records);
+    free(expected);
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        svm_free(models[c]);
+        svm_free(loaded_models[c]);
+    }
+    free(loaded_models);
+    free_codebook(&loaded);
+    free_codebook(&codebook);
+    return TEST_RESULT();
+}
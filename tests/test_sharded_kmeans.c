@@ -0,0 +1,102 @@
+// 分片K-means: 分片数不影响结果；工作进程被杀死时协调进程中止并返回空码本，而不是永远等待屏障
+#define _POSIX_C_SOURCE 200809L
+#include "test_common.h"
+#include "sharded.h"
+#include "kmeans.h"
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DIM 32
+
+static DescriptorList make_descriptors(int count, uint64_t seed) {
+    Rng rng = rng_create(seed);
+    DescriptorList list = create_descriptor_list(count);
+    for (int i = 0; i < count; i++) {
+        Descriptor desc = create_descriptor(DIM);
+        for (int j = 0; j < DIM; j++) {
+            desc.data[j] = rng_uniform_float(&rng);
+        }
+        add_descriptor(&list, desc);
+    }
+    return list;
+}
+
+// 把描述符均分写入 num_shards 个分片文件
+static void write_shards(const DescriptorList* list, const char* dir, int num_shards, char paths[][256]) {
+    for (int s = 0; s < num_shards; s++) {
+        snprintf(paths[s], 256, "%s/shard-%d-of-%d.dsh", dir, s, num_shards);
+        int begin = list->count * s / num_shards;
+        int end = list->count * (s + 1) / num_shards;
+        CHECK(write_descriptor_shard(paths[s], list, begin, end));
+    }
+}
+
+// 杀死第一个出现的工作进程 (协调进程的子进程)
+static void* kill_first_worker(void* arg) {
+    (void)arg;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)getpid(), (int)getpid());
+    struct timespec pause = {0, 1000000};
+    for (int attempt = 0; attempt < 10000; attempt++) {
+        FILE* file = fopen(path, "r");
+        int pid = 0;
+        if (file) {
+            if (fscanf(file, "%d", &pid) != 1) pid = 0;
+            fclose(file);
+        }
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            return NULL;
+        }
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+int main(void) {
+    char dir[] = "/tmp/cv-c-sharded-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    // 屏障挂起时由 SIGALRM 结束测试
+    alarm(120);
+
+    // 1个与3个分片的码本逐位相同
+    DescriptorList small = make_descriptors(3000, 1);
+    char one[1][256], three[3][256];
+    write_shards(&small, dir, 1, one);
+    write_shards(&small, dir, 3, three);
+    const char* one_paths[1] = {one[0]};
+    const char* three_paths[3] = {three[0], three[1], three[2]};
+    Codebook a = build_codebook_sharded(one_paths, 1, 16, 100);
+    Codebook b = build_codebook_sharded(three_paths, 3, 16, 100);
+    CHECK(a.centers && b.centers);
+    for (int i = 0; a.centers && b.centers && i < 16; i++) {
+        CHECK(memcmp(a.centers[i], b.centers[i], DIM * sizeof(float)) == 0);
+    }
+    free_codebook(&a);
+    free_codebook(&b);
+
+    // 迭代期间杀死一个工作进程
+    DescriptorList large = make_descriptors(40000, 2);
+    char two[2][256];
+    write_shards(&large, dir, 2, two);
+    const char* two_paths[2] = {two[0], two[1]};
+    pthread_t killer;
+    pthread_create(&killer, NULL, kill_first_worker, NULL);
+    Codebook aborted = build_codebook_sharded(two_paths, 2, 64, 1000000);
+    pthread_join(killer, NULL);
+    CHECK(aborted.centers == NULL);
+    free_codebook(&aborted);
+
+    for (int s = 0; s < 3; s++) unlink(three[s]);
+    for (int s = 0; s < 2; s++) unlink(two[s]);
+    unlink(one[0]);
+    rmdir(dir);
+    free_descriptor_list(&small);
+    free_descriptor_list(&large);
+    return TEST_RESULT();
+}
@@ -0,0 +1,72 @@
+// 分条处理与整幅图像路径的一致性测试
+// 高于一个条带的图像上，extract_dense_sift_tiled 的描述符、坐标和顺序须与 extract_dense_sift_view 逐位相同，
+// build_spatial_pyramid_tiled 的直方图须与 build_spatial_pyramid 逐位相同
+#include "test_common.h"
+#include "kmeans.h"
+#include "tiled.h"
+
+typedef struct {
+    const DescriptorList* expected;
+    int seen;
+    int mismatches;
+} TiledCheck;
+
+static void compare_strip(float* descriptors, const float* positions, int count, void* ctx) {
+    TiledCheck* check = (TiledCheck*)ctx;
+    for (int i = 0; i < count; i++, check->seen++) {
+        if (check->seen >= check->expected->count) {
+            check->mismatches++;
+            continue;
+        }
+        const Descriptor* desc = &check->expected->descriptors[check->seen];
+        if (desc->x != positions[i * 2] || desc->y != positions[i * 2 + 1] ||
+            memcmp(desc->data, descriptors + (size_t)i * SIFT_DESC_SIZE, SIFT_DESC_SIZE * sizeof(float)) != 0) {
+            check->mismatches++;
+        }
+    }
+}
+
+static void check_tiled(const Image* img, const ImageView* view, const Codebook* codebook, int strip_rows) {
+    DescriptorList expected = extract_dense_sift_view(view, SPM_SIFT_STEP);
+    TiledCheck check = {&expected, 0, 0};
+    int count = extract_dense_sift_tiled(view, SPM_SIFT_STEP, strip_rows, compare_strip, &check);
+    CHECK(count == expected.count);
+    CHECK(check.seen == expected.count);
+    CHECK(check.mismatches == 0);
+    free_descriptor_list(&expected);
+
+    for (int level = SPM_LEVEL_0; level <= SPM_LEVEL_2; level++) {
+        SpmHistogram whole = build_spatial_pyramid(img, (Codebook*)codebook, level);
+        SpmHistogram tiled = build_spatial_pyramid_tiled(view, (Codebook*)codebook, level, strip_rows);
+        CHECK(tiled.length == whole.length);
+        CHECK(tiled.length == whole.length &&
+              memcmp(tiled.histogram, whole.histogram, whole.length * sizeof(float)) == 0);
+        free_spm_histogram(&whole);
+        free_spm_histogram(&tiled);
+    }
+}
+
+int main(void) {
+    Codebook codebook = make_random_codebook(40, SIFT_DESC_SIZE, 31);
+
+    // 条带行数: 步长的倍数、非倍数、默认值，以及大于图像 (单个条带)
+    int strips[] = {16, 17, 8, TILED_DEFAULT_STRIP_ROWS, 200};
+    Image tall = make_random_image(70, 150, 32);
+    ImageView tall_view = image_view(&tall);
+    for (size_t s = 0; s < sizeof(strips) / sizeof(strips[0]); s++) {
+        check_tiled(&tall, &tall_view, &codebook, strips[s]);
+    }
+
+    // 大图像中的子区域视图与其副本
+    Image large = make_random_image(90, 170, 33);
+    ImageView large_view = image_view(&large);
+    ImageView roi = image_view_roi(&large_view, 7, 11, 61, 141);
+    Image copy = extract_sub_image(&large, 7, 11, 61, 141);
+    check_tiled(&copy, &roi, &codebook, 16);
+
+    free_image(&copy);
+    free_image(&large);
+    free_image(&tall);
+    free_codebook(&codebook);
+    return TEST_RESULT();
+}
@@ -0,0 +1,122 @@
+// 三线性插值描述符对直接参考实现的误差测试
+// 参考实现逐像素以double计算高斯权重和双线性插值系数 (不使用查找表、不补单元格)，
+// compute_trilinear_descriptor 与 extract_dense_sift_trilinear_into 的每个分量之差
+// 不超过 TRILINEAR_SIFT_TOLERANCE (见 sift.h)，包括窗口部分越出图像的位置
+#include "test_common.h"
+#include "orientation.h"
+#include "sift.h"
+#include "spm.h"
+
+#define PATCH (SIFT_GRID_SIZE * SIFT_CELL_SIZE)
+#define HALF_WINDOW (PATCH / 2)
+
+static void reference_descriptor(const OrientationPlanes* planes, int x, int y, float* descriptor) {
+    double hist[SIFT_DESC_SIZE] = {0};
+    double sigma = 0.5 * PATCH;
+
+    for (int py = 0; py < PATCH; py++) {
+        int iy = y - HALF_WINDOW + py;
+        if (iy < 0 || iy >= planes->height) continue;
+        for (int px = 0; px < PATCH; px++) {
+            int ix = x - HALF_WINDOW + px;
+            if (ix < 0 || ix >= planes->width) continue;
+
+            double dx = (px + 0.5) - 0.5 * PATCH;
+            double dy = (py + 0.5) - 0.5 * PATCH;
+            double g = exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+            double cx = (px + 0.5) / SIFT_CELL_SIZE - 0.5;
+            double cy = (py + 0.5) / SIFT_CELL_SIZE - 0.5;
+            int x0 = (int)floor(cx);
+            int y0 = (int)floor(cy);
+            double fx = cx - x0;
+            double fy = cy - y0;
+            const float* pixel = planes->data + ((size_t)iy * planes->width + ix) * ORIENTATION_BINS;
+
+            for (int j = 0; j < 2; j++) {
+                int gy = y0 + j;
+                if (gy < 0 || gy >= SIFT_GRID_SIZE) continue;
+                double wy = j ? fy : 1.0 - fy;
+                for (int i = 0; i < 2; i++) {
+                    int gx = x0 + i;
+                    if (gx < 0 || gx >= SIFT_GRID_SIZE) continue;
+                    double w = g * wy * (i ? fx : 1.0 - fx);
+                    double* cell = hist + (gy * SIFT_GRID_SIZE + gx) * SIFT_ORI_BINS;
+                    for (int b = 0; b < SIFT_ORI_BINS; b++) {
+                        cell[b] += w * pixel[b];
+                    }
+                }
+            }
+        }
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        sum += hist[i] * hist[i];
+    }
+    double norm = sum > 0 ? 1.0 / sqrt(sum) : 1.0;
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        descriptor[i] = (float)(hist[i] * norm);
+    }
+}
+
+static float max_difference(const float* a, const float* b) {
+    float max_error = 0.0f;
+    for (int i = 0; i < SIFT_DESC_SIZE; i++) {
+        float error = fabsf(a[i] - b[i]);
+        if (error > max_error) max_error = error;
+    }
+    return max_error;
+}
+
+static void check_image(const Image* img, OrientationBinning binning) {
+    GrayImage gray = convert_to_gray(img);
+    OrientationPlanes planes = compute_orientation_planes(&gray, binning);
+    float expected[SIFT_DESC_SIZE];
+    float actual[SIFT_DESC_SIZE];
+
+    // 每个像素位置，包括窗口越出图像的边界位置
+    float max_error = 0.0f;
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            reference_descriptor(&planes, x, y, expected);
+            compute_trilinear_descriptor(&planes, x, y, actual);
+            float error = max_difference(expected, actual);
+            if (error > max_error) max_error = error;
+        }
+    }
+
+    // 密集版本: 网格坐标与逐点版本一致
+    int max_count = dense_sift_grid_count(img->width, SPM_SIFT_STEP) *
+                    dense_sift_grid_count(img->height, SPM_SIFT_STEP);
+    float* descriptors = allocate_float_array(max_count * SIFT_DESC_SIZE);
+    float* positions = allocate_float_array(max_count * 2);
+    int count = extract_dense_sift_trilinear_into(&planes, SPM_SIFT_STEP, descriptors, positions, max_count);
+    CHECK(count == max_count);
+    for (int i = 0; i < count; i++) {
+        reference_descriptor(&planes, (int)positions[i * 2], (int)positions[i * 2 + 1], expected);
+        float error = max_difference(expected, descriptors + (size_t)i * SIFT_DESC_SIZE);
+        if (error > max_error) max_error = error;
+    }
+
+    printf("trilinear (%s) %dx%d %s: max error %.3g\n", sift_trilinear_kernel_name(), img->width, img->height,
+           binning == ORIENTATION_SOFT ? "soft" : "hard", max_error);
+    CHECK(max_error <= TRILINEAR_SIFT_TOLERANCE);
+
+    free_float_array(positions);
+    free_float_array(descriptors);
+    free_orientation_planes(&planes);
+    free_gray_image(&gray);
+}
+
+int main(void) {
+    for (int i = 0; i < 3; i++) {
+        Image img = make_random_image(CIFAR_IMAGE_SIZE, CIFAR_IMAGE_SIZE, 800 + i);
+        check_image(&img, ORIENTATION_SOFT);
+        check_image(&img, ORIENTATION_HARD);
+        free_image(&img);
+    }
+    Image other = make_random_image(45, 29, 810);
+    check_image(&other, ORIENTATION_SOFT);
+    free_image(&other);
+    return TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+// 零拷贝视图与复制路径的一致性测试
+// 子区域、翻转和CIFAR记录视图上的灰度、梯度、模糊、方向平面和密集SIFT，须与先复制像素再计算的结果逐位相同
+#include "test_common.h"
+#include "orientation.h"
+#include "sift.h"
+#include "spm.h"
+
+static int same_gray(const GrayImage* a, const GrayImage* b) {
+    return a->width == b->width && a->height == b->height &&
+           memcmp(a->data, b->data, (size_t)a->width * a->height * sizeof(float)) == 0;
+}
+
+static int same_descriptors(const DescriptorList* a, const DescriptorList* b) {
+    if (a->count != b->count) {
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        const Descriptor* da = &a->descriptors[i];
+        const Descriptor* db = &b->descriptors[i];
+        if (da->x != db->x || da->y != db->y || da->length != db->length ||
+            memcmp(da->data, db->data, da->length * sizeof(float)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 子区域视图与 extract_sub_image 的副本 (包括超出图像而被裁剪的区域)
+static void check_roi(const Image* img, int x, int y, int width, int height) {
+    ImageView full = image_view(img);
+    ImageView roi = image_view_roi(&full, x, y, width, height);
+    Image copy = extract_sub_image(img, x, y, width, height);
+    CHECK(roi.width == copy.width && roi.height == copy.height);
+
+    DescriptorList from_view = extract_dense_sift_view(&roi, SPM_SIFT_STEP);
+    DescriptorList from_copy = extract_dense_sift(&copy, SPM_SIFT_STEP);
+    CHECK(from_view.count > 0);
+    CHECK(same_descriptors(&from_view, &from_copy));
+    free_descriptor_list(&from_view);
+    free_descriptor_list(&from_copy);
+
+    GrayImage gray_from_view = create_gray_image(roi.width, roi.height);
+    convert_view_to_gray_into(&roi, &gray_from_view);
+    GrayImage gray_from_copy = convert_to_gray(&copy);
+    CHECK(same_gray(&gray_from_view, &gray_from_copy));
+    free_gray_image(&gray_from_view);
+    free_gray_image(&gray_from_copy);
+    free_image(&copy);
+}
+
+// 灰度子区域视图上的梯度、模糊与方向平面
+static void check_gray_roi(const GrayImage* gray, int x, int y, int width, int height) {
+    GrayView full = gray_view(gray);
+    GrayView roi = gray_view_roi(&full, x, y, width, height);
+    GrayImage copy = create_gray_image(roi.width, roi.height);
+    for (int yy = 0; yy < roi.height; yy++) {
+        for (int xx = 0; xx < roi.width; xx++) {
+            copy.data[yy * copy.width + xx] = roi.data[yy * roi.row_stride + xx * roi.pixel_stride];
+        }
+    }
+
+    GrayImage magnitude = create_gray_image(roi.width, roi.height);
+    compute_gradient_magnitude_view_into(&roi, &magnitude);
+    GrayImage expected_magnitude = compute_gradient_magnitude(&copy);
+    CHECK(same_gray(&magnitude, &expected_magnitude));
+
+    GrayImage orientation = create_gray_image(roi.width, roi.height);
+    compute_gradient_orientation_view_into(&roi, &orientation);
+    GrayImage expected_orientation = compute_gradient_orientation(&copy);
+    CHECK(same_gray(&orientation, &expected_orientation));
+
+    GrayImage blurred = gaussian_blur_view(&roi, 1.2f);
+    GrayImage expected_blurred = gaussian_blur(&copy, 1.2f);
+    CHECK(same_gray(&blurred, &expected_blurred));
+
+    OrientationPlanes planes = create_orientation_planes(roi.width, roi.height);
+    compute_orientation_planes_view_into(&roi, &planes, ORIENTATION_SOFT);
+    OrientationPlanes expected_planes = compute_orientation_planes(&copy, ORIENTATION_SOFT);
+    CHECK(memcmp(planes.data, expected_planes.data,
+                 (size_t)roi.width * roi.height * ORIENTATION_BINS * sizeof(float)) == 0);
+
+    free_orientation_planes(&planes);
+    free_orientation_planes(&expected_planes);
+    free_gray_image(&blurred);
+    free_gray_image(&expected_blurred);
+    free_gray_image(&orientation);
+    free_gray_image(&expected_orientation);
+    free_gray_image(&magnitude);
+    free_gray_image(&expected_magnitude);
+    free_gray_image(&copy);
+}
+
+int main(void) {
+    Image img = make_random_image(57, 43, 3);
+    check_roi(&img, 0, 0, img.width, img.height);
+    check_roi(&img, 5, 7, 32, 24);
+    check_roi(&img, 40, 30, 30, 30);
+
+    // 水平翻转视图 (负像素步长) 与翻转后的副本
+    Image flipped = create_image(img.width, img.height, img.channels);
+    for (int y = 0; y < img.height; y++) {
+        for (int x = 0; x < img.width; x++) {
+            memcpy(flipped.data + ((size_t)y * img.width + x) * 3,
+                   img.data + ((size_t)y * img.width + (img.width - 1 - x)) * 3, 3);
+        }
+    }
+    ImageView full = image_view(&img);
+    ImageView flip = image_view_flip_horizontal(&full);
+    DescriptorList from_flip = extract_dense_sift_view(&flip, SPM_SIFT_STEP);
+    DescriptorList from_flipped = extract_dense_sift(&flipped, SPM_SIFT_STEP);
+    CHECK(same_descriptors(&from_flip, &from_flipped));
+    free_descriptor_list(&from_flip);
+    free_descriptor_list(&from_flipped);
+    free_image(&flipped);
+
+    // CIFAR记录视图 (按通道平面布局) 与解码后的图像
+    unsigned char record[CIFAR_RECORD_SIZE];
+    Rng rng = rng_create(4);
+    for (int i = 0; i < CIFAR_RECORD_SIZE; i++) {
+        record[i] = (unsigned char)(rng_next_u64(&rng) & 0xFF);
+    }
+    ImageView cifar = cifar_record_view(record);
+    Image decoded = decode_cifar_record(record);
+    DescriptorList from_record = extract_dense_sift_view(&cifar, SPM_SIFT_STEP);
+    DescriptorList from_decoded = extract_dense_sift(&decoded, SPM_SIFT_STEP);
+    CHECK(same_descriptors(&from_record, &from_decoded));
+    free_descriptor_list(&from_record);
+    free_descriptor_list(&from_decoded);
+    free_image(&decoded);
+
+    // 32x32 的稠密视图走专用模糊内核，大图中的子区域走通用路径
+    GrayImage gray = convert_to_gray(&img);
+    check_gray_roi(&gray, 0, 0, gray.width, gray.height);
+    check_gray_roi(&gray, 3, 2, 32, 32);
+    check_gray_roi(&gray, 50, 38, 20, 20);
+    GrayImage small = create_gray_image(32, 32);
+    for (int y = 0; y < 32; y++) {
+        memcpy(small.data + y * 32, gray.data + y * gray.width, 32 * sizeof(float));
+    }
+    check_gray_roi(&small, 0, 0, 32, 32);
+
+    free_gray_image(&small);
+    free_gray_image(&gray);
+    free_image(&img);
+    return TEST_RESULT();
+}